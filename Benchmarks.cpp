@@ -0,0 +1,1591 @@
+#include "Benchmarks.h"
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
+#include "VertexCompressor.h"
+#include "MeshSimplifier.h"
+#include "MeshClusterizer.h"
+#include "TangentGenerator.h"
+#include "MeshCodec.h"
+#include "PrimitiveGenerator.h"
+#include "MeshBvh.h"
+#include "GltfParser.h"
+#include "ProgressiveMesh.h"
+#include "MeshCache.h"
+#include "MeshLoader.h"
+#include "Transform.h"
+#include "TransformSystem.h"
+#include "Entity.h"
+#include "EntityStore.h"
+#include "RenderQueue.h"
+#include "ObjectPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+// Seconds elapsed since the given start point
+static double SecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count();
+}
+
+// Builds the text of a wavy, fully textured grid OBJ that's roughly the requested size
+static std::string GenerateGridObj(int megabytes)
+{
+	// Each grid point costs roughly 175 bytes of text once its quad is included
+	int resolution = 2;
+	while ((double)resolution * resolution * 175.0 < megabytes * 1024.0 * 1024.0)
+		resolution++;
+
+	std::string text;
+	text.reserve((size_t)megabytes * 1024 * 1024 + 4096);
+	char line[128];
+
+	for (int y = 0; y < resolution; y++)
+	{
+		for (int x = 0; x < resolution; x++)
+		{
+			float u = x / (float)(resolution - 1);
+			float v = y / (float)(resolution - 1);
+			text.append(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", u * 100.0f, (float)((x * 7 + y * 13) % 17) * 0.031f, v * 100.0f));
+			text.append(line, snprintf(line, sizeof(line), "vt %.6f %.6f\n", u, v));
+			text.append(line, snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", 0.0f, 1.0f, 0.0f));
+		}
+	}
+
+	for (int y = 0; y < resolution - 1; y++)
+	{
+		for (int x = 0; x < resolution - 1; x++)
+		{
+			int a = y * resolution + x + 1;
+			int b = a + 1;
+			int c = a + resolution + 1;
+			int d = a + resolution;
+			text.append(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d));
+		}
+	}
+
+	return text;
+}
+
+// Runs every benchmark with their default settings
+void RunBenchmarks()
+{
+	printf("---> Running benchmarks\n");
+	BenchmarkObjParsing(nullptr, 256);
+	BenchmarkObjParsingThreads(256);
+	BenchmarkVertexCache(16);
+	BenchmarkOverdraw(64, 0.5f, 3);
+	BenchmarkVertexCompression(1000000);
+	BenchmarkLods(nullptr, 4);
+	BenchmarkClusterCulling(128, 32);
+	BenchmarkTangents(96);
+	BenchmarkMeshCodec(32);
+	BenchmarkPrimitives(512);
+	BenchmarkRaycasts(nullptr, 256);
+	BenchmarkGlbParsing(64);
+	BenchmarkProgressiveStreaming(nullptr, 512, 10.0f);
+	BenchmarkTransforms(20);
+	BenchmarkTransformHierarchy(100000, 0.01f, 20);
+	BenchmarkEntityStorage(10);
+	BenchmarkEntityChurn(0.01f, 20);
+	BenchmarkObjectPools(250000, 4);
+	printf("---> Benchmarks finished\n");
+}
+
+// Parses an OBJ file repeatedly and reports throughput in MB/s
+void BenchmarkObjParsing(const char* objFile, int generatedMegabytes)
+{
+	const int iterations = 3;
+	double best = 1e30;
+	size_t bytes = 0;
+	ObjData obj;
+
+	if (objFile != nullptr)
+	{
+		// Straight from disk, which includes the cost of mapping and paging the file in
+		for (int i = 0; i < iterations; i++)
+		{
+			if (!ObjParser::ParseFile(objFile, obj))
+			{
+				printf("OBJ parse benchmark: couldn't open %s\n", objFile);
+				return;
+			}
+			bytes = obj.fileBytes;
+			best = obj.parseSeconds < best ? obj.parseSeconds : best;
+		}
+	}
+	else
+	{
+		// From a generated file already sitting in memory
+		std::string text = GenerateGridObj(generatedMegabytes);
+		bytes = text.size();
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			ObjParser::Parse(text.data(), text.data() + text.size(), obj);
+			double seconds = SecondsSince(start);
+			best = seconds < best ? seconds : best;
+		}
+	}
+
+	double megabytes = bytes / (1024.0 * 1024.0);
+	printf("OBJ parse: %.1f MB, %zu corners welded to %zu verts, %zu indices, best of %d = %.1f ms (%.1f MB/s)\n",
+		megabytes, obj.cornerCount, obj.verts.size(), obj.indices.size(), iterations, best * 1000.0, megabytes / best);
+}
+
+// Parses the same generated OBJ with 1 to N threads and reports how throughput scales
+void BenchmarkObjParsingThreads(int generatedMegabytes)
+{
+	std::string text = GenerateGridObj(generatedMegabytes);
+	double megabytes = text.size() / (1024.0 * 1024.0);
+	int maxThreads = (int)std::thread::hardware_concurrency();
+	if (maxThreads < 1)
+		maxThreads = 1;
+
+	printf("OBJ parse scaling on %.1f MB:\n", megabytes);
+	double singleThreaded = 0.0;
+	for (int threads = 1; threads <= maxThreads; threads = threads * 2 > maxThreads && threads != maxThreads ? maxThreads : threads * 2)
+	{
+		// Best of a few runs to smooth out noise
+		double best = 1e30;
+		ObjData obj;
+		for (int i = 0; i < 3; i++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			ObjParser::Parse(text.data(), text.data() + text.size(), obj, threads);
+			double seconds = SecondsSince(start);
+			best = seconds < best ? seconds : best;
+		}
+
+		if (threads == 1)
+			singleThreaded = best;
+		printf("  %2d threads: %.1f ms (%.1f MB/s, %.2fx)\n", threads, best * 1000.0, megabytes / best, singleThreaded / best);
+	}
+}
+
+// Prints FIFO and LRU cache stats for an index buffer
+static void PrintCacheStats(const char* label, const std::vector<unsigned int>& indices, int numVerts)
+{
+	VertexCacheStats fifo = MeshOptimizer::SimulateVertexCache(indices.data(), (int)indices.size(), numVerts, MeshOptimizer::DefaultCacheSize, false);
+	VertexCacheStats lru = MeshOptimizer::SimulateVertexCache(indices.data(), (int)indices.size(), numVerts, MeshOptimizer::DefaultCacheSize, true);
+	printf("  %-10s FIFO ACMR %.3f ATVR %.3f | LRU ACMR %.3f ATVR %.3f\n", label, fifo.acmr, fifo.atvr, lru.acmr, lru.atvr);
+}
+
+// Runs the vertex cache optimizer on a generated grid, both in file order and with shuffled triangles
+void BenchmarkVertexCache(int generatedMegabytes)
+{
+	std::string text = GenerateGridObj(generatedMegabytes);
+	ObjData obj;
+	ObjParser::Parse(text.data(), text.data() + text.size(), obj);
+	int numVerts = (int)obj.verts.size();
+	int numTriangles = (int)obj.indices.size() / 3;
+
+	// A shuffled copy stands in for meshes exported in a poor order
+	std::vector<unsigned int> shuffled(obj.indices.size());
+	unsigned int seed = 12345;
+	std::vector<int> order(numTriangles);
+	for (int t = 0; t < numTriangles; t++)
+		order[t] = t;
+	for (int t = numTriangles - 1; t > 0; t--)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		int other = (int)(seed % (unsigned int)(t + 1));
+		int temp = order[t];
+		order[t] = order[other];
+		order[other] = temp;
+	}
+	for (int t = 0; t < numTriangles; t++)
+		for (int c = 0; c < 3; c++)
+			shuffled[t * 3 + c] = obj.indices[order[t] * 3 + c];
+
+	printf("Vertex cache optimization on %d triangles (cache size %d):\n", numTriangles, MeshOptimizer::DefaultCacheSize);
+	std::vector<unsigned int>* inputs[] = { &obj.indices, &shuffled };
+	const char* names[] = { "file order", "shuffled" };
+	for (int i = 0; i < 2; i++)
+	{
+		std::vector<unsigned int>& indices = *inputs[i];
+		PrintCacheStats(names[i], indices, numVerts);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		MeshOptimizer::OptimizeVertexCache(indices.data(), (int)indices.size(), numVerts);
+		double seconds = SecondsSince(start);
+
+		PrintCacheStats("optimized", indices, numVerts);
+		printf("  optimizer took %.1f ms (%.1f M triangles/s)\n", seconds * 1000.0, numTriangles / seconds / 1e6);
+	}
+}
+
+// Prints overdraw and cache stats for a mesh
+static void PrintOverdrawStats(const char* label, const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices)
+{
+	OverdrawStats overdraw = MeshOptimizer::EstimateOverdraw(verts.data(), (int)verts.size(), indices.data(), (int)indices.size());
+	VertexCacheStats cache = MeshOptimizer::SimulateVertexCache(indices.data(), (int)indices.size(), (int)verts.size(), MeshOptimizer::DefaultCacheSize, false);
+	float fetch = MeshOptimizer::SimulateVertexFetch(indices.data(), (int)indices.size(), (int)verts.size(), sizeof(Vertex));
+	printf("  %-12s overdraw %.3f (%u shaded / %u covered), ACMR %.3f, overfetch %.3f\n",
+		label, overdraw.overdraw, overdraw.pixelsShaded, overdraw.pixelsCovered, cache.acmr, fetch);
+}
+
+// Runs the overdraw and vertex fetch passes on a set of nested, shuffled tori
+// (the inner ones are completely hidden, so draw order matters a lot)
+void BenchmarkOverdraw(int segments, float tubeStep, int layers)
+{
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	int rings = segments / 2;
+	for (int layer = 0; layer < layers; layer++)
+	{
+		unsigned int base = (unsigned int)verts.size();
+		float tubeRadius = 0.5f + tubeStep * layer;
+		for (int i = 0; i < segments; i++)
+		{
+			for (int j = 0; j < rings; j++)
+			{
+				float a = i * DirectX::XM_2PI / segments;
+				float b = j * DirectX::XM_2PI / rings;
+				Vertex v = {};
+				v.position = DirectX::XMFLOAT3((3.0f + tubeRadius * cosf(b)) * cosf(a), tubeRadius * sinf(b), (3.0f + tubeRadius * cosf(b)) * sinf(a));
+				verts.push_back(v);
+			}
+		}
+
+		// Clockwise (front facing) when seen from outside the tube
+		for (int i = 0; i < segments; i++)
+		{
+			for (int j = 0; j < rings; j++)
+			{
+				unsigned int a = base + i * rings + j;
+				unsigned int b = base + ((i + 1) % segments) * rings + j;
+				unsigned int c = base + i * rings + (j + 1) % rings;
+				unsigned int d = base + ((i + 1) % segments) * rings + (j + 1) % rings;
+				unsigned int quad[] = { a, c, b, b, c, d };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	// Shuffle the triangles
+	int numTriangles = (int)indices.size() / 3;
+	unsigned int seed = 777;
+	for (int t = numTriangles - 1; t > 0; t--)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		int other = (int)(seed % (unsigned int)(t + 1));
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int temp = indices[t * 3 + c];
+			indices[t * 3 + c] = indices[other * 3 + c];
+			indices[other * 3 + c] = temp;
+		}
+	}
+
+	printf("Overdraw and vertex fetch optimization on %d triangles:\n", numTriangles);
+	PrintOverdrawStats("shuffled", verts, indices);
+
+	MeshOptimizer::OptimizeVertexCache(indices.data(), (int)indices.size(), (int)verts.size());
+	PrintOverdrawStats("cache", verts, indices);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshOptimizer::OptimizeOverdraw(indices.data(), (int)indices.size(), verts.data(), (int)verts.size(), 1.05f);
+	double overdrawSeconds = SecondsSince(start);
+	PrintOverdrawStats("+ overdraw", verts, indices);
+
+	int numVerts = MeshOptimizer::OptimizeVertexFetch(verts.data(), (int)verts.size(), indices.data(), (int)indices.size());
+	verts.resize(numVerts);
+	PrintOverdrawStats("+ fetch", verts, indices);
+	printf("  overdraw pass took %.2f ms\n", overdrawSeconds * 1000.0);
+}
+
+// Encodes a set of random vertices with the scalar and SSE encoders, then reports speed, size and error
+void BenchmarkVertexCompression(int vertexCount)
+{
+	// Random unit normals and tangents, positions in a 100 unit box and uvs that tile a few times
+	std::vector<Vertex> verts(vertexCount);
+	std::vector<float> handedness(vertexCount);
+	unsigned int seed = 1234;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 8388608.0f - 1.0f; };
+	for (int i = 0; i < vertexCount; i++)
+	{
+		DirectX::XMFLOAT3 normal(random(), random(), random());
+		DirectX::XMFLOAT3 tangent(random(), random(), random());
+		DirectX::XMStoreFloat3(&verts[i].normal, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&normal)));
+		DirectX::XMStoreFloat3(&verts[i].tangent, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&tangent)));
+		verts[i].position = DirectX::XMFLOAT3(random() * 50.0f, random() * 50.0f, random() * 50.0f);
+		verts[i].uv = DirectX::XMFLOAT2(random() * 4.0f, random() * 4.0f);
+		handedness[i] = random() < 0.0f ? -1.0f : 1.0f;
+	}
+	DirectX::XMFLOAT3 boundsMin(-50.0f, -50.0f, -50.0f);
+	DirectX::XMFLOAT3 boundsMax(50.0f, 50.0f, 50.0f);
+
+	std::vector<CompactVertex> compact(vertexCount);
+	std::vector<QuantizedVertex> quantized(vertexCount);
+	const int runs = 10;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		VertexCompressor::EncodeScalar(verts.data(), vertexCount, handedness.data(), compact.data());
+	double scalarSeconds = SecondsSince(start) / runs;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		VertexCompressor::Encode(verts.data(), vertexCount, handedness.data(), compact.data());
+	double simdSeconds = SecondsSince(start) / runs;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		VertexCompressor::EncodeQuantized(verts.data(), vertexCount, handedness.data(), boundsMin, boundsMax, quantized.data());
+	double quantizedSeconds = SecondsSince(start) / runs;
+
+	printf("Vertex compression of %d vertices:\n", vertexCount);
+	printf("  scalar encode     %7.2f ms (%.1f M verts/s)\n", scalarSeconds * 1000.0, vertexCount / scalarSeconds / 1e6);
+	printf("  SSE encode        %7.2f ms (%.1f M verts/s, %.2fx)\n", simdSeconds * 1000.0, vertexCount / simdSeconds / 1e6, scalarSeconds / simdSeconds);
+	printf("  SSE quantized     %7.2f ms (%.1f M verts/s)\n", quantizedSeconds * 1000.0, vertexCount / quantizedSeconds / 1e6);
+
+	// Error of each format against the originals
+	std::vector<Vertex> decoded(vertexCount);
+	std::vector<float> decodedHandedness(vertexCount);
+	VertexCompressor::Decode(compact.data(), vertexCount, decoded.data(), decodedHandedness.data());
+	VertexErrorStats compactError = VertexCompressor::MeasureError(verts.data(), decoded.data(), vertexCount, handedness.data(), decodedHandedness.data());
+	VertexCompressor::DecodeQuantized(quantized.data(), vertexCount, boundsMin, boundsMax, decoded.data(), decodedHandedness.data());
+	VertexErrorStats quantizedError = VertexCompressor::MeasureError(verts.data(), decoded.data(), vertexCount, handedness.data(), decodedHandedness.data());
+
+	printf("  %-9s %2zu bytes (%.0f%%), max error: position %g, normal %.4f deg, tangent %.4f deg, uv %g, %d handedness flips\n",
+		"compact", sizeof(CompactVertex), 100.0 * sizeof(CompactVertex) / sizeof(Vertex),
+		compactError.positionError, compactError.normalAngle, compactError.tangentAngle, compactError.uvError, compactError.handednessFlips);
+	printf("  %-9s %2zu bytes (%.0f%%), max error: position %g, normal %.4f deg, tangent %.4f deg, uv %g, %d handedness flips\n",
+		"quantized", sizeof(QuantizedVertex), 100.0 * sizeof(QuantizedVertex) / sizeof(Vertex),
+		quantizedError.positionError, quantizedError.normalAngle, quantizedError.tangentAngle, quantizedError.uvError, quantizedError.handednessFlips);
+}
+
+// Builds a level of detail chain the same way Mesh does (half the triangles per level, 5% max error)
+// and reports the triangle count, estimated error and measured distance for each level
+void BenchmarkLods(const char* objFile, int generatedMegabytes)
+{
+	ObjData obj;
+	if (objFile != nullptr)
+	{
+		if (!ObjParser::ParseFile(objFile, obj))
+		{
+			printf("LOD benchmark: couldn't open %s\n", objFile);
+			return;
+		}
+	}
+	else
+	{
+		std::string text = GenerateGridObj(generatedMegabytes);
+		ObjParser::Parse(text.data(), text.data() + text.size(), obj);
+	}
+
+	int numVerts = (int)obj.verts.size();
+	int fullCount = (int)obj.indices.size();
+	float scale = MeshSimplifier::GetMeshScale(obj.verts.data(), numVerts);
+	std::vector<unsigned int> simplified(fullCount);
+
+	printf("LOD chain for %s (%d triangles, %g units across):\n", objFile ? objFile : "generated grid", fullCount / 3, scale);
+	int previousCount = fullCount;
+	for (int level = 1; level < 5; level++)
+	{
+		float error = 0.0f;
+		auto start = std::chrono::high_resolution_clock::now();
+		int count = MeshSimplifier::Simplify(obj.verts.data(), numVerts, obj.indices.data(), fullCount, (fullCount >> level) / 3 * 3, 0.05f, simplified.data(), &error);
+		double seconds = SecondsSince(start);
+
+		float distance = MeshSimplifier::MeasureDistance(obj.verts.data(), numVerts, obj.indices.data(), fullCount, simplified.data(), count, 2000);
+		printf("  lod %d: %7d tris (%5.1f%%), quadric error %g, measured distance %g, %.1f ms\n",
+			level, count / 3, 100.0 * count / fullCount, error * scale, distance, seconds * 1000.0);
+
+		if (count == 0 || count > previousCount * 3 / 4)
+		{
+			printf("  simplification stalled, Mesh would stop at lod %d\n", level - 1);
+			break;
+		}
+		previousCount = count;
+	}
+}
+
+// Builds a unit sphere with clockwise (front facing) triangles when seen from outside
+static void GenerateSphere(int segments, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	int rings = segments / 2;
+	for (int j = 0; j <= rings; j++)
+	{
+		for (int i = 0; i <= segments; i++)
+		{
+			float phi = j * DirectX::XM_PI / rings;
+			float theta = i * DirectX::XM_2PI / segments;
+			Vertex v = {};
+			v.position = DirectX::XMFLOAT3(sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta));
+			v.normal = v.position;
+			v.uv = DirectX::XMFLOAT2(i / (float)segments, j / (float)rings);
+			verts.push_back(v);
+		}
+	}
+
+	for (int j = 0; j < rings; j++)
+	{
+		for (int i = 0; i < segments; i++)
+		{
+			unsigned int a = j * (segments + 1) + i;
+			unsigned int b = a + 1;
+			unsigned int c = a + segments + 1;
+			unsigned int d = c + 1;
+			unsigned int quad[] = { a, b, c, b, d, c };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+// Culls every copy in the grid and prints the totals for one frame
+static void CullSphereGrid(const char* label, const std::vector<MeshCluster>& clusters, int gridSize,
+	const DirectX::XMFLOAT4X4& viewProj, DirectX::XMFLOAT3 cameraPosition)
+{
+	const int Frames = 10;
+	std::vector<MeshIndexRange> ranges;
+	ClusterCullStats total = {};
+	size_t draws = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < Frames; frame++)
+	{
+		total = {};
+		draws = 0;
+		for (int z = 0; z < gridSize; z++)
+		{
+			for (int x = 0; x < gridSize; x++)
+			{
+				// Spread out in front of the camera, turned a little so the copies don't all match
+				DirectX::XMFLOAT4X4 world;
+				DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixMultiply(
+					DirectX::XMMatrixRotationRollPitchYaw(0.0f, (x * 7 + z * 3) * 0.1f, 0.0f),
+					DirectX::XMMatrixTranslation((x - gridSize / 2) * 3.0f, 0.0f, z * 3.0f + 5.0f)));
+
+				ranges.clear();
+				ClusterCullStats stats = MeshClusterizer::CullClusters(clusters.data(), (int)clusters.size(), world, viewProj, cameraPosition, ranges);
+				total.clustersVisible += stats.clustersVisible;
+				total.trianglesDrawn += stats.trianglesDrawn;
+				total.trianglesFrustumCulled += stats.trianglesFrustumCulled;
+				total.trianglesBackfaceCulled += stats.trianglesBackfaceCulled;
+				draws += ranges.size();
+			}
+		}
+	}
+	double seconds = SecondsSince(start) / Frames;
+
+	unsigned int triangles = total.trianglesDrawn + total.trianglesFrustumCulled + total.trianglesBackfaceCulled;
+	printf("  %-14s drawn %5.1f%%, frustum culled %5.1f%%, back face culled %5.1f%%, %zu draws, %.3f ms per frame\n",
+		label, 100.0 * total.trianglesDrawn / triangles, 100.0 * total.trianglesFrustumCulled / triangles,
+		100.0 * total.trianglesBackfaceCulled / triangles, draws, seconds * 1000.0);
+}
+
+// Clusters a dense sphere, then culls a grid of copies of it and reports the triangles rejected
+void BenchmarkClusterCulling(int segments, int gridSize)
+{
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	GenerateSphere(segments, verts, indices);
+	MeshOptimizer::OptimizeVertexCache(indices.data(), (int)indices.size(), (int)verts.size());
+	int numTriangles = (int)indices.size() / 3;
+
+	// The same thing Mesh does on import
+	std::vector<MeshCluster> clusters;
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshClusterizer::BuildClusters(verts.data(), (int)verts.size(), indices.data(), (int)indices.size(), MeshClusterizer::MaxVertices, MeshClusterizer::MaxTriangles, clusters);
+	double buildSeconds = SecondsSince(start);
+
+	int cullable = 0;
+	for (size_t i = 0; i < clusters.size(); i++)
+		cullable += clusters[i].coneCutoff < 1.0f;
+
+	printf("Cluster culling on a %dx%d grid of %d triangle spheres (%d triangles):\n", gridSize, gridSize, numTriangles, numTriangles * gridSize * gridSize);
+	printf("  %zu clusters (%.1f tris each, %d back face cullable), built in %.2f ms\n",
+		clusters.size(), numTriangles / (double)clusters.size(), cullable, buildSeconds * 1000.0);
+
+	// A single cluster covering everything is the same as whole object culling
+	MeshCluster whole = clusters[0];
+	whole.startIndex = 0;
+	whole.indexCount = numTriangles * 3;
+	whole.center = DirectX::XMFLOAT3(0, 0, 0);
+	whole.radius = 1.0f;
+	whole.coneCutoff = 1.0f;
+	std::vector<MeshCluster> wholeMesh(1, whole);
+
+	// Same projection as Camera, a little above the grid and looking down along it
+	DirectX::XMFLOAT3 cameraPosition(0.0f, 4.0f, 0.0f);
+	DirectX::XMVECTOR eye = DirectX::XMLoadFloat3(&cameraPosition);
+	DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(eye, DirectX::XMVectorSet(0.0f, -0.3f, 1.0f, 0.0f), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	DirectX::XMMATRIX proj = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PI / 4.0f, 16.0f / 9.0f, 0.01f, 1000.0f);
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(view, proj));
+
+	CullSphereGrid("whole objects", wholeMesh, gridSize, viewProj, cameraPosition);
+	CullSphereGrid("clusters", clusters, gridSize, viewProj, cameraPosition);
+}
+
+// Largest angle between the tangents of two copies of the same vertices, in degrees
+// - Measured with atan2 instead of acos, which can't resolve tiny angles near a dot product of 1
+static float MaxTangentAngle(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+{
+	float largest = 0.0f;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		DirectX::XMVECTOR ta = DirectX::XMLoadFloat3(&a[i].tangent);
+		DirectX::XMVECTOR tb = DirectX::XMLoadFloat3(&b[i].tangent);
+		float sine = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3Cross(ta, tb)));
+		float cosine = DirectX::XMVectorGetX(DirectX::XMVector3Dot(ta, tb));
+		largest = fmaxf(largest, atan2f(sine, cosine));
+	}
+	return DirectX::XMConvertToDegrees(largest);
+}
+
+// Counts the tangents with an infinity or NaN in them
+static int CountBadTangents(const std::vector<Vertex>& verts)
+{
+	int bad = 0;
+	for (size_t i = 0; i < verts.size(); i++)
+		bad += !std::isfinite(verts[i].tangent.x + verts[i].tangent.y + verts[i].tangent.z);
+	return bad;
+}
+
+// Times the scalar and SSE tangent paths on a generated grid and compares their results
+void BenchmarkTangents(int generatedMegabytes)
+{
+	const int Runs = 5;
+
+	ObjData obj;
+	std::string text = GenerateGridObj(generatedMegabytes);
+	ObjParser::Parse(text.data(), text.data() + text.size(), obj);
+	int numVerts = (int)obj.verts.size();
+	int numIndices = (int)obj.indices.size();
+	int threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+
+	printf("Tangent generation on %d triangles (%d verts), best of %d runs:\n", numIndices / 3, numVerts, Runs);
+
+	std::vector<Vertex> scalar = obj.verts;
+	std::vector<Vertex> simd = obj.verts;
+	double scalarSeconds = 1e9;
+	for (int run = 0; run < Runs; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		TangentGenerator::CalculateScalar(scalar.data(), numVerts, obj.indices.data(), numIndices);
+		scalarSeconds = fmin(scalarSeconds, SecondsSince(start));
+	}
+	printf("  scalar:             %8.2f ms\n", scalarSeconds * 1000.0);
+
+	int threadCounts[] = { 1, threads };
+	for (int t = 0; t < (threads > 1 ? 2 : 1); t++)
+	{
+		double seconds = 1e9;
+		for (int run = 0; run < Runs; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			TangentGenerator::Calculate(simd.data(), numVerts, obj.indices.data(), numIndices, threadCounts[t]);
+			seconds = fmin(seconds, SecondsSince(start));
+		}
+		printf("  sse, %2d thread(s):  %8.2f ms (%.1fx), max difference from scalar %.4f deg\n",
+			threadCounts[t], seconds * 1000.0, scalarSeconds / seconds, MaxTangentAngle(scalar, simd));
+	}
+
+	// Collapse the uvs of every 10th row of vertices (and a few normals) so plenty of triangles are degenerate
+	int resolution = (int)sqrt((double)numVerts);
+	for (int i = 0; i < numVerts; i++)
+	{
+		if ((i / resolution) % 10 == 0)
+			simd[i].uv = DirectX::XMFLOAT2(0.5f, 0.5f);
+		if (i % 1000 == 0)
+			simd[i].normal = DirectX::XMFLOAT3(0, 0, 0);
+	}
+	TangentGenerator::Calculate(simd.data(), numVerts, obj.indices.data(), numIndices, threads);
+	printf("  degenerate uvs:     %d bad tangents\n", CountBadTangents(simd));
+}
+
+// Encodes and decodes one mesh, checking the decoded data matches exactly and printing sizes and speeds
+static void MeasureMeshCodec(const char* label, const void* verts, int numVerts, int stride, const unsigned int* indices, int numIndices)
+{
+	const int Runs = 5;
+	size_t vertexBytes = (size_t)numVerts * stride;
+	size_t indexBytes = (size_t)numIndices * sizeof(unsigned int);
+
+	std::vector<unsigned char> encodedVertices;
+	std::vector<unsigned char> encodedIndices;
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshCodec::EncodeVertices(verts, numVerts, stride, encodedVertices);
+	MeshCodec::EncodeIndices(indices, numIndices, encodedIndices);
+	double encodeSeconds = SecondsSince(start);
+
+	std::vector<unsigned char> decodedVertices(vertexBytes);
+	std::vector<unsigned int> decodedIndices(numIndices);
+	double vertexSeconds = 1e9;
+	double indexSeconds = 1e9;
+	bool decoded = true;
+	for (int run = 0; run < Runs; run++)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		decoded &= MeshCodec::DecodeVertices(encodedVertices.data(), encodedVertices.size(), decodedVertices.data(), numVerts, stride);
+		vertexSeconds = fmin(vertexSeconds, SecondsSince(start));
+
+		start = std::chrono::high_resolution_clock::now();
+		decoded &= MeshCodec::DecodeIndices(encodedIndices.data(), encodedIndices.size(), decodedIndices.data(), numIndices);
+		indexSeconds = fmin(indexSeconds, SecondsSince(start));
+	}
+
+	// Cutting either stream short has to be caught rather than read past the end
+	bool truncatedRejected =
+		!MeshCodec::DecodeVertices(encodedVertices.data(), encodedVertices.size() - 1, decodedVertices.data(), numVerts, stride) &&
+		!MeshCodec::DecodeIndices(encodedIndices.data(), encodedIndices.size() - 1, decodedIndices.data(), numIndices);
+
+	// Decode once more so the truncated attempts above can't affect the comparison
+	decoded &= MeshCodec::DecodeVertices(encodedVertices.data(), encodedVertices.size(), decodedVertices.data(), numVerts, stride);
+	decoded &= MeshCodec::DecodeIndices(encodedIndices.data(), encodedIndices.size(), decodedIndices.data(), numIndices);
+	bool identical = decoded && memcmp(decodedVertices.data(), verts, vertexBytes) == 0 && memcmp(decodedIndices.data(), indices, indexBytes) == 0;
+
+	printf("  %s (%d verts of %d bytes, %d tris):\n", label, numVerts, stride, numIndices / 3);
+	printf("    vertices: %8.1f KB -> %8.1f KB (%.2fx), decode %.2f GB/s\n",
+		vertexBytes / 1024.0, encodedVertices.size() / 1024.0, vertexBytes / (double)encodedVertices.size(), vertexBytes / vertexSeconds / 1e9);
+	printf("    indices:  %8.1f KB -> %8.1f KB (%.1f bits per triangle), decode %.2f GB/s\n",
+		indexBytes / 1024.0, encodedIndices.size() / 1024.0, encodedIndices.size() * 8.0 / (numIndices / 3), indexBytes / indexSeconds / 1e9);
+	printf("    encode %.1f MB/s, round trip %s, truncated data %s\n",
+		(vertexBytes + indexBytes) / encodeSeconds / (1024.0 * 1024.0), identical ? "identical" : "MISMATCH", truncatedRejected ? "rejected" : "NOT REJECTED");
+}
+
+// Runs the mesh codec on a generated grid (with and without the mesh optimizations), a sphere, and compact vertices
+void BenchmarkMeshCodec(int generatedMegabytes)
+{
+	printf("Mesh codec, decode speeds are the best of 5 runs on one thread:\n");
+
+	ObjData obj;
+	std::string text = GenerateGridObj(generatedMegabytes);
+	ObjParser::Parse(text.data(), text.data() + text.size(), obj);
+	int numVerts = (int)obj.verts.size();
+	int numIndices = (int)obj.indices.size();
+	TangentGenerator::Calculate(obj.verts.data(), numVerts, obj.indices.data(), numIndices);
+	MeasureMeshCodec("grid, as parsed", obj.verts.data(), numVerts, sizeof(Vertex), obj.indices.data(), numIndices);
+
+	// The order the cache actually stores meshes in
+	MeshOptimizer::OptimizeVertexCache(obj.indices.data(), numIndices, numVerts);
+	numVerts = MeshOptimizer::OptimizeVertexFetch(obj.verts.data(), numVerts, obj.indices.data(), numIndices);
+	MeasureMeshCodec("grid, optimized", obj.verts.data(), numVerts, sizeof(Vertex), obj.indices.data(), numIndices);
+
+	std::vector<CompactVertex> compact(numVerts);
+	VertexCompressor::Encode(obj.verts.data(), numVerts, nullptr, compact.data());
+	MeasureMeshCodec("grid, optimized compact vertices", compact.data(), numVerts, sizeof(CompactVertex), obj.indices.data(), numIndices);
+
+	std::vector<Vertex> sphereVerts;
+	std::vector<unsigned int> sphereIndices;
+	GenerateSphere(512, sphereVerts, sphereIndices);
+	int sphereVertCount = (int)sphereVerts.size();
+	TangentGenerator::Calculate(sphereVerts.data(), sphereVertCount, sphereIndices.data(), (int)sphereIndices.size());
+	MeshOptimizer::OptimizeVertexCache(sphereIndices.data(), (int)sphereIndices.size(), sphereVertCount);
+	sphereVertCount = MeshOptimizer::OptimizeVertexFetch(sphereVerts.data(), sphereVertCount, sphereIndices.data(), (int)sphereIndices.size());
+	MeasureMeshCodec("sphere, optimized", sphereVerts.data(), sphereVertCount, sizeof(Vertex), sphereIndices.data(), (int)sphereIndices.size());
+}
+
+// Times one shape, generating into the same data every run so only the first one allocates
+static void MeasurePrimitive(const char* label, void (*generate)(MeshData&, int), int segments)
+{
+	const int Runs = 10;
+	MeshData data;
+	double seconds = 1e9;
+	for (int run = 0; run < Runs; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		generate(data, segments);
+		seconds = fmin(seconds, SecondsSince(start));
+	}
+
+	double tangentSeconds = 1e9;
+	for (int run = 0; run < Runs; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		TangentGenerator::Calculate(data.verts.data(), (int)data.verts.size(), data.indices.data(), (int)data.indices.size());
+		tangentSeconds = fmin(tangentSeconds, SecondsSince(start));
+	}
+
+	printf("  %-9s %8zu verts %8zu tris: %8.1f us (%6.1f Mverts/s), tangent generation would add %8.1f us\n",
+		label, data.verts.size(), data.indices.size() / 3, seconds * 1e6, data.verts.size() / seconds / 1e6, tangentSeconds * 1e6);
+}
+
+// Every shape at a similar density
+void BenchmarkPrimitives(int segments)
+{
+	printf("Primitive generation with %d segments, best of 10 runs:\n", segments);
+	MeasurePrimitive("sphere", [](MeshData& data, int n) { PrimitiveGenerator::Sphere(data, 0.5f, n, n / 2); }, segments);
+	MeasurePrimitive("cube", [](MeshData& data, int n) { PrimitiveGenerator::Cube(data, 1.0f, n / 2); }, segments);
+	MeasurePrimitive("cylinder", [](MeshData& data, int n) { PrimitiveGenerator::Cylinder(data, 0.5f, 1.0f, n, n / 2); }, segments);
+	MeasurePrimitive("cone", [](MeshData& data, int n) { PrimitiveGenerator::Cone(data, 0.5f, 1.0f, n, n / 2); }, segments);
+	MeasurePrimitive("torus", [](MeshData& data, int n) { PrimitiveGenerator::Torus(data, 0.5f, 0.2f, n, n / 2); }, segments);
+	MeasurePrimitive("helix", [](MeshData& data, int n) { PrimitiveGenerator::Helix(data, 0.5f, 0.15f, 2.0f, 2.0f, n, n / 2); }, segments);
+}
+
+// Scalar ray test against every triangle, the reference the BVH has to agree with
+static bool BruteForceRaycast(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices,
+	DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, float& distance)
+{
+	using namespace DirectX;
+	XMVECTOR o = XMLoadFloat3(&origin);
+	XMVECTOR d = XMLoadFloat3(&direction);
+	distance = maxDistance;
+	bool hit = false;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		XMVECTOR a = XMLoadFloat3(&verts[indices[i]].position);
+		XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&verts[indices[i + 1]].position), a);
+		XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&verts[indices[i + 2]].position), a);
+		XMVECTOR p = XMVector3Cross(d, e2);
+		float det = XMVectorGetX(XMVector3Dot(e1, p));
+		if (det == 0.0f)
+			continue;
+
+		XMVECTOR s = XMVectorSubtract(o, a);
+		XMVECTOR q = XMVector3Cross(s, e1);
+		float u = XMVectorGetX(XMVector3Dot(s, p)) / det;
+		float v = XMVectorGetX(XMVector3Dot(d, q)) / det;
+		float t = XMVectorGetX(XMVector3Dot(e2, q)) / det;
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < distance)
+		{
+			distance = t;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+// Builds a BVH over one mesh, then fires random rays at it from outside its bounds
+// - Rays aim at random points inside the bounds, so most of them hit but plenty graze past
+static void MeasureRaycasts(const char* label, const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices)
+{
+	const int RayCount = 1000000;
+	const int CheckedRays = 1000;
+
+	MeshBvh bvh;
+	auto start = std::chrono::high_resolution_clock::now();
+	bvh.Build(verts.data(), (int)verts.size(), indices.data(), (int)indices.size());
+	double buildSeconds = SecondsSince(start);
+
+	DirectX::XMFLOAT3 boundsMin = verts[0].position, boundsMax = verts[0].position;
+	for (const Vertex& vert : verts)
+	{
+		boundsMin = DirectX::XMFLOAT3(fminf(boundsMin.x, vert.position.x), fminf(boundsMin.y, vert.position.y), fminf(boundsMin.z, vert.position.z));
+		boundsMax = DirectX::XMFLOAT3(fmaxf(boundsMax.x, vert.position.x), fmaxf(boundsMax.y, vert.position.y), fmaxf(boundsMax.z, vert.position.z));
+	}
+	DirectX::XMFLOAT3 center((boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f);
+	DirectX::XMFLOAT3 half((boundsMax.x - boundsMin.x) * 0.5f, (boundsMax.y - boundsMin.y) * 0.5f, (boundsMax.z - boundsMin.z) * 0.5f);
+	float radius = sqrtf(half.x * half.x + half.y * half.y + half.z * half.z) * 2.0f;
+
+	unsigned int seed = 12345u;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 8388608.0f - 1.0f; };
+	std::vector<DirectX::XMFLOAT3> origins(RayCount), directions(RayCount);
+	for (int i = 0; i < RayCount; i++)
+	{
+		DirectX::XMFLOAT3 side(random(), random(), random());
+		float length = sqrtf(side.x * side.x + side.y * side.y + side.z * side.z) + 1e-6f;
+		origins[i] = DirectX::XMFLOAT3(center.x + side.x / length * radius, center.y + side.y / length * radius, center.z + side.z / length * radius);
+		DirectX::XMFLOAT3 target(center.x + random() * half.x, center.y + random() * half.y, center.z + random() * half.z);
+		directions[i] = DirectX::XMFLOAT3(target.x - origins[i].x, target.y - origins[i].y, target.z - origins[i].z);
+	}
+
+	// Rays reach just past their target, far enough to cross the whole mesh
+	int closestHits = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < RayCount; i++)
+	{
+		MeshRayHit hit;
+		closestHits += bvh.IntersectClosest(origins[i], directions[i], 2.0f, hit) ? 1 : 0;
+	}
+	double closestSeconds = SecondsSince(start);
+
+	int anyHits = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < RayCount; i++)
+		anyHits += bvh.IntersectAny(origins[i], directions[i], 2.0f) ? 1 : 0;
+	double anySeconds = SecondsSince(start);
+
+	int mismatches = 0;
+	for (int i = 0; i < CheckedRays; i++)
+	{
+		float expected = 0.0f;
+		MeshRayHit hit;
+		bool expectedHit = BruteForceRaycast(verts, indices, origins[i], directions[i], 2.0f, expected);
+		bool bvhHit = bvh.IntersectClosest(origins[i], directions[i], 2.0f, hit);
+		if (expectedHit != bvhHit || (bvhHit && fabsf(hit.distance - expected) > 1e-5f))
+			mismatches++;
+	}
+
+	printf("  %-9s %8d tris: built in %7.2f ms (%6d nodes, depth %2d, %7.1f KB), closest %6.2f Mrays/s, any %6.2f Mrays/s, %4.1f%% hit, %d/%d differ from brute force\n",
+		label, bvh.GetTriangleCount(), buildSeconds * 1000.0, bvh.GetNodeCount(), bvh.GetDepth(), bvh.GetMemoryBytes() / 1024.0,
+		RayCount / closestSeconds / 1e6, RayCount / anySeconds / 1e6, 100.0 * closestHits / RayCount, mismatches, CheckedRays);
+	if (anyHits != closestHits)
+		printf("  %-9s any hit and closest hit disagree on %d rays\n", label, abs(anyHits - closestHits));
+}
+
+// Every built-in shape at a similar density, or the given OBJ file instead
+void BenchmarkRaycasts(const char* objFile, int segments)
+{
+	printf("BVH ray queries, single threaded:\n");
+	if (objFile != nullptr)
+	{
+		ObjData obj;
+		if (!ObjParser::ParseFile(objFile, obj) || obj.indices.empty())
+		{
+			printf("  couldn't open %s\n", objFile);
+			return;
+		}
+		MeasureRaycasts(objFile, obj.verts, obj.indices);
+		return;
+	}
+
+	MeshData data;
+	PrimitiveGenerator::Sphere(data, 0.5f, segments, segments / 2);
+	MeasureRaycasts("sphere", data.verts, data.indices);
+	PrimitiveGenerator::Cube(data, 1.0f, segments / 2);
+	MeasureRaycasts("cube", data.verts, data.indices);
+	PrimitiveGenerator::Cylinder(data, 0.5f, 1.0f, segments, segments / 2);
+	MeasureRaycasts("cylinder", data.verts, data.indices);
+	PrimitiveGenerator::Cone(data, 0.5f, 1.0f, segments, segments / 2);
+	MeasureRaycasts("cone", data.verts, data.indices);
+	PrimitiveGenerator::Torus(data, 0.5f, 0.2f, segments, segments / 2);
+	MeasureRaycasts("torus", data.verts, data.indices);
+	PrimitiveGenerator::Helix(data, 0.5f, 0.15f, 2.0f, 2.0f, segments, segments / 2);
+	MeasureRaycasts("helix", data.verts, data.indices);
+}
+
+// Writes parsed OBJ data back out as an equivalent .glb, converting it back to glTF's right-handed space
+// - Every attribute gets its own tightly packed float accessor, the common layout exporters write
+static std::string BuildGlb(const ObjData& obj)
+{
+	size_t vertexCount = obj.verts.size();
+	std::vector<float> positions(vertexCount * 3), normals(vertexCount * 3), tangents(vertexCount * 4), uvs(vertexCount * 2);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const Vertex& v = obj.verts[i];
+		float position[3] = { v.position.x, v.position.y, -v.position.z };
+		float normal[3] = { v.normal.x, v.normal.y, -v.normal.z };
+		float tangent[4] = { v.tangent.x, v.tangent.y, -v.tangent.z, 1.0f };
+		memcpy(&positions[i * 3], position, sizeof(position));
+		memcpy(&normals[i * 3], normal, sizeof(normal));
+		memcpy(&tangents[i * 4], tangent, sizeof(tangent));
+		uvs[i * 2] = v.uv.x;
+		uvs[i * 2 + 1] = v.uv.y;
+	}
+
+	std::vector<unsigned int> indices(obj.indices);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		std::swap(indices[i + 1], indices[i + 2]);
+
+	// One buffer view per attribute, back to back in the binary chunk
+	std::string bin;
+	const void* blocks[] = { positions.data(), normals.data(), tangents.data(), uvs.data(), indices.data() };
+	size_t sizes[] = { positions.size() * 4, normals.size() * 4, tangents.size() * 4, uvs.size() * 4, indices.size() * 4 };
+	size_t offsets[5];
+	for (int b = 0; b < 5; b++)
+	{
+		offsets[b] = bin.size();
+		bin.append((const char*)blocks[b], sizes[b]);
+	}
+
+	char json[2048];
+	int jsonLength = snprintf(json, sizeof(json),
+		"{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0,\"name\":\"grid\"}],"
+		"\"meshes\":[{\"name\":\"grid\",\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TANGENT\":2,\"TEXCOORD_0\":3},\"indices\":4,\"material\":0}]}],"
+		"\"materials\":[{\"name\":\"ground\"}],\"buffers\":[{\"byteLength\":%zu}],"
+		"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},"
+		"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+		"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},{\"bufferView\":1,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+		"{\"bufferView\":2,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC4\"},{\"bufferView\":3,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+		"{\"bufferView\":4,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+		bin.size(), offsets[0], sizes[0], offsets[1], sizes[1], offsets[2], sizes[2], offsets[3], sizes[3], offsets[4], sizes[4],
+		vertexCount, vertexCount, vertexCount, vertexCount, indices.size());
+
+	// Chunks are padded to four bytes, the JSON one with spaces
+	std::string jsonChunk(json, jsonLength);
+	jsonChunk.resize((jsonChunk.size() + 3) & ~(size_t)3, ' ');
+	bin.resize((bin.size() + 3) & ~(size_t)3, '\0');
+
+	unsigned int header[5] = { 0x46546C67, 2, (unsigned int)(12 + 8 + jsonChunk.size() + 8 + bin.size()), (unsigned int)jsonChunk.size(), 0x4E4F534A };
+	unsigned int binHeader[2] = { (unsigned int)bin.size(), 0x004E4942 };
+	std::string glb((const char*)header, sizeof(header));
+	glb += jsonChunk;
+	glb.append((const char*)binHeader, sizeof(binHeader));
+	glb += bin;
+	return glb;
+}
+
+// Parses the same generated grid as OBJ text and as an equivalent .glb, and checks both give the same vertices and indices
+void BenchmarkGlbParsing(int generatedMegabytes)
+{
+	const int Runs = 3;
+	std::string text = GenerateGridObj(generatedMegabytes);
+	int threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+
+	ObjData obj;
+	double objSeconds = 1e30, objThreadedSeconds = 1e30;
+	for (int run = 0; run < Runs; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		ObjParser::Parse(text.data(), text.data() + text.size(), obj, 1);
+		objSeconds = fmin(objSeconds, SecondsSince(start));
+
+		start = std::chrono::high_resolution_clock::now();
+		ObjParser::Parse(text.data(), text.data() + text.size(), obj, threadCount);
+		objThreadedSeconds = fmin(objThreadedSeconds, SecondsSince(start));
+	}
+
+	// The .glb carries tangents, so loading it also skips TangentGenerator
+	TangentGenerator::Calculate(obj.verts.data(), (int)obj.verts.size(), obj.indices.data(), (int)obj.indices.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	TangentGenerator::Calculate(obj.verts.data(), (int)obj.verts.size(), obj.indices.data(), (int)obj.indices.size());
+	double tangentSeconds = SecondsSince(start);
+	std::string glb = BuildGlb(obj);
+
+	ObjData gltf;
+	double glbSeconds = 1e30;
+	bool parsed = true;
+	for (int run = 0; run < Runs; run++)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		parsed &= GltfParser::Parse(glb.data(), glb.data() + glb.size(), gltf);
+		glbSeconds = fmin(glbSeconds, SecondsSince(start));
+	}
+
+	bool same = parsed && gltf.hasTangents && gltf.verts.size() == obj.verts.size() && gltf.indices == obj.indices &&
+		memcmp(gltf.verts.data(), obj.verts.data(), obj.verts.size() * sizeof(Vertex)) == 0;
+
+	printf("OBJ vs GLB loading, %zu verts and %zu triangles, best of %d runs:\n", obj.verts.size(), obj.indices.size() / 3, Runs);
+	printf("  obj, 1 thread:   %8.1f MB in %8.2f ms, plus %.2f ms of tangent generation\n", text.size() / (1024.0 * 1024.0), objSeconds * 1000.0, tangentSeconds * 1000.0);
+	printf("  obj, %2d threads: %8.1f MB in %8.2f ms\n", threadCount, text.size() / (1024.0 * 1024.0), objThreadedSeconds * 1000.0);
+	printf("  glb:             %8.1f MB in %8.2f ms (%.1fx faster than 1 thread, %.1fx with tangents, %.1fx faster than %d threads)\n",
+		glb.size() / (1024.0 * 1024.0), glbSeconds * 1000.0, objSeconds / glbSeconds, (objSeconds + tangentSeconds) / glbSeconds, objThreadedSeconds / glbSeconds, threadCount);
+	printf("  glb output %s the obj output\n", same ? "matches" : "DOES NOT match");
+}
+
+// Hashes every triangle's three vertices, so meshes with different vertex numbering can be compared
+static void HashTriangles(const std::vector<Vertex>& verts, const unsigned int* indices, int numIndices, std::vector<unsigned long long>& hashes)
+{
+	for (int i = 0; i < numIndices; i += 3)
+	{
+		Vertex corners[3] = { verts[indices[i]], verts[indices[i + 1]], verts[indices[i + 2]] };
+		hashes.push_back(MeshCache::HashBytes(corners, sizeof(corners), 0));
+	}
+}
+
+void BenchmarkProgressiveStreaming(const char* objFile, int segments, float megabytesPerSecond)
+{
+	MeshData data;
+	if (objFile != nullptr)
+	{
+		if (!Mesh::LoadData(objFile, MESH_PROCESS_DEFAULT, data))
+		{
+			printf("Progressive streaming benchmark: couldn't open %s\n", objFile);
+			return;
+		}
+	}
+	else
+	{
+		PrimitiveGenerator::Torus(data, 0.5f, 0.2f, segments, segments / 2);
+		Mesh::ProcessData(data, MESH_PROCESS_VERTEX_CACHE | MESH_PROCESS_VERTEX_FETCH);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<unsigned char> stream;
+	ProgressiveMesh::Encode(data, stream);
+	double encodeSeconds = SecondsSince(start);
+
+	// What a regular load would have to wait for, the mesh cache's encoded full detail level
+	int fullIndices = 0;
+	for (size_t s = 0; s < data.submeshes.size(); s++)
+		fullIndices += (int)data.submeshes[s].indexCount;
+	if (data.submeshes.empty())
+		fullIndices = (int)data.indices.size();
+	std::vector<unsigned char> cache;
+	MeshCodec::EncodeVertices(data.verts.data(), (int)data.verts.size(), sizeof(Vertex), cache);
+	MeshCodec::EncodeIndices(data.indices.data(), fullIndices, cache);
+
+	const ProgressiveMeshHeader* header = (const ProgressiveMeshHeader*)stream.data();
+	double bytesPerSecond = megabytesPerSecond * 1024.0 * 1024.0;
+	printf("Progressive streaming of %s (%d tris, %u splits in %u chunks, encoded in %.1f ms):\n", objFile ? objFile : "generated torus",
+		fullIndices / 3, header->splitCount, header->chunkCount, encodeSeconds * 1000.0);
+	printf("  stream %.1f KB, mesh cache %.1f KB (%.2fx), raw %.1f KB\n", stream.size() / 1024.0, cache.size() / 1024.0, (double)stream.size() / cache.size(),
+		(data.verts.size() * sizeof(Vertex) + fullIndices * sizeof(unsigned int)) / 1024.0);
+
+	// Feed the stream in the loader's block size, and note how far along it is at a few points
+	ProgressiveMeshStream decoder;
+	double decodeSeconds = 0.0;
+	double marks[] = { 0.0, 0.05, 0.10, 0.25, 0.50, 1.0 };
+	int nextMark = 0;
+	for (size_t at = 0; at < stream.size();)
+	{
+		size_t size = std::min((size_t)MeshLoader::StreamBlockBytes, stream.size() - at);
+		bool hadBase = decoder.HasBase();
+		start = std::chrono::high_resolution_clock::now();
+		if (!decoder.Append(stream.data() + at, size))
+		{
+			printf("  the decoder rejected the stream at byte %zu\n", at);
+			return;
+		}
+		decodeSeconds += SecondsSince(start);
+		at += size;
+
+		bool report = !hadBase && decoder.HasBase();
+		while (nextMark < 6 && at >= marks[nextMark] * stream.size())
+		{
+			report |= nextMark > 0;
+			nextMark++;
+		}
+		if (report)
+		{
+			printf("  %s after %6.1f KB (%5.1f%%, %7.1f ms at %g MB/s): %7d tris (%5.1f%%), error %g\n", hadBase ? "refined " : "base in ",
+				at / 1024.0, 100.0 * at / stream.size(), at / bytesPerSecond * 1000.0, megabytesPerSecond,
+				decoder.GetResidentTriangleCount(), 100.0 * decoder.GetResidentTriangleCount() / (fullIndices / 3), decoder.GetResidentError());
+		}
+	}
+	printf("  the whole mesh cache takes %.1f ms to arrive, decoding the stream took %.2f ms (%.0f MB/s)\n",
+		cache.size() / bytesPerSecond * 1000.0, decodeSeconds * 1000.0, stream.size() / (1024.0 * 1024.0) / decodeSeconds);
+
+	// Every original triangle should be back, in some order and with some numbering
+	std::vector<unsigned long long> original, decoded;
+	HashTriangles(data.verts, data.indices.data(), fullIndices, original);
+	const std::vector<MeshSubmesh>& submeshes = decoder.GetSubmeshes();
+	for (size_t s = 0; s < submeshes.size(); s++)
+		HashTriangles(decoder.GetVertices(), decoder.GetIndices().data() + submeshes[s].startIndex, decoder.GetResidentIndexCount((int)s), decoded);
+	std::sort(original.begin(), original.end());
+	std::sort(decoded.begin(), decoded.end());
+	printf("  %s\n", decoder.IsComplete() && original == decoded ? "fully refined mesh matches the original" : "FULLY REFINED MESH DOESN'T MATCH THE ORIGINAL");
+}
+
+// Largest difference between any element of the per-object and batched world matrices
+static float MaxWorldDifference(std::vector<Transform>& transforms, TransformSystem& system)
+{
+	float maxDifference = 0.0f;
+	for (int i = 0; i < (int)transforms.size(); i++)
+	{
+		DirectX::XMFLOAT4X4 a = transforms[i].GetWorldMatrix();
+		const DirectX::XMFLOAT4X4& b = system.GetWorldMatrix(i);
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				maxDifference = fmaxf(maxDifference, fabsf(a.m[r][c] - b.m[r][c]));
+	}
+	return maxDifference;
+}
+
+// Moves every transform, or every tenth one, each frame and rebuilds the world matrices with Transform and TransformSystem
+void BenchmarkTransforms(int frames)
+{
+	int counts[] = { 10000, 100000, 1000000 };
+	for (int count : counts)
+	{
+		// The same random transforms in both
+		unsigned int seed = 12345;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 8388608.0f - 1.0f; };
+		std::vector<Transform> transforms(count);
+		TransformSystem system;
+		for (int i = 0; i < count; i++)
+		{
+			DirectX::XMFLOAT3 p(random() * 100.0f, random() * 100.0f, random() * 100.0f);
+			DirectX::XMFLOAT3 r(random() * 10.0f, random() * 10.0f, random() * 10.0f);
+			DirectX::XMFLOAT3 s(random() + 1.5f, random() + 1.5f, random() + 1.5f);
+			transforms[i].SetPosition(p.x, p.y, p.z);
+			transforms[i].SetRotation(r.x, r.y, r.z);
+			transforms[i].SetScale(s.x, s.y, s.z);
+
+			int t = system.Create();
+			system.SetPosition(t, p.x, p.y, p.z);
+			system.SetRotation(t, r.x, r.y, r.z);
+			system.SetScale(t, s.x, s.y, s.z);
+		}
+
+		printf("World matrices for %d transforms, average of %d frames:\n", count, frames);
+		int strides[] = { 1, 10 };
+		for (int stride : strides)
+		{
+			// Each frame moves some of them, then reads every matrix back the way the renderer does
+			float sum = 0.0f;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (int i = frame % stride; i < count; i += stride)
+					transforms[i].Rotate(0.01f, 0.02f, 0.03f);
+				for (int i = 0; i < count; i++)
+					sum += transforms[i].GetWorldMatrix()._41;
+			}
+			double objectSeconds = SecondsSince(start) / frames;
+
+			start = std::chrono::high_resolution_clock::now();
+			int rebuilt = 0;
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (int i = frame % stride; i < count; i += stride)
+					system.Rotate(i, 0.01f, 0.02f, 0.03f);
+				rebuilt += system.UpdateWorldMatrices();
+				for (int i = 0; i < count; i++)
+					sum -= system.GetWorldMatrix(i)._41;
+			}
+			double batchSeconds = SecondsSince(start) / frames;
+
+			printf("  %3d%% moving: per object %8.3f ms, batched %8.3f ms (%.1fx), %d rebuilt per frame, max difference %g (checksum %g)\n",
+				100 / stride, objectSeconds * 1000.0, batchSeconds * 1000.0, objectSeconds / batchSeconds,
+				rebuilt / frames, MaxWorldDifference(transforms, system), sum);
+		}
+	}
+}
+
+// Builds a hierarchy of the given number of nodes, parents first and depth first
+// - A branching of 1 is one long chain, 0 is a single root with every other node as its child, and anything
+//   else is a tree with that many children per node, just deep enough to hold them all
+static void BuildHierarchy(TransformSystem& system, int nodeCount, int branching)
+{
+	unsigned int seed = 777;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 8388608.0f - 1.0f; };
+
+	int maxDepth = 0;
+	for (long long total = 1, level = 1; branching > 1 && total < nodeCount; maxDepth++)
+	{
+		level *= branching;
+		total += level;
+	}
+
+	// Tree nodes that can still take children, the deepest last, with their depth and child count
+	struct OpenNode { int node; int depth; int children; };
+	std::vector<OpenNode> open;
+	int last = -1;
+	for (int i = 0; i < nodeCount; i++)
+	{
+		int parent = -1;
+		int depth = 0;
+		if (branching == 0)
+			parent = i > 0 ? 0 : -1;
+		else if (branching == 1)
+			parent = last;
+		else
+		{
+			while (!open.empty() && open.back().children == branching)
+				open.pop_back();
+			if (!open.empty())
+			{
+				parent = open.back().node;
+				depth = open.back().depth + 1;
+				open.back().children++;
+			}
+		}
+
+		last = system.Create();
+		system.SetParent(last, parent);
+		system.SetPosition(last, random() * 2.0f, random() * 2.0f, random() * 2.0f);
+		system.SetRotation(last, random() * 0.1f, random() * 0.1f, random() * 0.1f);
+		if (branching > 1 && depth < maxDepth)
+			open.push_back({ last, depth, 0 });
+	}
+}
+
+// Moves a fraction of the nodes of deep and wide hierarchies of parented transforms each frame, comparing incremental and
+// full world matrix updates
+void BenchmarkTransformHierarchy(int nodeCount, float dirtyFraction, int frames)
+{
+	struct Shape { const char* name; int branching; };
+	Shape shapes[] = { { "deep (one chain)", 1 }, { "tree (8 children each)", 8 }, { "wide (one parent)", 0 } };
+	int dirtyPerFrame = (int)(nodeCount * dirtyFraction);
+
+	printf("Transform hierarchy with %d nodes, %d moving per frame, average of %d frames:\n", nodeCount, dirtyPerFrame, frames);
+	for (const Shape& shape : shapes)
+	{
+		// Two copies of the same hierarchy, one updated incrementally and one in full (the first update lays it out)
+		TransformSystem incremental;
+		TransformSystem full;
+		auto start = std::chrono::high_resolution_clock::now();
+		BuildHierarchy(incremental, nodeCount, shape.branching);
+		incremental.UpdateWorldMatrices();
+		double buildSeconds = SecondsSince(start);
+		BuildHierarchy(full, nodeCount, shape.branching);
+		full.UpdateAllWorldMatrices();
+
+		// The same nodes move in both
+		std::vector<int> moving((size_t)dirtyPerFrame * frames);
+		unsigned int seed = 4242;
+		for (int& node : moving)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			node = (int)((seed >> 8) % (unsigned int)nodeCount);
+		}
+
+		long long rebuilt = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (int i = 0; i < dirtyPerFrame; i++)
+				incremental.Rotate(moving[(size_t)frame * dirtyPerFrame + i], 0.001f, 0.002f, 0.003f);
+			rebuilt += incremental.UpdateWorldMatrices();
+		}
+		double incrementalSeconds = SecondsSince(start) / frames;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (int i = 0; i < dirtyPerFrame; i++)
+				full.Rotate(moving[(size_t)frame * dirtyPerFrame + i], 0.001f, 0.002f, 0.003f);
+			full.UpdateAllWorldMatrices();
+		}
+		double fullSeconds = SecondsSince(start) / frames;
+
+		// Both did exactly the same math on the nodes they rebuilt, so they should match exactly
+		float maxDifference = 0.0f;
+		for (int i = 0; i < nodeCount; i++)
+		{
+			const DirectX::XMFLOAT4X4& a = incremental.GetWorldMatrix(i);
+			const DirectX::XMFLOAT4X4& b = full.GetWorldMatrix(i);
+			for (int r = 0; r < 4; r++)
+				for (int c = 0; c < 4; c++)
+					maxDifference = fmaxf(maxDifference, fabsf(a.m[r][c] - b.m[r][c]));
+		}
+
+		printf("  %-24s built in %7.2f ms, incremental %7.3f ms (%lld rebuilt per frame), full %7.3f ms (%.1fx), max difference %g\n",
+			shape.name, buildSeconds * 1000.0, incrementalSeconds * 1000.0, rebuilt / frames, fullSeconds * 1000.0,
+			fullSeconds / incrementalSeconds, maxDifference);
+	}
+}
+
+// What Renderer::DrawMeshes read per entity back when it took a std::vector<Entity> by value, minus the GPU calls
+static float GatherEntitiesByValue(std::vector<Entity> entities)
+{
+	float sum = 0.0f;
+	for (int i = 0; i < (int)entities.size(); i++)
+	{
+		DirectX::XMFLOAT4X4 world = entities[i].GetTransform()->GetWorldMatrix();
+		DirectX::XMFLOAT4X4 normals = entities[i].GetTransform()->GetWorldInverseTransposeMatrix();
+		sum += world._41 + normals._11 + entities[i].GetMaterial()->renderPriority + (entities[i].GetMesh() != nullptr);
+	}
+	return sum;
+}
+
+// What Renderer::GenerateRenderQueue did before, a copy of the vector copied again into the queue and sorted
+static void QueueEntitiesByValue(std::vector<Entity> entities, std::vector<Entity>& queue)
+{
+	queue.clear();
+	for (int i = 0; i < (int)entities.size(); i++)
+		queue.push_back(entities[i]);
+	std::sort(queue.begin(), queue.end(), [](Entity& a, Entity& b) {
+		if (a.renderPriority != b.renderPriority)
+			return a < b;
+		return a.GetMesh() < b.GetMesh();
+	});
+}
+
+// The same reads straight out of the renderable chunks
+static float GatherEntityStore(EntityStore& store, std::vector<EntityChunk*>& chunks)
+{
+	float sum = 0.0f;
+	TransformSystem* transforms = store.GetTransforms();
+	store.Query(ENTITY_COMPONENT_RENDERABLE, chunks);
+	for (EntityChunk* chunk : chunks)
+	{
+		for (int row = 0; row < chunk->count; row++)
+		{
+			const DirectX::XMFLOAT4X4& world = transforms->GetWorldMatrix(chunk->transforms[row]);
+			const DirectX::XMFLOAT4X4& normals = transforms->GetWorldInverseTransposeMatrix(chunk->transforms[row]);
+			sum += world._41 + normals._11 + chunk->materials[row]->renderPriority + (chunk->meshes[row] != nullptr);
+		}
+	}
+	return sum;
+}
+
+// Moves a tenth of the entities each frame and reads back everything the renderer draws with, from a
+// std::vector<Entity> passed by value (the old path) and from an EntityStore
+// - Also times regenerating the render queue both ways
+void BenchmarkEntityStorage(int frames)
+{
+	// Materials only need their priority here, and meshes are never touched (they get point bounds)
+	Material* materials[4];
+	for (int m = 0; m < 4; m++)
+		materials[m] = new Material(DirectX::XMFLOAT4(1, 1, 1, 1), nullptr, nullptr, nullptr, m + 1);
+	Mesh* meshes[6] = {};
+
+	int counts[] = { 1000, 100000, 1000000 };
+	for (int count : counts)
+	{
+		printf("Entity storage with %d entities, average of %d frames:\n", count, frames);
+		double seconds[4];
+		float sum = 0.0f;
+
+		// The old path first, freed before the store is built so only one is resident at a time
+		{
+			srand(1);
+			std::vector<Entity> entities;
+			for (int i = 0; i < count; i++)
+			{
+				Entity e = Entity(meshes[rand() % 6], materials[rand() % 4]);
+				e.GetTransform()->SetPosition((rand() % 30) - 15.0f, (rand() % 30) - 15.0f, (rand() % 30) - 15.0f);
+				e.GetTransform()->SetRotation((float)(rand() % 360), (float)(rand() % 360), (float)(rand() % 360));
+				entities.push_back(e);
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (int i = frame % 10; i < count; i += 10)
+					entities[i].GetTransform()->MoveAbsolute(0.0f, 0.01f, 0.0f);
+				sum += GatherEntitiesByValue(entities);
+			}
+			seconds[0] = SecondsSince(start) / frames;
+
+			std::vector<Entity> queue;
+			start = std::chrono::high_resolution_clock::now();
+			QueueEntitiesByValue(entities, queue);
+			seconds[1] = SecondsSince(start);
+		}
+
+		{
+			srand(1);
+			EntityStore store;
+			std::vector<EntityHandle> ids;
+			for (int i = 0; i < count; i++)
+			{
+				EntityHandle e = store.CreateRenderable(meshes[rand() % 6], materials[rand() % 4]);
+				store.GetTransforms()->SetPosition(store.GetTransform(e), (rand() % 30) - 15.0f, (rand() % 30) - 15.0f, (rand() % 30) - 15.0f);
+				store.GetTransforms()->SetRotation(store.GetTransform(e), (float)(rand() % 360), (float)(rand() % 360), (float)(rand() % 360));
+				ids.push_back(e);
+			}
+
+			// World matrices and bounds are part of every frame now, so they're timed too
+			std::vector<EntityChunk*> chunks;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (int i = frame % 10; i < count; i += 10)
+					store.GetTransforms()->MoveAbsolute(store.GetTransform(ids[i]), 0.0f, 0.01f, 0.0f);
+				store.UpdateWorldMatrices();
+				store.UpdateBounds();
+				sum -= GatherEntityStore(store, chunks);
+			}
+			seconds[2] = SecondsSince(start) / frames;
+
+			// Queue entries are just a chunk, row and the sort keys
+			struct QueueItem { EntityChunk* chunk; int row; int priority; Mesh* mesh; };
+			std::vector<QueueItem> queue;
+			start = std::chrono::high_resolution_clock::now();
+			store.Query(ENTITY_COMPONENT_RENDERABLE, chunks);
+			for (EntityChunk* chunk : chunks)
+				for (int row = 0; row < chunk->count; row++)
+					queue.push_back({ chunk, row, chunk->materials[row]->renderPriority, chunk->meshes[row] });
+			std::sort(queue.begin(), queue.end(), [](const QueueItem& a, const QueueItem& b) {
+				if (a.priority != b.priority)
+					return a.priority < b.priority;
+				return a.mesh < b.mesh;
+			});
+			seconds[3] = SecondsSince(start);
+		}
+
+		printf("  frame:        vector by value %9.3f ms, entity store %9.3f ms (%.1fx)\n", seconds[0] * 1000.0, seconds[2] * 1000.0, seconds[0] / seconds[2]);
+		printf("  render queue: vector by value %9.3f ms, entity store %9.3f ms (%.1fx), checksum %g\n", seconds[1] * 1000.0, seconds[3] * 1000.0, seconds[1] / seconds[3], sum);
+	}
+
+	for (int m = 0; m < 4; m++)
+		delete materials[m];
+}
+
+// Destroys a random entity in O(1), moving the last handle into its place, and returns its now stale handle
+static EntityHandle DestroyRandomEntity(EntityStore& store, std::vector<EntityHandle>& handles)
+{
+	int index = rand() % handles.size();
+	EntityHandle entity = handles[index];
+	store.Destroy(entity);
+	handles[index] = handles.back();
+	handles.pop_back();
+	return entity;
+}
+
+// True if both queues hold the same entities and each is in order
+static bool SameRenderQueue(RenderQueue& a, RenderQueue& b)
+{
+	if (a.GetCount() != b.GetCount())
+		return false;
+
+	std::vector<EntityHandle> handlesA, handlesB;
+	for (int i = 0; i < a.GetCount(); i++)
+	{
+		handlesA.push_back(a.GetItem(i).entity);
+		handlesB.push_back(b.GetItem(i).entity);
+		if (i > 0 && a.GetItem(i).renderPriority < a.GetItem(i - 1).renderPriority)
+			return false;
+	}
+	std::sort(handlesA.begin(), handlesA.end());
+	std::sort(handlesB.begin(), handlesB.end());
+	return handlesA == handlesB;
+}
+
+// Replaces a fraction of the entities every frame (random ones destroyed, new ones created), then brings a render
+// queue up to date by rebuilding it and by applying the store's change logs
+// - Also checks the destroyed handles are all caught as stale, even though the new entities reuse their slots
+void BenchmarkEntityChurn(float churnFraction, int frames)
+{
+	Material* materials[4];
+	for (int m = 0; m < 4; m++)
+		materials[m] = new Material(DirectX::XMFLOAT4(1, 1, 1, 1), nullptr, nullptr, nullptr, m + 1);
+
+	int counts[] = { 10000, 100000, 1000000 };
+	for (int count : counts)
+	{
+		int churn = (int)(count * churnFraction);
+		printf("Entity churn with %d entities, %d replaced per frame, average of %d frames:\n", count, churn, frames);
+
+		// The same churn both ways, from the same seed
+		double seconds[2];
+		RenderQueue queues[2];
+		int staleFound = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			srand(1);
+			EntityStore store;
+			std::vector<EntityHandle> handles;
+			for (int i = 0; i < count; i++)
+				handles.push_back(store.CreateRenderable(nullptr, materials[rand() % 4]));
+			queues[pass].Rebuild(&store);
+
+			std::vector<EntityHandle> stale;
+			seconds[pass] = 0.0;
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (int i = 0; i < churn; i++)
+				{
+					EntityHandle destroyed = DestroyRandomEntity(store, handles);
+					if (pass == 0)
+						stale.push_back(destroyed);
+				}
+				for (int i = 0; i < churn; i++)
+					handles.push_back(store.CreateRenderable(nullptr, materials[rand() % 4]));
+
+				// Only the queue is timed, the churn is the same both ways
+				auto start = std::chrono::high_resolution_clock::now();
+				if (pass == 0)
+					queues[pass].Rebuild(&store);
+				else
+					queues[pass].Update(&store);
+				seconds[pass] += SecondsSince(start) / frames;
+			}
+
+			for (EntityHandle handle : stale)
+			{
+				int row;
+				if (store.IsAlive(handle) || store.Find(handle, row))
+					staleFound++;
+			}
+		}
+
+		printf("  full rebuild %9.3f ms, incremental %9.3f ms (%.1fx), queues %s, stale handles still found %d\n",
+			seconds[0] * 1000.0, seconds[1] * 1000.0, seconds[0] / seconds[1],
+			SameRenderQueue(queues[0], queues[1]) ? "match" : "DIFFER", staleFound);
+	}
+
+	for (int m = 0; m < 4; m++)
+		delete materials[m];
+}
+
+// Copies of the prototype made with new/delete or from a pool, filling the same fragmented heap either way
+template <typename T>
+static void MeasureObjectPool(const char* label, const T& prototype, int count, int rounds)
+{
+	double seconds[2][2];
+	long long sums[2];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		srand(1);
+		ObjectPool<T> pool(256);
+		std::vector<T*> objects;
+
+		// Everything else the program allocates lands between heap objects, half of it freed again to leave holes
+		std::vector<char*> noise;
+		for (int i = 0; i < count; i++)
+		{
+			objects.push_back(pass == 0 ? new T(prototype) : pool.Create(prototype));
+			noise.push_back(new char[16 + rand() % 256]);
+		}
+		for (size_t i = 0; i < noise.size(); i += 2)
+		{
+			delete[] noise[i];
+			noise[i] = nullptr;
+		}
+
+		// Each round replaces a random half of the objects, so the order in the vector ends up shuffled
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int round = 0; round < rounds; round++)
+		{
+			for (int i = 0; i < count / 2; i++)
+			{
+				int index = rand() % count;
+				if (pass == 0)
+					delete objects[index];
+				else
+					pool.Destroy(objects[index]);
+				objects[index] = pass == 0 ? new T(prototype) : pool.Create(prototype);
+			}
+		}
+		seconds[pass][0] = SecondsSince(start);
+
+		// Reading one field of each object through the pointers is mostly cache misses once they're scattered
+		sums[pass] = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < count; i++)
+			sums[pass] += objects[i]->renderPriority;
+		seconds[pass][1] = SecondsSince(start);
+
+		if (pass == 0)
+		{
+			for (T* object : objects)
+				delete object;
+		}
+		else
+		{
+			// The pool can also walk its pages in address order
+			long long pageSum = 0;
+			start = std::chrono::high_resolution_clock::now();
+			pool.ForEach([&pageSum](T* object) { pageSum += object->renderPriority; });
+			double pageSeconds = SecondsSince(start);
+
+			printf("  %-9s pool occupancy %d / %d blocks in %d pages (%.1f / %.1f MB), walked in address order %.2f ns/object\n",
+				label, pool.GetLiveCount(), pool.GetCapacity(), pool.GetPageCount(), pool.GetUsedBytes() / 1048576.0, pool.GetTotalBytes() / 1048576.0,
+				pageSeconds * 1e9 / count);
+			if (pageSum != sums[pass])
+				printf("  %-9s MISMATCH walking the pool's pages\n", label);
+
+			for (T* object : objects)
+				pool.Destroy(object);
+		}
+		for (char* block : noise)
+			delete[] block;
+	}
+
+	double operations = (double)rounds * count;
+	printf("  %-9s create+destroy: heap %6.1f ns, pool %6.1f ns (%.1fx)   iterate: heap %6.2f ns/object, pool %6.2f ns/object (%.1fx)%s\n",
+		label, seconds[0][0] * 1e9 / operations, seconds[1][0] * 1e9 / operations, seconds[0][0] / seconds[1][0],
+		seconds[0][1] * 1e9 / count, seconds[1][1] * 1e9 / count, seconds[0][1] / seconds[1][1],
+		sums[0] == sums[1] ? "" : "  MISMATCH");
+}
+
+// Churns through materials and entities allocated with new/delete and from ObjectPools, and times iterating over them
+// - Meshes need a device, so they aren't measured here, but they pool the same way
+void BenchmarkObjectPools(int count, int rounds)
+{
+	printf("Object pools with %d objects, %d rounds replacing half of them:\n", count, rounds);
+	Material material(DirectX::XMFLOAT4(1, 1, 1, 1), nullptr, nullptr, nullptr, 1);
+	MeasureObjectPool("Material", material, count, rounds);
+	MeasureObjectPool("Entity", Entity(nullptr, &material), count, rounds);
+
+	// EntityStore chunks come from pools too, so rebuilding a store reuses its blocks
+	EntityStore store;
+	for (int round = 0; round < rounds; round++)
+	{
+		std::vector<EntityHandle> handles;
+		for (int i = 0; i < count; i++)
+			handles.push_back(store.CreateRenderable(nullptr, &material));
+		if (round == rounds - 1)
+			printf("  EntityStore chunks: %d, %.1f / %.1f MB reserved after %d rebuilds\n",
+				store.GetChunkCount(), store.GetChunkBytes() / 1048576.0, store.GetReservedChunkBytes() / 1048576.0, rounds);
+		for (EntityHandle handle : handles)
+			store.Destroy(handle);
+		store.ClearChanges();
+	}
+}
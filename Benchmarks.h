@@ -0,0 +1,84 @@
+#pragma once
+
+// --------------------------------------------------------
+// Console benchmarks for the asset and scene pipelines
+//
+// - Compiled in everywhere, but only run when the project
+//   is built with RUN_BENCHMARKS defined (see Game::Init)
+// - Results are printed to the debug console window
+// --------------------------------------------------------
+
+// Runs every benchmark below with their default settings
+void RunBenchmarks();
+
+// Parses an OBJ file repeatedly and reports throughput in MB/s
+// - Pass nullptr to parse a generated grid OBJ of roughly the given size instead
+void BenchmarkObjParsing(const char* objFile, int generatedMegabytes);
+
+// Parses a generated OBJ of roughly the given size with 1 to N threads and reports the scaling
+void BenchmarkObjParsingThreads(int generatedMegabytes);
+
+// Reports simulated vertex cache stats before and after MeshOptimizer::OptimizeVertexCache on a generated grid
+void BenchmarkVertexCache(int generatedMegabytes);
+
+// Reports CPU estimated overdraw, cache and fetch stats as each mesh optimization pass runs on nested tori
+void BenchmarkOverdraw(int segments, float tubeStep, int layers);
+
+// Times the scalar and SSE vertex encoders and reports the size and max error of each compressed vertex format
+void BenchmarkVertexCompression(int vertexCount);
+
+// Builds a level of detail chain and reports triangles and geometric error per level
+// - Pass nullptr to use a generated grid OBJ of roughly the given size instead
+void BenchmarkLods(const char* objFile, int generatedMegabytes);
+
+// Clusters a dense sphere, then culls a grid of copies of it against a camera and reports the triangles rejected
+// - Compares whole object culling with per-cluster frustum and back face cone culling
+void BenchmarkClusterCulling(int segments, int gridSize);
+
+// Times TangentGenerator's scalar path against its SSE path on one and many threads for a generated grid of roughly the given size
+// - Also reports how far the results differ and checks that degenerate uvs never produce infinities or NaNs
+void BenchmarkTangents(int generatedMegabytes);
+
+// Encodes and decodes generated meshes with MeshCodec, reporting compression ratios and single threaded decode speeds
+// - Also checks every round trip is bit exact and that truncated streams are rejected
+void BenchmarkMeshCodec(int generatedMegabytes);
+
+// Generates every PrimitiveGenerator shape with roughly segments x segments quads and reports the time and vertex rate
+// - Also times TangentGenerator on the same shapes, which the analytic tangents make unnecessary
+void BenchmarkPrimitives(int segments);
+
+// Builds a BVH over each built-in shape at roughly segments x segments quads and fires random rays at it
+// - Reports build time, closest and any hit rays per second, and checks a sample of rays against brute force
+// - Pass an OBJ file to measure that instead
+void BenchmarkRaycasts(const char* objFile, int segments);
+
+// Parses a generated grid OBJ of roughly the given size and the same grid written out as a .glb, reporting both times
+// - Also checks that both parsers hand back exactly the same vertices and indices
+void BenchmarkGlbParsing(int generatedMegabytes);
+
+// Encodes a mesh as a progressive stream, then feeds it to a decoder in blocks as if it arrived at the given bandwidth
+// - Reports how soon the base mesh and each refinement would be drawable, against waiting for the whole mesh cache
+// - Also checks the fully decoded stream has exactly the original triangles
+// - Pass nullptr to use a generated torus with roughly segments x segments quads
+void BenchmarkProgressiveStreaming(const char* objFile, int segments, float megabytesPerSecond);
+
+// Rebuilds world matrices for 10k, 100k and 1M transforms, one Transform at a time and batched with TransformSystem
+// - Runs with every transform moving each frame and with only a tenth of them, and reports the max difference
+void BenchmarkTransforms(int frames);
+
+// Builds a deep chain, a tree and a wide single parent hierarchy, then moves the given fraction of their nodes each frame
+// - Parented TransformSystem transforms, the same ones entities use
+// - Compares the incremental update with recomposing every world matrix, and checks both give the same result
+void BenchmarkTransformHierarchy(int nodeCount, float dirtyFraction, int frames);
+
+// Times the CPU side of a frame for 1k, 100k and 1M entities, as a std::vector<Entity> passed by value and as an EntityStore
+// - Each frame moves a tenth of them and reads everything the renderer draws with, and the render queue is rebuilt once
+void BenchmarkEntityStorage(int frames);
+
+// Replaces a fraction of 10k, 100k and 1M entities every frame and times bringing the render queue up to date,
+// rebuilt from scratch and updated from the store's change logs
+void BenchmarkEntityChurn(float churnFraction, int frames);
+
+// Replaces half of a set of materials and entities a few times over, allocated with new/delete and from ObjectPools,
+// then times reading them all back (how scattered they ended up shows as cache misses)
+void BenchmarkObjectPools(int count, int rounds);
@@ -4,6 +4,7 @@
 // Getters/Setters
 DirectX::XMFLOAT4X4 Camera::GetViewMatrix() { return viewMatrix; }
 DirectX::XMFLOAT4X4 Camera::GetProjectionMatrix() { return projMatrix; }
+Transform* Camera::GetTransform() { return &transform; }
 
 // Initializes the camera
 Camera::Camera(float x, float y, float z, float aspectRatio) 
@@ -25,11 +26,8 @@ void Camera::UpdateProjectionMatrix(float aspectRatio)
 // Updates the camera's view matrix
 void Camera::UpdateViewMatrix() 
 {
-	// Get rotation and direction values
-	DirectX::XMFLOAT3 rot = transform.GetPitchYawRoll();
-	DirectX::XMVECTOR dir = DirectX::XMVector3Rotate(
-		DirectX::XMVectorSet(0, 0, 1, 0),	
-		DirectX::XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rot)));
+	// The transform caches its rotated axes, so the direction is free
+	DirectX::XMVECTOR dir = transform.GetForwardVector();
 
 	// Generatee and set our view matrix
 	DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(
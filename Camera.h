@@ -9,6 +9,7 @@ public:
 	Camera(float x, float y, float z, float aspectRatio);
 	DirectX::XMFLOAT4X4 GetViewMatrix();
 	DirectX::XMFLOAT4X4 GetProjectionMatrix();
+	Transform* GetTransform();
 	void UpdateProjectionMatrix(float aspectRatio);
 	void UpdateViewMatrix();
 	void Update(float deltaTime, HWND windowHandle);
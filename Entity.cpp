@@ -9,4 +9,19 @@ Entity::Entity(Mesh* _mesh, Material* _material)
 
 Mesh* Entity::GetMesh() { return mesh; };
 Transform* Entity::GetTransform() { return &transform; }
-Material* Entity::GetMaterial() { return material; }
\ No newline at end of file
+Material* Entity::GetMaterial() { return material; }
+
+// Null clears the submesh's material so it goes back to the entity's
+void Entity::SetSubmeshMaterial(int submesh, Material* _material)
+{
+	if (submesh >= (int)submeshMaterials.size())
+		submeshMaterials.resize(submesh + 1, nullptr);
+	submeshMaterials[submesh] = _material;
+}
+
+Material* Entity::GetSubmeshMaterial(int submesh)
+{
+	if (submesh < (int)submeshMaterials.size() && submeshMaterials[submesh])
+		return submeshMaterials[submesh];
+	return material;
+}
@@ -3,6 +3,8 @@
 #include "Mesh.h"
 #include "Material.h"
 
+#include <vector>
+
 class Entity
 {
 public:
@@ -13,6 +15,11 @@ public:
 	Mesh* GetMesh();
 	Transform* GetTransform();
 	Material* GetMaterial();
+
+	// Per submesh materials, submeshes without their own use the entity's material
+	void SetSubmeshMaterial(int submesh, Material* _material);
+	Material* GetSubmeshMaterial(int submesh);
+
 	int renderPriority;
 	bool operator< (const Entity& other) const {
 		return renderPriority < other.renderPriority;
@@ -21,6 +28,7 @@ public:
 private:
 	Mesh* mesh;
 	Material* material;
+	std::vector<Material*> submeshMaterials;
 	Transform transform;
 };
 
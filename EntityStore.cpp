@@ -0,0 +1,460 @@
+#include "EntityStore.h"
+#include "Mesh.h"
+#include <cstring>
+
+// Arrays inside a chunk start on 16 byte boundaries
+static size_t AlignChunkOffset(size_t offset) { return (offset + 15) & ~(size_t)15; }
+
+Material* EntityChunk::GetSubmeshMaterial(int row, int submesh)
+{
+	if (submeshMaterials && submesh < EntitySubmeshMaterials::MaxSubmeshes && submeshMaterials[row].materials[submesh])
+		return submeshMaterials[row].materials[submesh];
+	return materials ? materials[row] : nullptr;
+}
+
+EntityStore::~EntityStore()
+{
+	Clear();
+}
+
+// --------------------------------- Creating and destroying entities
+// Takes the most recently freed slot, or a new one
+EntityHandle EntityStore::Create(unsigned int components)
+{
+	EntityHandle entity;
+	if (freeSlots.empty())
+	{
+		entity.index = (int)locations.size();
+		locations.push_back(Location());
+		generations.push_back(0);
+	}
+	else
+	{
+		entity.index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	entity.generation = generations[entity.index];
+
+	AddRow(entity, FindArchetype(components));
+	created.push_back(entity);
+	count++;
+	return entity;
+}
+
+EntityHandle EntityStore::CreateRenderable(Mesh* mesh, Material* material)
+{
+	EntityHandle entity = Create(ENTITY_COMPONENT_RENDERABLE);
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	chunk->meshes[row] = mesh;
+	chunk->materials[row] = material;
+	return entity;
+}
+
+// Bumping the generation is what makes every handle to the entity stale
+bool EntityStore::Destroy(EntityHandle entity)
+{
+	if (!IsAlive(entity))
+		return false;
+
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	if (chunk->transforms)
+		transformSystem.Destroy(chunk->transforms[row]);
+
+	RemoveRow(locations[entity.index]);
+	locations[entity.index].archetype = -1;
+	generations[entity.index]++;
+	freeSlots.push_back(entity.index);
+	destroyed.push_back(entity);
+	count--;
+	return true;
+}
+
+// Keeps the slots and their generations, so handles from before stay stale
+void EntityStore::Clear()
+{
+	for (Archetype& archetype : archetypes)
+	{
+		for (EntityChunk* chunk : archetype.chunks)
+		{
+			for (int row = 0; row < chunk->count; row++)
+			{
+				EntityHandle entity = chunk->entities[row];
+				locations[entity.index].archetype = -1;
+				generations[entity.index]++;
+				freeSlots.push_back(entity.index);
+				destroyed.push_back(entity);
+			}
+			DestroyChunk(chunk);
+		}
+	}
+	archetypes.clear();
+	transformSystem.Clear();
+	count = 0;
+}
+
+bool EntityStore::IsAlive(EntityHandle entity)
+{
+	return entity.index >= 0 && entity.index < (int)locations.size() &&
+		generations[entity.index] == entity.generation && locations[entity.index].archetype >= 0;
+}
+
+int EntityStore::GetCount() { return count; }
+
+EntityChunk* EntityStore::Find(EntityHandle entity, int& row)
+{
+	if (!IsAlive(entity))
+		return nullptr;
+	return GetChunk(entity, row);
+}
+
+// --------------------------------- Change tracking
+const std::vector<EntityHandle>& EntityStore::GetCreated() { return created; }
+const std::vector<EntityHandle>& EntityStore::GetDestroyed() { return destroyed; }
+
+void EntityStore::ClearChanges()
+{
+	created.clear();
+	destroyed.clear();
+}
+
+// Logs the entity as destroyed and created again, for changes to what downstream systems key on
+void EntityStore::LogChange(EntityHandle entity)
+{
+	destroyed.push_back(entity);
+	created.push_back(entity);
+}
+
+// --------------------------------- Archetypes and chunks
+int EntityStore::FindArchetype(unsigned int components)
+{
+	for (int i = 0; i < (int)archetypes.size(); i++)
+	{
+		if (archetypes[i].components == components)
+			return i;
+	}
+
+	Archetype archetype;
+	archetype.components = components;
+	archetypes.push_back(archetype);
+	return (int)archetypes.size() - 1;
+}
+
+// Lays out one array per component in a single pooled block, as many rows as fit in ChunkBytes
+EntityChunk* EntityStore::CreateChunk(unsigned int components)
+{
+	size_t sizes[] = {
+		sizeof(EntityHandle),
+		(components & ENTITY_COMPONENT_TRANSFORM) ? sizeof(int) : 0,
+		(components & ENTITY_COMPONENT_MESH) ? sizeof(Mesh*) : 0,
+		(components & ENTITY_COMPONENT_MATERIAL) ? sizeof(Material*) : 0,
+		(components & ENTITY_COMPONENT_BOUNDS) ? sizeof(EntityBounds) : 0,
+		(components & ENTITY_COMPONENT_RENDER_FLAGS) ? sizeof(unsigned int) : 0,
+		(components & ENTITY_COMPONENT_SUBMESH_MATERIALS) ? sizeof(EntitySubmeshMaterials) : 0,
+	};
+	const int arrayCount = sizeof(sizes) / sizeof(sizes[0]);
+
+	size_t rowBytes = 0;
+	for (int i = 0; i < arrayCount; i++)
+		rowBytes += sizes[i];
+	int capacity = (int)(ChunkBytes / rowBytes);
+	if (capacity < 1)
+		capacity = 1;
+
+	// Padding each array out to 16 bytes can push the last rows past the end
+	size_t offsets[arrayCount];
+	for (;; capacity--)
+	{
+		size_t total = 0;
+		for (int i = 0; i < arrayCount; i++)
+		{
+			offsets[i] = total;
+			total = AlignChunkOffset(total + sizes[i] * capacity);
+		}
+		if (total <= ChunkBytes || capacity == 1)
+			break;
+	}
+
+	EntityChunk* chunk = chunkPool.Create();
+	chunk->count = 0;
+	chunk->capacity = capacity;
+	chunk->components = components;
+	chunk->memory = chunkMemoryPool.Create()->bytes;
+
+	unsigned char* arrays[arrayCount];
+	for (int i = 0; i < arrayCount; i++)
+		arrays[i] = sizes[i] ? chunk->memory + offsets[i] : nullptr;
+	chunk->entities = (EntityHandle*)arrays[0];
+	chunk->transforms = (int*)arrays[1];
+	chunk->meshes = (Mesh**)arrays[2];
+	chunk->materials = (Material**)arrays[3];
+	chunk->bounds = (EntityBounds*)arrays[4];
+	chunk->renderFlags = (unsigned int*)arrays[5];
+	chunk->submeshMaterials = (EntitySubmeshMaterials*)arrays[6];
+	return chunk;
+}
+
+// The bytes are the first member, so they're also the block's address
+void EntityStore::DestroyChunk(EntityChunk* chunk)
+{
+	chunkMemoryPool.Destroy(reinterpret_cast<ChunkMemory*>(chunk->memory));
+	chunkPool.Destroy(chunk);
+}
+
+void EntityStore::DefaultRow(EntityChunk* chunk, int row)
+{
+	if (chunk->transforms)
+		chunk->transforms[row] = transformSystem.Create();
+	if (chunk->meshes)
+		chunk->meshes[row] = nullptr;
+	if (chunk->materials)
+		chunk->materials[row] = nullptr;
+	if (chunk->bounds)
+		chunk->bounds[row] = {};
+	if (chunk->renderFlags)
+		chunk->renderFlags[row] = ENTITY_RENDER_DEFAULT;
+	if (chunk->submeshMaterials)
+		memset(&chunk->submeshMaterials[row], 0, sizeof(EntitySubmeshMaterials));
+}
+
+// Appends a defaulted row to the archetype's last chunk, starting a new one when it's full
+void EntityStore::AddRow(EntityHandle entity, int archetype)
+{
+	std::vector<EntityChunk*>& chunks = archetypes[archetype].chunks;
+	if (chunks.empty() || chunks.back()->count == chunks.back()->capacity)
+		chunks.push_back(CreateChunk(archetypes[archetype].components));
+
+	EntityChunk* chunk = chunks.back();
+	int row = chunk->count++;
+	chunk->entities[row] = entity;
+	DefaultRow(chunk, row);
+
+	locations[entity.index].archetype = archetype;
+	locations[entity.index].chunk = (int)chunks.size() - 1;
+	locations[entity.index].row = row;
+}
+
+// Fills the hole with the archetype's last row, freeing the last chunk once it's empty
+void EntityStore::RemoveRow(const Location& at)
+{
+	std::vector<EntityChunk*>& chunks = archetypes[at.archetype].chunks;
+	EntityChunk* chunk = chunks[at.chunk];
+	EntityChunk* last = chunks.back();
+	int lastRow = last->count - 1;
+	if (chunk != last || at.row != lastRow)
+	{
+		EntityHandle moved = last->entities[lastRow];
+		CopyRow(last, lastRow, chunk, at.row);
+		chunk->entities[at.row] = moved;
+		locations[moved.index] = at;
+	}
+
+	if (--last->count == 0)
+	{
+		DestroyChunk(last);
+		chunks.pop_back();
+	}
+}
+
+// Copies the components both chunks have, transforms are just indices so nothing needs destroying
+void EntityStore::CopyRow(EntityChunk* from, int fromRow, EntityChunk* to, int toRow)
+{
+	if (from->transforms && to->transforms)
+		to->transforms[toRow] = from->transforms[fromRow];
+	if (from->meshes && to->meshes)
+		to->meshes[toRow] = from->meshes[fromRow];
+	if (from->materials && to->materials)
+		to->materials[toRow] = from->materials[fromRow];
+	if (from->bounds && to->bounds)
+		to->bounds[toRow] = from->bounds[fromRow];
+	if (from->renderFlags && to->renderFlags)
+		to->renderFlags[toRow] = from->renderFlags[fromRow];
+	if (from->submeshMaterials && to->submeshMaterials)
+		to->submeshMaterials[toRow] = from->submeshMaterials[fromRow];
+}
+
+EntityChunk* EntityStore::GetChunk(EntityHandle entity, int& row)
+{
+	const Location& location = locations[entity.index];
+	row = location.row;
+	return archetypes[location.archetype].chunks[location.chunk];
+}
+
+void EntityStore::SetComponents(EntityHandle entity, unsigned int components)
+{
+	Location from = locations[entity.index];
+	if (archetypes[from.archetype].components == components)
+		return;
+
+	// Add the new row first, so the old one is still there to copy from
+	EntityChunk* fromChunk = archetypes[from.archetype].chunks[from.chunk];
+	AddRow(entity, FindArchetype(components));
+	int row;
+	EntityChunk* toChunk = GetChunk(entity, row);
+
+	// An entity keeping its transform doesn't need the new row's, and one losing it frees it
+	if (fromChunk->transforms && toChunk->transforms)
+		transformSystem.Destroy(toChunk->transforms[row]);
+	else if (fromChunk->transforms)
+		transformSystem.Destroy(fromChunk->transforms[from.row]);
+
+	CopyRow(fromChunk, from.row, toChunk, row);
+	RemoveRow(from);
+	LogChange(entity);
+}
+
+unsigned int EntityStore::GetComponents(EntityHandle entity) { return archetypes[locations[entity.index].archetype].components; }
+
+// --------------------------------- Component access
+int EntityStore::GetTransform(EntityHandle entity)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	return chunk->transforms[row];
+}
+
+bool EntityStore::SetParent(EntityHandle entity, EntityHandle parent)
+{
+	int row;
+	EntityChunk* chunk = Find(entity, row);
+	if (!chunk || !chunk->transforms)
+		return false;
+
+	int parentTransform = -1;
+	if (parent.index >= 0)
+	{
+		int parentRow;
+		EntityChunk* parentChunk = Find(parent, parentRow);
+		if (!parentChunk || !parentChunk->transforms)
+			return false;
+		parentTransform = parentChunk->transforms[parentRow];
+	}
+	return transformSystem.SetParent(chunk->transforms[row], parentTransform);
+}
+
+Mesh* EntityStore::GetMesh(EntityHandle entity)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	return chunk->meshes[row];
+}
+
+void EntityStore::SetMesh(EntityHandle entity, Mesh* mesh)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	chunk->meshes[row] = mesh;
+	LogChange(entity);
+}
+
+Material* EntityStore::GetMaterial(EntityHandle entity)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	return chunk->materials[row];
+}
+
+void EntityStore::SetMaterial(EntityHandle entity, Material* material)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	chunk->materials[row] = material;
+	LogChange(entity);
+}
+
+EntityBounds EntityStore::GetBounds(EntityHandle entity)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	return chunk->bounds[row];
+}
+
+unsigned int EntityStore::GetRenderFlags(EntityHandle entity)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	return chunk->renderFlags[row];
+}
+
+void EntityStore::SetRenderFlags(EntityHandle entity, unsigned int flags)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	chunk->renderFlags[row] = flags;
+}
+
+// Submeshes past the last slot always use the entity's material
+void EntityStore::SetSubmeshMaterial(EntityHandle entity, int submesh, Material* material)
+{
+	if (submesh < 0 || submesh >= EntitySubmeshMaterials::MaxSubmeshes)
+		return;
+
+	unsigned int components = GetComponents(entity);
+	if (!(components & ENTITY_COMPONENT_SUBMESH_MATERIALS))
+		SetComponents(entity, components | ENTITY_COMPONENT_SUBMESH_MATERIALS);
+
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	chunk->submeshMaterials[row].materials[submesh] = material;
+}
+
+Material* EntityStore::GetSubmeshMaterial(EntityHandle entity, int submesh)
+{
+	int row;
+	EntityChunk* chunk = GetChunk(entity, row);
+	return chunk->GetSubmeshMaterial(row, submesh);
+}
+
+// --------------------------------- Pool occupancy
+int EntityStore::GetChunkCount() { return chunkPool.GetLiveCount(); }
+size_t EntityStore::GetChunkBytes() { return chunkMemoryPool.GetUsedBytes() + chunkPool.GetUsedBytes(); }
+size_t EntityStore::GetReservedChunkBytes() { return chunkMemoryPool.GetTotalBytes() + chunkPool.GetTotalBytes(); }
+
+// --------------------------------- Queries and systems
+TransformSystem* EntityStore::GetTransforms() { return &transformSystem; }
+int EntityStore::UpdateWorldMatrices() { return transformSystem.UpdateWorldMatrices(); }
+
+void EntityStore::Query(unsigned int components, std::vector<EntityChunk*>& chunks)
+{
+	chunks.clear();
+	for (Archetype& archetype : archetypes)
+	{
+		if ((archetype.components & components) == components)
+			chunks.insert(chunks.end(), archetype.chunks.begin(), archetype.chunks.end());
+	}
+}
+
+// Moves the mesh's box center through the world matrix and grows the extents by the absolute rotation and scale
+void EntityStore::UpdateBounds()
+{
+	Query(ENTITY_COMPONENT_TRANSFORM | ENTITY_COMPONENT_MESH | ENTITY_COMPONENT_BOUNDS, boundsChunks);
+	for (EntityChunk* chunk : boundsChunks)
+	{
+		for (int row = 0; row < chunk->count; row++)
+		{
+			DirectX::XMFLOAT3 localMin(0, 0, 0);
+			DirectX::XMFLOAT3 localMax(0, 0, 0);
+			if (chunk->meshes[row])
+			{
+				localMin = chunk->meshes[row]->GetBoundsMin();
+				localMax = chunk->meshes[row]->GetBoundsMax();
+			}
+
+			DirectX::XMMATRIX worldMatrix = DirectX::XMLoadFloat4x4(&transformSystem.GetWorldMatrix(chunk->transforms[row]));
+			DirectX::XMVECTOR minVector = DirectX::XMLoadFloat3(&localMin);
+			DirectX::XMVECTOR maxVector = DirectX::XMLoadFloat3(&localMax);
+			DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(minVector, maxVector), 0.5f);
+			DirectX::XMVECTOR extent = DirectX::XMVectorScale(DirectX::XMVectorSubtract(maxVector, minVector), 0.5f);
+
+			center = DirectX::XMVector3Transform(center, worldMatrix);
+			DirectX::XMVECTOR worldExtent = DirectX::XMVectorAdd(DirectX::XMVectorAdd(
+				DirectX::XMVectorScale(DirectX::XMVectorAbs(worldMatrix.r[0]), DirectX::XMVectorGetX(extent)),
+				DirectX::XMVectorScale(DirectX::XMVectorAbs(worldMatrix.r[1]), DirectX::XMVectorGetY(extent))),
+				DirectX::XMVectorScale(DirectX::XMVectorAbs(worldMatrix.r[2]), DirectX::XMVectorGetZ(extent)));
+
+			DirectX::XMStoreFloat3(&chunk->bounds[row].min, DirectX::XMVectorSubtract(center, worldExtent));
+			DirectX::XMStoreFloat3(&chunk->bounds[row].max, DirectX::XMVectorAdd(center, worldExtent));
+		}
+	}
+}
@@ -0,0 +1,240 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+#include "TransformSystem.h"
+#include "ObjectPool.h"
+
+class Mesh;
+class Material;
+
+// Components an entity can have, which together make up its archetype
+enum EntityComponentFlags
+{
+	ENTITY_COMPONENT_TRANSFORM = 1 << 0,
+	ENTITY_COMPONENT_MESH = 1 << 1,
+	ENTITY_COMPONENT_MATERIAL = 1 << 2,
+	ENTITY_COMPONENT_BOUNDS = 1 << 3,          // World space box around the mesh, kept up by UpdateBounds
+	ENTITY_COMPONENT_RENDER_FLAGS = 1 << 4,
+	ENTITY_COMPONENT_SUBMESH_MATERIALS = 1 << 5, // Only for entities that override some of their submeshes' materials
+
+	// Everything the renderer needs to draw an entity
+	ENTITY_COMPONENT_RENDERABLE = ENTITY_COMPONENT_TRANSFORM | ENTITY_COMPONENT_MESH | ENTITY_COMPONENT_MATERIAL | ENTITY_COMPONENT_BOUNDS | ENTITY_COMPONENT_RENDER_FLAGS
+};
+
+// What the renderer does with an entity
+enum EntityRenderFlags
+{
+	ENTITY_RENDER_VISIBLE = 1 << 0,            // Drawn at all
+	ENTITY_RENDER_NO_CULLING = 1 << 1,         // Drawn even when its bounds are outside the view
+
+	ENTITY_RENDER_DEFAULT = ENTITY_RENDER_VISIBLE
+};
+
+// Generational reference to an entity
+// - Slots are reused once their entity is destroyed, the generation tells a stale handle from the slot's new entity
+struct EntityHandle
+{
+	int index;                              // Slot in the store
+	int generation;                         // Bumped every time the slot's entity is destroyed
+
+	bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+	bool operator<(const EntityHandle& other) const { return index != other.index ? index < other.index : generation < other.generation; }
+};
+
+// Never refers to an entity
+const EntityHandle ENTITY_HANDLE_NONE = { -1, 0 };
+
+// Axis aligned box in world space
+struct EntityBounds
+{
+	DirectX::XMFLOAT3 min;
+	DirectX::XMFLOAT3 max;
+};
+
+// Per submesh materials, null slots (and submeshes past the last slot) use the entity's material
+struct EntitySubmeshMaterials
+{
+	static const int MaxSubmeshes = 8;
+	Material* materials[MaxSubmeshes];
+};
+
+// --------------------------------------------------------
+// A fixed size block of entities that all have the same
+// components, each component in its own contiguous array
+//
+// - Rows 0 to count - 1 are live, with no gaps
+// - Arrays for components the archetype doesn't have are
+//   null
+// --------------------------------------------------------
+struct EntityChunk
+{
+	int count;
+	int capacity;
+	unsigned int components;
+	unsigned char* memory;                  // One ChunkBytes block holding every array below
+
+	EntityHandle* entities;                 // Handle of the entity in each row
+	int* transforms;                        // Index in the store's TransformSystem
+	Mesh** meshes;
+	Material** materials;
+	EntityBounds* bounds;
+	unsigned int* renderFlags;
+	EntitySubmeshMaterials* submeshMaterials;
+
+	// The submesh's own material, or the entity's if it has none
+	Material* GetSubmeshMaterial(int row, int submesh);
+};
+
+// --------------------------------------------------------
+// Entities stored by archetype (the set of components they
+// have) in chunks of contiguous component arrays
+//
+// - Systems ask for every chunk that has the components
+//   they need and walk its arrays directly, so nothing is
+//   copied and each pass only touches what it reads
+// - Entities are generational handles into a slot map, so
+//   a handle to a destroyed entity is detected (IsAlive,
+//   Find) even once its slot is reused
+// - Destroying one, or changing its components, moves the
+//   archetype's last entity into the hole in O(1), so every
+//   chunk but the last stays full
+// - Chunk pointers and rows are only stable until entities
+//   are created, destroyed or change components, hold on to
+//   handles instead
+// - Chunks and their memory come from pools of fixed size
+//   blocks, so churning through chunks doesn't go back to
+//   the heap
+// - Creations and destructions are logged until
+//   ClearChanges, so a system downstream (the render queue)
+//   can update incrementally instead of starting over
+// --------------------------------------------------------
+class EntityStore
+{
+public:
+	// Size of one chunk's memory, the rows per chunk depend on the archetype
+	static const int ChunkBytes = 16384;
+
+	~EntityStore();
+
+	// Creates an entity with the given components, all defaulted, and returns its handle
+	EntityHandle Create(unsigned int components);
+
+	// Creates an entity with every renderable component, at the origin with default render flags
+	EntityHandle CreateRenderable(Mesh* mesh, Material* material);
+
+	// Destroys the entity in O(1), false if the handle is stale
+	bool Destroy(EntityHandle entity);
+
+	// Destroys every entity and frees every chunk, leaving every outstanding handle stale
+	void Clear();
+
+	bool IsAlive(EntityHandle entity);
+	int GetCount();
+
+	// The chunk and row the entity is in right now, null if the handle is stale
+	EntityChunk* Find(EntityHandle entity, int& row);
+
+	// Moves the entity to the archetype with the given components, keeping the ones both have
+	void SetComponents(EntityHandle entity, unsigned int components);
+	unsigned int GetComponents(EntityHandle entity);
+
+	// Component access, only valid while the entity is alive and has the component
+	// - The transform is an index in GetTransforms(), which stays the same for the entity's whole life
+	int GetTransform(EntityHandle entity);
+
+	// Attaches the entity's transform under another entity's, or detaches it with ENTITY_HANDLE_NONE
+	// - Destroying the parent, or taking its transform away, leaves its children as roots
+	// - Returns false and changes nothing if either is dead or has no transform, or the parent is below the entity
+	bool SetParent(EntityHandle entity, EntityHandle parent);
+	Mesh* GetMesh(EntityHandle entity);
+	void SetMesh(EntityHandle entity, Mesh* mesh);
+	Material* GetMaterial(EntityHandle entity);
+	void SetMaterial(EntityHandle entity, Material* material);
+	EntityBounds GetBounds(EntityHandle entity);
+	unsigned int GetRenderFlags(EntityHandle entity);
+	void SetRenderFlags(EntityHandle entity, unsigned int flags);
+
+	// Per submesh materials, adding the component the first time one is set (null goes back to the entity's material)
+	void SetSubmeshMaterial(EntityHandle entity, int submesh, Material* material);
+	Material* GetSubmeshMaterial(EntityHandle entity, int submesh);
+
+	// Entities created and destroyed since the last ClearChanges, in order
+	// - One created and destroyed in between is in both lists, and is no longer alive
+	// - Changing an entity's mesh, material or components logs it in both lists too, so anything keyed on
+	//   those takes it out and puts it back
+	const std::vector<EntityHandle>& GetCreated();
+	const std::vector<EntityHandle>& GetDestroyed();
+	void ClearChanges();
+
+	// Every entity's transform, rebuilt in batches by UpdateWorldMatrices
+	TransformSystem* GetTransforms();
+
+	// Rebuilds the world matrices of every transform changed since the last call, once per frame before
+	// UpdateBounds and drawing, and returns how many that was
+	int UpdateWorldMatrices();
+
+	// Every chunk whose archetype has at least the given components
+	void Query(unsigned int components, std::vector<EntityChunk*>& chunks);
+
+	// Occupancy of the chunk pools
+	int GetChunkCount();
+	size_t GetChunkBytes();
+	size_t GetReservedChunkBytes();
+
+	// Fits the world space bounds of every entity with a transform, mesh and bounds around its mesh, using the
+	// world matrices from the last UpdateWorldMatrices
+	// - Entities without a mesh get a point at their position
+	void UpdateBounds();
+
+private:
+	// Every chunk of one set of components
+	struct Archetype
+	{
+		unsigned int components;
+		std::vector<EntityChunk*> chunks;
+	};
+
+	// Where a slot's entity lives, archetype -1 while the slot is free
+	struct Location
+	{
+		int archetype;
+		int chunk;
+		int row;
+	};
+
+	// The memory block behind each chunk
+	struct ChunkMemory
+	{
+		alignas(16) unsigned char bytes[ChunkBytes];
+	};
+
+	int FindArchetype(unsigned int components);
+	EntityChunk* CreateChunk(unsigned int components);
+	void DestroyChunk(EntityChunk* chunk);
+	void DefaultRow(EntityChunk* chunk, int row);
+	void AddRow(EntityHandle entity, int archetype);
+	void RemoveRow(const Location& at);
+	void CopyRow(EntityChunk* from, int fromRow, EntityChunk* to, int toRow);
+	EntityChunk* GetChunk(EntityHandle entity, int& row);
+	void LogChange(EntityHandle entity);
+
+	std::vector<Archetype> archetypes;
+	TransformSystem transformSystem;
+	ObjectPool<EntityChunk> chunkPool;
+	ObjectPool<ChunkMemory> chunkMemoryPool { 16 };	// 256 KB pages
+
+	// The slot map, one entry per slot in each, with free slots reused last in first out
+	std::vector<Location> locations;
+	std::vector<int> generations;
+	std::vector<int> freeSlots;
+	int count = 0;
+
+	// Changes since the last ClearChanges
+	std::vector<EntityHandle> created;
+	std::vector<EntityHandle> destroyed;
+
+	// Reused by UpdateBounds every frame
+	std::vector<EntityChunk*> boundsChunks;
+};
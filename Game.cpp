@@ -1,6 +1,9 @@
 #include "Game.h"
 #include "Vertex.h"
 #include "Renderer.h"
+#include "Benchmarks.h"
+#include "PrimitiveGenerator.h"
+#include "VertexCompressor.h"
 
 // Needed for a helper function to read compiled shader files from the hard drive
 #pragma comment(lib, "d3dcompiler.lib")
@@ -33,8 +36,9 @@ Game::Game(HINSTANCE hInstance)
 	printf("Console window created successfully.  Feel free to printf() here.\n");
 #endif
 
-	// Setting up renderer and camera
+	// Setting up renderer, camera and entity storage
 	renderer = new Renderer();
+	entities = new EntityStore();
 	camera = new Camera(0, 0, -40, (float)this->width / this->height);
 }
 
@@ -48,25 +52,37 @@ Game::~Game()
 	// Clean up all of our normal pointers to items on the heap
 	delete renderer;
 	delete camera;
+	delete entities;
 
 	// Yeet all those shaders
 	delete pixelShader;
 	delete vertexShader;
 	delete pixelShaderWithNormals;
 	delete vertexShaderWithNormals;
+	delete vertexShaderCompact;
+	delete vertexShaderQuantized;
 	delete pixelShaderSkybox;
 	delete vertexShaderSkybox;
 	delete skybox;
 
+	// Stop loading before the meshes being loaded go away
+	delete meshLoader;
+	meshPool.Destroy(placeholderMesh);
+
 	// Delete al the meshes
 	for (int i = 0; i < meshes.size(); i++) {
-		delete meshes[i];
+		meshPool.Destroy(meshes[i]);
 	}
 
+	// Only once every mesh has given its buffer ranges back
+	delete geometryPool;
+
 	// Delete all the materials
 	for (int i = 0; i < materials.size(); i++) {
-		delete materials[i];
+		materialPool.Destroy(materials[i]);
 	}
+	materialPool.Destroy(compactMaterial);
+	materialPool.Destroy(quantizedMaterial);
 
 	// Clean up ImGui's memory
 	ImGui_ImplDX11_Shutdown();
@@ -148,8 +164,14 @@ void Game::Init(HWND hWnd)
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
 	ImGui::StyleColorsDark();
 	showGui = true;
+	firstFrameDrawn = false;
 	ImGui_ImplWin32_Init(hWnd); // Unclear on if I need this?
 	ImGui_ImplDX11_Init(device.Get(), context.Get());
+
+#if defined(RUN_BENCHMARKS)
+	// Print pipeline performance numbers to the console
+	RunBenchmarks();
+#endif
 }
 
 // --------------------------------------------------------
@@ -165,6 +187,19 @@ void Game::LoadShaders()
 	vertexShader = new SimpleVertexShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"VertexShader.cso").c_str());
 	vertexShaderSkybox = new SimpleVertexShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"VertexShaderSkybox.cso").c_str());
 	vertexShaderWithNormals = new SimpleVertexShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"VertexShaderNormal.cso").c_str());
+
+	// Reflection would describe the compressed attributes as floats, so these get the layouts that match the vertex structs
+	vertexShaderCompact = nullptr;
+	vertexShaderQuantized = nullptr;
+	ID3D11InputLayout* compactLayout = nullptr;
+	ID3D11InputLayout* quantizedLayout = nullptr;
+	std::wstring compactPath = GetFullPathTo_Wide(L"VertexShaderCompact.cso");
+	if (SUCCEEDED(VertexCompressor::CreateInputLayout(device.Get(), compactPath.c_str(), false, &compactLayout)))
+		vertexShaderCompact = new SimpleVertexShader(device.Get(), context.Get(), compactPath.c_str(), compactLayout, false);
+	if (SUCCEEDED(VertexCompressor::CreateInputLayout(device.Get(), compactPath.c_str(), true, &quantizedLayout)))
+		vertexShaderQuantized = new SimpleVertexShader(device.Get(), context.Get(), compactPath.c_str(), quantizedLayout, false);
+	if (!vertexShaderCompact || !vertexShaderQuantized)
+		printf("Couldn't create the compressed vertex input layouts, compressed meshes are skipped\n");
 }
 
 // --------------------------------------------------------
@@ -179,22 +214,55 @@ void Game::CreateBasicGeometry()
 	XMFLOAT4 white = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 
 	// Generating materials to be used by different meshes
-	Material* cushionNoNormal = new Material(white, pixelShader, vertexShader, cushionDiffuseMap, 1);
-	Material* cushionNormal = new Material(white, pixelShaderWithNormals, vertexShaderWithNormals, cushionDiffuseMap, cushionNormalMap, 2);
-	Material* rocksNoNormal = new Material(white, pixelShader, vertexShader, rockDiffuseMap, 3);
-	Material* rocksNormal = new Material(white, pixelShaderWithNormals, vertexShaderWithNormals, rockDiffuseMap, rockNormalMap, 4);
+	Material* cushionNoNormal = materialPool.Create(white, pixelShader, vertexShader, cushionDiffuseMap, 1);
+	Material* cushionNormal = materialPool.Create(white, pixelShaderWithNormals, vertexShaderWithNormals, cushionDiffuseMap, cushionNormalMap, 2);
+	Material* rocksNoNormal = materialPool.Create(white, pixelShader, vertexShader, rockDiffuseMap, 3);
+	Material* rocksNormal = materialPool.Create(white, pixelShaderWithNormals, vertexShaderWithNormals, rockDiffuseMap, rockNormalMap, 4);
 
 	// Store the materials and meshes
 	materials.push_back(cushionNoNormal);
 	materials.push_back(cushionNormal);
 	materials.push_back(rocksNoNormal);
 	materials.push_back(rocksNormal);
-	meshes.push_back(new Mesh(GetFullPathTo("../../Assets/sphere.obj").c_str(), device));
-	meshes.push_back(new Mesh(GetFullPathTo("../../Assets/cube.obj").c_str(), device));
-	meshes.push_back(new Mesh(GetFullPathTo("../../Assets/helix.obj").c_str(), device));
-	meshes.push_back(new Mesh(GetFullPathTo("../../Assets/cylinder.obj").c_str(), device));
-	meshes.push_back(new Mesh(GetFullPathTo("../../Assets/cone.obj").c_str(), device));
-	meshes.push_back(new Mesh(GetFullPathTo("../../Assets/torus.obj").c_str(), device));
+
+	// Normal mapped, so the handedness the compressed vertices carry is put to use
+	compactMaterial = vertexShaderCompact ? materialPool.Create(white, pixelShaderWithNormals, vertexShaderCompact, rockDiffuseMap, rockNormalMap, 5) : nullptr;
+	quantizedMaterial = vertexShaderQuantized ? materialPool.Create(white, pixelShaderWithNormals, vertexShaderQuantized, cushionDiffuseMap, cushionNormalMap, 6) : nullptr;
+
+	// Meshes from files load in the background, and are uploaded by Update as they finish
+	geometryPool = new GeometryPool(device);
+	placeholderMesh = MeshLoader::CreatePlaceholder(device, meshPool, geometryPool);
+	meshLoader = new MeshLoader(device, meshPool, placeholderMesh, geometryPool);
+
+	// The basic shapes are generated instead, so they're ready right away (the skybox uses the cube)
+	MeshData shapes[6];
+	PrimitiveGenerator::Sphere(shapes[0]);
+	PrimitiveGenerator::Cube(shapes[1]);
+	PrimitiveGenerator::Helix(shapes[2]);
+	PrimitiveGenerator::Cylinder(shapes[3]);
+	PrimitiveGenerator::Cone(shapes[4]);
+	PrimitiveGenerator::Torus(shapes[5]);
+	for (int i = 0; i < 6; i++)
+	{
+		printf("Generated %s (%zu verts, %zu triangles)\n", shapes[i].submeshes[0].name, shapes[i].verts.size(), shapes[i].indices.size() / 3);
+		Mesh::ProcessData(shapes[i], MESH_PROCESS_DEFAULT);
+		meshes.push_back(meshPool.Create(shapes[i], device, geometryPool));
+	}
+
+	// Plus a compressed copy of the sphere and the torus, one of each vertex format
+	if (compactMaterial && quantizedMaterial)
+	{
+		MeshData compressed[2];
+		PrimitiveGenerator::Sphere(compressed[0]);
+		PrimitiveGenerator::Torus(compressed[1]);
+		Mesh::ProcessData(compressed[0], MESH_PROCESS_DEFAULT | MESH_PROCESS_COMPACT_VERTICES);
+		Mesh::ProcessData(compressed[1], MESH_PROCESS_DEFAULT | MESH_PROCESS_QUANTIZE_POSITIONS);
+		for (int i = 0; i < 2; i++)
+			meshes.push_back(meshPool.Create(compressed[i], device, geometryPool));
+	}
+
+	// And one asset from disk, drawn as the placeholder until the loader uploads it (or for good, if it's missing)
+	meshes.push_back(meshLoader->Load(GetFullPathTo("../../Assets/helix.obj").c_str()));
 
 	// Spawn in entities with random meshes, materials, and locations
 	AddGeo(50);
@@ -207,36 +275,55 @@ void Game::AddGeo(int n)
 	for (int i = 0; i < n; i++) {
 		AddSingleGeo();
 	}
-
-	renderer->SetDirty();
 }
 
 // Adds a single random piece of geometry to the scene
 void Game::AddSingleGeo() {
-	Entity e = Entity(meshes[rand() % meshes.size()], materials[rand() % materials.size()]);
+	// Compressed meshes need the material whose vertex shader reads their format
+	Mesh* mesh = meshes[rand() % meshes.size()];
+	Material* material = materials[rand() % materials.size()];
+	if (mesh->GetVertexStride() == sizeof(CompactVertex))
+		material = compactMaterial;
+	else if (mesh->GetVertexStride() == sizeof(QuantizedVertex))
+		material = quantizedMaterial;
+	EntityHandle e = entities->CreateRenderable(mesh, material);
+
+	// Every fourth one is attached to an earlier entity, half its size and just off to its side
+	TransformSystem* transforms = entities->GetTransforms();
+	int transform = entities->GetTransform(e);
+	if (spawnedEntities.size() > 0 && rand() % 4 == 0) {
+		entities->SetParent(e, spawnedEntities[rand() % spawnedEntities.size()]);
+		transforms->SetPosition(transform, 2.0f, 0.0f, 0.0f);
+		transforms->SetScale(transform, 0.5f, 0.5f, 0.5f);
+		spawnedEntities.push_back(e);
+		return;
+	}
 
 	float xPos = (rand() % 30) - 15.0f;
 	float yPos = (rand() % 30) - 15.0f;
 	float zPos = (rand() % 30) - 15.0f;
-	e.GetTransform()->SetPosition(xPos, yPos, zPos);
+	transforms->SetPosition(transform, xPos, yPos, zPos);
 
 	float xRot = rand() % 360;
 	float yRot = rand() % 360;
 	float zRot = rand() % 360;
-	e.GetTransform()->SetRotation(xRot, yRot, zRot);
+	transforms->SetRotation(transform, xRot, yRot, zRot);
 
-	entities.push_back(e);
+	spawnedEntities.push_back(e);
 }
 
-// Removes 10 pieces of geometry from the scene
+// Removes 10 random pieces of geometry from the scene
 void Game::RemoveGeo(int n)
 {
 	for (int i = 0; i < n; i++) {
-		if (entities.size() == 0) return;
-		entities.pop_back();
-	}
+		if (spawnedEntities.size() == 0) return;
 
-	renderer->SetDirty();
+		// Any entity can go in O(1), with the last handle moved into its place here too
+		int index = rand() % spawnedEntities.size();
+		entities->Destroy(spawnedEntities[index]);
+		spawnedEntities[index] = spawnedEntities.back();
+		spawnedEntities.pop_back();
+	}
 }
 
 // --------------------------------------------------------
@@ -266,6 +353,9 @@ void Game::Update(float deltaTime, float totalTime)
 
 	// Update the camera
 	camera->Update(deltaTime, this->hWnd);
+
+	// Create the buffers of any meshes that finished loading
+	meshLoader->Update();
 }
 
 // --------------------------------------------------------
@@ -276,9 +366,12 @@ void Game::Draw(float deltaTime, float totalTime)
 	// Clear the background then draw the meshes
 	renderer->ClearBackground(context, backBufferRTV, depthStencilView);
 
-	// Check if the render queue needs to be cleaned
-	if (renderer->GetDirty())
-		renderer->GenerateRenderQueue(entities);
+	// Rebuild the world matrices of the entities that moved, then fit every entity's bounds around them for culling
+	entities->UpdateWorldMatrices();
+	entities->UpdateBounds();
+
+	// Bring the render queue up to date with whatever was added or removed
+	renderer->UpdateRenderQueue(entities);
 
 	// Draw the skybox
 	skybox->Draw(context, camera);
@@ -309,7 +402,7 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	// Actually draw the meshes
 	if (drawWithRenderQueue)
-		renderer->DrawMeshesQueued(context, samplerState, camera);
+		renderer->DrawMeshesQueued(context, samplerState, entities, camera);
 	else
 		renderer->DrawMeshes(context, samplerState, entities, camera);
 
@@ -319,6 +412,11 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	// Present the back buffer to the user
 	swapChain->Present(0, 0);
+	if (!firstFrameDrawn)
+	{
+		printf("---> First frame presented %.2f ms after startup (%d meshes still loading)\n", totalTime * 1000.0f, meshLoader->GetPendingCount());
+		firstFrameDrawn = true;
+	}
 
 	// Due to the usage of a more sophisticated swap chain, the render target must be re-bound after every call to Present()
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
@@ -429,7 +527,12 @@ void Game::DrawGui() {
 
 	// Showing FPS
 	ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-	ImGui::Text("Total objects being rendered: %i", entities.size());
+	ImGui::Text("Total objects being rendered: %i", entities->GetCount());
+	ImGui::Text("Objects culled last frame: %i", renderer->GetCulledEntityCount());
+	ImGui::Text("Geometry buffer binds last frame: %i", renderer->GetGeometryBindCount());
+	ImGui::Text("Geometry pool: %.1f / %.1f MB in %i buffers", geometryPool->GetUsedBytes() / 1048576.0, geometryPool->GetTotalBytes() / 1048576.0, geometryPool->GetPageCount());
+	ImGui::Text("Mesh pool: %i / %i blocks, material pool: %i / %i blocks", meshPool.GetLiveCount(), meshPool.GetCapacity(), materialPool.GetLiveCount(), materialPool.GetCapacity());
+	ImGui::Text("Entity chunks: %i, %.1f / %.1f MB", entities->GetChunkCount(), entities->GetChunkBytes() / 1048576.0, entities->GetReservedChunkBytes() / 1048576.0);
 
 	// Actually displaying
 	ImGui::End();
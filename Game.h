@@ -2,8 +2,11 @@
 
 #include "DXCore.h"
 #include "Mesh.h"
+#include "MeshLoader.h"
 #include "Material.h"
 #include "Renderer.h"
+#include "EntityStore.h"
+#include "ObjectPool.h"
 #include "Camera.h"
 #include "Lights.h"
 #include "Skybox.h"
@@ -59,16 +62,33 @@ private:
 	SimpleVertexShader* vertexShaderWithNormals;
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
 
+	// VertexShaderCompact with the input layout for each compressed vertex format, null if the layout couldn't be made
+	SimpleVertexShader* vertexShaderCompact;
+	SimpleVertexShader* vertexShaderQuantized;
+
 	// Custom renderer
 	Renderer* renderer;
 
 	// Camera
 	Camera* camera;
 
-	// Entities and Materials
+	// Entities and Materials, the meshes and materials packed into pools instead of one heap allocation each
+	ObjectPool<Mesh> meshPool { 16 };
+	ObjectPool<Material> materialPool { 16 };
 	std::vector<Mesh*> meshes;
 	std::vector<Material*> materials;
-	std::vector<Entity> entities;
+
+	// Compressed meshes can only be drawn through VertexShaderCompact, so they get materials of their own
+	Material* compactMaterial;
+	Material* quantizedMaterial;
+	EntityStore* entities;
+	std::vector<EntityHandle> spawnedEntities;
+
+	// Background mesh loading, meshes draw as the placeholder until they're uploaded
+	// - Every mesh lives in the geometry pool's shared buffers
+	GeometryPool* geometryPool;
+	MeshLoader* meshLoader;
+	Mesh* placeholderMesh;
 
 	// Texture info 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cushionDiffuseMap;
@@ -88,5 +108,6 @@ private:
 	// GUI Info
 	bool showGui;
 	bool drawWithRenderQueue;
+	bool firstFrameDrawn;
 };
 
@@ -0,0 +1,194 @@
+#include "GeometryPool.h"
+#include <algorithm>
+#include <cstdio>
+
+// Pages are created as they're needed, so nothing is allocated up front
+GeometryPool::GeometryPool(Microsoft::WRL::ComPtr<ID3D11Device> device, unsigned int pageBytes)
+	: device(device), pageBytes(pageBytes)
+{
+	device->GetImmediateContext(context.GetAddressOf());
+}
+
+GeometryPool::~GeometryPool()
+{
+	if (!pages.empty())
+		printf("---> Geometry pool released (%d pages, %.1f KB still in use)\n", GetPageCount(), GetUsedBytes() / 1024.0);
+}
+
+std::shared_ptr<GeometryAllocation> GeometryPool::AllocateVertices(const void* data, unsigned int numVerts, unsigned int stride)
+{
+	return Allocate(data, numVerts, stride, D3D11_BIND_VERTEX_BUFFER);
+}
+
+std::shared_ptr<GeometryAllocation> GeometryPool::AllocateIndices(const void* data, unsigned int numIndices, DXGI_FORMAT format)
+{
+	return Allocate(data, numIndices, format == DXGI_FORMAT_R16_UINT ? 2 : 4, D3D11_BIND_INDEX_BUFFER);
+}
+
+// Tries every page of the same kind before making a new one
+std::shared_ptr<GeometryAllocation> GeometryPool::Allocate(const void* data, unsigned int count, unsigned int elementSize, unsigned int bindFlags)
+{
+	// Nothing to draw, so there's no need for a buffer either
+	if (count == 0)
+		return std::make_shared<GeometryAllocation>();
+
+	int pageIndex = -1;
+	unsigned int first = 0;
+	for (size_t p = 0; p < pages.size() && pageIndex < 0; p++)
+	{
+		if (pages[p].bindFlags == bindFlags && pages[p].elementSize == elementSize && TakeRange(pages[p], count, first))
+			pageIndex = (int)p;
+	}
+
+	if (pageIndex < 0)
+	{
+		// Default usage (rather than immutable) so ranges can be filled in one at a time
+		Page page;
+		page.bindFlags = bindFlags;
+		page.elementSize = elementSize;
+		page.capacity = std::max(pageBytes / elementSize, count);
+		page.used = 0;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.ByteWidth = page.capacity * elementSize;
+		desc.BindFlags = bindFlags;
+		if (FAILED(device->CreateBuffer(&desc, 0, page.buffer.GetAddressOf())))
+			return nullptr;
+
+		AddFreeRange(page, 0, page.capacity);
+		TakeRange(page, count, first);
+		pages.push_back(page);
+		pageIndex = (int)pages.size() - 1;
+		printf("  geometry pool: new %s page (%u bytes each, %.1f KB)\n",
+			bindFlags == D3D11_BIND_VERTEX_BUFFER ? "vertex" : "index", elementSize, desc.ByteWidth / 1024.0);
+	}
+
+	Page& page = pages[pageIndex];
+	page.used += count;
+
+	// Buffers take their box in bytes, and the other two dimensions have to cover one element
+	// - Freed ranges can be reused right away, since the context orders the copy after any draws still reading them
+	D3D11_BOX box = {};
+	box.left = first * elementSize;
+	box.right = (first + count) * elementSize;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(page.buffer.Get(), 0, &box, data, 0, 0);
+
+	GeometryAllocation* allocation = new GeometryAllocation();
+	allocation->buffer = page.buffer;
+	allocation->first = first;
+	allocation->count = count;
+	return std::shared_ptr<GeometryAllocation>(allocation, [this, pageIndex](GeometryAllocation* a) {
+		Free(pageIndex, a->first, a->count);
+		delete a;
+	});
+}
+
+// Dedicated buffers usually can't change, so they're immutable like any other mesh buffer
+std::shared_ptr<GeometryAllocation> GeometryPool::CreateBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, const void* data, unsigned int count, unsigned int elementSize, unsigned int bindFlags,
+	D3D11_USAGE usage)
+{
+	if (count == 0)
+		return std::make_shared<GeometryAllocation>();
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = usage;
+	desc.ByteWidth = count * elementSize;
+	desc.BindFlags = bindFlags;
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = data;
+
+	std::shared_ptr<GeometryAllocation> allocation = std::make_shared<GeometryAllocation>();
+	allocation->first = 0;
+	allocation->count = count;
+	if (FAILED(device->CreateBuffer(&desc, &initialData, allocation->buffer.GetAddressOf())))
+		return nullptr;
+	return allocation;
+}
+
+// Best fit, the leftover part of the range stays free
+bool GeometryPool::TakeRange(Page& page, unsigned int count, unsigned int& first)
+{
+	std::multimap<unsigned int, unsigned int>::iterator fit = page.freeBySize.lower_bound(count);
+	if (fit == page.freeBySize.end())
+		return false;
+
+	unsigned int rangeFirst = fit->second;
+	unsigned int rangeCount = fit->first;
+	RemoveFreeRange(page, page.freeByStart.find(rangeFirst));
+	if (rangeCount > count)
+		AddFreeRange(page, rangeFirst + count, rangeCount - count);
+
+	first = rangeFirst;
+	return true;
+}
+
+// Merges the range with the free ranges right before and after it
+void GeometryPool::Free(int pageIndex, unsigned int first, unsigned int count)
+{
+	Page& page = pages[pageIndex];
+	page.used -= count;
+
+	std::map<unsigned int, unsigned int>::iterator next = page.freeByStart.lower_bound(first);
+	if (next != page.freeByStart.end() && next->first == first + count)
+	{
+		count += next->second;
+		RemoveFreeRange(page, next);
+	}
+
+	std::map<unsigned int, unsigned int>::iterator prev = page.freeByStart.lower_bound(first);
+	if (prev != page.freeByStart.begin())
+	{
+		--prev;
+		if (prev->first + prev->second == first)
+		{
+			first = prev->first;
+			count += prev->second;
+			RemoveFreeRange(page, prev);
+		}
+	}
+
+	AddFreeRange(page, first, count);
+}
+
+void GeometryPool::AddFreeRange(Page& page, unsigned int first, unsigned int count)
+{
+	page.freeByStart[first] = count;
+	page.freeBySize.insert(std::make_pair(count, first));
+}
+
+// Several ranges can have the same size, so the right one is found by its start
+void GeometryPool::RemoveFreeRange(Page& page, std::map<unsigned int, unsigned int>::iterator range)
+{
+	std::pair<std::multimap<unsigned int, unsigned int>::iterator, std::multimap<unsigned int, unsigned int>::iterator> sized = page.freeBySize.equal_range(range->second);
+	for (std::multimap<unsigned int, unsigned int>::iterator it = sized.first; it != sized.second; ++it)
+	{
+		if (it->second == range->first)
+		{
+			page.freeBySize.erase(it);
+			break;
+		}
+	}
+	page.freeByStart.erase(range);
+}
+
+int GeometryPool::GetPageCount() { return (int)pages.size(); }
+
+size_t GeometryPool::GetUsedBytes()
+{
+	size_t bytes = 0;
+	for (size_t p = 0; p < pages.size(); p++)
+		bytes += (size_t)pages[p].used * pages[p].elementSize;
+	return bytes;
+}
+
+size_t GeometryPool::GetTotalBytes()
+{
+	size_t bytes = 0;
+	for (size_t p = 0; p < pages.size(); p++)
+		bytes += (size_t)pages[p].capacity * pages[p].elementSize;
+	return bytes;
+}
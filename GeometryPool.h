@@ -0,0 +1,74 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+// A range of vertices or indices in a GPU buffer, shared by every mesh drawing from it
+// - Pooled ranges go back to their pool once the last mesh holding them lets go
+struct GeometryAllocation
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	unsigned int first;                     // In elements, the base vertex or start index to draw with
+	unsigned int count;
+};
+
+// --------------------------------------------------------
+// Suballocates mesh vertices and indices out of a few large
+// buffers, so meshes with the same vertex format share
+// their buffers and draws only need different offsets
+//
+// - Each vertex stride and index format gets its own pages,
+//   since base vertices are counted in whole vertices
+// - Free space in a page is a list of ranges: allocations
+//   take the smallest range that fits, and freed ranges are
+//   merged with their neighbors
+// - Anything that doesn't fit in an existing page gets a
+//   new one (as big as it needs to be)
+// - Only use it from the device's thread, and keep it alive
+//   until every mesh allocated from it is gone
+// --------------------------------------------------------
+class GeometryPool
+{
+public:
+	GeometryPool(Microsoft::WRL::ComPtr<ID3D11Device> device, unsigned int pageBytes = 16 * 1024 * 1024);
+	~GeometryPool();
+
+	// Copies the data into a free range of a page for the stride or format, nullptr if the buffer couldn't be created
+	std::shared_ptr<GeometryAllocation> AllocateVertices(const void* data, unsigned int numVerts, unsigned int stride);
+	std::shared_ptr<GeometryAllocation> AllocateIndices(const void* data, unsigned int numIndices, DXGI_FORMAT format);
+
+	// A buffer holding only the data, for meshes created without a pool
+	// - Immutable unless asked otherwise, default usage buffers can be updated in place like pool pages
+	static std::shared_ptr<GeometryAllocation> CreateBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, const void* data, unsigned int count, unsigned int elementSize, unsigned int bindFlags,
+		D3D11_USAGE usage = D3D11_USAGE_IMMUTABLE);
+
+	// Usage across every page
+	int GetPageCount();
+	size_t GetUsedBytes();
+	size_t GetTotalBytes();
+
+private:
+	struct Page
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		unsigned int bindFlags;
+		unsigned int elementSize;
+		unsigned int capacity;                    // In elements
+		unsigned int used;
+		std::map<unsigned int, unsigned int> freeByStart;       // First element -> count
+		std::multimap<unsigned int, unsigned int> freeBySize;   // Count -> first element
+	};
+
+	std::shared_ptr<GeometryAllocation> Allocate(const void* data, unsigned int count, unsigned int elementSize, unsigned int bindFlags);
+	bool TakeRange(Page& page, unsigned int count, unsigned int& first);
+	void Free(int pageIndex, unsigned int first, unsigned int count);
+	void AddFreeRange(Page& page, unsigned int first, unsigned int count);
+	void RemoveFreeRange(Page& page, std::map<unsigned int, unsigned int>::iterator range);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	unsigned int pageBytes;
+	std::vector<Page> pages;
+};
@@ -0,0 +1,764 @@
+#include "GltfParser.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+// Little endian chunk and header tags
+static const unsigned int GlbMagic = 0x46546C67;      // "glTF"
+static const unsigned int GlbChunkJson = 0x4E4F534A;  // "JSON"
+static const unsigned int GlbChunkBin = 0x004E4942;   // "BIN\0"
+
+// Accessor component types
+static const int ComponentByte = 5120;
+static const int ComponentUnsignedByte = 5121;
+static const int ComponentShort = 5122;
+static const int ComponentUnsignedShort = 5123;
+static const int ComponentUnsignedInt = 5125;
+static const int ComponentFloat = 5126;
+
+// Primitive modes that make triangles
+static const int ModeTriangles = 4;
+static const int ModeTriangleStrip = 5;
+static const int ModeTriangleFan = 6;
+
+// Deeper JSON than this is rejected rather than risking the stack
+static const int MaxJsonDepth = 64;
+
+// Node hierarchies deeper than this are cut off, which also stops cycles
+static const int MaxNodeDepth = 64;
+
+enum JsonType
+{
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT
+};
+
+// One value of the JSON chunk, pointing back into the mapping for its text
+// - Children of arrays and objects are linked through nextSibling
+struct JsonValue
+{
+	JsonType type;
+	double number;                       // Numbers and bools
+	const char* text;                    // String contents, escapes left as written
+	int length;
+	const char* key;                     // Name of the member, for values inside objects
+	int keyLength;
+	int firstChild;                      // -1 when empty
+	int nextSibling;                     // -1 for the last child
+};
+
+// The whole JSON chunk, parsed once up front
+class JsonDocument
+{
+public:
+	bool Parse(const char* begin, const char* end);
+
+	// Member of an object by name, -1 when it's missing (or the value isn't an object)
+	int Find(int object, const char* key) const;
+
+	// Every child of an array, in order
+	void GetElements(int array, std::vector<int>& elements) const;
+
+	// Typed lookups of an object's members, falling back to the default when they're missing or the wrong type
+	double GetNumber(int object, const char* key, double fallback) const;
+	int GetInt(int object, const char* key, int fallback) const;
+	std::string GetString(int object, const char* key) const;
+	bool IsString(int object, const char* key, const char* value) const;
+
+	std::vector<JsonValue> values;
+
+private:
+	const char* ParseValue(const char* c, int depth, int& index);
+	const char* ParseString(const char* c, const char*& text, int& length);
+	const char* ParseNumber(const char* c, double& number);
+	const char* SkipSpace(const char* c);
+
+	const char* end = nullptr;
+};
+
+const char* JsonDocument::SkipSpace(const char* c)
+{
+	while (c < end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n'))
+		c++;
+	return c;
+}
+
+// Leaves the quotes off, nullptr if the string never ends
+const char* JsonDocument::ParseString(const char* c, const char*& text, int& length)
+{
+	c++;
+	text = c;
+	while (c < end && *c != '"')
+		c += *c == '\\' ? 2 : 1;
+	if (c >= end)
+		return nullptr;
+
+	length = (int)(c - text);
+	return c + 1;
+}
+
+// Hand written like ObjParser's, since strtod would need the text copied out to be sure it stops in time
+const char* JsonDocument::ParseNumber(const char* c, double& number)
+{
+	bool negative = c < end && *c == '-';
+	if (negative)
+		c++;
+
+	double value = 0.0;
+	const char* digits = c;
+	while (c < end && *c >= '0' && *c <= '9')
+		value = value * 10.0 + (*c++ - '0');
+	if (c == digits)
+		return nullptr;
+
+	if (c < end && *c == '.')
+	{
+		double scale = 0.1;
+		for (c++; c < end && *c >= '0' && *c <= '9'; c++, scale *= 0.1)
+			value += (*c - '0') * scale;
+	}
+
+	if (c < end && (*c == 'e' || *c == 'E'))
+	{
+		c++;
+		bool negativeExponent = c < end && *c == '-';
+		if (c < end && (*c == '-' || *c == '+'))
+			c++;
+		int exponent = 0;
+		while (c < end && *c >= '0' && *c <= '9')
+			exponent = std::min(exponent * 10 + (*c++ - '0'), 400);
+		value *= pow(10.0, negativeExponent ? -exponent : exponent);
+	}
+
+	number = negative ? -value : value;
+	return c;
+}
+
+// Appends the value at c (and everything inside it), nullptr on any syntax error
+const char* JsonDocument::ParseValue(const char* c, int depth, int& index)
+{
+	c = SkipSpace(c);
+	if (c >= end || depth > MaxJsonDepth)
+		return nullptr;
+
+	index = (int)values.size();
+	values.push_back({ JSON_NULL, 0.0, nullptr, 0, nullptr, 0, -1, -1 });
+
+	char first = *c;
+	if (first == '{' || first == '[')
+	{
+		bool object = first == '{';
+		values[index].type = object ? JSON_OBJECT : JSON_ARRAY;
+		char close = object ? '}' : ']';
+		int previous = -1;
+		c = SkipSpace(c + 1);
+		if (c < end && *c == close)
+			return c + 1;
+
+		while (c < end)
+		{
+			const char* key = nullptr;
+			int keyLength = 0;
+			if (object)
+			{
+				if (*c != '"' || !(c = ParseString(c, key, keyLength)))
+					return nullptr;
+				c = SkipSpace(c);
+				if (c >= end || *c != ':')
+					return nullptr;
+				c++;
+			}
+
+			int child;
+			if (!(c = ParseValue(c, depth + 1, child)))
+				return nullptr;
+			values[child].key = key;
+			values[child].keyLength = keyLength;
+			if (previous < 0)
+				values[index].firstChild = child;
+			else
+				values[previous].nextSibling = child;
+			previous = child;
+
+			c = SkipSpace(c);
+			if (c < end && *c == ',')
+				c = SkipSpace(c + 1);
+			else if (c < end && *c == close)
+				return c + 1;
+			else
+				return nullptr;
+		}
+		return nullptr;
+	}
+
+	if (first == '"')
+	{
+		values[index].type = JSON_STRING;
+		return ParseString(c, values[index].text, values[index].length);
+	}
+
+	if (first == '-' || (first >= '0' && first <= '9'))
+	{
+		values[index].type = JSON_NUMBER;
+		return ParseNumber(c, values[index].number);
+	}
+
+	// true, false and null
+	static const char* words[] = { "true", "false", "null" };
+	for (int w = 0; w < 3; w++)
+	{
+		size_t length = strlen(words[w]);
+		if ((size_t)(end - c) >= length && memcmp(c, words[w], length) == 0)
+		{
+			values[index].type = w < 2 ? JSON_BOOL : JSON_NULL;
+			values[index].number = w == 0 ? 1.0 : 0.0;
+			return c + length;
+		}
+	}
+	return nullptr;
+}
+
+// The root ends up as value 0
+bool JsonDocument::Parse(const char* begin, const char* textEnd)
+{
+	end = textEnd;
+	values.clear();
+	values.reserve((textEnd - begin) / 16 + 16);
+	int root;
+	return ParseValue(begin, 0, root) != nullptr && values[0].type == JSON_OBJECT;
+}
+
+int JsonDocument::Find(int object, const char* key) const
+{
+	if (object < 0 || values[object].type != JSON_OBJECT)
+		return -1;
+
+	int length = (int)strlen(key);
+	for (int child = values[object].firstChild; child >= 0; child = values[child].nextSibling)
+	{
+		if (values[child].keyLength == length && memcmp(values[child].key, key, length) == 0)
+			return child;
+	}
+	return -1;
+}
+
+void JsonDocument::GetElements(int array, std::vector<int>& elements) const
+{
+	elements.clear();
+	if (array < 0 || values[array].type != JSON_ARRAY)
+		return;
+	for (int child = values[array].firstChild; child >= 0; child = values[child].nextSibling)
+		elements.push_back(child);
+}
+
+double JsonDocument::GetNumber(int object, const char* key, double fallback) const
+{
+	int found = Find(object, key);
+	return found >= 0 && (values[found].type == JSON_NUMBER || values[found].type == JSON_BOOL) ? values[found].number : fallback;
+}
+
+int JsonDocument::GetInt(int object, const char* key, int fallback) const
+{
+	return (int)GetNumber(object, key, fallback);
+}
+
+std::string JsonDocument::GetString(int object, const char* key) const
+{
+	int found = Find(object, key);
+	return found >= 0 && values[found].type == JSON_STRING ? std::string(values[found].text, values[found].length) : std::string();
+}
+
+bool JsonDocument::IsString(int object, const char* key, const char* value) const
+{
+	int found = Find(object, key);
+	return found >= 0 && values[found].type == JSON_STRING && values[found].length == (int)strlen(value) &&
+		memcmp(values[found].text, value, values[found].length) == 0;
+}
+
+// Where an accessor's elements are in the binary chunk, already checked to be inside it
+struct AccessorView
+{
+	const unsigned char* data;
+	size_t stride;
+	size_t count;
+	int componentType;
+	int components;
+	bool normalized;
+};
+
+// Everything the primitives refer to by index, looked up once
+struct GltfFile
+{
+	JsonDocument json;
+	const unsigned char* bin = nullptr;
+	size_t binLength = 0;
+	std::vector<int> accessors;
+	std::vector<int> bufferViews;
+	std::vector<int> meshes;
+	std::vector<int> materials;
+	std::vector<int> nodes;
+};
+
+static int GetComponentSize(int componentType)
+{
+	switch (componentType)
+	{
+	case ComponentByte: case ComponentUnsignedByte: return 1;
+	case ComponentShort: case ComponentUnsignedShort: return 2;
+	case ComponentUnsignedInt: case ComponentFloat: return 4;
+	default: return 0;
+	}
+}
+
+static int GetComponentCount(const JsonDocument& json, int accessor)
+{
+	static const char* types[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+	for (int i = 0; i < 4; i++)
+	{
+		if (json.IsString(accessor, "type", types[i]))
+			return i + 1;
+	}
+	return 0;
+}
+
+// Resolves an accessor down to a pointer and stride in the binary chunk, false if it's missing, sparse or out of bounds
+static bool GetAccessorView(const GltfFile& file, int accessorIndex, AccessorView& view)
+{
+	if (accessorIndex < 0 || accessorIndex >= (int)file.accessors.size())
+		return false;
+
+	const JsonDocument& json = file.json;
+	int accessor = file.accessors[accessorIndex];
+	int bufferViewIndex = json.GetInt(accessor, "bufferView", -1);
+	if (bufferViewIndex < 0 || bufferViewIndex >= (int)file.bufferViews.size() || json.Find(accessor, "sparse") >= 0)
+		return false;
+
+	// Only the binary chunk's buffer (buffer 0 without a uri) can be read
+	int bufferView = file.bufferViews[bufferViewIndex];
+	if (json.GetInt(bufferView, "buffer", 0) != 0)
+		return false;
+
+	view.componentType = json.GetInt(accessor, "componentType", 0);
+	view.components = GetComponentCount(json, accessor);
+	view.normalized = json.GetNumber(accessor, "normalized", 0.0) != 0.0;
+	view.count = (size_t)std::max(json.GetNumber(accessor, "count", 0.0), 0.0);
+	size_t elementSize = (size_t)GetComponentSize(view.componentType) * view.components;
+	if (elementSize == 0)
+		return false;
+
+	double viewOffset = json.GetNumber(bufferView, "byteOffset", 0.0);
+	double viewLength = json.GetNumber(bufferView, "byteLength", 0.0);
+	double accessorOffset = json.GetNumber(accessor, "byteOffset", 0.0);
+	double stride = json.GetNumber(bufferView, "byteStride", 0.0);
+	view.stride = stride > 0.0 ? (size_t)stride : elementSize;
+	if (viewOffset < 0.0 || viewLength < 0.0 || accessorOffset < 0.0 || viewOffset + viewLength > (double)file.binLength)
+		return false;
+
+	// The last element has to end inside the buffer view
+	if (view.count > 0 && accessorOffset + (double)view.stride * (view.count - 1) + elementSize > viewLength)
+		return false;
+
+	view.data = file.bin + (size_t)viewOffset + (size_t)accessorOffset;
+	return true;
+}
+
+// Converts one component to float, following the accessor's normalization
+template <typename Component>
+static float ToFloat(Component value, bool normalized)
+{
+	if (!normalized)
+		return (float)value;
+	float scaled = (float)value / (float)std::numeric_limits<Component>::max();
+	return std::max(scaled, -1.0f);
+}
+
+// Reads components floats per element into dest, scaling each by its sign (so Z can be flipped on the way in)
+template <typename Component>
+static void ReadComponents(const AccessorView& view, int components, const float* signs, unsigned char* dest, size_t destStride)
+{
+	const unsigned char* source = view.data;
+	for (size_t i = 0; i < view.count; i++, source += view.stride, dest += destStride)
+	{
+		float* out = (float*)dest;
+		for (int c = 0; c < components; c++)
+		{
+			Component value;
+			memcpy(&value, source + c * sizeof(Component), sizeof(Component));
+			out[c] = ToFloat(value, view.normalized) * signs[c];
+		}
+	}
+}
+
+// Floats need no conversion at all, so they get their own loop
+template <>
+void ReadComponents<float>(const AccessorView& view, int components, const float* signs, unsigned char* dest, size_t destStride)
+{
+	const unsigned char* source = view.data;
+	for (size_t i = 0; i < view.count; i++, source += view.stride, dest += destStride)
+	{
+		float values[4];
+		memcpy(values, source, components * sizeof(float));
+		float* out = (float*)dest;
+		for (int c = 0; c < components; c++)
+			out[c] = values[c] * signs[c];
+	}
+}
+
+// Fills one attribute of every vertex, false if the accessor doesn't have enough components or an unknown type
+static bool ReadAttribute(const AccessorView& view, int components, const float* signs, Vertex* verts, size_t offset)
+{
+	if (view.components < components)
+		return false;
+
+	unsigned char* dest = (unsigned char*)verts + offset;
+	switch (view.componentType)
+	{
+	case ComponentFloat: ReadComponents<float>(view, components, signs, dest, sizeof(Vertex)); return true;
+	case ComponentByte: ReadComponents<signed char>(view, components, signs, dest, sizeof(Vertex)); return true;
+	case ComponentUnsignedByte: ReadComponents<unsigned char>(view, components, signs, dest, sizeof(Vertex)); return true;
+	case ComponentShort: ReadComponents<short>(view, components, signs, dest, sizeof(Vertex)); return true;
+	case ComponentUnsignedShort: ReadComponents<unsigned short>(view, components, signs, dest, sizeof(Vertex)); return true;
+	default: return false;
+	}
+}
+
+// True if any tangent's handedness (w) is negative, which Vertex has no room for
+static bool HasMirroredTangents(const AccessorView& view)
+{
+	if (view.components < 4 || view.componentType != ComponentFloat)
+		return false;
+
+	const unsigned char* source = view.data + 3 * sizeof(float);
+	for (size_t i = 0; i < view.count; i++, source += view.stride)
+	{
+		float w;
+		memcpy(&w, source, sizeof(float));
+		if (w < 0.0f)
+			return true;
+	}
+	return false;
+}
+
+// Copies indices out, offset by the primitive's first vertex, false if any points past its vertices
+template <typename Index>
+static bool ReadIndices(const AccessorView& view, unsigned int vertexCount, unsigned int baseVertex, unsigned int* dest)
+{
+	const unsigned char* source = view.data;
+	unsigned int highest = 0;
+	for (size_t i = 0; i < view.count; i++, source += view.stride)
+	{
+		Index index;
+		memcpy(&index, source, sizeof(Index));
+		highest = std::max(highest, (unsigned int)index);
+		dest[i] = baseVertex + index;
+	}
+	return view.count == 0 || highest < vertexCount;
+}
+
+// A node's transform from its parent, as a row vector matrix
+static DirectX::XMMATRIX GetLocalTransform(const JsonDocument& json, int node)
+{
+	std::vector<int> elements;
+	json.GetElements(json.Find(node, "matrix"), elements);
+	if (elements.size() == 16)
+	{
+		// Column major column vector matrices read in order are already the transposed row vector matrix
+		DirectX::XMFLOAT4X4 matrix;
+		for (int i = 0; i < 16; i++)
+			(&matrix._11)[i] = (float)json.values[elements[i]].number;
+		return DirectX::XMLoadFloat4x4(&matrix);
+	}
+
+	float trs[10] = { 0, 0, 0, 0, 0, 0, 1, 1, 1, 1 };
+	const char* keys[] = { "translation", "rotation", "scale" };
+	const int offsets[] = { 0, 3, 7 };
+	const size_t sizes[] = { 3, 4, 3 };
+	for (int k = 0; k < 3; k++)
+	{
+		json.GetElements(json.Find(node, keys[k]), elements);
+		if (elements.size() == sizes[k])
+		{
+			for (size_t i = 0; i < sizes[k]; i++)
+				trs[offsets[k] + i] = (float)json.values[elements[i]].number;
+		}
+	}
+
+	DirectX::XMVECTOR rotation = DirectX::XMQuaternionNormalize(DirectX::XMVectorSet(trs[3], trs[4], trs[5], trs[6]));
+	return DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(
+		DirectX::XMMatrixScaling(trs[7], trs[8], trs[9]),
+		DirectX::XMMatrixRotationQuaternion(rotation)),
+		DirectX::XMMatrixTranslation(trs[0], trs[1], trs[2]));
+}
+
+// Appends one primitive's vertices and triangles as a new group, false (adding nothing) if it can't be read
+static bool AddPrimitive(const GltfFile& file, int primitive, const std::string& name, const DirectX::XMMATRIX& transform, bool identity, ObjData& out, bool& hasTangents)
+{
+	const JsonDocument& json = file.json;
+	int mode = json.GetInt(primitive, "mode", ModeTriangles);
+	if (mode != ModeTriangles && mode != ModeTriangleStrip && mode != ModeTriangleFan)
+		return false;
+
+	int attributes = json.Find(primitive, "attributes");
+	AccessorView positions;
+	if (!GetAccessorView(file, json.GetInt(attributes, "POSITION", -1), positions) || positions.count == 0 ||
+		positions.componentType != ComponentFloat || positions.count > 0xFFFFFFFFu - out.verts.size())
+		return false;
+
+	// The z flip into left-handed space happens as the attributes are read
+	static const float flipZ[4] = { 1.0f, 1.0f, -1.0f, 1.0f };
+	size_t baseVertex = out.verts.size();
+	unsigned int vertexCount = (unsigned int)positions.count;
+	out.verts.resize(baseVertex + vertexCount);
+	Vertex* verts = out.verts.data() + baseVertex;
+	memset(verts, 0, vertexCount * sizeof(Vertex));
+	bool valid = ReadAttribute(positions, 3, flipZ, verts, offsetof(Vertex, position));
+
+	AccessorView view;
+	if (valid && GetAccessorView(file, json.GetInt(attributes, "NORMAL", -1), view) && view.count == vertexCount)
+		valid = ReadAttribute(view, 3, flipZ, verts, offsetof(Vertex, normal));
+	if (valid && GetAccessorView(file, json.GetInt(attributes, "TEXCOORD_0", -1), view) && view.count == vertexCount)
+		valid = ReadAttribute(view, 2, flipZ, verts, offsetof(Vertex, uv));
+	if (valid && GetAccessorView(file, json.GetInt(attributes, "TANGENT", -1), view) && view.count == vertexCount)
+	{
+		valid = ReadAttribute(view, 3, flipZ, verts, offsetof(Vertex, tangent));
+
+		// Mirrored UVs need the handedness kept, so let the generator rebuild tangents from scratch instead
+		if (HasMirroredTangents(view))
+			hasTangents = false;
+	}
+	else
+		hasTangents = false;
+
+	// Read the indices (or make them up for unindexed primitives)
+	std::vector<unsigned int> indices;
+	int indicesAccessor = json.GetInt(primitive, "indices", -1);
+	if (valid && indicesAccessor >= 0)
+	{
+		valid = GetAccessorView(file, indicesAccessor, view) && view.components == 1;
+		if (valid)
+		{
+			indices.resize(view.count);
+			switch (view.componentType)
+			{
+			case ComponentUnsignedByte: valid = ReadIndices<unsigned char>(view, vertexCount, (unsigned int)baseVertex, indices.data()); break;
+			case ComponentUnsignedShort: valid = ReadIndices<unsigned short>(view, vertexCount, (unsigned int)baseVertex, indices.data()); break;
+			case ComponentUnsignedInt: valid = ReadIndices<unsigned int>(view, vertexCount, (unsigned int)baseVertex, indices.data()); break;
+			default: valid = false; break;
+			}
+		}
+	}
+	else if (valid)
+	{
+		indices.resize(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++)
+			indices[i] = (unsigned int)baseVertex + i;
+	}
+
+	if (!valid)
+	{
+		out.verts.resize(baseVertex);
+		return false;
+	}
+
+	// Bake in the node's transform, normals by the inverse transpose so non-uniform scales keep them perpendicular
+	// - The transform is in glTF's right-handed space, so it's applied with Z flipped on both sides
+	bool mirrored = false;
+	if (!identity)
+	{
+		DirectX::XMMATRIX flip = DirectX::XMMatrixScaling(1.0f, 1.0f, -1.0f);
+		DirectX::XMMATRIX world = DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(flip, transform), flip);
+		DirectX::XMVECTOR determinant;
+		DirectX::XMMATRIX normalMatrix = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&determinant, world));
+		mirrored = DirectX::XMVectorGetX(determinant) < 0.0f;
+		for (unsigned int i = 0; i < vertexCount; i++)
+		{
+			Vertex& v = verts[i];
+			DirectX::XMStoreFloat3(&v.position, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&v.position), world));
+			DirectX::XMStoreFloat3(&v.normal, DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&v.normal), normalMatrix)));
+			DirectX::XMStoreFloat3(&v.tangent, DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&v.tangent), world)));
+		}
+	}
+
+	// Turn strips and fans into lists, then flip the winding like ObjParser does (unless a mirroring transform already has)
+	size_t startIndex = out.indices.size();
+	if (mode == ModeTriangles)
+	{
+		indices.resize(indices.size() / 3 * 3);
+		out.indices.insert(out.indices.end(), indices.begin(), indices.end());
+	}
+	else
+	{
+		for (size_t i = 2; i < indices.size(); i++)
+		{
+			unsigned int a = mode == ModeTriangleFan ? indices[0] : indices[i - 2];
+			unsigned int b = indices[i - 1];
+			unsigned int c = indices[i];
+			if (mode == ModeTriangleStrip && (i & 1))
+				std::swap(a, b);
+			out.indices.push_back(a);
+			out.indices.push_back(b);
+			out.indices.push_back(c);
+		}
+	}
+
+	if (!mirrored)
+	{
+		for (size_t i = startIndex; i + 2 < out.indices.size(); i += 3)
+			std::swap(out.indices[i + 1], out.indices[i + 2]);
+	}
+
+	// Each primitive is its own group, named after its mesh and material
+	ObjGroup group;
+	group.name = name;
+	int material = json.GetInt(primitive, "material", -1);
+	if (material >= 0 && material < (int)file.materials.size())
+		group.material = json.GetString(file.materials[material], "name");
+	group.startIndex = (unsigned int)startIndex;
+	group.indexCount = (unsigned int)(out.indices.size() - startIndex);
+	out.groups.push_back(group);
+	return true;
+}
+
+// Adds every primitive of a mesh
+static void AddMesh(const GltfFile& file, int meshIndex, const DirectX::XMMATRIX& transform, bool identity, ObjData& out, bool& hasTangents)
+{
+	if (meshIndex < 0 || meshIndex >= (int)file.meshes.size())
+		return;
+
+	const JsonDocument& json = file.json;
+	int mesh = file.meshes[meshIndex];
+	std::string name = json.GetString(mesh, "name");
+	std::vector<int> primitives;
+	json.GetElements(json.Find(mesh, "primitives"), primitives);
+	for (size_t p = 0; p < primitives.size(); p++)
+	{
+		if (!AddPrimitive(file, primitives[p], name, transform, identity, out, hasTangents))
+			printf("  skipped primitive %zu of mesh %d (not triangles, or its accessors can't be read)\n", p, meshIndex);
+	}
+}
+
+// Adds a node's mesh with its world transform, then does the same for its children
+static void AddNode(const GltfFile& file, int nodeIndex, DirectX::XMMATRIX parent, bool parentIdentity, int depth, ObjData& out, bool& hasTangents)
+{
+	if (nodeIndex < 0 || nodeIndex >= (int)file.nodes.size() || depth > MaxNodeDepth)
+		return;
+
+	const JsonDocument& json = file.json;
+	int node = file.nodes[nodeIndex];
+	bool identity = parentIdentity && json.Find(node, "matrix") < 0 && json.Find(node, "translation") < 0 &&
+		json.Find(node, "rotation") < 0 && json.Find(node, "scale") < 0;
+	DirectX::XMMATRIX world = identity ? parent : DirectX::XMMatrixMultiply(GetLocalTransform(json, node), parent);
+
+	AddMesh(file, json.GetInt(node, "mesh", -1), world, identity, out, hasTangents);
+
+	std::vector<int> children;
+	json.GetElements(json.Find(node, "children"), children);
+	for (int child : children)
+	{
+		if (json.values[child].type == JSON_NUMBER)
+			AddNode(file, (int)json.values[child].number, world, identity, depth + 1, out, hasTangents);
+	}
+}
+
+// Maps the file at the given path and parses it
+bool GltfParser::ParseFile(const char* path, ObjData& out)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	MappedFile file(path);
+	if (!file.IsOpen())
+		return false;
+
+	bool parsed = Parse(file.GetData(), file.GetData() + file.GetSize(), out);
+
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	out.parseSeconds = elapsed.count();
+	return parsed;
+}
+
+// Checks the header and chunks, then adds every mesh the default scene uses (or every mesh when there's no scene)
+bool GltfParser::Parse(const char* begin, const char* end, ObjData& out)
+{
+	out = ObjData();
+	out.fileBytes = end - begin;
+
+	// 12 byte header, then the JSON chunk and an optional binary chunk, each with an 8 byte header
+	unsigned int header[3];
+	unsigned int chunk[2];
+	if (end - begin < 20)
+		return false;
+	memcpy(header, begin, sizeof(header));
+	memcpy(chunk, begin + 12, sizeof(chunk));
+	if (header[0] != GlbMagic || header[1] != 2 || chunk[1] != GlbChunkJson || chunk[0] > (size_t)(end - begin) - 20)
+		return false;
+
+	GltfFile file;
+	const char* json = begin + 20;
+	const char* jsonEnd = json + chunk[0];
+	if (end - jsonEnd >= 8)
+	{
+		// A binary chunk that runs past the end means the file was cut short
+		memcpy(chunk, jsonEnd, sizeof(chunk));
+		if (chunk[1] == GlbChunkBin)
+		{
+			if (chunk[0] > (size_t)(end - jsonEnd) - 8)
+				return false;
+			file.bin = (const unsigned char*)jsonEnd + 8;
+			file.binLength = chunk[0];
+		}
+	}
+
+	if (!file.json.Parse(json, jsonEnd))
+		return false;
+
+	file.json.GetElements(file.json.Find(0, "accessors"), file.accessors);
+	file.json.GetElements(file.json.Find(0, "bufferViews"), file.bufferViews);
+	file.json.GetElements(file.json.Find(0, "meshes"), file.meshes);
+	file.json.GetElements(file.json.Find(0, "materials"), file.materials);
+	file.json.GetElements(file.json.Find(0, "nodes"), file.nodes);
+
+	bool hasTangents = true;
+	std::vector<int> scenes;
+	file.json.GetElements(file.json.Find(0, "scenes"), scenes);
+	if (scenes.empty())
+	{
+		for (int m = 0; m < (int)file.meshes.size(); m++)
+			AddMesh(file, m, DirectX::XMMatrixIdentity(), true, out, hasTangents);
+	}
+	else
+	{
+		int scene = file.json.GetInt(0, "scene", 0);
+		std::vector<int> roots;
+		file.json.GetElements(file.json.Find(scenes[scene >= 0 && scene < (int)scenes.size() ? scene : 0], "nodes"), roots);
+		for (int root : roots)
+		{
+			if (file.json.values[root].type == JSON_NUMBER)
+				AddNode(file, (int)file.json.values[root].number, DirectX::XMMatrixIdentity(), true, 0, out, hasTangents);
+		}
+	}
+
+	// Nothing is welded, every vertex in the file is used as is
+	out.cornerCount = out.verts.size();
+	out.hasTangents = hasTangents && !out.verts.empty();
+	return true;
+}
+
+bool GltfParser::IsGlbPath(const char* path)
+{
+	size_t length = strlen(path);
+	if (length < 4)
+		return false;
+
+	const char* extension = path + length - 4;
+	return extension[0] == '.' && (extension[1] | 0x20) == 'g' && (extension[2] | 0x20) == 'l' && (extension[3] | 0x20) == 'b';
+}
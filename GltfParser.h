@@ -0,0 +1,38 @@
+#pragma once
+#include "ObjParser.h"
+
+// --------------------------------------------------------
+// Binary glTF 2.0 (.glb) parser, handing back the same
+// ObjData as ObjParser so Mesh treats both formats alike
+//
+// - The file is memory mapped, its JSON chunk is parsed
+//   once in place (names point into the mapping until
+//   they're copied out) and accessors are read straight
+//   out of the binary chunk into the final vertices, with
+//   no intermediate buffers
+// - Float attributes are copied component by component,
+//   only other layouts (normalized integer uvs and such)
+//   go through a conversion
+// - Every triangle primitive of every mesh the default
+//   scene's nodes use becomes an ObjGroup named after its
+//   mesh and material, with the node transforms baked in
+// - Tangents come from the file when every primitive has
+//   them (their W handedness is dropped, Vertex has none),
+//   otherwise hasTangents is left false
+// - Converted to the same left-handed space and winding as
+//   ObjParser's output (glTF uvs already start top left)
+// - Files with external buffers, sparse accessors or
+//   Draco compression aren't supported
+// --------------------------------------------------------
+class GltfParser
+{
+public:
+	// Maps the file at the given path and parses it, false if it couldn't be opened or isn't a valid .glb
+	static bool ParseFile(const char* path, ObjData& out);
+
+	// Parses a .glb that's already in memory
+	static bool Parse(const char* begin, const char* end, ObjData& out);
+
+	// True for paths ending in .glb (any case)
+	static bool IsGlbPath(const char* path);
+};
@@ -0,0 +1,44 @@
+#include "MappedFile.h"
+
+// Opens and maps the entire file, leaving the object closed on any failure
+MappedFile::MappedFile(const char* path)
+{
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+	data = nullptr;
+	size = 0;
+
+	// Open the file itself, hinting that we'll mostly walk it front to back
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	// Empty files can't be mapped, so treat them as failed opens
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	// Create the mapping object and a view over the whole file
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+		return;
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data != nullptr)
+		size = (size_t)fileSize.QuadPart;
+}
+
+// Releases the view and both handles
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+bool MappedFile::IsOpen() { return data != nullptr; }
+const char* MappedFile::GetData() { return data; }
+size_t MappedFile::GetSize() { return size; }
@@ -0,0 +1,30 @@
+#pragma once
+#include <Windows.h>
+
+// --------------------------------------------------------
+// Read-only memory mapping of a whole file on disk
+//
+// - The file's bytes are paged in by the OS on first touch,
+//   so nothing is copied into our own heap allocations
+// - The mapping stays valid until the object is destroyed
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const char* path);
+	~MappedFile();
+
+	// Mappings own OS handles, so they can't be copied around
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const char* data;
+	size_t size;
+};
@@ -1,222 +1,554 @@
 #include "Mesh.h"
+#include "ObjParser.h"
+#include "GltfParser.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "VertexCompressor.h"
+#include "MeshSimplifier.h"
+#include "TangentGenerator.h"
+#include "ProgressiveMesh.h"
+#include <algorithm>
 #include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 // Constructer, generattes vertex buffer & index buffer from variables
-Mesh::Mesh(Vertex verts[], int numVerts, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device) 
+Mesh::Mesh(Vertex verts[], int numVerts, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool) 
 {
-	GenerateBuffer(verts, numVerts, indices, numIndices, device);
+	GenerateBuffer(verts, numVerts, indices, numIndices, device, pool);
 }
 
-// Pullts information from a given mesh .obj file and feeds it into generate buffer
-Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device)
+// Pulls information from a given mesh .obj or .glb file and feeds it into generate buffer
+// - Uses the binary cache next to the file when it's up to date, and writes one when it isn't
+// - processFlags picks which MeshProcessFlags steps run on freshly parsed data
+Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, unsigned int processFlags, GeometryPool* pool)
+	: processFlags(processFlags)
+{
+	MeshData data;
+	if (LoadData(objFile, processFlags, data))
+		Upload(data, device, pool);
+	else
+		SetEmpty();
+}
+
+// Uploads data that's already finished, like generated shapes after ProcessData
+Mesh::Mesh(const MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool)
+{
+	Upload(data, device, pool);
+}
+
+// Builds the finished vertices and indices of a mesh .obj or .glb file without creating any buffers
+// - Returns false (leaving the data empty) if the file couldn't be parsed
+bool Mesh::LoadData(const char* objFile, unsigned int processFlags, MeshData& data, int threadCount)
 {
-	// File input object
-	std::ifstream obj(objFile);
 	printf("Started loading model at location %s...\n", objFile);
+	data.processFlags = processFlags;
+
+	// Fast path, the cache already holds the final vertices (tangents and all)
+	auto start = std::chrono::high_resolution_clock::now();
+	// - The vertices and indices are decoded directly into the arrays the buffers are created from
+	// - Ray query structures aren't stored, so they don't get a cache of their own
+	// - Scoped so a stale cache is unmapped again before it's rewritten below
+	unsigned int cacheFlags = processFlags & ~MESH_PROCESS_BVH;
+	{
+		MeshCache cache(objFile, cacheFlags);
+		if (cache.IsValid())
+		{
+			const MeshCacheHeader* header = cache.GetHeader();
+			data.verts.resize(header->vertexCount);
+			data.indices.resize(header->indexCount);
+			if (cache.DecodeVertices(data.verts.data()) && cache.DecodeIndices(data.indices.data()))
+			{
+				data.boundsMin = header->boundsMin;
+				data.boundsMax = header->boundsMax;
+				data.lods.assign(cache.GetLods(), cache.GetLods() + header->lodCount);
+				data.clusters.assign(cache.GetClusters(), cache.GetClusters() + header->clusterCount);
+				data.submeshes.assign(cache.GetSubmeshes(), cache.GetSubmeshes() + header->submeshCount);
+				BuildBvh(data);
+
+				std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+				double rawKilobytes = (header->vertexCount * sizeof(Vertex) + header->indexCount * sizeof(unsigned int)) / 1024.0;
+				printf("model loaded from cache (%u verts, %u indices, %.1f KB -> %.1f KB on disk, in %.2f ms)\n",
+					header->vertexCount, header->indexCount, rawKilobytes, (header->vertexBytes + header->indexBytes) / 1024.0, elapsed.count() * 1000.0);
+				return true;
+			}
+
+			// Shouldn't happen past the hash check, but rebuild rather than draw garbage
+			data.verts.clear();
+			data.indices.clear();
+		}
+	}
+
+	// Map and parse the whole file in one go (.glb files are read straight from their binary chunk instead)
+	ObjData obj;
+	bool glb = GltfParser::IsGlbPath(objFile);
+	if (!(glb ? GltfParser::ParseFile(objFile, obj) : ObjParser::ParseFile(objFile, obj, threadCount)) || obj.indices.empty())
+		return false;
+
+	double megabytes = obj.fileBytes / (1024.0 * 1024.0);
+	printf("model loaded (%.2f MB parsed in %.2f ms, %.1f MB/s)\n", megabytes, obj.parseSeconds * 1000.0, megabytes / obj.parseSeconds);
+	if (glb)
+		printf("  %zu verts (%.1f KB vertex buffer)%s\n", obj.verts.size(), obj.verts.size() * sizeof(Vertex) / 1024.0, obj.hasTangents ? ", tangents from the file" : "");
+	else
+		printf("  welded %zu -> %zu verts (%.1f KB -> %.1f KB vertex buffer)\n",
+			obj.cornerCount, obj.verts.size(), obj.cornerCount * sizeof(Vertex) / 1024.0, obj.verts.size() * sizeof(Vertex) / 1024.0);
+
+	// Every o/g and usemtl group (or glTF primitive) becomes a submesh
+	for (size_t i = 0; i < obj.groups.size(); i++)
+	{
+		MeshSubmesh submesh = {};
+		snprintf(submesh.name, sizeof(submesh.name), "%s", obj.groups[i].name.c_str());
+		snprintf(submesh.material, sizeof(submesh.material), "%s", obj.groups[i].material.c_str());
+		submesh.startIndex = obj.groups[i].startIndex;
+		submesh.indexCount = obj.groups[i].indexCount;
+		data.submeshes.push_back(submesh);
+	}
+	if (data.submeshes.size() > 1)
+		printf("  %zu submeshes sharing one vertex and index buffer\n", data.submeshes.size());
+
+	// Run any optional optimization steps
+	data.verts = std::move(obj.verts);
+	data.indices = std::move(obj.indices);
+	ProcessData(data, processFlags);
+
+	// Calculate the tangents (from the full detail level only) unless the file had them, then save the finished data for next time
+	int numVerts = (int)data.verts.size();
+	int numIndices = (int)data.indices.size();
+	if (!obj.hasTangents)
+		TangentGenerator::Calculate(data.verts.data(), numVerts, data.indices.data(), CountFullDetailIndices(data.submeshes, numIndices), threadCount);
+	MeshCache::Write(objFile, cacheFlags, data.verts.data(), numVerts, data.indices.data(), numIndices,
+		data.lods.data(), (int)data.lods.size(), data.clusters.data(), (int)data.clusters.size(),
+		data.submeshes.data(), (int)data.submeshes.size(), data.boundsMin, data.boundsMax);
+	return true;
+}
+
+// Data without submeshes is treated as a single one covering every index
+void Mesh::ProcessData(MeshData& data, unsigned int processFlags)
+{
+	data.processFlags = processFlags;
+	if (data.submeshes.empty())
+	{
+		MeshSubmesh whole = {};
+		whole.indexCount = (unsigned int)data.indices.size();
+		data.submeshes.push_back(whole);
+	}
 
-	// Check for successful open
-	if (!obj.is_open())
+	ProcessMesh(data);
+	CalculateBounds(data.verts.data(), (int)data.verts.size(), data.boundsMin, data.boundsMax);
+	BuildBvh(data);
+}
+
+// Builds the ray query BVH over the full detail level, once the vertices are in their final order
+// - Tangents don't matter to it, so it can be built before they're calculated
+void Mesh::BuildBvh(MeshData& data)
+{
+	data.bvh.reset();
+	if (!(data.processFlags & MESH_PROCESS_BVH) || data.indices.empty())
 		return;
 
-	// Variables used while reading the file
-	std::vector<DirectX::XMFLOAT3> positions;     // Positions from the file
-	std::vector<DirectX::XMFLOAT3> normals;       // Normals from the file
-	std::vector<DirectX::XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	auto start = std::chrono::high_resolution_clock::now();
+	data.bvh = std::make_shared<MeshBvh>();
+	if (!data.bvh->Build(data.verts.data(), (int)data.verts.size(), data.indices.data(), CountFullDetailIndices(data.submeshes, (int)data.indices.size())))
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		printf("  skipped BVH, indices point past the last vertex\n");
+		data.bvh.reset();
+		return;
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	printf("  built BVH (%d tris, %d nodes, depth %d, %.1f KB, in %.2f ms)\n", data.bvh->GetTriangleCount(), data.bvh->GetNodeCount(),
+		data.bvh->GetDepth(), data.bvh->GetMemoryBytes() / 1024.0, elapsed.count() * 1000.0);
+}
+
+// Swaps in finished data, everything the mesh drew before is released
+void Mesh::Upload(const MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool)
+{
+	processFlags = data.processFlags;
+	lods = data.lods;
+	clusters = data.clusters;
+	submeshes = data.submeshes;
+	boundsMin = data.boundsMin;
+	boundsMax = data.boundsMax;
+	bvh = data.bvh;
+	vertexStride = sizeof(Vertex);
+	quantizeMin = DirectX::XMFLOAT3(0, 0, 0);
+	quantizeExtent = DirectX::XMFLOAT3(1, 1, 1);
+	streaming = false;
+	residentError = 0.0f;
+	vertexAllocation.reset();
+	indexAllocation.reset();
+
+	CreateBuffers(data.verts.data(), (int)data.verts.size(), data.indices.data(), (int)data.indices.size(), device, pool);
+}
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
+// Same as Upload, except the buffers are sized for the full detail level and every submesh only counts its resident triangles
+// - The stream keeps whatever isn't resident yet zeroed, so it can go up with everything else
+void Mesh::BeginStream(ProgressiveMeshStream& stream, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool)
+{
+	const ProgressiveMeshHeader& header = stream.GetHeader();
+	processFlags = MESH_PROCESS_NONE;
+	lods.clear();
+	clusters.clear();
+	submeshes = stream.GetSubmeshes();
+	for (size_t s = 0; s < submeshes.size(); s++)
+		submeshes[s].indexCount = stream.GetResidentIndexCount((int)s);
+	boundsMin = header.boundsMin;
+	boundsMax = header.boundsMax;
+	bvh.reset();
+	vertexStride = sizeof(Vertex);
+	quantizeMin = DirectX::XMFLOAT3(0, 0, 0);
+	quantizeExtent = DirectX::XMFLOAT3(1, 1, 1);
+	streaming = true;
+	residentError = stream.GetResidentError();
+	vertexAllocation.reset();
+	indexAllocation.reset();
+
+	CreateBuffers(stream.GetVertices().data(), (int)header.vertexCount, stream.GetIndices().data(), (int)header.indexCount, device, pool);
+	stream.ClearChanges();
+
+	// Drawing the whole mesh covers every submesh's full range, the parts that aren't resident yet are degenerate
+	if (indexAllocation->count == header.indexCount)
+		indexCount = (int)header.indexCount;
+	else
+		streaming = false;
+}
+
+// New vertices only ever go on the end, and indices go up a run of changed blocks at a time
+void Mesh::Refine(ProgressiveMeshStream& stream, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	if (!streaming)
+		return;
+
+	int uploaded = stream.GetUploadedVertexCount();
+	int resident = stream.GetResidentVertexCount();
+	if (resident > uploaded)
+		UpdateBuffer(context, vertexAllocation.get(), uploaded, resident - uploaded, sizeof(Vertex), stream.GetVertices().data() + uploaded);
+
+	const std::vector<unsigned int>& indices = stream.GetIndices();
+	const std::vector<unsigned char>& dirty = stream.GetDirtyBlocks();
+	std::vector<unsigned short> shortIndices;
+	for (size_t block = 0; block < dirty.size();)
+	{
+		if (!dirty[block])
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
+			block++;
+			continue;
 		}
-		else if (chars[0] == 'v' && chars[1] == 't')
+
+		size_t end = block;
+		while (end < dirty.size() && dirty[end])
+			end++;
+		unsigned int first = (unsigned int)block * ProgressiveMeshStream::DirtyBlockIndices;
+		unsigned int count = (unsigned int)std::min(end * ProgressiveMeshStream::DirtyBlockIndices, indices.size()) - first;
+
+		// Narrowed the same way CreateBuffers did it
+		if (indexFormat == DXGI_FORMAT_R16_UINT)
 		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			DirectX::XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
+			shortIndices.resize(count);
+			for (unsigned int i = 0; i < count; i++)
+				shortIndices[i] = (unsigned short)indices[first + i];
+			UpdateBuffer(context, indexAllocation.get(), first, count, sizeof(unsigned short), shortIndices.data());
 		}
-		else if (chars[0] == 'v')
+		else
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			UpdateBuffer(context, indexAllocation.get(), first, count, sizeof(unsigned int), indices.data() + first);
 		}
-		else if (chars[0] == 'f')
+		block = end;
+	}
+
+	// Every submesh has a single level, the resident one
+	for (size_t s = 0; s < submeshes.size(); s++)
+	{
+		submeshes[s].indexCount = stream.GetResidentIndexCount((int)s);
+		lods[submeshes[s].firstLod].indexCount = submeshes[s].indexCount;
+	}
+	residentError = stream.GetResidentError();
+	stream.ClearChanges();
+}
+
+// Copies elements into part of one of the mesh's allocations, counting from the start of the allocation
+void Mesh::UpdateBuffer(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, GeometryAllocation* allocation, unsigned int first, unsigned int count, unsigned int elementSize, const void* data)
+{
+	D3D11_BOX box = {};
+	box.left = (allocation->first + first) * elementSize;
+	box.right = (allocation->first + first + count) * elementSize;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(allocation->buffer.Get(), 0, &box, data, 0, 0);
+}
+
+// Runs the optional optimization steps picked by processFlags on CPU side mesh data
+// - Triangles are only ever reordered within their own submesh
+void Mesh::ProcessMesh(MeshData& data)
+{
+	std::vector<Vertex>& verts = data.verts;
+	std::vector<unsigned int>& indices = data.indices;
+	std::vector<MeshCluster>& clusters = data.clusters;
+	std::vector<MeshSubmesh>& submeshes = data.submeshes;
+	unsigned int processFlags = data.processFlags;
+	int numVerts = (int)verts.size();
+	int numIndices = (int)indices.size();
+
+	// Reorder triangles for the post-transform vertex cache
+	if (processFlags & MESH_PROCESS_VERTEX_CACHE)
+	{
+		VertexCacheStats before = MeshOptimizer::SimulateVertexCache(indices.data(), numIndices, numVerts, MeshOptimizer::DefaultCacheSize, false);
+		for (size_t s = 0; s < submeshes.size(); s++)
+			MeshOptimizer::OptimizeVertexCache(indices.data() + submeshes[s].startIndex, submeshes[s].indexCount, numVerts);
+		VertexCacheStats after = MeshOptimizer::SimulateVertexCache(indices.data(), numIndices, numVerts, MeshOptimizer::DefaultCacheSize, false);
+
+		printf("  vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+
+	// Sort triangle clusters so the outside of the mesh is drawn first
+	if (processFlags & MESH_PROCESS_OVERDRAW)
+	{
+		OverdrawStats before = MeshOptimizer::EstimateOverdraw(verts.data(), numVerts, indices.data(), numIndices);
+		for (size_t s = 0; s < submeshes.size(); s++)
+			MeshOptimizer::OptimizeOverdraw(indices.data() + submeshes[s].startIndex, submeshes[s].indexCount, verts.data(), numVerts, 1.05f);
+		OverdrawStats after = MeshOptimizer::EstimateOverdraw(verts.data(), numVerts, indices.data(), numIndices);
+
+		printf("  overdraw: %.3f -> %.3f\n", before.overdraw, after.overdraw);
+	}
+
+	// Split the full detail level into clusters (the levels of detail below are drawn whole)
+	if (processFlags & MESH_PROCESS_CLUSTERS)
+	{
+		VertexCacheStats before = MeshOptimizer::SimulateVertexCache(indices.data(), numIndices, numVerts, MeshOptimizer::DefaultCacheSize, false);
+		std::vector<MeshCluster> submeshClusters;
+		clusters.clear();
+		for (size_t s = 0; s < submeshes.size(); s++)
 		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			//  If the model is missing any of these, this 
-			//  code will not handle the file correctly!
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.position = positions[i[0] - 1];
-			v1.uv = uvs[i[1] - 1];
-			v1.normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.position = positions[i[3] - 1];
-			v2.uv = uvs[i[4] - 1];
-			v2.normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.position = positions[i[6] - 1];
-			v3.uv = uvs[i[7] - 1];
-			v3.normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.uv.y = 1.0f - v1.uv.y;
-			v2.uv.y = 1.0f - v2.uv.y;
-			v3.uv.y = 1.0f - v3.uv.y;
-
-			// Flip Z (LH vs. RH)
-			v1.position.z *= -1.0f;
-			v2.position.z *= -1.0f;
-			v3.position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.normal.z *= -1.0f;
-			v2.normal.z *= -1.0f;
-			v3.normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
+			MeshClusterizer::BuildClusters(verts.data(), numVerts, indices.data() + submeshes[s].startIndex, submeshes[s].indexCount,
+				MeshClusterizer::MaxVertices, MeshClusterizer::MaxTriangles, submeshClusters);
+
+			// Clusters come back relative to the submesh's own range
+			submeshes[s].firstCluster = (unsigned int)clusters.size();
+			submeshes[s].clusterCount = (unsigned int)submeshClusters.size();
+			for (size_t i = 0; i < submeshClusters.size(); i++)
 			{
-				// Make the last vertex
-				Vertex v4;
-				v4.position = positions[i[9] - 1];
-				v4.uv = uvs[i[10] - 1];
-				v4.normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.uv.y = 1.0f - v4.uv.y;
-				v4.position.z *= -1.0f;
-				v4.normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
+				submeshClusters[i].startIndex += submeshes[s].startIndex;
+				clusters.push_back(submeshClusters[i]);
 			}
 		}
+		VertexCacheStats after = MeshOptimizer::SimulateVertexCache(indices.data(), numIndices, numVerts, MeshOptimizer::DefaultCacheSize, false);
+
+		int cullable = 0;
+		for (size_t i = 0; i < clusters.size(); i++)
+			cullable += clusters[i].coneCutoff < 1.0f;
+		printf("  clusters: %zu (%.1f tris each, %d back face cullable), ACMR %.3f -> %.3f\n",
+			clusters.size(), numIndices / 3.0 / clusters.size(), cullable, before.acmr, after.acmr);
+	}
+
+	// Append the simplified levels after the full detail one
+	if (processFlags & MESH_PROCESS_LODS)
+	{
+		GenerateLods(data);
+		numIndices = (int)indices.size();
+	}
+
+	// Renumber vertices into the order they're first used (this must run last, since it changes the vertices)
+	// - Every level is renumbered together, the full detail level decides most of the order
+	if (processFlags & MESH_PROCESS_VERTEX_FETCH)
+	{
+		float before = MeshOptimizer::SimulateVertexFetch(indices.data(), numIndices, numVerts, sizeof(Vertex));
+		numVerts = MeshOptimizer::OptimizeVertexFetch(verts.data(), numVerts, indices.data(), numIndices);
+		verts.resize(numVerts);
+		float after = MeshOptimizer::SimulateVertexFetch(indices.data(), numIndices, numVerts, sizeof(Vertex));
+
+		printf("  vertex fetch: overfetch %.3f -> %.3f\n", before, after);
 	}
+}
+
+// Builds up to MaxLods levels of detail for each submesh by simplifying its full detail indices to half as many triangles each time
+// - Stops early once simplification stalls (seams and borders are locked) or the error gets too large
+// - Edges shared with other submeshes are borders too, so neighboring submeshes never crack apart
+void Mesh::GenerateLods(MeshData& data)
+{
+	const std::vector<Vertex>& verts = data.verts;
+	std::vector<unsigned int>& indices = data.indices;
+	std::vector<MeshLod>& lods = data.lods;
+	const int MaxLods = 5;
+	const float MaxRelativeError = 0.05f;
+
+	int numVerts = (int)verts.size();
+	float scale = MeshSimplifier::GetMeshScale(verts.data(), numVerts);
+	lods.clear();
+
+	std::vector<unsigned int> simplified;
+	for (size_t s = 0; s < data.submeshes.size(); s++)
+	{
+		MeshSubmesh& submesh = data.submeshes[s];
+		int fullCount = (int)submesh.indexCount;
+		submesh.firstLod = (unsigned int)lods.size();
+		lods.push_back({ submesh.startIndex, submesh.indexCount, 0.0f });
 
-	// Close the file and create the actual buffers
-	obj.close();
-	GenerateBuffer(&verts[0], verts.size(), &indices[0], indices.size(), device);
+		simplified.resize(fullCount);
+		for (int level = 1; level < MaxLods; level++)
+		{
+			int target = (fullCount >> level) / 3 * 3;
+			float error = 0.0f;
+			int count = MeshSimplifier::Simplify(verts.data(), numVerts, indices.data() + submesh.startIndex, fullCount, target, MaxRelativeError, simplified.data(), &error);
+
+			// Not worth a level unless it's at least 25% smaller than the last one
+			if (count == 0 || count > (int)lods.back().indexCount * 3 / 4)
+				break;
+
+			MeshOptimizer::OptimizeVertexCache(simplified.data(), count, numVerts);
+			lods.push_back({ (unsigned int)indices.size(), (unsigned int)count, error * scale });
+			indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+
+			if (data.submeshes.size() > 1)
+				printf("  submesh %zu lod %d: %d -> %d tris (error %g)\n", s, level, fullCount / 3, count / 3, error * scale);
+			else
+				printf("  lod %d: %d -> %d tris (error %g)\n", level, fullCount / 3, count / 3, error * scale);
+		}
 
-	printf("model loaded \n");
+		submesh.lodCount = (unsigned int)lods.size() - submesh.firstLod;
+	}
 }
 
 // Generates a buffer based on a set of given inputs
-void Mesh::GenerateBuffer(Vertex verts[], int numVerts, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
+void Mesh::GenerateBuffer(Vertex verts[], int numVerts, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool)
 {
-	// Calculate and append all the tangents into the vertices
-	CalculateTangents(verts, numVerts, indices, numIndices);
-	
-	// Set the number of indices in place
-	indexCount = numIndices;
-
-	// Generating the vertex buffer description & vertex buffer from info passed --------------------------------
-	D3D11_BUFFER_DESC vbd;
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * numVerts;
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
-
-	// Create the proper struct to hold the initial vertex data
-	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = verts;
-
-	// Actually create the buffer with the initial data
-	device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
-
-	// Generating the index buffer description & index buffer from info passed --------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * numIndices;	// 3 = number of indices in the buffer
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells DirectX this is an index buffer
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
-
-	// Create the proper struct to hold the initial index data
-	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indices;
-
-	// Actually create the buffer with the initial data
-	device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+	// Calculate and append all the tangents into the vertices (from the full detail level only)
+	CalculateTangents(verts, numVerts, indices, CountFullDetailIndices(submeshes, numIndices));
+	CalculateBounds(verts, numVerts, boundsMin, boundsMax);
+
+	CreateBuffers(verts, numVerts, indices, numIndices, device, pool);
+}
+
+// Creates the GPU buffers from finished vertex and index data (nothing is modified)
+void Mesh::CreateBuffers(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool)
+{
+	// Meshes without submeshes are a single one, using whatever levels of detail and clusters there are
+	if (submeshes.empty())
+	{
+		MeshSubmesh whole = {};
+		whole.indexCount = lods.empty() ? numIndices : lods[0].indexCount;
+		whole.lodCount = (unsigned int)lods.size();
+		whole.clusterCount = (unsigned int)clusters.size();
+		submeshes.push_back(whole);
+	}
+
+	// Submeshes without levels of detail draw everything as level 0
+	for (size_t s = 0; s < submeshes.size(); s++)
+	{
+		if (submeshes[s].lodCount > 0)
+			continue;
+
+		submeshes[s].firstLod = (unsigned int)lods.size();
+		submeshes[s].lodCount = 1;
+		lods.push_back({ submeshes[s].startIndex, submeshes[s].indexCount, 0.0f });
+	}
+	indexCount = CountFullDetailIndices(submeshes, numIndices);
+
+	// Compress the vertices first if asked to
+	const void* vertexData = verts;
+	std::vector<CompactVertex> compact;
+	std::vector<QuantizedVertex> quantized;
+	if (processFlags & (MESH_PROCESS_COMPACT_VERTICES | MESH_PROCESS_QUANTIZE_POSITIONS))
+	{
+		std::vector<float> handedness;
+		std::vector<float> decodedHandedness(numVerts);
+		std::vector<Vertex> decoded(numVerts);
+		VertexCompressor::CalculateHandedness(verts, numVerts, indices, indexCount, handedness);
+
+		if (processFlags & MESH_PROCESS_QUANTIZE_POSITIONS)
+		{
+			quantized.resize(numVerts);
+			VertexCompressor::EncodeQuantized(verts, numVerts, handedness.data(), boundsMin, boundsMax, quantized.data());
+			VertexCompressor::DecodeQuantized(quantized.data(), numVerts, boundsMin, boundsMax, decoded.data(), decodedHandedness.data());
+			vertexData = quantized.data();
+			vertexStride = sizeof(QuantizedVertex);
+			quantizeMin = boundsMin;
+			quantizeExtent = DirectX::XMFLOAT3(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z);
+		}
+		else
+		{
+			compact.resize(numVerts);
+			VertexCompressor::Encode(verts, numVerts, handedness.data(), compact.data());
+			VertexCompressor::Decode(compact.data(), numVerts, decoded.data(), decodedHandedness.data());
+			vertexData = compact.data();
+			vertexStride = sizeof(CompactVertex);
+		}
+
+		VertexErrorStats error = VertexCompressor::MeasureError(verts, decoded.data(), numVerts, handedness.data(), decodedHandedness.data());
+		printf("  compressed vertices: %.1f KB -> %.1f KB (max error: position %g, normal %.3f deg, tangent %.3f deg, uv %g)\n",
+			numVerts * sizeof(Vertex) / 1024.0, numVerts * vertexStride / 1024.0, error.positionError, error.normalAngle, error.tangentAngle, error.uvError);
+	}
+
+	// Put the vertices in the pool's buffer for this vertex format, or a buffer of their own --------------------------------
+	if (pool)
+		vertexAllocation = pool->AllocateVertices(vertexData, numVerts, vertexStride);
+	else
+		vertexAllocation = GeometryPool::CreateBuffer(device, vertexData, numVerts, vertexStride, D3D11_BIND_VERTEX_BUFFER, streaming ? D3D11_USAGE_DEFAULT : D3D11_USAGE_IMMUTABLE);
+
+	// Narrow the indices to 16 bits when every vertex can be reached with them
+	// - Triangle lists have no strip cut value, so all 65536 values are usable
+	const void* indexData = indices;
+	unsigned int indexSize = sizeof(unsigned int);
+	std::vector<unsigned short> shortIndices;
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	if (numVerts <= 65536)
+	{
+		shortIndices.resize(numIndices);
+		for (int i = 0; i < numIndices; i++)
+			shortIndices[i] = (unsigned short)indices[i];
+
+		indexData = shortIndices.data();
+		indexSize = sizeof(unsigned short);
+		indexFormat = DXGI_FORMAT_R16_UINT;
+	}
+
+	// Same for the indices, which stay relative to the mesh's own first vertex --------------------------------
+	if (pool)
+		indexAllocation = pool->AllocateIndices(indexData, numIndices, indexFormat);
+	else
+		indexAllocation = GeometryPool::CreateBuffer(device, indexData, numIndices, indexSize, D3D11_BIND_INDEX_BUFFER, streaming ? D3D11_USAGE_DEFAULT : D3D11_USAGE_IMMUTABLE);
+
+	// Buffers only fail to be created when the device is out of memory, and then the mesh just draws nothing
+	if (!vertexAllocation || !indexAllocation)
+	{
+		printf("  couldn't create the mesh's buffers\n");
+		SetEmpty();
+	}
+}
+
+// Leaves the mesh drawing nothing, with empty buffer ranges and a single empty submesh and level of detail
+// - For when there's nothing to upload, so every accessor (and the renderer) can still use it
+void Mesh::SetEmpty()
+{
+	vertexAllocation = std::make_shared<GeometryAllocation>();
+	indexAllocation = std::make_shared<GeometryAllocation>();
+	MeshSubmesh empty = {};
+	empty.lodCount = 1;
+	submeshes.assign(1, empty);
+	lods.assign(1, { 0, 0, 0.0f });
+	clusters.clear();
+	indexCount = 0;
+}
+
+// Finds the axis aligned bounds of every vertex position
+void Mesh::CalculateBounds(const Vertex* verts, int numVerts, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax)
+{
+	boundsMin = DirectX::XMFLOAT3(0, 0, 0);
+	boundsMax = DirectX::XMFLOAT3(0, 0, 0);
+	if (numVerts == 0)
+		return;
+
+	DirectX::XMVECTOR lowest = DirectX::XMLoadFloat3(&verts[0].position);
+	DirectX::XMVECTOR highest = lowest;
+	for (int i = 1; i < numVerts; i++)
+	{
+		DirectX::XMVECTOR pos = DirectX::XMLoadFloat3(&verts[i].position);
+		lowest = DirectX::XMVectorMin(lowest, pos);
+		highest = DirectX::XMVectorMax(highest, pos);
+	}
+
+	DirectX::XMStoreFloat3(&boundsMin, lowest);
+	DirectX::XMStoreFloat3(&boundsMax, highest);
 }
 
 // Calculates the tangents of the vertices in a mesh
@@ -229,103 +561,139 @@ void Mesh::GenerateBuffer(Vertex verts[], int numVerts, unsigned int indices[],
 //
 // - Be sure to call this BEFORE creating your D3D vertex/index buffers
 //
+// - The work itself is done by TangentGenerator (SSE, multithreaded, safe with degenerate uvs)
+//
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].tangent = DirectX::XMFLOAT3(0, 0, 0);
-	}
-
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->position.x - v1->position.x;
-		float y1 = v2->position.y - v1->position.y;
-		float z1 = v2->position.z - v1->position.z;
-
-		float x2 = v3->position.x - v1->position.x;
-		float y2 = v3->position.y - v1->position.y;
-		float z2 = v3->position.z - v1->position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->uv.x - v1->uv.x;
-		float t1 = v2->uv.y - v1->uv.y;
-
-		float s2 = v3->uv.x - v1->uv.x;
-		float t2 = v3->uv.y - v1->uv.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->tangent.x += tx;
-		v1->tangent.y += ty;
-		v1->tangent.z += tz;
-
-		v2->tangent.x += tx;
-		v2->tangent.y += ty;
-		v2->tangent.z += tz;
-
-		v3->tangent.x += tx;
-		v3->tangent.y += ty;
-		v3->tangent.z += tz;
-	}
-
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		DirectX::XMVECTOR normal = DirectX::XMLoadFloat3(&verts[i].normal);
-		DirectX::XMVECTOR tangent = DirectX::XMLoadFloat3(&verts[i].tangent);
-
-		// Use Gram-Schmidt orthogonalize
-		tangent = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(tangent, DirectX::XMVectorMultiply( normal, DirectX::XMVector3Dot(normal, tangent))));
-
-		// Store the tangent
-		XMStoreFloat3(&verts[i].tangent, tangent);
-	}
+	TangentGenerator::Calculate(verts, numVerts, indices, numIndices);
 }
 
 // Returns the ComPtr to the vertex buffer
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer() 
 {
-	return vertexBuffer;
+	return vertexAllocation->buffer;
 }
 
 // Returns the ComPtr to the IndexBuffer
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
 {
-	return indexBuffer;
+	return indexAllocation->buffer;
 }
 
+// Returns where the mesh starts in its buffers, every index range of the mesh is relative to the start index
+int Mesh::GetBaseVertex() { return (int)vertexAllocation->first; }
+unsigned int Mesh::GetStartIndex() { return indexAllocation->first; }
+
 // Returns the index count
 int Mesh::GetIndexCount() 
 {
 	return indexCount;
 }
 
+// Returns the format to bind the index buffer with
+DXGI_FORMAT Mesh::GetIndexFormat()
+{
+	return indexFormat;
+}
+
+// Returns the submeshes, which split up the index buffer by material
+int Mesh::GetSubmeshCount() { return (int)submeshes.size(); }
+const MeshSubmesh& Mesh::GetSubmesh(int submesh) { return submeshes[submesh]; }
+
+// Returns the first submesh using the given material name, or -1 if none do
+int Mesh::FindSubmesh(const char* material)
+{
+	for (size_t s = 0; s < submeshes.size(); s++)
+	{
+		if (strcmp(submeshes[s].material, material) == 0)
+			return (int)s;
+	}
+	return -1;
+}
+
+// Returns the number of levels of detail of a submesh (always at least 1)
+int Mesh::GetLodCount(int submesh)
+{
+	return (int)submeshes[submesh].lodCount;
+}
+
+// Returns where a level of detail of a submesh lives in the index buffer
+MeshLod Mesh::GetLod(int level, int submesh)
+{
+	return lods[submeshes[submesh].firstLod + level];
+}
+
+// Picks the submesh's coarsest level whose error is still below errorPerDistance at the given distance
+// - Pass the distance divided by the entity's largest scale, since the errors are in mesh space
+int Mesh::SelectLod(float distance, float errorPerDistance, int submesh)
+{
+	const MeshLod* levels = lods.data() + submeshes[submesh].firstLod;
+	int levelCount = (int)submeshes[submesh].lodCount;
+	float allowedError = distance * errorPerDistance;
+	int level = 0;
+	while (level + 1 < levelCount && levels[level + 1].error <= allowedError)
+		level++;
+
+	return level;
+}
+
+// Returns the clusters covering the full detail level of a submesh
+int Mesh::GetClusterCount(int submesh) { return (int)submeshes[submesh].clusterCount; }
+const MeshCluster* Mesh::GetClusters(int submesh) { return clusters.data() + submeshes[submesh].firstCluster; }
+
+// The full detail ranges of the submeshes are back to back at the start, so they end where the last one does
+int Mesh::CountFullDetailIndices(const std::vector<MeshSubmesh>& submeshes, int numIndices)
+{
+	if (submeshes.empty())
+		return numIndices;
+	return (int)(submeshes.back().startIndex + submeshes.back().indexCount);
+}
+
+// Returns the corners of the mesh's axis aligned bounding box
+DirectX::XMFLOAT3 Mesh::GetBoundsMin() { return boundsMin; }
+DirectX::XMFLOAT3 Mesh::GetBoundsMax() { return boundsMax; }
+
+// Ray queries
+bool Mesh::HasBvh() { return bvh != nullptr; }
+const MeshBvh* Mesh::GetBvh() { return bvh.get(); }
+
+bool Mesh::Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, MeshRayHit& hit)
+{
+	return bvh && bvh->IntersectClosest(origin, direction, maxDistance, hit);
+}
+
+bool Mesh::RaycastAny(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance)
+{
+	return bvh && bvh->IntersectAny(origin, direction, maxDistance);
+}
+
+// Streaming progress, the submeshes only count their resident triangles
+bool Mesh::IsFullyResident() { return GetResidentTriangleCount() == GetTotalTriangleCount(); }
+float Mesh::GetResidentError() { return residentError; }
+int Mesh::GetTotalTriangleCount() { return indexCount / 3; }
+
+int Mesh::GetResidentTriangleCount()
+{
+	int triangles = 0;
+	for (size_t s = 0; s < submeshes.size(); s++)
+		triangles += submeshes[s].indexCount / 3;
+	return triangles;
+}
+
+// Returns the size of a single vertex in the vertex buffer, and how to expand compressed positions
+unsigned int Mesh::GetVertexStride() { return vertexStride; }
+bool Mesh::IsCompressed() { return vertexStride != sizeof(Vertex); }
+DirectX::XMFLOAT3 Mesh::GetQuantizeMin() { return quantizeMin; }
+DirectX::XMFLOAT3 Mesh::GetQuantizeExtent() { return quantizeExtent; }
+
 void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
 	// Set buffers in the input assembler
-	UINT stride = sizeof(Vertex);
+	UINT stride = vertexStride;
 	UINT offset = 0;
-	context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	context->IASetVertexBuffers(0, 1, vertexAllocation->buffer.GetAddressOf(), &stride, &offset);
+	context->IASetIndexBuffer(indexAllocation->buffer.Get(), indexFormat, 0);
 
 	// Draw this mesh
-	context->DrawIndexed(indexCount, 0, 0);
+	context->DrawIndexed(indexCount, indexAllocation->first, (int)vertexAllocation->first);
 }
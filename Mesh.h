@@ -2,30 +2,177 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <fstream>
+#include <memory>
+#include <vector>
 
 #include "Vertex.h"
+#include "MeshClusterizer.h"
+#include "GeometryPool.h"
+#include "MeshBvh.h"
+
+class ProgressiveMeshStream;
+
+// Optional processing steps run on imported meshes before their buffers are created
+enum MeshProcessFlags
+{
+	MESH_PROCESS_NONE = 0,
+	MESH_PROCESS_VERTEX_CACHE = 1 << 0,     // Reorder triangles for the post-transform vertex cache
+	MESH_PROCESS_OVERDRAW = 1 << 1,         // Reorder triangle clusters so outward facing ones draw first
+	MESH_PROCESS_VERTEX_FETCH = 1 << 2,     // Renumber vertices into first-use order
+	MESH_PROCESS_COMPACT_VERTICES = 1 << 3, // Store CompactVertex data on the GPU (needs VertexShaderCompact)
+	MESH_PROCESS_QUANTIZE_POSITIONS = 1 << 4,   // Store QuantizedVertex data on the GPU (needs VertexShaderCompact)
+	MESH_PROCESS_LODS = 1 << 5,             // Append simplified levels of detail to the index buffer
+	MESH_PROCESS_CLUSTERS = 1 << 6,         // Split the full detail level into clusters that can be culled on their own
+	MESH_PROCESS_BVH = 1 << 7,              // Keep a BVH of the full detail triangles for ray queries (never cached, rebuilt on load)
+
+	MESH_PROCESS_DEFAULT = MESH_PROCESS_VERTEX_CACHE | MESH_PROCESS_OVERDRAW | MESH_PROCESS_VERTEX_FETCH | MESH_PROCESS_LODS | MESH_PROCESS_CLUSTERS
+};
+
+// One level of detail, a range of the mesh's index buffer (all levels share the vertex buffer)
+struct MeshLod
+{
+	unsigned int startIndex;
+	unsigned int indexCount;
+	float error;                            // Geometric error in world units, 0 for the full detail level
+};
+
+// Part of a mesh drawn with one material, all submeshes share the mesh's vertex and index buffers
+// - The full detail ranges of every submesh sit back to back at the start of the index buffer
+// - Names are cut off to fit, since the table is stored as is in the mesh cache
+struct MeshSubmesh
+{
+	char name[64];                          // From the OBJ's o or g records, empty if there weren't any
+	char material[64];                      // From the OBJ's usemtl records, empty if there weren't any
+	unsigned int startIndex;                // Full detail range
+	unsigned int indexCount;
+	unsigned int firstLod;                  // Range of the mesh's level of detail table, the first one is full detail
+	unsigned int lodCount;
+	unsigned int firstCluster;              // Range of the mesh's cluster table
+	unsigned int clusterCount;
+};
+
+// Everything a Mesh is built from before its GPU buffers exist
+// - Filled by Mesh::LoadData without touching the device, so any thread can build one
+struct MeshData
+{
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	std::vector<MeshLod> lods;
+	std::vector<MeshCluster> clusters;
+	std::vector<MeshSubmesh> submeshes;
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(0, 0, 0);
+	unsigned int processFlags = MESH_PROCESS_NONE;
+	std::shared_ptr<MeshBvh> bvh;           // Only with MESH_PROCESS_BVH
+};
 
 class Mesh
 {
 public:
 	// Setup
-	Mesh(Vertex verts[], int numVerts, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
-	Mesh(const char* path, Microsoft::WRL::ComPtr<ID3D11Device> device);
-	void GenerateBuffer(Vertex verts[], int numVerts, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	// - With a pool the mesh's vertices and indices are suballocated from its shared buffers, otherwise it gets buffers of its own
+	Mesh(Vertex verts[], int numVerts, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool = nullptr);
+	Mesh(const char* path, Microsoft::WRL::ComPtr<ID3D11Device> device, unsigned int processFlags = MESH_PROCESS_DEFAULT, GeometryPool* pool = nullptr);
+	Mesh(const MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool = nullptr);
+	void GenerateBuffer(Vertex verts[], int numVerts, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool = nullptr);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 
+	// Split loading, for building the data on another thread
+	// - LoadData does all the CPU work (cache, parsing, processing, tangents) and is safe to call from any thread
+	// - Upload replaces everything this mesh draws with the data, and has to run on the device's thread
+	// - The thread count caps parsing and tangent generation, 0 lets them use every core
+	static bool LoadData(const char* path, unsigned int processFlags, MeshData& data, int threadCount = 0);
+
+	// Runs the processing steps on data built some other way (like PrimitiveGenerator), then fills in its bounds
+	// - Tangents have to be there already, the steps only move vertices around
+	static void ProcessData(MeshData& data, unsigned int processFlags);
+	void Upload(const MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool = nullptr);
 
-	// Vertex and Index buffers
+	// Progressive streaming, both on the device's thread (see ProgressiveMeshStream)
+	// - BeginStream replaces everything this mesh draws with buffers sized for the stream's full detail level,
+	//   filled with whatever is resident so far (call it once the stream has its base mesh)
+	// - Refine uploads whatever the stream decoded since, in place, so the mesh sharpens while it keeps drawing
+	// - Streamed meshes have a single level of detail per submesh (the resident one) and no clusters or BVH
+	void BeginStream(ProgressiveMeshStream& stream, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool = nullptr);
+	void Refine(ProgressiveMeshStream& stream, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	// How much of the mesh is on the GPU, meshes that weren't streamed are always fully resident
+	// - The error is in mesh space like the level of detail errors, 0 once everything is in
+	bool IsFullyResident();
+	int GetResidentTriangleCount();
+	int GetTotalTriangleCount();
+	float GetResidentError();
+
+	// Vertex and Index buffers, which pooled meshes share with others
+	// - Draw with the base vertex, and offset every index range of the mesh by the start index
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+	int GetBaseVertex();
+	unsigned int GetStartIndex();
 
-	// Index count access
+	// Index count and format access (16-bit whenever the mesh has few enough vertices)
+	// - The count is for the full detail level of every submesh together
 	int GetIndexCount();
+	DXGI_FORMAT GetIndexFormat();
+
+	// Submesh access, there's always at least one
+	int GetSubmeshCount();
+	const MeshSubmesh& GetSubmesh(int submesh);
+	int FindSubmesh(const char* material);
+
+	// Level of detail access for a submesh, level 0 is full detail
+	int GetLodCount(int submesh = 0);
+	MeshLod GetLod(int level, int submesh = 0);
+	int SelectLod(float distance, float errorPerDistance, int submesh = 0);
+
+	// Cluster access for a submesh, the clusters cover its full detail level (empty if the mesh wasn't clustered)
+	int GetClusterCount(int submesh = 0);
+	const MeshCluster* GetClusters(int submesh = 0);
+
+	// Bounds access
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+
+	// Ray queries in the mesh's own space, which always miss unless it was processed with MESH_PROCESS_BVH
+	// - Hit triangles count from the start of the full detail indices, across every submesh
+	bool HasBvh();
+	const MeshBvh* GetBvh();
+	bool Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, MeshRayHit& hit);
+	bool RaycastAny(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance);
+
+	// Vertex format access, compressed formats need the quantization values passed to the vertex shader
+	unsigned int GetVertexStride();
+	bool IsCompressed();
+	DirectX::XMFLOAT3 GetQuantizeMin();
+	DirectX::XMFLOAT3 GetQuantizeExtent();
 
 private:
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	static void ProcessMesh(MeshData& data);
+	static void GenerateLods(MeshData& data);
+	void CreateBuffers(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, GeometryPool* pool);
+	void SetEmpty();
+	void UpdateBuffer(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, GeometryAllocation* allocation, unsigned int first, unsigned int count, unsigned int elementSize, const void* data);
+	static void CalculateBounds(const Vertex* verts, int numVerts, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax);
+	static int CountFullDetailIndices(const std::vector<MeshSubmesh>& submeshes, int numIndices);
+	static void BuildBvh(MeshData& data);
+
+	// Shared, so copies of a mesh draw from the same ranges and the last one gives them back
+	std::shared_ptr<GeometryAllocation> vertexAllocation;
+	std::shared_ptr<GeometryAllocation> indexAllocation;
+	std::shared_ptr<MeshBvh> bvh;           // Shared the same way, it never changes once built
 	int indexCount = 0;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT;
+	std::vector<MeshLod> lods;
+	std::vector<MeshCluster> clusters;
+	std::vector<MeshSubmesh> submeshes;
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(0, 0, 0);
+	unsigned int processFlags = MESH_PROCESS_NONE;
+	unsigned int vertexStride = sizeof(Vertex);
+	DirectX::XMFLOAT3 quantizeMin = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 quantizeExtent = DirectX::XMFLOAT3(1, 1, 1);
+	bool streaming = false;                 // Buffers are refined in place, see BeginStream
+	float residentError = 0.0f;
 };
 
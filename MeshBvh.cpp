@@ -0,0 +1,509 @@
+#include "MeshBvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+
+// Binary levels past this become leaves whatever their size, which keeps the traversal stack bounded
+static const int MaxBuildDepth = 64;
+
+// Each level of a 4 wide node leaves at most 3 siblings on the stack
+static const int StackSize = MaxBuildDepth * 3 + 4;
+
+// Cost of visiting a node, relative to testing one triangle
+static const float TraversalCost = 1.0f;
+
+// A triangle's bounds, moved around whole so each range's triangles stay next to each other in memory
+// - Padded to four floats so the build can work on all three axes at once
+struct BuildTriangle
+{
+	alignas(16) float boundsMin[4];
+	alignas(16) float boundsMax[4];
+	int index;
+};
+
+struct MeshBvh::BuildState
+{
+	const Vertex* verts;
+	const unsigned int* indices;
+	std::vector<BuildTriangle> triangles;
+	std::vector<BuildNode> nodes;
+	float padding;
+};
+
+// Half the surface area of a box, which is all the heuristic needs
+static float HalfArea(__m128 boundsMin, __m128 boundsMax)
+{
+	float extent[4];
+	_mm_storeu_ps(extent, _mm_sub_ps(boundsMax, boundsMin));
+	return extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0];
+}
+
+static float HalfArea(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax)
+{
+	return HalfArea(_mm_set_ps(0.0f, boundsMin.z, boundsMin.y, boundsMin.x), _mm_set_ps(0.0f, boundsMax.z, boundsMax.y, boundsMax.x));
+}
+
+static DirectX::XMFLOAT3 ToFloat3(__m128 v)
+{
+	float values[4];
+	_mm_storeu_ps(values, v);
+	return DirectX::XMFLOAT3(values[0], values[1], values[2]);
+}
+
+// Bounds center along one axis, worked out the same way as the four wide version in BuildRange
+static float GetCentroid(const BuildTriangle& triangle, int axis)
+{
+	return (triangle.boundsMin[axis] + triangle.boundsMax[axis]) * 0.5f;
+}
+
+// Which bin a centroid lands in along one axis, matching the four wide version in BuildRange
+static int GetBin(float centroid, float axisMin, float scale)
+{
+	return (int)std::min((centroid - axisMin) * scale, (float)(MeshBvh::BinCount - 1));
+}
+
+// Degenerate triangles are kept (they just never get hit), so triangle numbers always match the indices
+bool MeshBvh::Build(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	nodes.clear();
+	packets.clear();
+	triangleCount = 0;
+	depth = 0;
+	for (int i = 0; i < numIndices - numIndices % 3; i++)
+	{
+		if (indices[i] >= (unsigned int)numVerts)
+			return false;
+	}
+
+	triangleCount = numIndices / 3;
+	if (triangleCount == 0)
+		return true;
+
+	BuildState state;
+	state.verts = verts;
+	state.indices = indices;
+	state.triangles.resize(triangleCount);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		const DirectX::XMFLOAT3& a = verts[indices[t * 3]].position;
+		const DirectX::XMFLOAT3& b = verts[indices[t * 3 + 1]].position;
+		const DirectX::XMFLOAT3& c = verts[indices[t * 3 + 2]].position;
+		__m128 va = _mm_set_ps(0.0f, a.z, a.y, a.x);
+		__m128 vb = _mm_set_ps(0.0f, b.z, b.y, b.x);
+		__m128 vc = _mm_set_ps(0.0f, c.z, c.y, c.x);
+		BuildTriangle& triangle = state.triangles[t];
+		_mm_store_ps(triangle.boundsMin, _mm_min_ps(_mm_min_ps(va, vb), vc));
+		_mm_store_ps(triangle.boundsMax, _mm_max_ps(_mm_max_ps(va, vb), vc));
+		triangle.index = t;
+	}
+
+	// Build the binary tree, then pack it into 4 wide nodes (and the triangles into leaf order)
+	state.nodes.reserve(triangleCount * 2 / 3 + 1);
+	BuildRange(state, 0, triangleCount, 0);
+
+	// Boxes are grown a little so rays lying exactly in one of their faces (like an axis aligned ray along a flat
+	// side) still enter them, the triangle test decides what's really hit
+	const BuildNode& root = state.nodes[0];
+	float largest = std::max(std::max(std::max(fabsf(root.boundsMin.x), fabsf(root.boundsMax.x)), std::max(fabsf(root.boundsMin.y), fabsf(root.boundsMax.y))),
+		std::max(fabsf(root.boundsMin.z), fabsf(root.boundsMax.z)));
+	state.padding = std::max(largest, 1.0f) * 1e-6f;
+	nodes.reserve(state.nodes.size() / 3 + 1);
+	packets.reserve(triangleCount / 4 + state.nodes.size() / 2 + 1);
+	Collapse(state, 0, 1);
+	return true;
+}
+
+// Splits a range of triangles in two wherever the surface area heuristic says is cheapest
+// - Returns the new node's index, its children are built right after it
+int MeshBvh::BuildRange(BuildState& state, int first, int count, int depth)
+{
+	BuildTriangle* triangles = state.triangles.data() + first;
+	const __m128 half = _mm_set1_ps(0.5f);
+	__m128 boundsMin = _mm_set1_ps(FLT_MAX), boundsMax = _mm_set1_ps(-FLT_MAX);
+	__m128 centroidMin = boundsMin, centroidMax = boundsMax;
+	for (int i = 0; i < count; i++)
+	{
+		__m128 triangleMin = _mm_load_ps(triangles[i].boundsMin);
+		__m128 triangleMax = _mm_load_ps(triangles[i].boundsMax);
+		__m128 centroid = _mm_mul_ps(_mm_add_ps(triangleMin, triangleMax), half);
+		boundsMin = _mm_min_ps(boundsMin, triangleMin);
+		boundsMax = _mm_max_ps(boundsMax, triangleMax);
+		centroidMin = _mm_min_ps(centroidMin, centroid);
+		centroidMax = _mm_max_ps(centroidMax, centroid);
+	}
+
+	int index = (int)state.nodes.size();
+	state.nodes.push_back({ ToFloat3(boundsMin), ToFloat3(boundsMax), -1, -1, first, count });
+
+	if (count <= 4 || depth >= MaxBuildDepth)
+		return index;
+
+	// Bin the centroids along all three axes in one pass
+	// - Flat axes get a scale of 0, which puts everything in the first bin and leaves no split to find
+	float axisMin[4], extent[4], scale[4];
+	_mm_storeu_ps(axisMin, centroidMin);
+	_mm_storeu_ps(extent, _mm_sub_ps(centroidMax, centroidMin));
+	for (int axis = 0; axis < 4; axis++)
+		scale[axis] = axis < 3 && extent[axis] > 0.0f ? BinCount / extent[axis] : 0.0f;
+
+	__m128 binMin[3][BinCount], binMax[3][BinCount];
+	int binTriangles[3][BinCount] = {};
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int b = 0; b < BinCount; b++)
+		{
+			binMin[axis][b] = _mm_set1_ps(FLT_MAX);
+			binMax[axis][b] = _mm_set1_ps(-FLT_MAX);
+		}
+	}
+
+	const __m128 scales = _mm_loadu_ps(scale);
+	const __m128 lastBin = _mm_set1_ps((float)(BinCount - 1));
+	for (int i = 0; i < count; i++)
+	{
+		__m128 triangleMin = _mm_load_ps(triangles[i].boundsMin);
+		__m128 triangleMax = _mm_load_ps(triangles[i].boundsMax);
+		__m128 centroid = _mm_mul_ps(_mm_add_ps(triangleMin, triangleMax), half);
+		int bins[4];
+		_mm_storeu_si128((__m128i*)bins, _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_sub_ps(centroid, centroidMin), scales), lastBin)));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int b = bins[axis];
+			binTriangles[axis][b]++;
+			binMin[axis][b] = _mm_min_ps(binMin[axis][b], triangleMin);
+			binMax[axis][b] = _mm_max_ps(binMax[axis][b], triangleMax);
+		}
+	}
+
+	// Sweep each axis for the cheapest split
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float parentArea = HalfArea(boundsMin, boundsMax);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (scale[axis] == 0.0f)
+			continue;
+
+		// Right to left first, so the left to right sweep can price every split as it goes
+		float rightCost[BinCount];
+		__m128 sweepMin = _mm_set1_ps(FLT_MAX), sweepMax = _mm_set1_ps(-FLT_MAX);
+		int sweepCount = 0;
+		for (int b = BinCount - 1; b > 0; b--)
+		{
+			sweepMin = _mm_min_ps(sweepMin, binMin[axis][b]);
+			sweepMax = _mm_max_ps(sweepMax, binMax[axis][b]);
+			sweepCount += binTriangles[axis][b];
+			rightCost[b] = sweepCount > 0 ? HalfArea(sweepMin, sweepMax) * sweepCount : -1.0f;
+		}
+
+		sweepMin = _mm_set1_ps(FLT_MAX);
+		sweepMax = _mm_set1_ps(-FLT_MAX);
+		sweepCount = 0;
+		for (int split = 1; split < BinCount; split++)
+		{
+			sweepMin = _mm_min_ps(sweepMin, binMin[axis][split - 1]);
+			sweepMax = _mm_max_ps(sweepMax, binMax[axis][split - 1]);
+			sweepCount += binTriangles[axis][split - 1];
+			if (sweepCount == 0 || rightCost[split] < 0.0f)
+				continue;
+
+			float cost = TraversalCost + (HalfArea(sweepMin, sweepMax) * sweepCount + rightCost[split]) / parentArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	if (count <= MaxLeafTriangles && (bestAxis < 0 || bestCost >= (float)count))
+		return index;
+
+	// Split where the heuristic said, or at the median when every centroid landed in the same bin
+	int middle = 0;
+	if (bestAxis >= 0)
+	{
+		middle = (int)(std::partition(triangles, triangles + count, [&](const BuildTriangle& triangle) {
+			return GetBin(GetCentroid(triangle, bestAxis), axisMin[bestAxis], scale[bestAxis]) < bestSplit;
+		}) - triangles);
+	}
+	if (middle == 0 || middle == count)
+	{
+		int axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : (extent[1] >= extent[2] ? 1 : 2);
+		middle = count / 2;
+		std::nth_element(triangles, triangles + middle, triangles + count, [&](const BuildTriangle& a, const BuildTriangle& b) {
+			return GetCentroid(a, axis) < GetCentroid(b, axis);
+		});
+	}
+
+	int left = BuildRange(state, first, middle, depth + 1);
+	int right = BuildRange(state, first + middle, count - middle, depth + 1);
+	state.nodes[index].left = left;
+	state.nodes[index].right = right;
+	return index;
+}
+
+// Pulls grandchildren up until the node has four children, always opening the largest inner child first
+// - Leaves are written out as packets as they're reached, so each leaf's triangles end up next to each other
+int MeshBvh::Collapse(const BuildState& state, int buildNode, int nodeDepth)
+{
+	depth = std::max(depth, nodeDepth);
+	int index = (int)nodes.size();
+	nodes.push_back(MeshBvhNode());
+
+	int children[4];
+	int childCount = 0;
+	const BuildNode& root = state.nodes[buildNode];
+	if (root.left < 0)
+		children[childCount++] = buildNode;
+	else
+	{
+		children[childCount++] = root.left;
+		children[childCount++] = root.right;
+	}
+
+	while (childCount < 4)
+	{
+		int largest = -1;
+		float largestArea = -1.0f;
+		for (int i = 0; i < childCount; i++)
+		{
+			const BuildNode& child = state.nodes[children[i]];
+			float area = HalfArea(child.boundsMin, child.boundsMax);
+			if (child.left >= 0 && area > largestArea)
+			{
+				largest = i;
+				largestArea = area;
+			}
+		}
+		if (largest < 0)
+			break;
+
+		const BuildNode& opened = state.nodes[children[largest]];
+		children[largest] = opened.left;
+		children[childCount++] = opened.right;
+	}
+
+	MeshBvhNode node;
+	for (int i = 0; i < 4; i++)
+	{
+		// Empty slots are skipped by their child index, whatever the slab test makes of their bounds
+		node.minX[i] = node.minY[i] = node.minZ[i] = FLT_MAX;
+		node.maxX[i] = node.maxY[i] = node.maxZ[i] = -FLT_MAX;
+		node.child[i] = -1;
+		node.packetCount[i] = 0;
+		if (i >= childCount)
+			continue;
+
+		const BuildNode& child = state.nodes[children[i]];
+		node.minX[i] = child.boundsMin.x - state.padding;
+		node.minY[i] = child.boundsMin.y - state.padding;
+		node.minZ[i] = child.boundsMin.z - state.padding;
+		node.maxX[i] = child.boundsMax.x + state.padding;
+		node.maxY[i] = child.boundsMax.y + state.padding;
+		node.maxZ[i] = child.boundsMax.z + state.padding;
+		if (child.left >= 0)
+		{
+			node.child[i] = Collapse(state, children[i], nodeDepth + 1);
+			continue;
+		}
+
+		// Corners and edges of up to four triangles per packet, with the unused lanes left zeroed
+		node.child[i] = (int)packets.size();
+		node.packetCount[i] = (child.count + 3) / 4;
+		for (int p = 0; p < child.count; p += 4)
+		{
+			MeshBvhPacket packet = {};
+			for (int lane = 0; lane < 4; lane++)
+			{
+				packet.triangle[lane] = -1;
+				if (p + lane >= child.count)
+					continue;
+
+				int t = state.triangles[child.first + p + lane].index;
+				const DirectX::XMFLOAT3& a = state.verts[state.indices[t * 3]].position;
+				const DirectX::XMFLOAT3& b = state.verts[state.indices[t * 3 + 1]].position;
+				const DirectX::XMFLOAT3& c = state.verts[state.indices[t * 3 + 2]].position;
+				packet.v0x[lane] = a.x;
+				packet.v0y[lane] = a.y;
+				packet.v0z[lane] = a.z;
+				packet.e1x[lane] = b.x - a.x;
+				packet.e1y[lane] = b.y - a.y;
+				packet.e1z[lane] = b.z - a.z;
+				packet.e2x[lane] = c.x - a.x;
+				packet.e2y[lane] = c.y - a.y;
+				packet.e2z[lane] = c.z - a.z;
+				packet.triangle[lane] = t;
+			}
+			packets.push_back(packet);
+		}
+	}
+
+	nodes[index] = node;
+	return index;
+}
+
+bool MeshBvh::IntersectClosest(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, MeshRayHit& hit) const
+{
+	return Traverse<false>(origin, direction, maxDistance, &hit);
+}
+
+bool MeshBvh::IntersectAny(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance) const
+{
+	return Traverse<true>(origin, direction, maxDistance, nullptr);
+}
+
+// Nearest children are visited first, and leaves are tested as soon as their node is, so the closest hit
+// found so far can skip anything behind it
+template <bool AnyHit>
+bool MeshBvh::Traverse(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, MeshRayHit* hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	// Axis aligned directions would give 0 * infinity in the slab test, so zeros are nudged off axis
+	float inverse[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float d = (&direction.x)[axis];
+		if (fabsf(d) < 1e-30f)
+			d = d < 0.0f ? -1e-30f : 1e-30f;
+		inverse[axis] = 1.0f / d;
+	}
+
+	const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+	const __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+	const __m128 ix = _mm_set1_ps(inverse[0]), iy = _mm_set1_ps(inverse[1]), iz = _mm_set1_ps(inverse[2]);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	float closest = maxDistance;
+	int hitPacket = -1;
+	int hitLane = 0;
+	float hitU = 0.0f, hitV = 0.0f;
+
+	int stackNodes[StackSize];
+	float stackDistances[StackSize];
+	int stackSize = 1;
+	stackNodes[0] = 0;
+	stackDistances[0] = 0.0f;
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (stackDistances[stackSize] > closest)
+			continue;
+		const MeshBvhNode& node = nodes[stackNodes[stackSize]];
+
+		// Slab test against all four children
+		__m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+		__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+		__m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+		__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+		__m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+		__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+		__m128 nearest = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), zero));
+		__m128 farthest = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(closest)));
+		int mask = _mm_movemask_ps(_mm_cmple_ps(nearest, farthest));
+		if (mask == 0)
+			continue;
+
+		float distances[4];
+		_mm_storeu_ps(distances, nearest);
+
+		int pushed = stackSize;
+		for (int i = 0; i < 4; i++)
+		{
+			if (!(mask & (1 << i)) || node.child[i] < 0)
+				continue;
+
+			if (node.packetCount[i] == 0)
+			{
+				// Pushed sorted farthest first, so they come back off the stack nearest first
+				int slot = stackSize++;
+				while (slot > pushed && stackDistances[slot - 1] < distances[i])
+				{
+					stackNodes[slot] = stackNodes[slot - 1];
+					stackDistances[slot] = stackDistances[slot - 1];
+					slot--;
+				}
+				stackNodes[slot] = node.child[i];
+				stackDistances[slot] = distances[i];
+				continue;
+			}
+
+			// Moller-Trumbore on four triangles at a time
+			for (int p = node.child[i]; p < node.child[i] + node.packetCount[i]; p++)
+			{
+				const MeshBvhPacket& packet = packets[p];
+				__m128 e1x = _mm_load_ps(packet.e1x), e1y = _mm_load_ps(packet.e1y), e1z = _mm_load_ps(packet.e1z);
+				__m128 e2x = _mm_load_ps(packet.e2x), e2y = _mm_load_ps(packet.e2y), e2z = _mm_load_ps(packet.e2z);
+
+				__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+				__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+				__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+				__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+				__m128 invDet = _mm_div_ps(one, det);
+
+				__m128 tx = _mm_sub_ps(ox, _mm_load_ps(packet.v0x));
+				__m128 ty = _mm_sub_ps(oy, _mm_load_ps(packet.v0y));
+				__m128 tz = _mm_sub_ps(oz, _mm_load_ps(packet.v0z));
+				__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+				__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+				__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+				__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+				__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+				// Zero determinants (unused lanes, degenerate or edge on triangles) fail every comparison through the NaNs
+				__m128 valid = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmple_ps(_mm_add_ps(u, v), one), _mm_cmpge_ps(t, zero)));
+				valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(closest)));
+				int hits = _mm_movemask_ps(valid);
+				if (hits == 0)
+					continue;
+				if (AnyHit)
+					return true;
+
+				float ts[4], us[4], vs[4];
+				_mm_storeu_ps(ts, t);
+				_mm_storeu_ps(us, u);
+				_mm_storeu_ps(vs, v);
+				for (int lane = 0; lane < 4; lane++)
+				{
+					if ((hits & (1 << lane)) && ts[lane] < closest)
+					{
+						closest = ts[lane];
+						hitPacket = p;
+						hitLane = lane;
+						hitU = us[lane];
+						hitV = vs[lane];
+					}
+				}
+			}
+		}
+	}
+
+	if (hitPacket < 0)
+		return false;
+
+	// The normal comes from the winning triangle's edges, which point it out of the front face
+	const MeshBvhPacket& packet = packets[hitPacket];
+	DirectX::XMFLOAT3 e1(packet.e1x[hitLane], packet.e1y[hitLane], packet.e1z[hitLane]);
+	DirectX::XMFLOAT3 e2(packet.e2x[hitLane], packet.e2y[hitLane], packet.e2z[hitLane]);
+	hit->distance = closest;
+	hit->u = hitU;
+	hit->v = hitV;
+	hit->triangle = packet.triangle[hitLane];
+	DirectX::XMStoreFloat3(&hit->normal, DirectX::XMVector3Cross(DirectX::XMLoadFloat3(&e1), DirectX::XMLoadFloat3(&e2)));
+	return true;
+}
+
+int MeshBvh::GetNodeCount() const { return (int)nodes.size(); }
+int MeshBvh::GetTriangleCount() const { return triangleCount; }
+int MeshBvh::GetDepth() const { return depth; }
+size_t MeshBvh::GetMemoryBytes() const { return nodes.size() * sizeof(MeshBvhNode) + packets.size() * sizeof(MeshBvhPacket); }
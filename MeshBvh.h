@@ -0,0 +1,94 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+
+// Where a ray hit a mesh, all in the mesh's own space
+struct MeshRayHit
+{
+	float distance;                         // In multiples of the ray's direction
+	float u;                                // Barycentric weights of the triangle's second and third corners
+	float v;
+	int triangle;                           // Which triangle of the indices the BVH was built from (index / 3)
+	DirectX::XMFLOAT3 normal;               // Unnormalized geometric normal, on the triangle's front side
+};
+
+// Four children's bounds side by side, so a ray is tested against all of them at once
+// - Leaf children point at a run of triangle packets, empty slots have no child and are skipped
+struct alignas(16) MeshBvhNode
+{
+	float minX[4], minY[4], minZ[4];
+	float maxX[4], maxY[4], maxZ[4];
+	int child[4];                           // Node index, first packet index for leaves, or -1 for empty slots
+	int packetCount[4];                     // 0 for inner nodes
+};
+
+// Four triangles side by side as a corner and two edges, ready for the ray test (unused lanes are all zero)
+struct alignas(16) MeshBvhPacket
+{
+	float v0x[4], v0y[4], v0z[4];
+	float e1x[4], e1y[4], e1z[4];
+	float e2x[4], e2y[4], e2z[4];
+	int triangle[4];                        // -1 for unused lanes
+};
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over a mesh's triangles, for
+// ray queries on the CPU (picking, baking, collision)
+//
+// - Built top down with a binned surface area heuristic,
+//   then collapsed from two children per node to four
+// - Keeps its own copy of the triangles (positions only) in
+//   leaf order, so it doesn't need the mesh afterwards
+// - Rays are tested against four boxes or four triangles
+//   at a time with SSE, and hit both sides of a triangle
+// - Queries only read, so any number of threads can run
+//   them at once
+// --------------------------------------------------------
+class MeshBvh
+{
+public:
+	// Bins per axis when looking for the best split
+	static const int BinCount = 16;
+
+	// Ranges at or below this many triangles can become leaves when that's cheaper than splitting
+	static const int MaxLeafTriangles = 8;
+
+	// Replaces whatever was built before
+	// - Returns false and leaves it empty (hitting nothing) if any index is past the last vertex
+	bool Build(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
+
+	// Finds the nearest hit within maxDistance (in multiples of direction, which doesn't need to be normalized)
+	bool IntersectClosest(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, MeshRayHit& hit) const;
+
+	// Stops at the first hit found within maxDistance, for shadow and occlusion rays
+	bool IntersectAny(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance) const;
+
+	// Size and shape of the tree
+	int GetNodeCount() const;
+	int GetTriangleCount() const;
+	int GetDepth() const;
+	size_t GetMemoryBytes() const;
+
+private:
+	struct BuildNode
+	{
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+		int left;                           // Children, -1 for leaves
+		int right;
+		int first;                          // Range of the build order
+		int count;
+	};
+
+	struct BuildState;
+	static int BuildRange(BuildState& state, int first, int count, int depth);
+	int Collapse(const BuildState& state, int buildNode, int depth);
+	template <bool AnyHit> bool Traverse(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, MeshRayHit* hit) const;
+
+	std::vector<MeshBvhNode> nodes;
+	std::vector<MeshBvhPacket> packets;
+	int triangleCount = 0;
+	int depth = 0;
+};
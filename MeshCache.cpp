@@ -0,0 +1,191 @@
+#include "MeshCache.h"
+#include "Mesh.h"
+#include "MeshCodec.h"
+
+#include <fstream>
+#include <cstring>
+#include <vector>
+
+// Grabs the size and last write time of a file, false if it doesn't exist
+static bool GetSourceInfo(const char* path, unsigned long long& size, unsigned long long& time)
+{
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info))
+		return false;
+
+	size = ((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	time = ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+// Maps the cache belonging to the given source asset and validates it
+MeshCache::MeshCache(const char* sourcePath, unsigned int processFlags)
+	: file(GetCachePath(sourcePath).c_str())
+{
+	header = nullptr;
+	valid = false;
+
+	if (!file.IsOpen() || file.GetSize() < sizeof(MeshCacheHeader))
+		return;
+
+	// Check that this is a cache we know how to read
+	const MeshCacheHeader* h = (const MeshCacheHeader*)file.GetData();
+	if (memcmp(h->magic, "MSHC", 4) != 0 || h->version != MESH_CACHE_VERSION || h->vertexStride != sizeof(Vertex))
+		return;
+
+	// Was it processed the same way we want now?
+	if (h->processFlags != processFlags)
+		return;
+
+	// Make sure the file actually holds everything the header claims
+	size_t payload = (size_t)h->vertexBytes + h->indexBytes + (size_t)h->lodCount * sizeof(MeshLod) + (size_t)h->clusterCount * sizeof(MeshCluster)
+		+ (size_t)h->submeshCount * sizeof(MeshSubmesh);
+	if (file.GetSize() != sizeof(MeshCacheHeader) + payload)
+		return;
+
+	// Has the source asset changed since this was written?
+	unsigned long long sourceSize, sourceTime;
+	if (!GetSourceInfo(sourcePath, sourceSize, sourceTime) || sourceSize != h->sourceSize || sourceTime != h->sourceTime)
+		return;
+
+	// Finally, catch any corruption or partially written data
+	header = h;
+	unsigned long long hash = HashBytes(GetEncodedVertices(), h->vertexBytes, h->vertexCount);
+	hash = HashBytes(GetEncodedIndices(), h->indexBytes, hash);
+	hash = HashBytes(GetLods(), (size_t)h->lodCount * sizeof(MeshLod), hash);
+	hash = HashBytes(GetClusters(), (size_t)h->clusterCount * sizeof(MeshCluster), hash);
+	hash = HashBytes(GetSubmeshes(), (size_t)h->submeshCount * sizeof(MeshSubmesh), hash);
+	if (hash != h->contentHash)
+	{
+		header = nullptr;
+		return;
+	}
+
+	valid = true;
+}
+
+bool MeshCache::IsValid() { return valid; }
+const MeshCacheHeader* MeshCache::GetHeader() { return header; }
+const MeshLod* MeshCache::GetLods() { return (const MeshLod*)(GetEncodedIndices() + header->indexBytes); }
+const MeshCluster* MeshCache::GetClusters() { return (const MeshCluster*)(GetLods() + header->lodCount); }
+const MeshSubmesh* MeshCache::GetSubmeshes() { return (const MeshSubmesh*)(GetClusters() + header->clusterCount); }
+
+// Where each encoded stream starts in the mapping
+const unsigned char* MeshCache::GetEncodedVertices() { return (const unsigned char*)file.GetData() + sizeof(MeshCacheHeader); }
+const unsigned char* MeshCache::GetEncodedIndices() { return GetEncodedVertices() + header->vertexBytes; }
+
+// Decodes straight out of the mapping into the given arrays
+bool MeshCache::DecodeVertices(Vertex* verts)
+{
+	return MeshCodec::DecodeVertices(GetEncodedVertices(), header->vertexBytes, verts, header->vertexCount, sizeof(Vertex));
+}
+
+bool MeshCache::DecodeIndices(unsigned int* indices)
+{
+	return MeshCodec::DecodeIndices(GetEncodedIndices(), header->indexBytes, indices, header->indexCount);
+}
+
+// Writes (or overwrites) the cache for the given source asset
+bool MeshCache::Write(
+	const char* sourcePath,
+	unsigned int processFlags,
+	const Vertex* verts, int numVerts,
+	const unsigned int* indices, int numIndices,
+	const MeshLod* lods, int numLods,
+	const MeshCluster* clusters, int numClusters,
+	const MeshSubmesh* submeshes, int numSubmeshes,
+	DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax)
+{
+	MeshCacheHeader header = {};
+	memcpy(header.magic, "MSHC", 4);
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.vertexCount = numVerts;
+	header.indexCount = numIndices;
+	header.lodCount = numLods;
+	header.clusterCount = numClusters;
+	header.submeshCount = numSubmeshes;
+	header.processFlags = processFlags;
+	header.boundsMin = boundsMin;
+	header.boundsMax = boundsMax;
+	if (!GetSourceInfo(sourcePath, header.sourceSize, header.sourceTime))
+		return false;
+
+	// Encode the vertices and indices, padding each so the tables after them stay aligned
+	std::vector<unsigned char> encodedVertices;
+	std::vector<unsigned char> encodedIndices;
+	MeshCodec::EncodeVertices(verts, numVerts, sizeof(Vertex), encodedVertices);
+	MeshCodec::EncodeIndices(indices, numIndices, encodedIndices);
+	encodedVertices.resize((encodedVertices.size() + 3) & ~(size_t)3, 0);
+	encodedIndices.resize((encodedIndices.size() + 3) & ~(size_t)3, 0);
+	header.vertexBytes = (unsigned int)encodedVertices.size();
+	header.indexBytes = (unsigned int)encodedIndices.size();
+
+	// Hash the encoded vertices, then chain the indices, levels, clusters and submeshes onto it
+	size_t lodBytes = (size_t)numLods * sizeof(MeshLod);
+	size_t clusterBytes = (size_t)numClusters * sizeof(MeshCluster);
+	size_t submeshBytes = (size_t)numSubmeshes * sizeof(MeshSubmesh);
+	header.contentHash = HashBytes(encodedVertices.data(), header.vertexBytes, header.vertexCount);
+	header.contentHash = HashBytes(encodedIndices.data(), header.indexBytes, header.contentHash);
+	header.contentHash = HashBytes(lods, lodBytes, header.contentHash);
+	header.contentHash = HashBytes(clusters, clusterBytes, header.contentHash);
+	header.contentHash = HashBytes(submeshes, submeshBytes, header.contentHash);
+
+	// Written to a file of this thread's own, then moved over the cache in one step, so loaders racing on the
+	// same asset never interleave their writes and a reader never sees half a cache
+	std::string cachePath = GetCachePath(sourcePath);
+	std::string tempPath = cachePath + "." + std::to_string(GetCurrentThreadId()) + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)encodedVertices.data(), header.vertexBytes);
+		out.write((const char*)encodedIndices.data(), header.indexBytes);
+		out.write((const char*)lods, lodBytes);
+		out.write((const char*)clusters, clusterBytes);
+		out.write((const char*)submeshes, submeshBytes);
+		out.close();
+		if (!out.good())
+		{
+			DeleteFileA(tempPath.c_str());
+			return false;
+		}
+	}
+
+	// Fails if the cache is still mapped somewhere, which leaves the old one in place for next time
+	if (!MoveFileExA(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Caches sit right next to their source asset
+std::string MeshCache::GetCachePath(const char* sourcePath)
+{
+	return std::string(sourcePath) + ".meshcache";
+}
+
+// Simple 64 bit multiply/xor-shift hash, eight bytes at a time
+unsigned long long MeshCache::HashBytes(const void* data, size_t size, unsigned long long seed)
+{
+	const unsigned long long prime = 0x9E3779B97F4A7C15ULL;
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long h = seed ^ prime;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		memcpy(&word, bytes + i, 8);
+		h = (h ^ word) * prime;
+		h ^= h >> 32;
+	}
+	for (; i < size; i++)
+		h = (h ^ bytes[i]) * prime;
+
+	return h;
+}
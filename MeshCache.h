@@ -0,0 +1,96 @@
+#pragma once
+#include <DirectXMath.h>
+#include <string>
+
+#include "MappedFile.h"
+#include "Vertex.h"
+
+struct MeshLod;
+struct MeshCluster;
+struct MeshSubmesh;
+
+// Bump whenever the layout below or the Vertex struct changes
+#define MESH_CACHE_VERSION 6
+
+// --------------------------------------------------------
+// Header at the very start of every binary mesh cache file
+// - Followed directly by the encoded vertices, the encoded
+//   indices (both MeshCodec streams padded to 4 bytes), the
+//   level of detail table, the cluster table, then the
+//   submesh table
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char magic[4];                     // Always "MSHC"
+	unsigned int version;              // MESH_CACHE_VERSION at write time
+	unsigned int vertexStride;         // sizeof(Vertex) at write time
+	unsigned int vertexCount;
+	unsigned int indexCount;           // Every level of detail together
+	unsigned int lodCount;
+	unsigned int clusterCount;
+	unsigned int submeshCount;
+	unsigned int vertexBytes;          // Size of the encoded vertices, padding included
+	unsigned int indexBytes;           // Size of the encoded indices, padding included
+	unsigned int processFlags;         // MeshProcessFlags the data was built with
+	unsigned long long sourceSize;     // Size of the source asset when the cache was built
+	unsigned long long sourceTime;     // Last write time of the source asset when the cache was built
+	unsigned long long contentHash;    // Hash of every array after the header
+	DirectX::XMFLOAT3 boundsMin;       // Axis aligned bounds of every vertex position
+	DirectX::XMFLOAT3 boundsMax;
+};
+
+// --------------------------------------------------------
+// Binary cache of a fully processed mesh (welded, with
+// tangents) sitting next to its source asset on disk
+//
+// - Vertices and indices are stored with MeshCodec, and are
+//   decoded straight from the mapped file into the caller's
+//   arrays. The smaller tables are read in place
+// - A cache is only valid if it matches the current version,
+//   the processing flags, the source file's size and write
+//   time, and its own hash
+// --------------------------------------------------------
+class MeshCache
+{
+public:
+	// Maps the cache belonging to the given source asset, if there is one
+	// - Caches built with different processing flags are treated as invalid
+	MeshCache(const char* sourcePath, unsigned int processFlags);
+
+	bool IsValid();
+	const MeshCacheHeader* GetHeader();
+
+	// Decode header->vertexCount vertices and header->indexCount indices, false if the data is malformed
+	bool DecodeVertices(Vertex* verts);
+	bool DecodeIndices(unsigned int* indices);
+
+	const MeshLod* GetLods();
+	const MeshCluster* GetClusters();
+	const MeshSubmesh* GetSubmeshes();
+
+	// Writes (or overwrites) the cache for the given source asset, through a temporary file moved into place
+	// - Nothing may have the old cache mapped, so let go of any MeshCache for it first
+	static bool Write(
+		const char* sourcePath,
+		unsigned int processFlags,
+		const Vertex* verts, int numVerts,
+		const unsigned int* indices, int numIndices,
+		const MeshLod* lods, int numLods,
+		const MeshCluster* clusters, int numClusters,
+		const MeshSubmesh* submeshes, int numSubmeshes,
+		DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+
+	// Where the cache for a given source asset lives
+	static std::string GetCachePath(const char* sourcePath);
+
+	// Hash used to detect corrupted or partially written caches
+	static unsigned long long HashBytes(const void* data, size_t size, unsigned long long seed);
+
+private:
+	const unsigned char* GetEncodedVertices();
+	const unsigned char* GetEncodedIndices();
+
+	MappedFile file;
+	const MeshCacheHeader* header;
+	bool valid;
+};
@@ -0,0 +1,321 @@
+#include "MeshClusterizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// How much a candidate triangle facing away from the cluster costs, compared to adding one new vertex
+static const float NormalWeight = 0.5f;
+
+// Clusters whose triangles spread wider than this (cosine from the axis, ~84 degrees) never back face cull
+static const float MinConeSpread = 0.1f;
+
+// Fills in the bounding sphere and normal cone of a finished cluster
+static void ComputeClusterBounds(const Vertex* verts, const unsigned int* indices, const DirectX::XMFLOAT3* normals, MeshCluster& cluster)
+{
+	int firstTriangle = cluster.startIndex / 3;
+	int numTriangles = cluster.indexCount / 3;
+
+	// Sphere around the middle of the cluster's bounding box
+	DirectX::XMVECTOR lowest = DirectX::XMLoadFloat3(&verts[indices[cluster.startIndex]].position);
+	DirectX::XMVECTOR highest = lowest;
+	for (unsigned int i = cluster.startIndex; i < cluster.startIndex + cluster.indexCount; i++)
+	{
+		DirectX::XMVECTOR pos = DirectX::XMLoadFloat3(&verts[indices[i]].position);
+		lowest = DirectX::XMVectorMin(lowest, pos);
+		highest = DirectX::XMVectorMax(highest, pos);
+	}
+
+	DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(lowest, highest), 0.5f);
+	float radius = 0.0f;
+	for (unsigned int i = cluster.startIndex; i < cluster.startIndex + cluster.indexCount; i++)
+	{
+		DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&verts[indices[i]].position), center);
+		radius = fmaxf(radius, DirectX::XMVectorGetX(DirectX::XMVector3Length(offset)));
+	}
+	DirectX::XMStoreFloat3(&cluster.center, center);
+	cluster.radius = radius;
+
+	// Cone around the average facing direction, as wide as the furthest facing triangle
+	DirectX::XMVECTOR axis = DirectX::XMVectorZero();
+	for (int t = firstTriangle; t < firstTriangle + numTriangles; t++)
+		axis = DirectX::XMVectorAdd(axis, DirectX::XMLoadFloat3(&normals[t]));
+
+	cluster.coneAxis = DirectX::XMFLOAT3(0, 0, 0);
+	cluster.coneCutoff = 1.0f;
+	float axisLength = DirectX::XMVectorGetX(DirectX::XMVector3Length(axis));
+	if (axisLength <= 0.0f)
+		return;
+
+	axis = DirectX::XMVectorScale(axis, 1.0f / axisLength);
+	float minDot = 1.0f;
+	for (int t = firstTriangle; t < firstTriangle + numTriangles; t++)
+	{
+		DirectX::XMVECTOR normal = DirectX::XMLoadFloat3(&normals[t]);
+		if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(normal)) > 0.0f)
+			minDot = fminf(minDot, DirectX::XMVectorGetX(DirectX::XMVector3Dot(axis, normal)));
+	}
+
+	DirectX::XMStoreFloat3(&cluster.coneAxis, axis);
+	if (minDot > MinConeSpread)
+		cluster.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+// Reorders the triangles of an index buffer into clusters and fills in their bounds
+void MeshClusterizer::BuildClusters(
+	const Vertex* verts, int numVerts,
+	unsigned int* indices, int numIndices,
+	int maxVertices, int maxTriangles,
+	std::vector<MeshCluster>& clusters)
+{
+	clusters.clear();
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+		return;
+
+	// Unit facing direction of every triangle (front faces are clockwise, so this points outward)
+	// - Degenerate triangles get a zero normal and fit in any cluster
+	std::vector<DirectX::XMFLOAT3> normals(numTriangles);
+	for (int t = 0; t < numTriangles; t++)
+	{
+		DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&verts[indices[t * 3]].position);
+		DirectX::XMVECTOR b = DirectX::XMLoadFloat3(&verts[indices[t * 3 + 1]].position);
+		DirectX::XMVECTOR c = DirectX::XMLoadFloat3(&verts[indices[t * 3 + 2]].position);
+		DirectX::XMVECTOR cross = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(b, a), DirectX::XMVectorSubtract(c, a));
+		float length = DirectX::XMVectorGetX(DirectX::XMVector3Length(cross));
+		DirectX::XMStoreFloat3(&normals[t], length > 0.0f ? DirectX::XMVectorScale(cross, 1.0f / length) : DirectX::XMVectorZero());
+	}
+
+	// Triangles using each vertex, as one flat array
+	std::vector<int> adjacencyStart(numVerts + 1, 0);
+	std::vector<int> adjacency(numTriangles * 3);
+	for (int i = 0; i < numTriangles * 3; i++)
+		adjacencyStart[indices[i] + 1]++;
+	for (int v = 0; v < numVerts; v++)
+		adjacencyStart[v + 1] += adjacencyStart[v];
+
+	std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (int i = 0; i < numTriangles * 3; i++)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	// Which cluster every triangle ended up in, and which cluster last touched a vertex or candidate
+	std::vector<int> triangleCluster(numTriangles, -1);
+	std::vector<int> vertexStamp(numVerts, -1);
+	std::vector<int> candidateStamp(numTriangles, -1);
+	std::vector<int> candidates;
+
+	// Triangles in cluster order, with where each cluster starts
+	std::vector<int> order;
+	std::vector<int> clusterStart;
+	order.reserve(numTriangles);
+
+	int nextUnassigned = 0;
+	int clusterCount = 0;
+	while (true)
+	{
+		// Seed the next cluster next to the last one when possible, so the leftovers don't end up scattered
+		int seed = -1;
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			if (triangleCluster[candidates[i]] < 0 && (seed < 0 || candidates[i] < seed))
+				seed = candidates[i];
+		}
+		if (seed < 0)
+		{
+			while (nextUnassigned < numTriangles && triangleCluster[nextUnassigned] >= 0)
+				nextUnassigned++;
+			if (nextUnassigned == numTriangles)
+				break;
+			seed = nextUnassigned;
+		}
+
+		int id = clusterCount++;
+		int clusterVerts = 0;
+		int clusterTriangles = 0;
+		DirectX::XMVECTOR normalSum = DirectX::XMVectorZero();
+		clusterStart.push_back((int)order.size());
+		candidates.clear();
+
+		int current = seed;
+		while (true)
+		{
+			// Add the triangle, then every unassigned neighbor of its new vertices becomes a candidate
+			triangleCluster[current] = id;
+			order.push_back(current);
+			clusterTriangles++;
+			normalSum = DirectX::XMVectorAdd(normalSum, DirectX::XMLoadFloat3(&normals[current]));
+
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[current * 3 + c];
+				if (vertexStamp[v] == id)
+					continue;
+
+				vertexStamp[v] = id;
+				clusterVerts++;
+				for (int a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++)
+				{
+					int neighbor = adjacency[a];
+					if (triangleCluster[neighbor] < 0 && candidateStamp[neighbor] != id)
+					{
+						candidateStamp[neighbor] = id;
+						candidates.push_back(neighbor);
+					}
+				}
+			}
+
+			if (clusterTriangles == maxTriangles)
+				break;
+
+			// Cheapest candidate that still fits: fewest new vertices, then closest facing
+			float axisLength = DirectX::XMVectorGetX(DirectX::XMVector3Length(normalSum));
+			DirectX::XMVECTOR axis = axisLength > 0.0f ? DirectX::XMVectorScale(normalSum, 1.0f / axisLength) : DirectX::XMVectorZero();
+			int best = -1;
+			float bestScore = FLT_MAX;
+			for (size_t i = 0; i < candidates.size();)
+			{
+				int t = candidates[i];
+				if (triangleCluster[t] >= 0)
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				i++;
+
+				int newVerts = 0;
+				for (int c = 0; c < 3; c++)
+					newVerts += vertexStamp[indices[t * 3 + c]] != id;
+				if (clusterVerts + newVerts > maxVertices)
+					continue;
+
+				float facing = DirectX::XMVectorGetX(DirectX::XMVector3Dot(axis, DirectX::XMLoadFloat3(&normals[t])));
+				float score = newVerts + NormalWeight * (1.0f - facing);
+				if (score < bestScore || (score == bestScore && t < best))
+				{
+					best = t;
+					bestScore = score;
+				}
+			}
+
+			if (best < 0)
+				break;
+			current = best;
+		}
+	}
+	clusterStart.push_back(numTriangles);
+
+	// Keep the original order inside each cluster, then sort clusters by their earliest triangle
+	std::vector<int> clusterOrder(clusterCount);
+	for (int i = 0; i < clusterCount; i++)
+	{
+		std::sort(order.begin() + clusterStart[i], order.begin() + clusterStart[i + 1]);
+		clusterOrder[i] = i;
+	}
+	std::sort(clusterOrder.begin(), clusterOrder.end(), [&](int a, int b) { return order[clusterStart[a]] < order[clusterStart[b]]; });
+
+	// Write the triangles (and their normals) back out cluster by cluster
+	std::vector<unsigned int> output;
+	std::vector<DirectX::XMFLOAT3> sortedNormals;
+	output.reserve(numTriangles * 3);
+	sortedNormals.reserve(numTriangles);
+	clusters.resize(clusterCount);
+	for (int i = 0; i < clusterCount; i++)
+	{
+		int cluster = clusterOrder[i];
+		clusters[i].startIndex = (unsigned int)output.size();
+		for (int o = clusterStart[cluster]; o < clusterStart[cluster + 1]; o++)
+		{
+			output.insert(output.end(), indices + order[o] * 3, indices + order[o] * 3 + 3);
+			sortedNormals.push_back(normals[order[o]]);
+		}
+		clusters[i].indexCount = (unsigned int)output.size() - clusters[i].startIndex;
+	}
+
+	for (int i = 0; i < numTriangles * 3; i++)
+		indices[i] = output[i];
+
+	for (int i = 0; i < clusterCount; i++)
+		ComputeClusterBounds(verts, indices, sortedNormals.data(), clusters[i]);
+}
+
+// Finds which clusters can be seen and appends their index ranges to visibleRanges
+// - Everything is tested in mesh space, so the clusters never need transforming
+ClusterCullStats MeshClusterizer::CullClusters(
+	const MeshCluster* clusters, int numClusters,
+	const DirectX::XMFLOAT4X4& world,
+	const DirectX::XMFLOAT4X4& viewProj,
+	DirectX::XMFLOAT3 cameraPosition,
+	std::vector<MeshIndexRange>& visibleRanges)
+{
+	ClusterCullStats stats = {};
+
+	// Frustum planes in mesh space, straight from the columns of world * view * projection
+	// - Left, right, bottom, top, near (z >= 0 in D3D) and far
+	DirectX::XMMATRIX worldMatrix = DirectX::XMLoadFloat4x4(&world);
+	DirectX::XMFLOAT4X4 m;
+	DirectX::XMStoreFloat4x4(&m, DirectX::XMMatrixMultiply(worldMatrix, DirectX::XMLoadFloat4x4(&viewProj)));
+	float planes[6][4] =
+	{
+		{ m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41 },
+		{ m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41 },
+		{ m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42 },
+		{ m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42 },
+		{ m._13, m._23, m._33, m._43 },
+		{ m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43 },
+	};
+	for (int p = 0; p < 6; p++)
+	{
+		float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		for (int i = 0; i < 4; i++)
+			planes[p][i] *= scale;
+	}
+
+	// Camera in mesh space too (back facing doesn't change under the transform, unless it mirrors the mesh,
+	// in which case the rasterizer flips its winding and the cones have to flip with it)
+	DirectX::XMVECTOR determinant;
+	DirectX::XMMATRIX inverseWorld = DirectX::XMMatrixInverse(&determinant, worldMatrix);
+	DirectX::XMFLOAT3 camera;
+	DirectX::XMStoreFloat3(&camera, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&cameraPosition), inverseWorld));
+	float coneSign = DirectX::XMVectorGetX(determinant) < 0.0f ? -1.0f : 1.0f;
+
+	for (int i = 0; i < numClusters; i++)
+	{
+		const MeshCluster& cluster = clusters[i];
+		unsigned int triangles = cluster.indexCount / 3;
+
+		// Entirely outside any one plane
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+			outside = planes[p][0] * cluster.center.x + planes[p][1] * cluster.center.y + planes[p][2] * cluster.center.z + planes[p][3] < -cluster.radius;
+		if (outside)
+		{
+			stats.trianglesFrustumCulled += triangles;
+			continue;
+		}
+
+		// Every point of the sphere sees every triangle from behind
+		if (cluster.coneCutoff < 1.0f)
+		{
+			float dx = cluster.center.x - camera.x;
+			float dy = cluster.center.y - camera.y;
+			float dz = cluster.center.z - camera.z;
+			float along = coneSign * (dx * cluster.coneAxis.x + dy * cluster.coneAxis.y + dz * cluster.coneAxis.z);
+			if (along >= cluster.coneCutoff * sqrtf(dx * dx + dy * dy + dz * dz) + cluster.radius)
+			{
+				stats.trianglesBackfaceCulled += triangles;
+				continue;
+			}
+		}
+
+		// Visible, so either extend the last range or start a new one
+		stats.clustersVisible++;
+		stats.trianglesDrawn += triangles;
+		if (!visibleRanges.empty() && visibleRanges.back().startIndex + visibleRanges.back().indexCount == cluster.startIndex)
+			visibleRanges.back().indexCount += cluster.indexCount;
+		else
+			visibleRanges.push_back({ cluster.startIndex, cluster.indexCount });
+	}
+
+	return stats;
+}
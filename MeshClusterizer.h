@@ -0,0 +1,77 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A small, contiguous piece of a mesh's index buffer with
+// the bounds needed to cull it on its own (a "meshlet")
+// --------------------------------------------------------
+struct MeshCluster
+{
+	unsigned int startIndex;
+	unsigned int indexCount;
+	DirectX::XMFLOAT3 center;     // Bounding sphere, in mesh space
+	float radius;
+	DirectX::XMFLOAT3 coneAxis;   // Average facing direction of the cluster's triangles
+	float coneCutoff;             // Sine of the cone's half angle, 1 when the cluster can't be back face culled
+};
+
+// --------------------------------------------------------
+// A run of the index buffer to draw with one call
+// --------------------------------------------------------
+struct MeshIndexRange
+{
+	unsigned int startIndex;
+	unsigned int indexCount;
+};
+
+// --------------------------------------------------------
+// How many triangles a cull call kept and threw away
+// --------------------------------------------------------
+struct ClusterCullStats
+{
+	unsigned int clustersVisible;
+	unsigned int trianglesDrawn;
+	unsigned int trianglesFrustumCulled;   // Clusters entirely outside the view
+	unsigned int trianglesBackfaceCulled;  // Clusters facing entirely away from the camera
+};
+
+// --------------------------------------------------------
+// Splits index buffers into clusters of neighboring,
+// similarly facing triangles and culls them against a
+// camera on the CPU
+//
+// - Clusters are grown from a seed triangle, preferring
+//   triangles that add the fewest new vertices and face
+//   the same way as the cluster so far
+// - Each cluster stays a contiguous index range, so the
+//   visible ones can be drawn straight from the original
+//   index buffer, with neighbors merged into one draw
+// --------------------------------------------------------
+class MeshClusterizer
+{
+public:
+	// Cluster limits, sized to match common mesh shader meshlets
+	static const int MaxVertices = 64;
+	static const int MaxTriangles = 124;
+
+	// Reorders the triangles of an index buffer into clusters and fills in their bounds
+	// - Triangles keep their relative order inside each cluster, and clusters are sorted
+	//   by their earliest triangle, so earlier vertex cache and overdraw ordering mostly survives
+	static void BuildClusters(
+		const Vertex* verts, int numVerts,
+		unsigned int* indices, int numIndices,
+		int maxVertices, int maxTriangles,
+		std::vector<MeshCluster>& clusters);
+
+	// Finds which clusters can be seen with the given world and view-projection
+	// matrices and appends their index ranges (neighbors merged) to visibleRanges
+	static ClusterCullStats CullClusters(
+		const MeshCluster* clusters, int numClusters,
+		const DirectX::XMFLOAT4X4& world,
+		const DirectX::XMFLOAT4X4& viewProj,
+		DirectX::XMFLOAT3 cameraPosition,
+		std::vector<MeshIndexRange>& visibleRanges);
+};
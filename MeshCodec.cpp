@@ -0,0 +1,375 @@
+#include "MeshCodec.h"
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+
+// Bytes of data after a plane's header for each group mode (all zero, 2-bit, 4-bit, raw)
+static const int GroupBytes[4] = { 0, 4, 8, 16 };
+
+// Maps small negative and positive differences to small unsigned values (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...)
+static inline unsigned int Zigzag(unsigned int value) { return (value << 1) ^ (unsigned int)((int)value >> 31); }
+static inline unsigned int Unzigzag(unsigned int value) { return (value >> 1) ^ (0u - (value & 1)); }
+
+// ---------------------- INDICES ----------------------
+
+// Seven bits at a time, low bits first, with the top bit set on every byte but the last
+static void WriteVarint(unsigned long long value, std::vector<unsigned char>& out)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+// Codes are at most 33 bits, so anything past 5 bytes is malformed
+static const int MaxVarintBytes = 5;
+static inline const unsigned char* ReadVarint(const unsigned char* data, const unsigned char* end, unsigned long long& value)
+{
+	if (data < end && *data < 0x80)
+	{
+		value = *data;
+		return data + 1;
+	}
+
+	value = 0;
+	for (int shift = 0; shift < MaxVarintBytes * 7; shift += 7)
+	{
+		if (data == end)
+			return nullptr;
+
+		unsigned char byte = *data++;
+		value |= (unsigned long long)(byte & 0x7F) << shift;
+		if (byte < 0x80)
+			return data;
+	}
+	return nullptr;
+}
+
+// Same as ReadVarint for when there's room for at least MaxVarintBytes left
+static inline const unsigned char* ReadVarintUnchecked(const unsigned char* data, unsigned long long& value)
+{
+	if (*data < 0x80)
+	{
+		value = *data;
+		return data + 1;
+	}
+	return ReadVarint(data, data + MaxVarintBytes, value);
+}
+
+// A zero code means the next unused vertex, anything else is one more than the zigzagged difference from
+// the index before it in the triangle (or from the first index of the last triangle)
+void MeshCodec::EncodeIndices(const unsigned int* indices, int numIndices, std::vector<unsigned char>& out)
+{
+	unsigned int next = 0;
+	unsigned int lastFirst = 0;
+	unsigned int previous = 0;
+	for (int i = 0; i < numIndices; i++)
+	{
+		unsigned int index = indices[i];
+		int corner = i % 3;
+		unsigned int reference = corner == 0 ? lastFirst : previous;
+
+		unsigned long long code = index == next ? 0 : 1ULL + Zigzag(index - reference);
+		WriteVarint(code, out);
+
+		if (index >= next)
+			next = index + 1;
+		if (corner == 0)
+			lastFirst = index;
+		previous = index;
+	}
+}
+
+// Turns a code back into an index, moving the next unused vertex along past it
+static inline unsigned int DecodeIndex(unsigned long long code, unsigned int reference, unsigned int& next)
+{
+	unsigned int index = code == 0 ? next : reference + Unzigzag((unsigned int)(code - 1));
+	next = index >= next ? index + 1 : next;
+	return index;
+}
+
+// Mirrors EncodeIndices exactly, a whole triangle at a time
+bool MeshCodec::DecodeIndices(const unsigned char* data, size_t size, unsigned int* indices, int numIndices)
+{
+	const unsigned char* end = data + size;
+	unsigned int next = 0;
+	unsigned int lastFirst = 0;
+	unsigned long long a, b, c;
+
+	int i = 0;
+	for (; i + 3 <= numIndices; i += 3)
+	{
+		// Only check for the end of the data near the end
+		if (end - data >= MaxVarintBytes * 3)
+		{
+			if (!(data = ReadVarintUnchecked(data, a)) || !(data = ReadVarintUnchecked(data, b)) || !(data = ReadVarintUnchecked(data, c)))
+				return false;
+		}
+		else if (!(data = ReadVarint(data, end, a)) || !(data = ReadVarint(data, end, b)) || !(data = ReadVarint(data, end, c)))
+			return false;
+
+		indices[i] = DecodeIndex(a, lastFirst, next);
+		indices[i + 1] = DecodeIndex(b, indices[i], next);
+		indices[i + 2] = DecodeIndex(c, indices[i + 1], next);
+		lastFirst = indices[i];
+	}
+
+	// A partial triangle at the end
+	for (; i < numIndices; i++)
+	{
+		if (!(data = ReadVarint(data, end, a)))
+			return false;
+		indices[i] = DecodeIndex(a, i % 3 == 0 ? lastFirst : indices[i - 1], next);
+	}
+	return true;
+}
+
+// ---------------------- VERTICES ----------------------
+
+// Writes one byte plane of a block, a 2-bit mode per group of 16 bytes followed by every group's data
+// - 2-bit groups put values j, j + 4, j + 8 and j + 12 in byte j, and 4-bit groups put j and j + 8 in byte j,
+//   which is the order the SSE2 decoder unpacks them in
+static void EncodePlane(const unsigned char* plane, int groups, std::vector<unsigned char>& out)
+{
+	size_t header = out.size();
+	out.resize(out.size() + (groups + 3) / 4, 0);
+
+	for (int g = 0; g < groups; g++)
+	{
+		const unsigned char* values = plane + g * 16;
+		unsigned char largest = 0;
+		for (int i = 0; i < 16; i++)
+			largest = std::max(largest, values[i]);
+
+		int mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+		out[header + g / 4] |= (unsigned char)(mode << ((g % 4) * 2));
+
+		if (mode == 1)
+		{
+			for (int j = 0; j < 4; j++)
+				out.push_back((unsigned char)(values[j] | values[j + 4] << 2 | values[j + 8] << 4 | values[j + 12] << 6));
+		}
+		else if (mode == 2)
+		{
+			for (int j = 0; j < 8; j++)
+				out.push_back((unsigned char)(values[j] | values[j + 8] << 4));
+		}
+		else if (mode == 3)
+		{
+			out.insert(out.end(), values, values + 16);
+		}
+	}
+}
+
+// Splits every 32-bit channel of each block into four byte planes of zigzagged differences from the previous vertex
+// - The previous value carries over between blocks, and the end of the last block is padded with zeros
+void MeshCodec::EncodeVertices(const void* verts, int numVerts, int stride, std::vector<unsigned char>& out)
+{
+	const unsigned char* bytes = (const unsigned char*)verts;
+	int channels = stride / 4;
+	std::vector<unsigned int> previous(channels, 0);
+	unsigned int deltas[BlockVertices];
+	unsigned char plane[BlockVertices];
+
+	for (int start = 0; start < numVerts; start += BlockVertices)
+	{
+		int count = std::min(numVerts - start, (int)BlockVertices);
+		int groups = (count + 15) / 16;
+
+		for (int c = 0; c < channels; c++)
+		{
+			for (int i = 0; i < groups * 16; i++)
+			{
+				if (i >= count)
+				{
+					deltas[i] = 0;
+					continue;
+				}
+
+				unsigned int value;
+				memcpy(&value, bytes + (size_t)(start + i) * stride + c * 4, 4);
+				deltas[i] = Zigzag(value - previous[c]);
+				previous[c] = value;
+			}
+
+			for (int b = 0; b < 4; b++)
+			{
+				for (int i = 0; i < groups * 16; i++)
+					plane[i] = (unsigned char)(deltas[i] >> (b * 8));
+				EncodePlane(plane, groups, out);
+			}
+		}
+	}
+}
+
+// Unpacks one byte plane written by EncodePlane, returning where the next one starts (null if the data runs out)
+static const unsigned char* DecodePlane(const unsigned char* data, const unsigned char* end, int groups, unsigned char* plane)
+{
+	int headerBytes = (groups + 3) / 4;
+	if (end - data < headerBytes)
+		return nullptr;
+
+	// Check the whole plane fits up front so the groups don't have to
+	const unsigned char* header = data;
+	size_t planeBytes = 0;
+	for (int i = 0; i < headerBytes; i++)
+		planeBytes += GroupBytes[header[i] & 3] + GroupBytes[(header[i] >> 2) & 3] + GroupBytes[(header[i] >> 4) & 3] + GroupBytes[header[i] >> 6];
+	data += headerBytes;
+	if ((size_t)(end - data) < planeBytes)
+		return nullptr;
+
+	const __m128i mask2 = _mm_set1_epi8(0x03);
+	const __m128i mask4 = _mm_set1_epi8(0x0F);
+	for (int g = 0; g < groups; g++)
+	{
+		__m128i values;
+		switch ((header[g >> 2] >> ((g & 3) * 2)) & 3)
+		{
+		case 0:
+			values = _mm_setzero_si128();
+			break;
+
+		case 1:
+		{
+			int packed;
+			memcpy(&packed, data, 4);
+			__m128i bits = _mm_cvtsi32_si128(packed);
+			__m128i v0 = _mm_and_si128(bits, mask2);
+			__m128i v1 = _mm_and_si128(_mm_srli_epi16(bits, 2), mask2);
+			__m128i v2 = _mm_and_si128(_mm_srli_epi16(bits, 4), mask2);
+			__m128i v3 = _mm_and_si128(_mm_srli_epi16(bits, 6), mask2);
+			values = _mm_unpacklo_epi64(_mm_unpacklo_epi32(v0, v1), _mm_unpacklo_epi32(v2, v3));
+			data += 4;
+			break;
+		}
+
+		case 2:
+		{
+			__m128i bits = _mm_loadl_epi64((const __m128i*)data);
+			values = _mm_unpacklo_epi64(_mm_and_si128(bits, mask4), _mm_and_si128(_mm_srli_epi16(bits, 4), mask4));
+			data += 8;
+			break;
+		}
+
+		default:
+			values = _mm_loadu_si128((const __m128i*)data);
+			data += 16;
+			break;
+		}
+
+		_mm_store_si128((__m128i*)(plane + g * 16), values);
+	}
+
+	return data;
+}
+
+// Interleaves the four byte planes back into 32-bit differences, undoes the zigzag, then adds them up
+// four at a time onto the previous vertex's value
+// - Whole groups are written, the padding past the last vertex decodes to zero differences so that's harmless
+static void ReconstructChannel(unsigned char planes[4][MeshCodec::BlockVertices], int groups, unsigned int& previous, unsigned int* values)
+{
+	const __m128i one = _mm_set1_epi32(1);
+	__m128i last = _mm_set1_epi32((int)previous);
+
+	for (int i = 0; i < groups * 16; i += 16)
+	{
+		__m128i p0 = _mm_load_si128((const __m128i*)(planes[0] + i));
+		__m128i p1 = _mm_load_si128((const __m128i*)(planes[1] + i));
+		__m128i p2 = _mm_load_si128((const __m128i*)(planes[2] + i));
+		__m128i p3 = _mm_load_si128((const __m128i*)(planes[3] + i));
+		__m128i low01 = _mm_unpacklo_epi8(p0, p1);
+		__m128i high01 = _mm_unpackhi_epi8(p0, p1);
+		__m128i low23 = _mm_unpacklo_epi8(p2, p3);
+		__m128i high23 = _mm_unpackhi_epi8(p2, p3);
+		__m128i words[4] = {
+			_mm_unpacklo_epi16(low01, low23), _mm_unpackhi_epi16(low01, low23),
+			_mm_unpacklo_epi16(high01, high23), _mm_unpackhi_epi16(high01, high23) };
+
+		for (int w = 0; w < 4; w++)
+		{
+			__m128i deltas = _mm_xor_si128(_mm_srli_epi32(words[w], 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(words[w], one)));
+			deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+			deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+			last = _mm_add_epi32(deltas, last);
+
+			_mm_store_si128((__m128i*)(values + i + w * 4), last);
+			last = _mm_shuffle_epi32(last, _MM_SHUFFLE(3, 3, 3, 3));
+		}
+	}
+
+	previous = (unsigned int)_mm_cvtsi128_si32(last);
+}
+
+// Writes a block of decoded channels (one row of BlockVertices values per channel) into interleaved vertices
+// - Four channels of four vertices are transposed at a time so every store is a whole 16 bytes, with the last
+//   set of channels moved back to overlap the one before it when the channel count isn't a multiple of 4
+static void InterleaveChannels(const unsigned int* values, int channels, int count, unsigned char* out, int stride)
+{
+	int i = 0;
+	if (channels >= 4)
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			for (int c = 0; c < channels; c += 4)
+			{
+				int first = std::min(c, channels - 4);
+				__m128i c0 = _mm_load_si128((const __m128i*)(values + (first + 0) * MeshCodec::BlockVertices + i));
+				__m128i c1 = _mm_load_si128((const __m128i*)(values + (first + 1) * MeshCodec::BlockVertices + i));
+				__m128i c2 = _mm_load_si128((const __m128i*)(values + (first + 2) * MeshCodec::BlockVertices + i));
+				__m128i c3 = _mm_load_si128((const __m128i*)(values + (first + 3) * MeshCodec::BlockVertices + i));
+				__m128i t0 = _mm_unpacklo_epi32(c0, c1);
+				__m128i t1 = _mm_unpacklo_epi32(c2, c3);
+				__m128i t2 = _mm_unpackhi_epi32(c0, c1);
+				__m128i t3 = _mm_unpackhi_epi32(c2, c3);
+
+				unsigned char* vertex = out + (size_t)i * stride + first * 4;
+				_mm_storeu_si128((__m128i*)(vertex), _mm_unpacklo_epi64(t0, t1));
+				_mm_storeu_si128((__m128i*)(vertex + stride), _mm_unpackhi_epi64(t0, t1));
+				_mm_storeu_si128((__m128i*)(vertex + stride * 2), _mm_unpacklo_epi64(t2, t3));
+				_mm_storeu_si128((__m128i*)(vertex + stride * 3), _mm_unpackhi_epi64(t2, t3));
+			}
+		}
+	}
+
+	// Leftover vertices (and layouts with fewer than 4 channels) go one value at a time
+	for (; i < count; i++)
+		for (int c = 0; c < channels; c++)
+			memcpy(out + (size_t)i * stride + c * 4, values + c * MeshCodec::BlockVertices + i, 4);
+}
+
+// Mirrors EncodeVertices, decoding a block's channels side by side before interleaving them into the output
+bool MeshCodec::DecodeVertices(const unsigned char* data, size_t size, void* verts, int numVerts, int stride)
+{
+	const unsigned char* end = data + size;
+	unsigned char* bytes = (unsigned char*)verts;
+	int channels = stride / 4;
+	std::vector<unsigned int> previous(channels, 0);
+	alignas(16) unsigned char planes[4][BlockVertices];
+
+	// Over-allocated so the channel rows can be 16 byte aligned
+	std::vector<unsigned int> storage((size_t)channels * BlockVertices + 4);
+	unsigned int* values = (unsigned int*)(((size_t)storage.data() + 15) & ~(size_t)15);
+
+	for (int start = 0; start < numVerts; start += BlockVertices)
+	{
+		int count = std::min(numVerts - start, (int)BlockVertices);
+		int groups = (count + 15) / 16;
+
+		for (int c = 0; c < channels; c++)
+		{
+			for (int b = 0; b < 4; b++)
+			{
+				data = DecodePlane(data, end, groups, planes[b]);
+				if (!data)
+					return false;
+			}
+
+			ReconstructChannel(planes, groups, previous[c], values + c * BlockVertices);
+		}
+
+		InterleaveChannels(values, channels, count, bytes + (size_t)start * stride, stride);
+	}
+	return true;
+}
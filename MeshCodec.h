@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// Lossless compression for index and vertex buffers, used
+// by MeshCache for its on-disk data
+//
+// - Indices are coded per triangle: a vertex that's never
+//   been used before (the next one, after vertex fetch
+//   optimization) costs a single zero, anything else is the
+//   zigzagged difference from the index before it in the
+//   triangle (or the last triangle's first index), all
+//   written as varints
+// - Vertices are split into 32-bit channels, and each
+//   channel stores the zigzagged difference from the
+//   previous vertex one byte plane at a time, so the mostly
+//   empty high bytes end up together. Every 16 bytes of a
+//   plane are stored with 0, 2, 4 or 8 bits each
+// - Vertices are coded in blocks small enough to stay in
+//   cache, and decoding the planes back into vertices is
+//   done with SSE2 sixteen vertices at a time
+// --------------------------------------------------------
+class MeshCodec
+{
+public:
+	// Vertices per independently decoded block
+	static const int BlockVertices = 256;
+
+	// Appends the encoded indices to out
+	static void EncodeIndices(const unsigned int* indices, int numIndices, std::vector<unsigned char>& out);
+
+	// Decodes exactly numIndices indices, false if the data runs out first or is malformed
+	static bool DecodeIndices(const unsigned char* data, size_t size, unsigned int* indices, int numIndices);
+
+	// Appends the encoded vertices to out, any vertex layout works as long as the stride is a multiple of 4 bytes
+	static void EncodeVertices(const void* verts, int numVerts, int stride, std::vector<unsigned char>& out);
+
+	// Decodes exactly numVerts vertices of the given stride, false if the data runs out first
+	static bool DecodeVertices(const unsigned char* data, size_t size, void* verts, int numVerts, int stride);
+};
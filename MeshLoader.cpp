@@ -0,0 +1,263 @@
+#include "MeshLoader.h"
+#include <algorithm>
+#include <fstream>
+
+// Starts the worker threads, which sleep until there's something to load
+MeshLoader::MeshLoader(Microsoft::WRL::ComPtr<ID3D11Device> device, ObjectPool<Mesh>& meshPool, Mesh* placeholder, GeometryPool* pool, int threadCount)
+	: device(device), meshPool(meshPool), placeholder(placeholder), pool(pool)
+{
+	device->GetImmediateContext(context.GetAddressOf());
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+	// Every worker can be parsing at once, so each gets its share of the cores rather than all of them
+	threadsPerJob = std::max(1, (int)std::thread::hardware_concurrency() / threadCount);
+
+	for (int i = 0; i < threadCount; i++)
+		workers.emplace_back(&MeshLoader::WorkerLoop, this);
+}
+
+// Stops the workers once they finish what they're on, anything not uploaded yet is dropped
+MeshLoader::~MeshLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	for (size_t i = 0; i < queued.size(); i++)
+		delete queued[i];
+	for (size_t i = 0; i < finished.size(); i++)
+		delete finished[i];
+}
+
+// The mesh starts out as a copy of the placeholder (sharing its buffers), so it can be drawn immediately
+Mesh* MeshLoader::Load(const char* path, unsigned int processFlags)
+{
+	LoadJob* job = new LoadJob();
+	job->mesh = meshPool.Create(*placeholder);
+	job->path = path;
+	job->processFlags = processFlags;
+	job->loaded = false;
+	job->requestTime = std::chrono::high_resolution_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(job);
+		pending++;
+	}
+	wake.notify_one();
+	return job->mesh;
+}
+
+// Same as Load, except the worker hands the job back every time it decodes more
+Mesh* MeshLoader::Stream(const char* path)
+{
+	LoadJob* job = new LoadJob();
+	job->mesh = meshPool.Create(*placeholder);
+	job->path = path;
+	job->processFlags = MESH_PROCESS_NONE;
+	job->loaded = false;
+	job->requestTime = std::chrono::high_resolution_clock::now();
+	job->streamed = true;
+	job->done = false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(job);
+		pending++;
+	}
+	wake.notify_one();
+	return job->mesh;
+}
+
+// Swapping the data in between frames means a mesh is never drawn half uploaded
+int MeshLoader::Update()
+{
+	std::vector<LoadJob*> ready;
+	std::vector<bool> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (finished.empty())
+			return 0;
+		ready.swap(finished);
+
+		// Streamed jobs can be handed back again while they're uploaded below, only done ones are finished with
+		for (size_t i = 0; i < ready.size(); i++)
+		{
+			ready[i]->listed = false;
+			done.push_back(ready[i]->done);
+		}
+	}
+
+	// Buffers are created outside the lock so the workers can keep going
+	int completed = 0;
+	for (size_t i = 0; i < ready.size(); i++)
+	{
+		LoadJob* job = ready[i];
+		if (job->streamed)
+		{
+			std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - job->requestTime;
+			{
+				std::lock_guard<std::mutex> streamLock(job->streamMutex);
+				ProgressiveMeshStream& stream = job->stream;
+				if (job->begun)
+				{
+					job->mesh->Refine(stream, context);
+				}
+				else if (stream.HasBase())
+				{
+					job->mesh->BeginStream(stream, device, pool);
+					job->begun = true;
+					printf("  streaming %s: first %d of %u tris drawn %.2f ms after it was requested (%.1f%% of the file)\n", job->path.c_str(),
+						stream.GetResidentTriangleCount(), stream.GetHeader().indexCount / 3, elapsed.count() * 1000.0,
+						100.0 * stream.GetBytesReceived() / stream.GetHeader().totalBytes);
+				}
+			}
+			if (!done[i])
+				continue;
+
+			if (job->loaded)
+				printf("  streamed %s (%.2f ms after it was requested)\n", job->path.c_str(), elapsed.count() * 1000.0);
+			else if (job->begun)
+				printf("  stopped streaming %s early, keeping what's resident\n", job->path.c_str());
+			else
+				printf("  failed to stream %s, keeping the placeholder\n", job->path.c_str());
+			delete job;
+			completed++;
+			continue;
+		}
+
+		if (job->loaded)
+			job->mesh->Upload(job->data, device, pool);
+
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - job->requestTime;
+		if (job->loaded)
+			printf("  uploaded %s (%.2f ms after it was requested)\n", job->path.c_str(), elapsed.count() * 1000.0);
+		else
+			printf("  failed to load %s, keeping the placeholder\n", job->path.c_str());
+		delete job;
+		completed++;
+	}
+
+	int remaining;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending -= completed;
+		remaining = pending;
+	}
+	if (remaining == 0)
+		printf("---> All queued meshes loaded\n");
+
+	return (int)ready.size();
+}
+
+int MeshLoader::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending;
+}
+
+// Takes jobs off the queue until the loader is destroyed
+void MeshLoader::WorkerLoop()
+{
+	while (true)
+	{
+		LoadJob* job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !queued.empty(); });
+			if (stopping)
+				return;
+
+			job = queued.front();
+			queued.pop_front();
+		}
+
+		if (job->streamed)
+		{
+			StreamFile(job);
+			continue;
+		}
+
+		// Only the job's own data is touched here, the mesh itself is left for Update
+		job->loaded = Mesh::LoadData(job->path.c_str(), job->processFlags, job->data, threadsPerJob);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.push_back(job);
+	}
+}
+
+// Decodes the file a block at a time, handing the job to Update after each one
+// - Gives up between blocks when the loader is being destroyed
+void MeshLoader::StreamFile(LoadJob* job)
+{
+	std::ifstream file(job->path, std::ios::binary);
+	bool ok = file.is_open();
+	std::vector<char> block(StreamBlockBytes);
+	while (ok)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping)
+				break;
+		}
+
+		file.read(block.data(), block.size());
+		std::streamsize read = file.gcount();
+		if (read <= 0)
+			break;
+
+		{
+			std::lock_guard<std::mutex> streamLock(job->streamMutex);
+			ok = job->stream.Append(block.data(), (size_t)read);
+		}
+		Publish(job, false);
+	}
+
+	// Only this thread changes the stream, so it can be read without the lock
+	job->loaded = ok && job->stream.IsComplete();
+	Publish(job, true);
+}
+
+// Puts the job on the finished list unless it's already waiting there
+// - Once it's published as done the worker never touches it again
+void MeshLoader::Publish(LoadJob* job, bool done)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (done)
+		job->done = true;
+	if (!job->listed)
+	{
+		job->listed = true;
+		finished.push_back(job);
+	}
+}
+
+// Every vertex sits on an axis, normals point straight out and uvs are projected along Z
+// - Tangents are filled in by the Mesh constructor
+Mesh* MeshLoader::CreatePlaceholder(Microsoft::WRL::ComPtr<ID3D11Device> device, ObjectPool<Mesh>& meshPool, GeometryPool* pool)
+{
+	const float r = 0.5f;
+	Vertex verts[6] = {};
+	DirectX::XMFLOAT3 positions[6] = {
+		DirectX::XMFLOAT3(r, 0, 0), DirectX::XMFLOAT3(-r, 0, 0),
+		DirectX::XMFLOAT3(0, r, 0), DirectX::XMFLOAT3(0, -r, 0),
+		DirectX::XMFLOAT3(0, 0, r), DirectX::XMFLOAT3(0, 0, -r) };
+	for (int i = 0; i < 6; i++)
+	{
+		verts[i].position = positions[i];
+		verts[i].normal = DirectX::XMFLOAT3(positions[i].x / r, positions[i].y / r, positions[i].z / r);
+		verts[i].uv = DirectX::XMFLOAT2(0.5f + positions[i].x, 0.5f - positions[i].y);
+	}
+
+	// Clockwise when seen from outside
+	unsigned int indices[24] = {
+		0, 2, 4,  0, 5, 2,  0, 4, 3,  0, 3, 5,
+		1, 4, 2,  1, 2, 5,  1, 3, 4,  1, 5, 3 };
+
+	return meshPool.Create(verts, 6, indices, 24, device, pool);
+}
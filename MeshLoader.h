@@ -0,0 +1,100 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mesh.h"
+#include "ObjectPool.h"
+#include "ProgressiveMesh.h"
+
+// --------------------------------------------------------
+// Loads meshes in the background
+//
+// - Load hands back the mesh right away, drawing exactly
+//   like the placeholder until its real data is uploaded
+// - Worker threads do everything that doesn't need the
+//   device (cache, parsing, processing, tangents), then
+//   Update creates the buffers on the device's thread
+// - Meshes are created in the given mesh pool and destroyed
+//   through it. The loader never owns the meshes it hands
+//   out, but they have to outlive it (or the loads have to
+//   have finished), and the mesh pool has to outlive it
+// - With a geometry pool every mesh is uploaded into it,
+//   so the pool has to outlive the meshes too
+// - Streamed meshes (progressive mesh files) are read a
+//   block at a time and decoded on the workers, and Update
+//   uploads each one as soon as its base mesh is in, then
+//   refines it in place as the rest arrives
+// --------------------------------------------------------
+class MeshLoader
+{
+public:
+	// A thread count of 0 picks one automatically, leaving a core for the main thread
+	MeshLoader(Microsoft::WRL::ComPtr<ID3D11Device> device, ObjectPool<Mesh>& meshPool, Mesh* placeholder, GeometryPool* pool = nullptr, int threadCount = 0);
+	~MeshLoader();
+
+	// Bytes read from a streamed file at a time, so slow shares still refine the mesh often
+	static const int StreamBlockBytes = 64 * 1024;
+
+	// Queues a mesh .obj file and returns its mesh, which is the placeholder until Update uploads it
+	Mesh* Load(const char* path, unsigned int processFlags = MESH_PROCESS_DEFAULT);
+
+	// Queues a progressive mesh file (see ProgressiveMesh::Write), its mesh is the placeholder until the base mesh is in
+	// - A worker stays on the file until it's all read, so keep a thread free for regular loads
+	Mesh* Stream(const char* path);
+
+	// Uploads every mesh finished (or streamed further) since the last call, call once a frame from the device's thread
+	// - Returns how many meshes were uploaded or refined
+	int Update();
+
+	// Number of meshes queued, loading, or waiting for Update
+	int GetPendingCount();
+
+	// Small octahedron to stand in for meshes that are still loading, created in the mesh pool
+	static Mesh* CreatePlaceholder(Microsoft::WRL::ComPtr<ID3D11Device> device, ObjectPool<Mesh>& meshPool, GeometryPool* pool = nullptr);
+
+private:
+	struct LoadJob
+	{
+		Mesh* mesh;
+		std::string path;
+		unsigned int processFlags;
+		MeshData data;
+		bool loaded;
+		std::chrono::high_resolution_clock::time_point requestTime;
+
+		// Streamed jobs go back on the finished list after every block, and are only done once the file is read
+		bool streamed = false;
+		bool listed = false;
+		bool done = true;
+		bool begun = false;                 // The mesh has had BeginStream
+		std::mutex streamMutex;             // Held while the stream is decoded into or uploaded from
+		ProgressiveMeshStream stream;
+	};
+
+	void WorkerLoop();
+	void StreamFile(LoadJob* job);
+	void Publish(LoadJob* job, bool done);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	ObjectPool<Mesh>& meshPool;             // Only touched from the device's thread, never by the workers
+	Mesh* placeholder;
+	GeometryPool* pool;
+	std::vector<std::thread> workers;
+	int threadsPerJob;                      // Most threads a single load may parse on
+
+	// Everything below the mutex is shared with the workers
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<LoadJob*> queued;
+	std::vector<LoadJob*> finished;
+	int pending = 0;
+	bool stopping = false;
+};
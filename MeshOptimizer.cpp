@@ -0,0 +1,598 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+// --------------------------------- Forsyth scoring
+// Constants from "Linear-Speed Vertex Cache Optimisation" (Tom Forsyth, 2006)
+// - The scoring cache is a little bigger than the hardware one we're
+//   targeting, which gives the algorithm some room to look ahead
+static const int ScoringCacheSize = 32;
+static const float CacheDecayPower = 1.5f;
+static const float LastTriangleScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+// Per vertex bookkeeping for the optimizer
+struct OptimizerVertex
+{
+	int cachePosition = -1;      // Position in the simulated LRU cache, -1 if it isn't in it
+	int remainingTriangles = 0;  // Triangles using this vertex that haven't been output yet
+	int firstTriangle = 0;       // Start of this vertex's triangles in the adjacency list
+	float score = 0.0f;
+};
+
+// Highest valence with its own entry in the score table, anything above shares the last entry
+static const int MaxScoredValence = 32;
+
+// Precomputed score pieces, since powf in the inner loop dominates the run time otherwise
+struct ScoreTables
+{
+	float cache[ScoringCacheSize];
+	float valence[MaxScoredValence + 1];
+
+	ScoreTables()
+	{
+		for (int i = 0; i < ScoringCacheSize; i++)
+		{
+			if (i < 3)
+			{
+				// Used by the last triangle, so we deliberately give it a fixed
+				// lower score, since it's better to move on a little than to
+				// bounce back and forth around the same few vertices
+				cache[i] = LastTriangleScore;
+			}
+			else
+			{
+				// Points for being high in the cache, falling off with age
+				float scaler = 1.0f / (ScoringCacheSize - 3);
+				cache[i] = powf(1.0f - (i - 3) * scaler, CacheDecayPower);
+			}
+		}
+
+		// Bonus points for having few triangles left, so lone vertices get finished off
+		valence[0] = 0.0f;
+		for (int i = 1; i <= MaxScoredValence; i++)
+			valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+	}
+};
+
+// Score of a vertex given its cache position and how many triangles still need it
+static float ScoreVertex(const OptimizerVertex& v, const ScoreTables& tables)
+{
+	// Nothing left to draw with this vertex
+	if (v.remainingTriangles == 0)
+		return -1.0f;
+
+	float score = v.cachePosition >= 0 ? tables.cache[v.cachePosition] : 0.0f;
+	score += tables.valence[v.remainingTriangles < MaxScoredValence ? v.remainingTriangles : MaxScoredValence];
+	return score;
+}
+
+// Reorders triangles for the post-transform vertex cache
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, int numIndices, int numVerts)
+{
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0 || numVerts == 0)
+		return;
+
+	// Count how many triangles each vertex is in, then build a flat adjacency list from that
+	std::vector<OptimizerVertex> verts(numVerts);
+	for (int i = 0; i < numTriangles * 3; i++)
+		verts[indices[i]].remainingTriangles++;
+
+	int offset = 0;
+	for (int v = 0; v < numVerts; v++)
+	{
+		verts[v].firstTriangle = offset;
+		offset += verts[v].remainingTriangles;
+	}
+
+	std::vector<int> adjacency(offset);
+	std::vector<int> fill(numVerts, 0);
+	for (int t = 0; t < numTriangles; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			adjacency[verts[v].firstTriangle + fill[v]++] = t;
+		}
+	}
+
+	// Initial scores for every vertex (triangles are only ever scored from the cache, below)
+	ScoreTables tables;
+	for (int v = 0; v < numVerts; v++)
+		verts[v].score = ScoreVertex(verts[v], tables);
+
+	std::vector<bool> triangleAdded(numTriangles, false);
+
+	// Simulated LRU cache (with room for the three vertices being pushed on top)
+	int cache[ScoringCacheSize + 3];
+	int cacheCount = 0;
+
+	std::vector<unsigned int> output(numTriangles * 3);
+	int bestTriangle = -1;
+	int nextUnaddedScan = 0;
+
+	for (int outputCount = 0; outputCount < numTriangles; outputCount++)
+	{
+		// Nothing in the cache has triangles left, so restart from the first triangle that hasn't been output
+		// - Scanning on from where the last scan stopped keeps this linear overall
+		if (bestTriangle < 0)
+		{
+			while (triangleAdded[nextUnaddedScan])
+				nextUnaddedScan++;
+			bestTriangle = nextUnaddedScan;
+		}
+
+		// Output the chosen triangle
+		triangleAdded[bestTriangle] = true;
+		unsigned int* triangle = &indices[bestTriangle * 3];
+		for (int c = 0; c < 3; c++)
+		{
+			output[outputCount * 3 + c] = triangle[c];
+
+			// This vertex has one less triangle to worry about
+			OptimizerVertex& v = verts[triangle[c]];
+			int* list = &adjacency[v.firstTriangle];
+			for (int i = 0; i < v.remainingTriangles; i++)
+			{
+				if (list[i] == bestTriangle)
+				{
+					list[i] = list[v.remainingTriangles - 1];
+					break;
+				}
+			}
+			v.remainingTriangles--;
+		}
+
+		// Push the triangle's vertices onto the front of the cache, removing any older copies
+		int newCache[ScoringCacheSize + 3];
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+			newCache[newCount++] = triangle[c];
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			if (v != (int)triangle[0] && v != (int)triangle[1] && v != (int)triangle[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that was in the cache, and anything that just fell out of it
+		for (int i = 0; i < newCount; i++)
+		{
+			OptimizerVertex& v = verts[newCache[i]];
+			v.cachePosition = i < ScoringCacheSize ? i : -1;
+			v.score = ScoreVertex(v, tables);
+		}
+
+		// Rescore the triangles touching the cache and pick the best one for next time
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount; i++)
+		{
+			const OptimizerVertex& v = verts[newCache[i]];
+			for (int a = 0; a < v.remainingTriangles; a++)
+			{
+				int t = adjacency[v.firstTriangle + a];
+				float score = verts[indices[t * 3]].score + verts[indices[t * 3 + 1]].score + verts[indices[t * 3 + 2]].score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		// Keep only what fits in the cache
+		cacheCount = newCount < ScoringCacheSize ? newCount : ScoringCacheSize;
+		for (int i = 0; i < cacheCount; i++)
+			cache[i] = newCache[i];
+	}
+
+	// Copy the new order back over the original indices
+	for (int i = 0; i < numTriangles * 3; i++)
+		indices[i] = output[i];
+}
+
+// Runs an index buffer through a FIFO or LRU cache of the given size
+VertexCacheStats MeshOptimizer::SimulateVertexCache(const unsigned int* indices, int numIndices, int numVerts, int cacheSize, bool lru)
+{
+	VertexCacheStats stats = {};
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0 || cacheSize <= 0)
+		return stats;
+
+	// Both policies are tracked with a timestamp per vertex
+	// - FIFO: stamped when the vertex enters the cache, so it's a hit while
+	//   fewer than cacheSize misses have happened since then
+	// - LRU: stamped on every use, and the cache is kept as an explicit list
+	std::vector<int> stamp(numVerts, -cacheSize - 1);
+	std::vector<bool> referenced(numVerts, false);
+	std::vector<int> lruCache;
+	int misses = 0;
+	int uniqueVerts = 0;
+
+	for (int i = 0; i < numTriangles * 3; i++)
+	{
+		unsigned int v = indices[i];
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			uniqueVerts++;
+		}
+
+		if (lru)
+		{
+			// Move (or insert) the vertex at the front, dropping whatever falls off the end
+			bool hit = false;
+			for (size_t c = 0; c < lruCache.size(); c++)
+			{
+				if (lruCache[c] == (int)v)
+				{
+					lruCache.erase(lruCache.begin() + c);
+					hit = true;
+					break;
+				}
+			}
+			lruCache.insert(lruCache.begin(), (int)v);
+			if ((int)lruCache.size() > cacheSize)
+				lruCache.pop_back();
+			if (!hit)
+				misses++;
+		}
+		else if (misses - stamp[v] > cacheSize)
+		{
+			stamp[v] = misses;
+			misses++;
+		}
+	}
+
+	stats.acmr = misses / (float)numTriangles;
+	stats.atvr = uniqueVerts > 0 ? misses / (float)uniqueVerts : 0.0f;
+	return stats;
+}
+
+// --------------------------------- Overdraw
+// One run of triangles that gets moved around as a unit when sorting for overdraw
+struct OverdrawCluster
+{
+	int firstTriangle;
+	int triangleCount;
+	float sortKey;
+};
+
+// Counts FIFO cache misses for a run of triangles, starting from an empty cache
+static int CountCacheMisses(const unsigned int* indices, int firstTriangle, int triangleCount, std::vector<int>& stamp, int& clock)
+{
+	// The stamps are shared between calls, so each run starts far enough ahead to see an empty cache
+	clock += MeshOptimizer::DefaultCacheSize + 1;
+	int misses = 0;
+	for (int i = firstTriangle * 3; i < (firstTriangle + triangleCount) * 3; i++)
+	{
+		if (clock - stamp[indices[i]] > MeshOptimizer::DefaultCacheSize)
+		{
+			stamp[indices[i]] = clock++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+// Splits a cache optimized index buffer into clusters and sorts them so outward facing ones draw first
+// - Based on "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007)
+void MeshOptimizer::OptimizeOverdraw(unsigned int* indices, int numIndices, const Vertex* verts, int numVerts, float threshold)
+{
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+		return;
+
+	std::vector<int> stamp(numVerts, -DefaultCacheSize - 1);
+	int clock = 0;
+
+	// Hard boundaries sit wherever the cache simulation misses on all three vertices,
+	// since reordering across those points can't cost any cache efficiency
+	std::vector<int> hardBoundaries;
+	for (int t = 0; t < numTriangles; t++)
+	{
+		int misses = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			if (clock - stamp[v] > DefaultCacheSize)
+			{
+				stamp[v] = clock++;
+				misses++;
+			}
+		}
+
+		if (misses == 3)
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(numTriangles);
+
+	// Soft boundaries split each hard cluster further, wherever the miss ratio
+	// of the piece so far is already close enough to the whole cluster's
+	std::vector<OverdrawCluster> clusters;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+	{
+		int start = hardBoundaries[h];
+		int end = hardBoundaries[h + 1];
+		float clusterAcmr = CountCacheMisses(indices, start, end - start, stamp, clock) / (float)(end - start);
+
+		int pieceStart = start;
+		int pieceMisses = 0;
+		clock += DefaultCacheSize + 1;
+		for (int t = start; t < end; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				if (clock - stamp[v] > DefaultCacheSize)
+				{
+					stamp[v] = clock++;
+					pieceMisses++;
+				}
+			}
+
+			// Close the piece once it's cache friendly enough (or at the very end)
+			int pieceTriangles = t - pieceStart + 1;
+			if (t + 1 == end || pieceMisses / (float)pieceTriangles <= clusterAcmr * threshold)
+			{
+				OverdrawCluster cluster = { pieceStart, pieceTriangles, 0.0f };
+				clusters.push_back(cluster);
+				pieceStart = t + 1;
+				pieceMisses = 0;
+				clock += DefaultCacheSize + 1;
+			}
+		}
+	}
+
+	// Area weighted centroid of the whole mesh
+	DirectX::XMVECTOR meshCentroid = DirectX::XMVectorZero();
+	float meshArea = 0.0f;
+	for (int t = 0; t < numTriangles; t++)
+	{
+		DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&verts[indices[t * 3]].position);
+		DirectX::XMVECTOR b = DirectX::XMLoadFloat3(&verts[indices[t * 3 + 1]].position);
+		DirectX::XMVECTOR c = DirectX::XMLoadFloat3(&verts[indices[t * 3 + 2]].position);
+		float area = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3Cross(DirectX::XMVectorSubtract(b, a), DirectX::XMVectorSubtract(c, a))));
+		meshCentroid = DirectX::XMVectorAdd(meshCentroid, DirectX::XMVectorScale(DirectX::XMVectorAdd(DirectX::XMVectorAdd(a, b), c), area / 3.0f));
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+		meshCentroid = DirectX::XMVectorScale(meshCentroid, 1.0f / meshArea);
+
+	// Clusters that face away from the middle of the mesh are the most likely to occlude others
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		DirectX::XMVECTOR centroid = DirectX::XMVectorZero();
+		DirectX::XMVECTOR normal = DirectX::XMVectorZero();
+		float area = 0.0f;
+		for (int t = clusters[i].firstTriangle; t < clusters[i].firstTriangle + clusters[i].triangleCount; t++)
+		{
+			DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&verts[indices[t * 3]].position);
+			DirectX::XMVECTOR b = DirectX::XMLoadFloat3(&verts[indices[t * 3 + 1]].position);
+			DirectX::XMVECTOR c = DirectX::XMLoadFloat3(&verts[indices[t * 3 + 2]].position);
+			DirectX::XMVECTOR cross = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(b, a), DirectX::XMVectorSubtract(c, a));
+			float triangleArea = DirectX::XMVectorGetX(DirectX::XMVector3Length(cross));
+			centroid = DirectX::XMVectorAdd(centroid, DirectX::XMVectorScale(DirectX::XMVectorAdd(DirectX::XMVectorAdd(a, b), c), triangleArea / 3.0f));
+			normal = DirectX::XMVectorAdd(normal, cross);
+			area += triangleArea;
+		}
+
+		if (area > 0.0f)
+			centroid = DirectX::XMVectorScale(centroid, 1.0f / area);
+		DirectX::XMVECTOR outward = DirectX::XMVectorSubtract(centroid, meshCentroid);
+		clusters[i].sortKey = DirectX::XMVectorGetX(DirectX::XMVector3Dot(outward, DirectX::XMVector3Normalize(normal)));
+	}
+
+	// Most outward facing first, keeping the original order for ties
+	std::stable_sort(clusters.begin(), clusters.end(), [](const OverdrawCluster& a, const OverdrawCluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned int> output;
+	output.reserve(numTriangles * 3);
+	for (size_t i = 0; i < clusters.size(); i++)
+		output.insert(output.end(), indices + clusters[i].firstTriangle * 3, indices + (clusters[i].firstTriangle + clusters[i].triangleCount) * 3);
+
+	for (int i = 0; i < numTriangles * 3; i++)
+		indices[i] = output[i];
+}
+
+// Small helpers for the rasterizer's bounding boxes
+static float Min3(float a, float b, float c) { return a < b ? (a < c ? a : c) : (b < c ? b : c); }
+static float Max3(float a, float b, float c) { return a > b ? (a > c ? a : c) : (b > c ? b : c); }
+static int ClampPixel(float value, int resolution) { return value < 0.0f ? 0 : (value > resolution - 1 ? resolution - 1 : (int)value); }
+
+// Top-left fill rule, so a pixel center exactly on an edge shared by two triangles is only drawn by one of them
+// - Edges run clockwise with the inside on their right (y up), so these are the edges going up and flat ones going right
+static bool IsTopLeftEdge(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to)
+{
+	float dy = to.y - from.y;
+	return dy > 0.0f || (dy == 0.0f && to.x > from.x);
+}
+
+// Which side of the edge a point is on, positive on the inside
+// - Always worked out from the same end, so both triangles sharing an edge get exactly opposite values
+static float EdgeFunction(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to, float px, float py)
+{
+	if (IsTopLeftEdge(from, to))
+		return (to.y - from.y) * (px - from.x) - (to.x - from.x) * (py - from.y);
+	return -((from.y - to.y) * (px - to.x) - (from.x - to.x) * (py - to.y));
+}
+
+// Rasterizes the mesh from several viewpoints and counts how many pixels are shaded more than once
+OverdrawStats MeshOptimizer::EstimateOverdraw(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	const int resolution = 256;
+	OverdrawStats stats = {};
+	if (numVerts == 0 || numIndices < 3)
+		return stats;
+
+	// Fit the views to the mesh's bounding sphere
+	DirectX::XMVECTOR lowest = DirectX::XMLoadFloat3(&verts[0].position);
+	DirectX::XMVECTOR highest = lowest;
+	for (int i = 1; i < numVerts; i++)
+	{
+		DirectX::XMVECTOR pos = DirectX::XMLoadFloat3(&verts[i].position);
+		lowest = DirectX::XMVectorMin(lowest, pos);
+		highest = DirectX::XMVectorMax(highest, pos);
+	}
+	DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(lowest, highest), 0.5f);
+	float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(highest, center)));
+	if (radius <= 0.0f)
+		return stats;
+
+	// Six axis aligned views plus the eight corner diagonals
+	DirectX::XMFLOAT3 directions[] =
+	{
+		DirectX::XMFLOAT3(1, 0, 0), DirectX::XMFLOAT3(-1, 0, 0),
+		DirectX::XMFLOAT3(0, 1, 0), DirectX::XMFLOAT3(0, -1, 0),
+		DirectX::XMFLOAT3(0, 0, 1), DirectX::XMFLOAT3(0, 0, -1),
+		DirectX::XMFLOAT3(1, 1, 1), DirectX::XMFLOAT3(-1, 1, 1),
+		DirectX::XMFLOAT3(1, -1, 1), DirectX::XMFLOAT3(-1, -1, 1),
+		DirectX::XMFLOAT3(1, 1, -1), DirectX::XMFLOAT3(-1, 1, -1),
+		DirectX::XMFLOAT3(1, -1, -1), DirectX::XMFLOAT3(-1, -1, -1),
+	};
+
+	std::vector<float> depth(resolution * resolution);
+	std::vector<DirectX::XMFLOAT3> projected(numVerts);
+	for (const DirectX::XMFLOAT3& direction : directions)
+	{
+		// Left handed camera basis looking along the direction (right = up x forward)
+		DirectX::XMVECTOR forward = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&direction));
+		DirectX::XMVECTOR up = fabsf(direction.y) > 0.99f && direction.x == 0 && direction.z == 0 ? DirectX::XMVectorSet(0, 0, 1, 0) : DirectX::XMVectorSet(0, 1, 0, 0);
+		DirectX::XMVECTOR right = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(up, forward));
+		up = DirectX::XMVector3Cross(forward, right);
+
+		// Project every vertex into pixel space once per view
+		float scale = resolution / (2.0f * radius);
+		for (int i = 0; i < numVerts; i++)
+		{
+			DirectX::XMVECTOR local = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&verts[i].position), center);
+			projected[i].x = (DirectX::XMVectorGetX(DirectX::XMVector3Dot(local, right)) + radius) * scale;
+			projected[i].y = (DirectX::XMVectorGetX(DirectX::XMVector3Dot(local, up)) + radius) * scale;
+			projected[i].z = DirectX::XMVectorGetX(DirectX::XMVector3Dot(local, forward));
+		}
+
+		for (size_t i = 0; i < depth.size(); i++)
+			depth[i] = FLT_MAX;
+
+		// Draw triangles in index buffer order, exactly like the GPU would
+		for (int t = 0; t + 2 < numIndices; t += 3)
+		{
+			const DirectX::XMFLOAT3& a = projected[indices[t]];
+			const DirectX::XMFLOAT3& b = projected[indices[t + 1]];
+			const DirectX::XMFLOAT3& c = projected[indices[t + 2]];
+
+			// Front faces are clockwise on screen (with y pointing up), so cull everything else
+			float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if (area >= 0.0f)
+				continue;
+
+			// Pixel bounds of the triangle, clamped to the target
+			int minX = ClampPixel(floorf(Min3(a.x, b.x, c.x)), resolution);
+			int minY = ClampPixel(floorf(Min3(a.y, b.y, c.y)), resolution);
+			int maxX = ClampPixel(ceilf(Max3(a.x, b.x, c.x)), resolution);
+			int maxY = ClampPixel(ceilf(Max3(a.y, b.y, c.y)), resolution);
+
+			// Test pixel centers against the three edges, interpolating depth with the barycentrics
+			// - Centers exactly on an edge only count for top and left edges
+			bool topLeft0 = IsTopLeftEdge(b, c);
+			bool topLeft1 = IsTopLeftEdge(c, a);
+			bool topLeft2 = IsTopLeftEdge(a, b);
+			float invArea = -1.0f / area;
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int x = minX; x <= maxX; x++)
+				{
+					float px = x + 0.5f;
+					float py = y + 0.5f;
+					float e0 = EdgeFunction(b, c, px, py);
+					float e1 = EdgeFunction(c, a, px, py);
+					float e2 = EdgeFunction(a, b, px, py);
+					if (e0 < 0.0f || (e0 == 0.0f && !topLeft0) ||
+						e1 < 0.0f || (e1 == 0.0f && !topLeft1) ||
+						e2 < 0.0f || (e2 == 0.0f && !topLeft2))
+						continue;
+
+					float z = (e0 * a.z + e1 * b.z + e2 * c.z) * invArea;
+					float& stored = depth[y * resolution + x];
+					if (z < stored)
+					{
+						if (stored == FLT_MAX)
+							stats.pixelsCovered++;
+						stored = z;
+						stats.pixelsShaded++;
+					}
+				}
+			}
+		}
+	}
+
+	stats.overdraw = stats.pixelsCovered > 0 ? stats.pixelsShaded / (float)stats.pixelsCovered : 0.0f;
+	return stats;
+}
+
+// --------------------------------- Vertex fetch
+// Renumbers vertices into the order the index buffer first uses them
+int MeshOptimizer::OptimizeVertexFetch(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	// Hand out new numbers in order of first use
+	std::vector<unsigned int> remap(numVerts, UINT_MAX);
+	unsigned int nextVertex = 0;
+	for (int i = 0; i < numIndices; i++)
+	{
+		unsigned int& newIndex = remap[indices[i]];
+		if (newIndex == UINT_MAX)
+			newIndex = nextVertex++;
+		indices[i] = newIndex;
+	}
+
+	// Move the vertices to their new homes, dropping any that were never used
+	std::vector<Vertex> reordered(nextVertex);
+	for (int v = 0; v < numVerts; v++)
+	{
+		if (remap[v] != UINT_MAX)
+			reordered[remap[v]] = verts[v];
+	}
+
+	for (unsigned int v = 0; v < nextVertex; v++)
+		verts[v] = reordered[v];
+
+	return (int)nextVertex;
+}
+
+// Ratio of vertex bytes fetched through a small simulated cache to the size of the vertex buffer
+float MeshOptimizer::SimulateVertexFetch(const unsigned int* indices, int numIndices, int numVerts, int vertexSize)
+{
+	// A small FIFO of 64 byte lines, roughly what a GPU's vertex fetch path sees
+	const int lineSize = 64;
+	const int cacheLines = 64;
+	if (numVerts == 0 || vertexSize <= 0)
+		return 0.0f;
+
+	int numLines = (numVerts * vertexSize + lineSize - 1) / lineSize;
+	std::vector<int> stamp(numLines, -cacheLines - 1);
+	int misses = 0;
+
+	for (int i = 0; i < numIndices; i++)
+	{
+		// A vertex can straddle two lines
+		int firstLine = indices[i] * vertexSize / lineSize;
+		int lastLine = (indices[i] * vertexSize + vertexSize - 1) / lineSize;
+		for (int line = firstLine; line <= lastLine; line++)
+		{
+			if (misses - stamp[line] > cacheLines)
+			{
+				stamp[line] = misses;
+				misses++;
+			}
+		}
+	}
+
+	return misses * (float)lineSize / (numVerts * (float)vertexSize);
+}
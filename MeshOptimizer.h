@@ -0,0 +1,63 @@
+#pragma once
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Results of running an index buffer through a simulated
+// post-transform vertex cache
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float acmr;   // Average cache miss ratio, vertex shader runs per triangle (0.5 is ideal on a large grid, 3 is worst)
+	float atvr;   // Average transformed vertex ratio, vertex shader runs per unique vertex (1 is ideal)
+};
+
+// --------------------------------------------------------
+// Results of rasterizing a mesh on the CPU from several
+// viewpoints to measure how much overdraw it causes
+// --------------------------------------------------------
+struct OverdrawStats
+{
+	unsigned int pixelsCovered;   // Pixels touched by at least one triangle
+	unsigned int pixelsShaded;    // Pixels that passed the depth test, including ones that were later overwritten
+	float overdraw;               // Shaded / covered (1 is ideal)
+};
+
+// --------------------------------------------------------
+// Index and vertex reordering passes that run on CPU side
+// mesh data before the GPU buffers are created
+//
+// - None of these change what the mesh looks like, only the
+//   order the GPU sees triangles and vertices in
+// --------------------------------------------------------
+class MeshOptimizer
+{
+public:
+	// Size of the cache the optimizer and the default stats assume
+	static const int DefaultCacheSize = 16;
+
+	// Reorders triangles so the GPU's post-transform vertex cache gets
+	// as many hits as possible (Tom Forsyth's linear speed algorithm)
+	static void OptimizeVertexCache(unsigned int* indices, int numIndices, int numVerts);
+
+	// Runs an index buffer through a FIFO or LRU cache of the given size
+	static VertexCacheStats SimulateVertexCache(const unsigned int* indices, int numIndices, int numVerts, int cacheSize, bool lru);
+
+	// Splits a cache optimized index buffer into clusters and sorts them so
+	// outward facing clusters draw first, letting the depth test reject more
+	// of what's behind them.  Clusters are only split where the vertex cache
+	// miss ratio stays within threshold (1.05 = 5% worse) of the input
+	static void OptimizeOverdraw(unsigned int* indices, int numIndices, const Vertex* verts, int numVerts, float threshold);
+
+	// Renumbers vertices into the order the index buffer first uses them, so
+	// vertex fetches walk memory mostly linearly.  Unused vertices are dropped,
+	// and the new vertex count is returned
+	static int OptimizeVertexFetch(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+
+	// Ratio of vertex bytes fetched through a small simulated cache to the
+	// size of the vertex buffer (1 is ideal)
+	static float SimulateVertexFetch(const unsigned int* indices, int numIndices, int numVerts, int vertexSize);
+
+	// Rasterizes the mesh from several viewpoints (with back face culling and
+	// a depth test) and counts how many pixels are shaded more than once
+	static OverdrawStats EstimateOverdraw(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
+};
@@ -0,0 +1,473 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <unordered_set>
+#include <vector>
+
+// How each vertex is allowed to collapse
+enum SimplifyVertexKind
+{
+	KindManifold,   // Interior vertex, can collapse onto any neighbor
+	KindBorder,     // On a single open border, can only collapse along it
+	KindLocked      // Seams, hard edges and anything non-manifold never move
+};
+
+// Extra weight for the planes that hold open borders in place
+static const double BorderWeight = 10.0;
+
+// Collapses that turn a triangle by more than ~75 degrees are rejected
+static const double FlipThreshold = 0.25;
+
+// Collapses between vertices whose normals differ by more than 60 degrees are rejected
+static const float NormalThreshold = 0.5f;
+
+// Symmetric 4x4 quadric, plus the total weight of the planes in it
+struct Quadric
+{
+	double a00, a11, a22, a01, a02, a12;
+	double b0, b1, b2;
+	double c;
+	double weight;
+};
+
+struct SimplifyPosition
+{
+	double x, y, z;
+};
+
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	double error;
+};
+
+static void AddPlane(Quadric& q, double nx, double ny, double nz, double d, double weight)
+{
+	q.a00 += weight * nx * nx;
+	q.a11 += weight * ny * ny;
+	q.a22 += weight * nz * nz;
+	q.a01 += weight * nx * ny;
+	q.a02 += weight * nx * nz;
+	q.a12 += weight * ny * nz;
+	q.b0 += weight * nx * d;
+	q.b1 += weight * ny * d;
+	q.b2 += weight * nz * d;
+	q.c += weight * d * d;
+	q.weight += weight;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+	q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+	q.a01 += other.a01; q.a02 += other.a02; q.a12 += other.a12;
+	q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+	q.c += other.c;
+	q.weight += other.weight;
+}
+
+// Weighted average squared distance from p to the planes in both quadrics
+static double QuadricError(const Quadric& q0, const Quadric& q1, const SimplifyPosition& p)
+{
+	Quadric q = q0;
+	AddQuadric(q, q1);
+
+	double r = q.a00 * p.x * p.x + q.a11 * p.y * p.y + q.a22 * p.z * p.z
+		+ 2.0 * (q.a01 * p.x * p.y + q.a02 * p.x * p.z + q.a12 * p.y * p.z)
+		+ 2.0 * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z)
+		+ q.c;
+	return fabs(r) / (q.weight > 0.0 ? q.weight : 1.0);
+}
+
+static SimplifyPosition Subtract(const SimplifyPosition& a, const SimplifyPosition& b)
+{
+	return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static SimplifyPosition Cross(const SimplifyPosition& a, const SimplifyPosition& b)
+{
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static double Dot(const SimplifyPosition& a, const SimplifyPosition& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+float MeshSimplifier::GetMeshScale(const Vertex* verts, int numVerts)
+{
+	if (numVerts == 0)
+		return 0.0f;
+
+	DirectX::XMFLOAT3 lowest = verts[0].position;
+	DirectX::XMFLOAT3 highest = verts[0].position;
+	for (int i = 1; i < numVerts; i++)
+	{
+		const DirectX::XMFLOAT3& p = verts[i].position;
+		lowest = DirectX::XMFLOAT3(fminf(lowest.x, p.x), fminf(lowest.y, p.y), fminf(lowest.z, p.z));
+		highest = DirectX::XMFLOAT3(fmaxf(highest.x, p.x), fmaxf(highest.y, p.y), fmaxf(highest.z, p.z));
+	}
+
+	return fmaxf(highest.x - lowest.x, fmaxf(highest.y - lowest.y, highest.z - lowest.z));
+}
+
+int MeshSimplifier::Simplify(
+	const Vertex* verts, int numVerts,
+	const unsigned int* indices, int numIndices,
+	int targetIndexCount, float maxError,
+	unsigned int* destination, float* resultError,
+	std::vector<SimplifyCollapse>* collapses)
+{
+	std::copy(indices, indices + numIndices, destination);
+	if (resultError)
+		*resultError = 0.0f;
+	if (collapses)
+		collapses->clear();
+	if (numVerts == 0 || numIndices < 3)
+		return numIndices;
+
+	// Work in a unit sized space so errors are relative to the mesh
+	float scale = GetMeshScale(verts, numVerts);
+	double invScale = scale > 0.0f ? 1.0 / scale : 1.0;
+	std::vector<SimplifyPosition> positions(numVerts);
+	for (int i = 0; i < numVerts; i++)
+		positions[i] = { verts[i].position.x * invScale, verts[i].position.y * invScale, verts[i].position.z * invScale };
+
+	// Group vertices that share a position, the first of each group stands in for all of them
+	std::vector<unsigned int> order(numVerts);
+	for (int i = 0; i < numVerts; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [verts](unsigned int a, unsigned int b) {
+		const DirectX::XMFLOAT3& pa = verts[a].position;
+		const DirectX::XMFLOAT3& pb = verts[b].position;
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		if (pa.z != pb.z) return pa.z < pb.z;
+		return a < b;
+	});
+
+	std::vector<unsigned int> remap(numVerts);
+	std::vector<int> groupSize(numVerts, 0);
+	for (int i = 0; i < numVerts;)
+	{
+		int end = i + 1;
+		const DirectX::XMFLOAT3& p = verts[order[i]].position;
+		while (end < numVerts && verts[order[end]].position.x == p.x && verts[order[end]].position.y == p.y && verts[order[end]].position.z == p.z)
+			end++;
+		for (int k = i; k < end; k++)
+			remap[order[k]] = order[i];
+		groupSize[order[i]] = end - i;
+		i = end;
+	}
+
+	// Find open border edges (directed edges between positions with no matching reverse edge)
+	std::unordered_set<unsigned long long> edges;
+	edges.reserve(numIndices * 2);
+	for (int i = 0; i < numIndices; i += 3)
+		for (int e = 0; e < 3; e++)
+			edges.insert(((unsigned long long)remap[indices[i + e]] << 32) | remap[indices[i + (e + 1) % 3]]);
+
+	std::vector<int> borderOut(numVerts, 0), borderIn(numVerts, 0);
+	std::vector<unsigned int> borderNext(numVerts), borderPrev(numVerts);
+	std::vector<Quadric> quadrics(numVerts, Quadric{});
+	for (int i = 0; i < numIndices; i += 3)
+	{
+		unsigned int r[3] = { remap[indices[i]], remap[indices[i + 1]], remap[indices[i + 2]] };
+		SimplifyPosition normal = Cross(Subtract(positions[r[1]], positions[r[0]]), Subtract(positions[r[2]], positions[r[0]]));
+		double area = sqrt(Dot(normal, normal));
+		if (area > 0.0)
+		{
+			// The triangle's own plane, weighted by its area
+			normal = { normal.x / area, normal.y / area, normal.z / area };
+			double d = -Dot(normal, positions[r[0]]);
+			for (int c = 0; c < 3; c++)
+				AddPlane(quadrics[r[c]], normal.x, normal.y, normal.z, d, area);
+		}
+
+		// Border edges also get a plane standing up along the edge, so the border can't drift sideways
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = r[e];
+			unsigned int b = r[(e + 1) % 3];
+			if (a == b || edges.count(((unsigned long long)b << 32) | a))
+				continue;
+
+			borderOut[a]++;
+			borderIn[b]++;
+			borderNext[a] = b;
+			borderPrev[b] = a;
+
+			SimplifyPosition edge = Subtract(positions[b], positions[a]);
+			SimplifyPosition side = Cross(edge, normal);
+			double length = sqrt(Dot(side, side));
+			if (area == 0.0 || length == 0.0)
+				continue;
+			side = { side.x / length, side.y / length, side.z / length };
+			double weight = Dot(edge, edge) * BorderWeight;
+			double sideD = -Dot(side, positions[a]);
+			AddPlane(quadrics[a], side.x, side.y, side.z, sideD, weight);
+			AddPlane(quadrics[b], side.x, side.y, side.z, sideD, weight);
+		}
+	}
+
+	std::vector<unsigned char> kinds(numVerts);
+	for (int i = 0; i < numVerts; i++)
+	{
+		unsigned int r = remap[i];
+		if (groupSize[r] != 1)
+			kinds[i] = KindLocked;
+		else if (borderOut[r] == 0 && borderIn[r] == 0)
+			kinds[i] = KindManifold;
+		else if (borderOut[r] == 1 && borderIn[r] == 1)
+			kinds[i] = KindBorder;
+		else
+			kinds[i] = KindLocked;
+	}
+
+	// Triangles with two corners at the same position (poles of uv spheres, for example) are already degenerate
+	int indexCount = 0;
+	for (int i = 0; i < numIndices; i += 3)
+	{
+		unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+		if (a == b || b == c || c == a)
+			continue;
+
+		destination[indexCount++] = indices[i];
+		destination[indexCount++] = indices[i + 1];
+		destination[indexCount++] = indices[i + 2];
+	}
+
+	// Collapse in passes, each pass picks the cheapest collapses that don't touch each other
+	double errorLimit = (double)maxError * maxError;
+	double worstError = 0.0;
+	std::vector<unsigned int> triangleOffsets(numVerts + 1), triangleList;
+	std::vector<unsigned int> collapseTo(numVerts);
+	std::vector<unsigned char> touched(numVerts);
+	std::vector<Collapse> candidates;
+
+	while (indexCount > targetIndexCount)
+	{
+		// Which triangles use each vertex
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (int i = 0; i < indexCount; i++)
+			triangleOffsets[destination[i] + 1]++;
+		for (int i = 0; i < numVerts; i++)
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		triangleList.resize(indexCount);
+		std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (int i = 0; i < indexCount; i++)
+			triangleList[fill[destination[i]]++] = i / 3;
+
+		// Score every edge, keeping whichever direction is cheaper
+		// - Interior edges show up in two triangles, so only the a < b copy is used (edges that might
+		//   be on a border are always used, an occasional duplicate is harmless)
+		candidates.clear();
+		for (int i = 0; i < indexCount; i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = destination[i + e];
+				unsigned int b = destination[i + (e + 1) % 3];
+				if (a > b && (kinds[a] == KindManifold || kinds[b] == KindManifold))
+					continue;
+
+				Collapse best = { 0, 0, DBL_MAX };
+				for (int direction = 0; direction < 2; direction++)
+				{
+					unsigned int from = direction ? b : a;
+					unsigned int to = direction ? a : b;
+					if (kinds[from] == KindLocked)
+						continue;
+					if (kinds[from] == KindBorder && (kinds[to] == KindManifold || (borderNext[from] != remap[to] && borderPrev[from] != remap[to])))
+						continue;
+
+					double error = QuadricError(quadrics[from], quadrics[remap[to]], positions[to]);
+					if (error < best.error)
+						best = { from, to, error };
+				}
+
+				if (best.error <= errorLimit)
+					candidates.push_back(best);
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		// Take as many as needed to reach the target (manifold collapses remove two triangles, border ones remove one)
+		int trianglesToRemove = (indexCount - targetIndexCount) / 3;
+		int trianglesRemoved = 0;
+		int collapseCount = 0;
+		for (int i = 0; i < numVerts; i++)
+			collapseTo[i] = i;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		for (size_t c = 0; c < candidates.size() && trianglesRemoved < trianglesToRemove; c++)
+		{
+			unsigned int from = candidates[c].from;
+			unsigned int to = candidates[c].to;
+			if (touched[from] || touched[to])
+				continue;
+
+			// Keep shading intact by not merging very different normals
+			const DirectX::XMFLOAT3& n0 = verts[from].normal;
+			const DirectX::XMFLOAT3& n1 = verts[to].normal;
+			float normalDot = n0.x * n1.x + n0.y * n1.y + n0.z * n1.z;
+			float normalLengths = sqrtf((n0.x * n0.x + n0.y * n0.y + n0.z * n0.z) * (n1.x * n1.x + n1.y * n1.y + n1.z * n1.z));
+			if (normalDot < NormalThreshold * normalLengths)
+				continue;
+
+			// Make sure none of the surviving triangles around "from" flip over (or get close to it)
+			bool flips = false;
+			for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1] && !flips; t++)
+			{
+				const unsigned int* tri = destination + triangleList[t] * 3;
+				if (tri[0] == to || tri[1] == to || tri[2] == to)
+					continue;
+
+				int corner = tri[0] == from ? 0 : (tri[1] == from ? 1 : 2);
+				const SimplifyPosition& pa = positions[tri[(corner + 1) % 3]];
+				const SimplifyPosition& pb = positions[tri[(corner + 2) % 3]];
+				SimplifyPosition before = Cross(Subtract(pa, positions[from]), Subtract(pb, positions[from]));
+				SimplifyPosition after = Cross(Subtract(pa, positions[to]), Subtract(pb, positions[to]));
+				flips = Dot(before, after) <= FlipThreshold * sqrt(Dot(before, before) * Dot(after, after));
+			}
+			if (flips)
+				continue;
+
+			collapseTo[from] = to;
+			AddQuadric(quadrics[remap[to]], quadrics[from]);
+			worstError = std::max(worstError, candidates[c].error);
+			collapseCount++;
+
+			// Collapses within a pass never share a triangle, so replaying them one at a time gives the same mesh
+			if (collapses)
+				collapses->push_back({ from, to, (float)sqrt(candidates[c].error) });
+
+			// Unlink the removed vertex from its border (it collapsed onto one of its two border neighbors)
+			if (kinds[from] == KindBorder)
+			{
+				borderNext[borderPrev[from]] = borderNext[from];
+				borderPrev[borderNext[from]] = borderPrev[from];
+				trianglesRemoved += 1;
+			}
+			else
+			{
+				trianglesRemoved += 2;
+			}
+
+			// Nothing else around this collapse can change until the next pass
+			touched[from] = 1;
+			touched[to] = 1;
+			for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++)
+			{
+				const unsigned int* tri = destination + triangleList[t] * 3;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Apply the collapses and drop the triangles that degenerated
+		int written = 0;
+		for (int i = 0; i < indexCount; i += 3)
+		{
+			unsigned int a = collapseTo[destination[i]];
+			unsigned int b = collapseTo[destination[i + 1]];
+			unsigned int c = collapseTo[destination[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			destination[written++] = a;
+			destination[written++] = b;
+			destination[written++] = c;
+		}
+		indexCount = written;
+	}
+
+	if (resultError)
+		*resultError = (float)sqrt(worstError);
+	return indexCount;
+}
+
+// Squared distance from p to triangle abc (closest point from Real-Time Collision Detection, 5.1.5)
+static double PointTriangleDistanceSq(const SimplifyPosition& p, const SimplifyPosition& a, const SimplifyPosition& b, const SimplifyPosition& c)
+{
+	SimplifyPosition ab = Subtract(b, a), ac = Subtract(c, a), ap = Subtract(p, a);
+	SimplifyPosition closest;
+
+	double d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+	SimplifyPosition bp = Subtract(p, b);
+	double d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+	SimplifyPosition cp = Subtract(p, c);
+	double d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+	double va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+
+	if (d1 <= 0.0 && d2 <= 0.0)
+		closest = a;
+	else if (d3 >= 0.0 && d4 <= d3)
+		closest = b;
+	else if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+	{
+		double v = d1 / (d1 - d3);
+		closest = { a.x + ab.x * v, a.y + ab.y * v, a.z + ab.z * v };
+	}
+	else if (d6 >= 0.0 && d5 <= d6)
+		closest = c;
+	else if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+	{
+		double w = d2 / (d2 - d6);
+		closest = { a.x + ac.x * w, a.y + ac.y * w, a.z + ac.z * w };
+	}
+	else if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+	{
+		double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		closest = { b.x + (c.x - b.x) * w, b.y + (c.y - b.y) * w, b.z + (c.z - b.z) * w };
+	}
+	else
+	{
+		double denom = 1.0 / (va + vb + vc);
+		double v = vb * denom, w = vc * denom;
+		closest = { a.x + ab.x * v + ac.x * w, a.y + ab.y * v + ac.y * w, a.z + ab.z * v + ac.z * w };
+	}
+
+	SimplifyPosition offset = Subtract(p, closest);
+	return Dot(offset, offset);
+}
+
+float MeshSimplifier::MeasureDistance(
+	const Vertex* verts, int numVerts,
+	const unsigned int* original, int numOriginal,
+	const unsigned int* simplified, int numSimplified,
+	int maxSamples)
+{
+	if (numSimplified < 3 || maxSamples <= 0)
+		return 0.0f;
+
+	// Only vertices the original mesh actually uses count
+	std::vector<unsigned char> used(numVerts, 0);
+	for (int i = 0; i < numOriginal; i++)
+		used[original[i]] = 1;
+	std::vector<unsigned int> samples;
+	for (int i = 0; i < numVerts; i++)
+		if (used[i])
+			samples.push_back(i);
+
+	std::vector<SimplifyPosition> positions(numVerts);
+	for (int i = 0; i < numVerts; i++)
+		positions[i] = { verts[i].position.x, verts[i].position.y, verts[i].position.z };
+
+	double worst = 0.0;
+	size_t step = samples.size() > (size_t)maxSamples ? samples.size() / maxSamples : 1;
+	for (size_t s = 0; s < samples.size(); s += step)
+	{
+		const SimplifyPosition& p = positions[samples[s]];
+		double nearest = DBL_MAX;
+		for (int i = 0; i < numSimplified && nearest > 0.0; i += 3)
+			nearest = std::min(nearest, PointTriangleDistanceSq(p, positions[simplified[i]], positions[simplified[i + 1]], positions[simplified[i + 2]]));
+		worst = std::max(worst, nearest);
+	}
+
+	return (float)sqrt(worst);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+
+#include "Vertex.h"
+
+// One edge collapse made by MeshSimplifier, in the order they were made
+// - from moved onto to (which already existed), so undoing them in reverse rebuilds the mesh
+struct SimplifyCollapse
+{
+	unsigned int from;
+	unsigned int to;
+	float error;                            // Relative, like Simplify's resultError
+};
+
+// --------------------------------------------------------
+// Quadric error metric simplification (Garland & Heckbert)
+//
+// - Works by collapsing edges onto one of their existing
+//   vertices, so normals and uvs are never blended
+// - Vertices sharing a position with others (uv seams and
+//   hard edges) are locked, and open borders only collapse
+//   along themselves, so seams and silhouettes stay intact
+// - Errors are relative to the largest side of the mesh's
+//   bounding box (multiply by GetMeshScale for world units)
+// --------------------------------------------------------
+class MeshSimplifier
+{
+public:
+	// Simplifies a triangle list towards targetIndexCount indices without going over maxError
+	// - destination needs room for numIndices indices, returns how many were written
+	// - resultError (optional) gets the largest error of any collapse that was made
+	// - collapses (optional) gets every collapse that was made, for building progressive meshes
+	static int Simplify(
+		const Vertex* verts, int numVerts,
+		const unsigned int* indices, int numIndices,
+		int targetIndexCount, float maxError,
+		unsigned int* destination, float* resultError,
+		std::vector<SimplifyCollapse>* collapses = nullptr);
+
+	// Largest distance from the original mesh's vertices to the simplified surface, in world units
+	// - Checks at most maxSamples vertices, spread evenly through the vertex list
+	static float MeasureDistance(
+		const Vertex* verts, int numVerts,
+		const unsigned int* original, int numOriginal,
+		const unsigned int* simplified, int numSimplified,
+		int maxSamples);
+
+	// Converts relative errors to world units
+	static float GetMeshScale(const Vertex* verts, int numVerts);
+};
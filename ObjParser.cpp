@@ -0,0 +1,658 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+// One face corner (0-based, -1 when the attribute was left out)
+struct ObjCorner
+{
+	int position;
+	int uv;
+	int normal;
+};
+
+// Marks an attribute that wasn't given for a corner
+static const int MissingIndex = -1;
+
+// Negative (relative) OBJ indices can only be resolved once we know how many
+// attributes came before the chunk they're in, so until the fix up step they're
+// stored as chunk-local indices offset by this (very negative) base
+static const int RelativeIndexBase = -0x40000000;
+
+// Flag set on a face's corner count when it points outside the attribute lists
+static const unsigned int DroppedFace = 0x80000000;
+
+// Files smaller than this are always parsed on a single thread
+static const size_t MinBytesPerThread = 1024 * 1024;
+
+// An o, g or usemtl record, applying to every face after it
+struct ObjGroupChange
+{
+	size_t face;                         // Index into the chunk's faceSizes of the first face it applies to
+	bool material;                       // usemtl rather than o/g
+	std::string name;
+};
+
+// Everything one worker pulls out of its slice of the file
+struct ObjChunk
+{
+	// The slice itself
+	const char* begin;
+	const char* end;
+
+	// Attributes in the order they appeared
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	std::vector<DirectX::XMFLOAT3> normals;
+
+	// Corners of every face back to back, plus how many corners each face has
+	std::vector<ObjCorner> corners;
+	std::vector<unsigned int> faceSizes;
+
+	// Group and material records in the order they appeared
+	std::vector<ObjGroupChange> groupChanges;
+
+	// Where this chunk's attributes start in the merged arrays
+	size_t positionOffset;
+	size_t uvOffset;
+	size_t normalOffset;
+};
+
+// --------------------------------------------------------
+// Open addressing hash table from a corner's attribute
+// index triplet to the vertex that was built for it
+//
+// - Linear probing over a power of two sized flat array,
+//   so lookups are a hash plus a short cache friendly scan
+// - Grows once it's half full to keep probe chains short
+// --------------------------------------------------------
+class CornerTable
+{
+public:
+	CornerTable() : count(0) { Resize(1024); }
+
+	// Returns the vertex index already stored for this corner, or stores and returns newIndex
+	unsigned int FindOrInsert(const ObjCorner& corner, unsigned int newIndex)
+	{
+		if ((count + 1) * 2 > slots.size())
+			Resize(slots.size() * 2);
+
+		size_t mask = slots.size() - 1;
+		for (size_t i = Hash(corner) & mask; ; i = (i + 1) & mask)
+		{
+			Slot& slot = slots[i];
+			if (slot.corner.position < 0)
+			{
+				slot.corner = corner;
+				slot.vertex = newIndex;
+				count++;
+				return newIndex;
+			}
+			if (slot.corner.position == corner.position && slot.corner.uv == corner.uv && slot.corner.normal == corner.normal)
+				return slot.vertex;
+		}
+	}
+
+private:
+	struct Slot
+	{
+		ObjCorner corner;
+		unsigned int vertex;
+	};
+
+	std::vector<Slot> slots;
+	size_t count;
+
+	static size_t Hash(const ObjCorner& corner)
+	{
+		unsigned long long h = (unsigned int)corner.position * 0x9E3779B97F4A7C15ULL;
+		h ^= (unsigned int)corner.uv * 0xC2B2AE3D27D4EB4FULL;
+		h ^= (unsigned int)corner.normal * 0x165667B19E3779F9ULL;
+		return (size_t)(h ^ (h >> 29));
+	}
+
+	// Rehashes every stored corner into a table of the new size
+	void Resize(size_t newSize)
+	{
+		std::vector<Slot> old;
+		old.swap(slots);
+
+		Slot empty = { { -1, -1, -1 }, 0 };
+		slots.assign(newSize, empty);
+
+		size_t mask = newSize - 1;
+		for (size_t i = 0; i < old.size(); i++)
+		{
+			if (old[i].corner.position < 0)
+				continue;
+
+			size_t j = Hash(old[i].corner) & mask;
+			while (slots[j].corner.position >= 0)
+				j = (j + 1) & mask;
+			slots[j] = old[i];
+		}
+	}
+};
+
+// Exact powers of ten that a double can represent, used by the float reader
+static const double powersOfTen[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// --------------------------------- Tokenizer helpers
+// Every helper takes the end of the buffer, since a mapped file has no null terminator
+static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+static bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Skips spaces and tabs (but not newlines)
+static const char* SkipBlanks(const char* c, const char* end)
+{
+	while (c < end && IsBlank(*c))
+		c++;
+	return c;
+}
+
+// Skips to the first character of the next line
+static const char* SkipLine(const char* c, const char* end)
+{
+	while (c < end && *c != '\n')
+		c++;
+	return c < end ? c + 1 : end;
+}
+
+// Reads an unsigned run of digits into a 64 bit mantissa, tracking any
+// digits that didn't fit as a power of ten adjustment instead
+static const char* ReadDigits(const char* c, const char* end, unsigned long long& mantissa, int& exponent, bool fraction)
+{
+	for (; c < end && IsDigit(*c); c++)
+	{
+		if (mantissa < 100000000000000000ULL)
+		{
+			mantissa = mantissa * 10 + (*c - '0');
+			if (fraction) exponent--;
+		}
+		else if (!fraction)
+		{
+			exponent++;
+		}
+	}
+	return c;
+}
+
+// Reads a float in plain or scientific notation
+static const char* ParseFloat(const char* c, const char* end, float& out)
+{
+	c = SkipBlanks(c, end);
+
+	// Optional sign
+	bool negative = false;
+	if (c < end && (*c == '-' || *c == '+'))
+	{
+		negative = *c == '-';
+		c++;
+	}
+
+	// Whole and fractional digits
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	c = ReadDigits(c, end, mantissa, exponent, false);
+	if (c < end && *c == '.')
+		c = ReadDigits(c + 1, end, mantissa, exponent, true);
+
+	// Optional exponent
+	if (c < end && (*c == 'e' || *c == 'E'))
+	{
+		c++;
+		bool negativeExponent = false;
+		if (c < end && (*c == '-' || *c == '+'))
+		{
+			negativeExponent = *c == '-';
+			c++;
+		}
+
+		int value = 0;
+		for (; c < end && IsDigit(*c); c++)
+		{
+			if (value < 10000)
+				value = value * 10 + (*c - '0');
+		}
+		exponent += negativeExponent ? -value : value;
+	}
+
+	// Scale by an exact power of ten whenever we can, which keeps the result correctly rounded for typical OBJ values
+	double result = (double)mantissa;
+	if (mantissa != 0)
+	{
+		if (exponent >= 0)
+			result *= exponent <= 22 ? powersOfTen[exponent] : std::pow(10.0, exponent);
+		else
+			result /= exponent >= -22 ? powersOfTen[-exponent] : std::pow(10.0, -exponent);
+	}
+
+	out = (float)(negative ? -result : result);
+	return c;
+}
+
+// Reads a signed integer, reporting whether any digits were actually there
+// - Accumulated in 64 bits and stops growing once past any int, so huge values can't overflow
+static const char* ParseInt(const char* c, const char* end, long long& out, bool& found)
+{
+	bool negative = false;
+	if (c < end && (*c == '-' || *c == '+'))
+	{
+		negative = *c == '-';
+		c++;
+	}
+
+	long long value = 0;
+	found = false;
+	for (; c < end && IsDigit(*c); c++)
+	{
+		if (value <= INT_MAX)
+			value = value * 10 + (*c - '0');
+		found = true;
+	}
+
+	out = negative ? -value : value;
+	return c;
+}
+
+// Converts a 1-based OBJ index into a 0-based one, leaving negative (relative)
+// ones local to the chunk until its offset in the merged arrays is known
+// - False if the index is too far out to encode, which no real file could point at anyway
+static bool EncodeIndex(long long index, size_t localCount, int& out)
+{
+	if (index > 0)
+	{
+		if (index > INT_MAX)
+			return false;
+		out = (int)(index - 1);
+		return true;
+	}
+	if (index < 0)
+	{
+		long long encoded = RelativeIndexBase + (long long)localCount + index;
+		if (encoded < INT_MIN || encoded >= MissingIndex)
+			return false;
+		out = (int)encoded;
+		return true;
+	}
+	out = MissingIndex;
+	return true;
+}
+
+// Finishes resolving an index once the chunk's offset is known, false if it's out of range
+static bool FixupIndex(int& index, size_t chunkOffset, size_t count)
+{
+	if (index == MissingIndex)
+		return true;
+	if (index < MissingIndex)
+		index = (int)chunkOffset + (index - RelativeIndexBase);
+	return index >= 0 && (size_t)index < count;
+}
+
+// Builds the final vertex for a single face corner
+static Vertex MakeVertex(
+	const ObjCorner& corner,
+	const std::vector<DirectX::XMFLOAT3>& positions,
+	const std::vector<DirectX::XMFLOAT2>& uvs,
+	const std::vector<DirectX::XMFLOAT3>& normals)
+{
+	Vertex v = {};
+	v.position = positions[corner.position];
+	if (corner.uv >= 0) v.uv = uvs[corner.uv];
+	if (corner.normal >= 0) v.normal = normals[corner.normal];
+	return v;
+}
+
+// Adds one triangle corner to the given group's indices, reusing the existing vertex if this exact
+// position/uv/normal combination has been seen before
+static void AddCorner(
+	const ObjCorner& corner,
+	const std::vector<DirectX::XMFLOAT3>& positions,
+	const std::vector<DirectX::XMFLOAT2>& uvs,
+	const std::vector<DirectX::XMFLOAT3>& normals,
+	CornerTable& corners,
+	ObjData& out,
+	std::vector<unsigned int>& indices)
+{
+	unsigned int index = corners.FindOrInsert(corner, (unsigned int)out.verts.size());
+	if (index == out.verts.size())
+		out.verts.push_back(MakeVertex(corner, positions, uvs, normals));
+
+	indices.push_back(index);
+	out.cornerCount++;
+}
+
+// Reads the rest of the line as a name, leaving off trailing blanks and comments
+static const char* ParseName(const char* c, const char* end, std::string& name)
+{
+	c = SkipBlanks(c, end);
+	const char* start = c;
+	while (c < end && *c != '\n' && *c != '#')
+		c++;
+
+	const char* last = c;
+	while (last > start && IsBlank(last[-1]))
+		last--;
+	name.assign(start, last);
+	return c;
+}
+
+// Maps the file at the given path and parses it, false if it couldn't be opened
+bool ObjParser::ParseFile(const char* path, ObjData& out, int threadCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	MappedFile file(path);
+	if (!file.IsOpen())
+		return false;
+
+	// Small files aren't worth spinning up threads for, whatever the count asked for
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+	if (threadCount <= 0 || file.GetSize() < MinBytesPerThread)
+		threadCount = 1;
+
+	Parse(file.GetData(), file.GetData() + file.GetSize(), out, threadCount);
+	out.fileBytes = file.GetSize();
+
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	out.parseSeconds = elapsed.count();
+	return true;
+}
+
+// Reads every record in one line aligned slice of the file
+static void ParseChunk(ObjChunk& chunk)
+{
+	const char* c = chunk.begin;
+	const char* end = chunk.end;
+	while (c < end)
+	{
+		c = SkipBlanks(c, end);
+		if (c >= end)
+			break;
+
+		// Figure out the record type from the leading keyword
+		char type = *c;
+		char subtype = c + 1 < end ? c[1] : '\n';
+
+		// The model is most likely in a right-handed space, especially if it
+		// came from Maya.  We want to convert to a left-handed space for DirectX,
+		// which means inverting position and normal Z and flipping the winding
+		// order.  DirectX also defines (0,0) as the top left of a texture, while
+		// many 3D modeling packages use the bottom left, so V is flipped as well.
+		// Flips are applied as attributes are read so every corner shares them.
+		if (type == 'v' && IsBlank(subtype))
+		{
+			DirectX::XMFLOAT3 pos;
+			c = ParseFloat(c + 1, end, pos.x);
+			c = ParseFloat(c, end, pos.y);
+			c = ParseFloat(c, end, pos.z);
+			pos.z *= -1.0f;
+			chunk.positions.push_back(pos);
+		}
+		else if (type == 'v' && subtype == 't' && c + 2 < end && IsBlank(c[2]))
+		{
+			DirectX::XMFLOAT2 uv;
+			c = ParseFloat(c + 2, end, uv.x);
+			c = ParseFloat(c, end, uv.y);
+			uv.y = 1.0f - uv.y;
+			chunk.uvs.push_back(uv);
+		}
+		else if (type == 'v' && subtype == 'n' && c + 2 < end && IsBlank(c[2]))
+		{
+			DirectX::XMFLOAT3 norm;
+			c = ParseFloat(c + 2, end, norm.x);
+			c = ParseFloat(c, end, norm.y);
+			c = ParseFloat(c, end, norm.z);
+			norm.z *= -1.0f;
+			chunk.normals.push_back(norm);
+		}
+		else if (type == 'f' && IsBlank(subtype))
+		{
+			// Read every corner on the line straight onto the end of the chunk's corner list
+			size_t firstCorner = chunk.corners.size();
+			bool valid = true;
+			c++;
+			while (true)
+			{
+				c = SkipBlanks(c, end);
+				if (c >= end || *c == '\n' || *c == '#')
+					break;
+
+				// Position index is required, uv and normal are optional
+				long long p = 0, t = 0, n = 0;
+				bool found = false;
+				c = ParseInt(c, end, p, found);
+				if (!found)
+				{
+					valid = false;
+					break;
+				}
+				if (c < end && *c == '/')
+				{
+					c = ParseInt(c + 1, end, t, found);
+					if (c < end && *c == '/')
+						c = ParseInt(c + 1, end, n, found);
+				}
+
+				ObjCorner corner;
+				if (!EncodeIndex(p, chunk.positions.size(), corner.position) ||
+					!EncodeIndex(t, chunk.uvs.size(), corner.uv) ||
+					!EncodeIndex(n, chunk.normals.size(), corner.normal))
+				{
+					valid = false;
+					break;
+				}
+				chunk.corners.push_back(corner);
+			}
+
+			// Keep the face only if it's a real polygon
+			size_t faceSize = chunk.corners.size() - firstCorner;
+			if (valid && faceSize >= 3)
+				chunk.faceSizes.push_back((unsigned int)faceSize);
+			else
+				chunk.corners.resize(firstCorner);
+		}
+
+		else if ((type == 'o' || type == 'g') && IsBlank(subtype))
+		{
+			ObjGroupChange change = { chunk.faceSizes.size(), false, std::string() };
+			c = ParseName(c + 1, end, change.name);
+			chunk.groupChanges.push_back(change);
+		}
+		else if (type == 'u' && end - c > 6 && strncmp(c, "usemtl", 6) == 0 && IsBlank(c[6]))
+		{
+			ObjGroupChange change = { chunk.faceSizes.size(), true, std::string() };
+			c = ParseName(c + 6, end, change.name);
+			chunk.groupChanges.push_back(change);
+		}
+
+		// Everything else (comments, material libraries, smoothing) is ignored for now
+		c = SkipLine(c, end);
+	}
+}
+
+// Copies a chunk's attributes into the merged arrays and resolves its face indices against them
+static void MergeChunk(
+	ObjChunk& chunk,
+	std::vector<DirectX::XMFLOAT3>& positions,
+	std::vector<DirectX::XMFLOAT2>& uvs,
+	std::vector<DirectX::XMFLOAT3>& normals)
+{
+	std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionOffset);
+	std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + chunk.uvOffset);
+	std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalOffset);
+
+	// Faces pointing outside of the attribute lists are flagged so they get skipped
+	ObjCorner* corner = chunk.corners.data();
+	for (size_t f = 0; f < chunk.faceSizes.size(); f++)
+	{
+		bool valid = true;
+		for (unsigned int i = 0; i < chunk.faceSizes[f]; i++, corner++)
+		{
+			valid &= corner->position != MissingIndex;
+			valid &= FixupIndex(corner->position, chunk.positionOffset, positions.size());
+			valid &= FixupIndex(corner->uv, chunk.uvOffset, uvs.size());
+			valid &= FixupIndex(corner->normal, chunk.normalOffset, normals.size());
+		}
+
+		if (!valid)
+			chunk.faceSizes[f] |= DroppedFace;
+	}
+}
+
+// Runs the given job once for every chunk, each on its own thread
+template<typename Job>
+static void ForEachChunk(std::vector<ObjChunk>& chunks, Job job)
+{
+	if (chunks.size() == 1)
+	{
+		job(chunks[0]);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < chunks.size(); i++)
+		workers.push_back(std::thread(job, std::ref(chunks[i])));
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+// Parses OBJ text that's already in memory
+// - Split into line aligned chunks, parse each chunk on its own thread,
+//   merge the attribute arrays using prefix sums of their counts, fix up
+//   the face indices, then build the welded vertices in file order
+// - The last step is serial, so the output is identical for any thread count
+void ObjParser::Parse(const char* begin, const char* end, ObjData& out, int threadCount)
+{
+	out.verts.clear();
+	out.indices.clear();
+	out.groups.clear();
+	out.cornerCount = 0;
+
+	// Split the file into line aligned chunks of roughly equal size
+	size_t size = end - begin;
+	size_t chunkCount = threadCount > 1 ? threadCount : 1;
+	if (chunkCount > 1 && size / chunkCount < MinBytesPerThread / 4)
+		chunkCount = size / (MinBytesPerThread / 4) + 1;
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* chunkStart = begin;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = i + 1 == chunkCount ? end : SkipLine(begin + size * (i + 1) / chunkCount, end);
+		if (chunkEnd < chunkStart)
+			chunkEnd = chunkStart;
+
+		chunks[i].begin = chunkStart;
+		chunks[i].end = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	// Parse every chunk in parallel
+	ForEachChunk(chunks, ParseChunk);
+
+	// Prefix sums tell each chunk where its attributes land in the merged arrays
+	size_t positionCount = 0, uvCount = 0, normalCount = 0;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		chunks[i].positionOffset = positionCount;
+		chunks[i].uvOffset = uvCount;
+		chunks[i].normalOffset = normalCount;
+		positionCount += chunks[i].positions.size();
+		uvCount += chunks[i].uvs.size();
+		normalCount += chunks[i].normals.size();
+	}
+
+	// Merge the attributes and fix up the face indices, again in parallel
+	std::vector<DirectX::XMFLOAT3> positions(positionCount);
+	std::vector<DirectX::XMFLOAT2> uvs(uvCount);
+	std::vector<DirectX::XMFLOAT3> normals(normalCount);
+	ForEachChunk(chunks, [&](ObjChunk& chunk) { MergeChunk(chunk, positions, uvs, normals); });
+
+	// Corners already turned into vertices, so shared corners are welded together
+	CornerTable corners;
+
+	// Each distinct name and material pair gets its own index list, found through a map keyed on both
+	std::string name;
+	std::string material;
+	std::unordered_map<std::string, size_t> groupLookup;
+	std::vector<std::vector<unsigned int>> groupIndices;
+	std::vector<unsigned int>* indices = nullptr;
+
+	// Fan triangulate every face in file order (flipping the winding order)
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		const ObjCorner* face = chunks[c].corners.data();
+		size_t change = 0;
+		for (size_t f = 0; f < chunks[c].faceSizes.size(); f++)
+		{
+			// Apply any o, g and usemtl records that came before this face
+			for (; change < chunks[c].groupChanges.size() && chunks[c].groupChanges[change].face == f; change++)
+			{
+				(chunks[c].groupChanges[change].material ? material : name) = chunks[c].groupChanges[change].name;
+				indices = nullptr;
+			}
+
+			unsigned int faceSize = chunks[c].faceSizes[f] & ~DroppedFace;
+			if ((chunks[c].faceSizes[f] & DroppedFace) == 0)
+			{
+				// Groups are only created once they actually get a face
+				if (!indices)
+				{
+					std::string key = name + '\0' + material;
+					auto found = groupLookup.find(key);
+					if (found == groupLookup.end())
+					{
+						found = groupLookup.emplace(key, groupIndices.size()).first;
+						groupIndices.emplace_back();
+						out.groups.push_back({ name, material, 0, 0 });
+					}
+					indices = &groupIndices[found->second];
+				}
+
+				for (unsigned int i = 1; i + 1 < faceSize; i++)
+				{
+					AddCorner(face[0], positions, uvs, normals, corners, out, *indices);
+					AddCorner(face[i + 1], positions, uvs, normals, corners, out, *indices);
+					AddCorner(face[i], positions, uvs, normals, corners, out, *indices);
+				}
+			}
+
+			face += faceSize;
+		}
+
+		// Records after the chunk's last face still carry over into the next chunk
+		for (; change < chunks[c].groupChanges.size(); change++)
+		{
+			(chunks[c].groupChanges[change].material ? material : name) = chunks[c].groupChanges[change].name;
+			indices = nullptr;
+		}
+	}
+
+	// Lay the groups out back to back in the order they first appeared, a lone group is moved over as is
+	if (groupIndices.size() == 1)
+	{
+		out.indices.swap(groupIndices[0]);
+		out.groups[0].indexCount = (unsigned int)out.indices.size();
+		return;
+	}
+
+	for (size_t g = 0; g < out.groups.size(); g++)
+	{
+		out.groups[g].startIndex = (unsigned int)out.indices.size();
+		out.groups[g].indexCount = (unsigned int)groupIndices[g].size();
+		out.indices.insert(out.indices.end(), groupIndices[g].begin(), groupIndices[g].end());
+	}
+}
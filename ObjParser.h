@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+
+// Triangles that share the same o/g name and usemtl material, a range of ObjData::indices
+struct ObjGroup
+{
+	std::string name;                    // From the latest o or g record, empty before the first one
+	std::string material;                // From the latest usemtl record, empty before the first one
+	unsigned int startIndex;
+	unsigned int indexCount;
+};
+
+// --------------------------------------------------------
+// Everything the OBJ parser (and GltfParser) hands back,
+// ready to be fed straight into Mesh::GenerateBuffer
+// --------------------------------------------------------
+struct ObjData
+{
+	std::vector<Vertex> verts;           // Final vertices (already converted to left-handed space)
+	std::vector<unsigned int> indices;   // Triangle list indices into verts, grouped by ObjGroup
+	std::vector<ObjGroup> groups;        // At least one whenever there are any triangles
+	size_t cornerCount = 0;              // Vertex count before welding (one per face corner)
+	size_t fileBytes = 0;                // Size of the source text
+	double parseSeconds = 0.0;           // Time spent mapping + parsing
+	bool hasTangents = false;            // Only from formats that store them, OBJ never does
+};
+
+// --------------------------------------------------------
+// Zero-copy Wavefront OBJ parser
+//
+// - The file is memory mapped and walked in place, so there
+//   are no per-line string copies or fixed size line buffers
+// - Numbers are read with a hand written tokenizer rather
+//   than sscanf, which is by far the slowest part of loading
+// - Faces can have any number of corners (fan triangulated)
+//   and any of the v, v/vt, v//vn or v/vt/vn index forms
+// - Corners that share the same position/uv/normal indices
+//   are welded into a single vertex
+// - Faces are grouped by their o/g name and usemtl material,
+//   each group's triangles kept in file order, while every
+//   group shares the one set of welded vertices
+// - Large files are split into line aligned chunks that are
+//   parsed on worker threads, with identical output to a
+//   single threaded parse
+// --------------------------------------------------------
+class ObjParser
+{
+public:
+	// Maps the file at the given path and parses it, false if it couldn't be opened
+	// - A thread count of 0 picks one automatically, and files under a megabyte always get a single thread
+	static bool ParseFile(const char* path, ObjData& out, int threadCount = 0);
+
+	// Parses OBJ text that's already in memory, splitting the work across threads
+	static void Parse(const char* begin, const char* end, ObjData& out, int threadCount = 1);
+};
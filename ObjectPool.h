@@ -0,0 +1,121 @@
+#pragma once
+#include <new>
+#include <utility>
+#include <vector>
+
+// --------------------------------------------------------
+// Fixed size blocks for objects of one type, carved out of
+// contiguous pages instead of a heap allocation each
+//
+// - Destroyed blocks go on a free list and are handed out
+//   again most recently freed first, while they're likely
+//   still in cache. A new page is only added once every
+//   block is taken, and pages are kept until the pool goes
+// - Objects never move, so pointers to them stay valid
+//   until they're destroyed
+// - ForEach walks the live objects page by page, in
+//   address order, which is how iteration should go when
+//   order doesn't matter
+// - The pool destroys whatever is still alive when it
+//   goes, but objects that need something else cleaned up
+//   after them (meshes and their geometry pool) should be
+//   destroyed explicitly first
+// - Not thread safe
+// --------------------------------------------------------
+template <typename T>
+class ObjectPool
+{
+public:
+	ObjectPool(int blocksPerPage = 64) : blocksPerPage(blocksPerPage < 1 ? 1 : blocksPerPage) {}
+
+	~ObjectPool()
+	{
+		ForEach([](T* object) { object->~T(); });
+		for (Block* page : pages)
+			delete[] page;
+	}
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	// Constructs an object in a free block, adding a page if there are none
+	template <typename... Args>
+	T* Create(Args&&... args)
+	{
+		if (!freeList)
+			AddPage();
+
+		// Unlink the block first, constructing the object overwrites the link
+		Block* block = freeList;
+		freeList = block->next;
+		T* object = new (block->storage) T(std::forward<Args>(args)...);
+		block->live = true;
+		liveCount++;
+		return object;
+	}
+
+	// Destroys an object from this pool and puts its block back on the free list (null is ignored)
+	void Destroy(T* object)
+	{
+		if (!object)
+			return;
+
+		object->~T();
+		Block* block = reinterpret_cast<Block*>(object);
+		block->live = false;
+		block->next = freeList;
+		freeList = block;
+		liveCount--;
+	}
+
+	// Calls fn(T*) on every live object, in address order
+	template <typename Fn>
+	void ForEach(Fn fn)
+	{
+		for (Block* page : pages)
+		{
+			for (int i = 0; i < blocksPerPage; i++)
+			{
+				if (page[i].live)
+					fn(reinterpret_cast<T*>(page[i].storage));
+			}
+		}
+	}
+
+	// Occupancy, in objects and in bytes
+	int GetLiveCount() { return liveCount; }
+	int GetCapacity() { return (int)pages.size() * blocksPerPage; }
+	int GetPageCount() { return (int)pages.size(); }
+	size_t GetUsedBytes() { return (size_t)liveCount * sizeof(Block); }
+	size_t GetTotalBytes() { return pages.size() * blocksPerPage * sizeof(Block); }
+
+private:
+	// The object's storage comes first, so an object's address is its block's
+	struct Block
+	{
+		union
+		{
+			alignas(T) unsigned char storage[sizeof(T)];
+			Block* next;                    // Next free block, while this one is free
+		};
+		bool live;
+	};
+
+	// Threads the new page's blocks onto the free list so they're handed out first to last
+	void AddPage()
+	{
+		Block* page = new Block[blocksPerPage];
+		for (int i = 0; i < blocksPerPage; i++)
+		{
+			page[i].live = false;
+			page[i].next = i + 1 < blocksPerPage ? &page[i + 1] : freeList;
+		}
+		freeList = page;
+		pages.push_back(page);
+	}
+
+	int blocksPerPage;
+	std::vector<Block*> pages;
+	Block* freeList = nullptr;
+	int liveCount = 0;
+};
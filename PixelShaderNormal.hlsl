@@ -33,7 +33,7 @@ float4 main(VertexToPixelWithTangent input) : SV_TARGET
 	float2 uv		: TEXCOORD;			// UV coord of the pixel
 	float3 normal	: NORMAL;			// Normal at the pixel's position
 	float3 worldPos	: POSITION;			// Position of the pixel in world space
-	float3 tangent	: TANGENT;
+	float4 tangent	: TANGENT;
 	*/
 
 	//return float4(input. tangent, 0);
@@ -41,7 +41,7 @@ float4 main(VertexToPixelWithTangent input) : SV_TARGET
 
 	input.normal = normalize(input.normal);
 	float3 unpackedNormal = normalTexture.Sample(basicSampler, input.uv).rgb * 2 - 1;
-	input.normal = normalize(mul(unpackedNormal, createTBNMatrix(input.normal, input.tangent)));
+	input.normal = normalize(mul(unpackedNormal, createTBNMatrix(input.normal, input.tangent.xyz, input.tangent.w)));
 
 	float3 toCamera = normalize(cameraPos - input.worldPos);
 	float3 normalizedLightDir = normalize(lightDir);
@@ -0,0 +1,457 @@
+#include "PrimitiveGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <xmmintrin.h>
+
+// Where each float of a Vertex lives
+enum VertexComponent
+{
+	PositionX, PositionY, PositionZ,
+	NormalX, NormalY, NormalZ,
+	TangentX, TangentY, TangentZ,
+	TextureU, TextureV,
+	ComponentCount
+};
+static_assert(sizeof(Vertex) == ComponentCount * sizeof(float), "Vertex has to be tightly packed floats");
+
+// Every component of a ring's vertices is cosine * c + sine * s + constant + fraction * f,
+// where c, s and f come from the vertex's column (the tangent is normalized afterwards)
+struct RingBasis
+{
+	float cosine[ComponentCount];
+	float sine[ComponentCount];
+	float constant[ComponentCount];
+	float fraction[ComponentCount];
+};
+
+// The cosine, sine and fraction of every column, padded to a multiple of 4
+// - The first and last columns sit at the same angle (so the seam can have its own uvs) and get exactly the same values
+struct ColumnTable
+{
+	int count;
+	std::vector<float> cosine;
+	std::vector<float> sine;
+	std::vector<float> fraction;
+};
+
+static ColumnTable BuildColumns(int segments)
+{
+	ColumnTable columns;
+	columns.count = segments + 1;
+	int padded = (columns.count + 3) & ~3;
+	columns.cosine.resize(padded);
+	columns.sine.resize(padded);
+	columns.fraction.resize(padded);
+
+	for (int i = 0; i < padded; i += 4)
+	{
+		float fractions[4];
+		for (int k = 0; k < 4; k++)
+			fractions[k] = std::min(i + k, segments) / (float)segments;
+
+		DirectX::XMVECTOR angles = DirectX::XMVectorScale(DirectX::XMLoadFloat4((DirectX::XMFLOAT4*)fractions), DirectX::XM_2PI);
+		DirectX::XMVECTOR sines, cosines;
+		DirectX::XMVectorSinCos(&sines, &cosines, angles);
+		DirectX::XMStoreFloat4((DirectX::XMFLOAT4*)&columns.cosine[i], cosines);
+		DirectX::XMStoreFloat4((DirectX::XMFLOAT4*)&columns.sine[i], sines);
+		memcpy(&columns.fraction[i], fractions, sizeof(fractions));
+	}
+
+	for (int i = segments; i < padded; i++)
+	{
+		columns.cosine[i] = columns.cosine[0];
+		columns.sine[i] = columns.sine[0];
+	}
+	return columns;
+}
+
+// Fills one vertex per column, four at a time
+// - Each group of four is evaluated as one register per component, then transposed into three registers per vertex
+// - The last register of a vertex spills into the next one, which is written right after, so only the final group
+//   (the one that would spill past the ring) goes through a scratch buffer
+static void EmitRing(const RingBasis& ring, const ColumnTable& columns, Vertex* out)
+{
+	__m128 cosine[ComponentCount], sine[ComponentCount], constant[ComponentCount], fraction[ComponentCount];
+	for (int k = 0; k < ComponentCount; k++)
+	{
+		cosine[k] = _mm_set1_ps(ring.cosine[k]);
+		sine[k] = _mm_set1_ps(ring.sine[k]);
+		constant[k] = _mm_set1_ps(ring.constant[k]);
+		fraction[k] = _mm_set1_ps(ring.fraction[k]);
+	}
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (int i = 0; i < columns.count; i += 4)
+	{
+		__m128 c = _mm_loadu_ps(&columns.cosine[i]);
+		__m128 s = _mm_loadu_ps(&columns.sine[i]);
+		__m128 f = _mm_loadu_ps(&columns.fraction[i]);
+
+		__m128 v[ComponentCount + 1];
+		for (int k = 0; k < ComponentCount; k++)
+			v[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cosine[k], c), _mm_mul_ps(sine[k], s)), _mm_add_ps(constant[k], _mm_mul_ps(fraction[k], f)));
+		v[ComponentCount] = _mm_setzero_ps();
+
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[TangentX], v[TangentX]), _mm_mul_ps(v[TangentY], v[TangentY])), _mm_mul_ps(v[TangentZ], v[TangentZ]));
+		__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+		v[TangentX] = _mm_mul_ps(v[TangentX], inverse);
+		v[TangentY] = _mm_mul_ps(v[TangentY], inverse);
+		v[TangentZ] = _mm_mul_ps(v[TangentZ], inverse);
+
+		// Columns become the first 4, middle 4 and last 3 floats of each vertex
+		_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+		_MM_TRANSPOSE4_PS(v[4], v[5], v[6], v[7]);
+		_MM_TRANSPOSE4_PS(v[8], v[9], v[10], v[11]);
+
+		float scratch[4 * ComponentCount + 1];
+		bool spills = i + 4 >= columns.count;
+		float* dest = spills ? scratch : (float*)(out + i);
+		for (int k = 0; k < 4; k++)
+		{
+			_mm_storeu_ps(dest + k * ComponentCount, v[k]);
+			_mm_storeu_ps(dest + k * ComponentCount + 4, v[4 + k]);
+			_mm_storeu_ps(dest + k * ComponentCount + 8, v[8 + k]);
+		}
+		if (spills)
+			memcpy(out + i, scratch, (columns.count - i) * sizeof(Vertex));
+	}
+}
+
+// Appends the rings' vertices, and two triangles for every quad between neighboring rings
+// - Rings that collapse to a point (poles, tips, cap centers) only get the triangle that isn't degenerate
+static void AddRings(MeshData& data, const std::vector<RingBasis>& rings, const ColumnTable& columns, bool pointFirst, bool pointLast)
+{
+	unsigned int first = (unsigned int)data.verts.size();
+	data.verts.resize(first + rings.size() * columns.count);
+	for (size_t r = 0; r < rings.size(); r++)
+		EmitRing(rings[r], columns, data.verts.data() + first + r * columns.count);
+
+	// With the next column along b and the next ring along c, abc and bdc are clockwise from outside
+	int quads = ((int)rings.size() - 1) * (columns.count - 1);
+	size_t start = data.indices.size();
+	data.indices.resize(start + (size_t)quads * 6 - (pointFirst ? 3 : 0) * (columns.count - 1) - (pointLast ? 3 : 0) * (columns.count - 1));
+	unsigned int* out = data.indices.data() + start;
+	for (int r = 0; r + 1 < (int)rings.size(); r++)
+	{
+		bool upper = !(pointFirst && r == 0);
+		bool lower = !(pointLast && r + 2 == (int)rings.size());
+		for (int i = 0; i + 1 < columns.count; i++)
+		{
+			unsigned int a = first + r * columns.count + i;
+			unsigned int b = a + 1;
+			unsigned int c = a + columns.count;
+			unsigned int d = c + 1;
+			if (upper)
+			{
+				out[0] = a; out[1] = b; out[2] = c;
+				out += 3;
+			}
+			if (lower)
+			{
+				out[0] = b; out[1] = d; out[2] = c;
+				out += 3;
+			}
+		}
+	}
+}
+
+// A ring of a surface spun around Y, from a point on its profile and the profile's normal there
+// - Moving from one ring to the next has to turn the normal's way, which keeps the uvs unmirrored too
+static RingBasis RevolvedRing(float radius, float height, float normalRadius, float normalHeight, float v)
+{
+	RingBasis ring = {};
+	ring.cosine[PositionX] = radius;
+	ring.constant[PositionY] = height;
+	ring.sine[PositionZ] = radius;
+	ring.cosine[NormalX] = normalRadius;
+	ring.constant[NormalY] = normalHeight;
+	ring.sine[NormalZ] = normalRadius;
+	ring.sine[TangentX] = -1.0f;
+	ring.cosine[TangentZ] = 1.0f;
+	ring.fraction[TextureU] = 1.0f;
+	ring.constant[TextureV] = v;
+	return ring;
+}
+
+// A ring of a flat disc facing straight up or down, with the texture projected onto it from above or below
+static RingBasis CapRing(float radius, float height, float capRadius, bool up)
+{
+	RingBasis ring = {};
+	ring.cosine[PositionX] = radius;
+	ring.constant[PositionY] = height;
+	ring.sine[PositionZ] = radius;
+	ring.constant[NormalY] = up ? 1.0f : -1.0f;
+	ring.constant[TangentX] = 1.0f;
+	ring.cosine[TextureU] = 0.5f * radius / capRadius;
+	ring.constant[TextureU] = 0.5f;
+	ring.sine[TextureV] = (up ? -0.5f : 0.5f) * radius / capRadius;
+	ring.constant[TextureV] = 0.5f;
+	return ring;
+}
+
+// A cap for a shape spun around Y, the top one goes center to rim and the bottom one rim to center
+static void AddCap(MeshData& data, const ColumnTable& columns, float radius, float height, bool up)
+{
+	std::vector<RingBasis> rings;
+	rings.push_back(CapRing(up ? 0.0f : radius, height, radius, up));
+	rings.push_back(CapRing(up ? radius : 0.0f, height, radius, up));
+	AddRings(data, rings, columns, up, !up);
+}
+
+// Starts the data over as a single submesh named after the shape
+// - The arrays keep their memory, so generating into the same data again doesn't allocate
+static void BeginShape(MeshData& data, const char* name)
+{
+	data.verts.clear();
+	data.indices.clear();
+	data.lods.clear();
+	data.clusters.clear();
+	data.submeshes.clear();
+	data.boundsMin = DirectX::XMFLOAT3(0, 0, 0);
+	data.boundsMax = DirectX::XMFLOAT3(0, 0, 0);
+	data.processFlags = MESH_PROCESS_NONE;
+
+	MeshSubmesh whole = {};
+	snprintf(whole.name, sizeof(whole.name), "%s", name);
+	data.submeshes.push_back(whole);
+}
+
+static void EndShape(MeshData& data)
+{
+	data.submeshes[0].indexCount = (unsigned int)data.indices.size();
+}
+
+void PrimitiveGenerator::Sphere(MeshData& data, float radius, int slices, int stacks)
+{
+	slices = std::max(slices, 3);
+	stacks = std::max(stacks, 2);
+	BeginShape(data, "sphere");
+
+	std::vector<RingBasis> rings;
+	for (int j = 0; j <= stacks; j++)
+	{
+		float angle = DirectX::XM_PI * j / stacks;
+		float s = j == stacks ? 0.0f : sinf(angle);
+		float c = cosf(angle);
+		rings.push_back(RevolvedRing(radius * s, radius * c, s, c, j / (float)stacks));
+	}
+	AddRings(data, rings, BuildColumns(slices), true, true);
+
+	EndShape(data);
+}
+
+// Each face is a grid with u along its tangent and v along cross(normal, tangent)
+void PrimitiveGenerator::Cube(MeshData& data, float size, int subdivisions)
+{
+	subdivisions = std::max(subdivisions, 1);
+	BeginShape(data, "cube");
+
+	// Sides have the texture upright, the top and bottom have it facing +Z
+	const DirectX::XMFLOAT3 faces[6][2] = {
+		{ DirectX::XMFLOAT3(1, 0, 0), DirectX::XMFLOAT3(0, 0, 1) },
+		{ DirectX::XMFLOAT3(-1, 0, 0), DirectX::XMFLOAT3(0, 0, -1) },
+		{ DirectX::XMFLOAT3(0, 1, 0), DirectX::XMFLOAT3(1, 0, 0) },
+		{ DirectX::XMFLOAT3(0, -1, 0), DirectX::XMFLOAT3(1, 0, 0) },
+		{ DirectX::XMFLOAT3(0, 0, 1), DirectX::XMFLOAT3(-1, 0, 0) },
+		{ DirectX::XMFLOAT3(0, 0, -1), DirectX::XMFLOAT3(1, 0, 0) } };
+
+	ColumnTable columns = BuildColumns(subdivisions);
+	float half = size * 0.5f;
+	for (int f = 0; f < 6; f++)
+	{
+		DirectX::XMVECTOR normal = DirectX::XMLoadFloat3(&faces[f][0]);
+		DirectX::XMVECTOR u = DirectX::XMLoadFloat3(&faces[f][1]);
+		DirectX::XMVECTOR v = DirectX::XMVector3Cross(normal, u);
+		DirectX::XMFLOAT3 axes[3];
+		DirectX::XMStoreFloat3(&axes[0], normal);
+		DirectX::XMStoreFloat3(&axes[1], u);
+		DirectX::XMStoreFloat3(&axes[2], v);
+		const float* n = &axes[0].x;
+		const float* uAxis = &axes[1].x;
+		const float* vAxis = &axes[2].x;
+
+		std::vector<RingBasis> rows;
+		for (int j = 0; j <= subdivisions; j++)
+		{
+			float along = j / (float)subdivisions;
+			RingBasis row = {};
+			for (int k = 0; k < 3; k++)
+			{
+				row.constant[PositionX + k] = (n[k] - uAxis[k] + vAxis[k] * (2.0f * along - 1.0f)) * half;
+				row.fraction[PositionX + k] = uAxis[k] * size;
+				row.constant[NormalX + k] = n[k];
+				row.constant[TangentX + k] = uAxis[k];
+			}
+			row.fraction[TextureU] = 1.0f;
+			row.constant[TextureV] = along;
+			rows.push_back(row);
+		}
+		AddRings(data, rows, columns, false, false);
+	}
+
+	EndShape(data);
+}
+
+void PrimitiveGenerator::Cylinder(MeshData& data, float radius, float height, int slices, int stacks)
+{
+	slices = std::max(slices, 3);
+	stacks = std::max(stacks, 1);
+	BeginShape(data, "cylinder");
+
+	ColumnTable columns = BuildColumns(slices);
+	float half = height * 0.5f;
+	std::vector<RingBasis> rings;
+	for (int j = 0; j <= stacks; j++)
+		rings.push_back(RevolvedRing(radius, half - height * j / stacks, 1.0f, 0.0f, j / (float)stacks));
+	AddRings(data, rings, columns, false, false);
+	AddCap(data, columns, radius, half, true);
+	AddCap(data, columns, radius, -half, false);
+
+	EndShape(data);
+}
+
+// The side's normals all lean up by the same amount, including the ones at the tip
+void PrimitiveGenerator::Cone(MeshData& data, float radius, float height, int slices, int stacks)
+{
+	slices = std::max(slices, 3);
+	stacks = std::max(stacks, 1);
+	BeginShape(data, "cone");
+
+	ColumnTable columns = BuildColumns(slices);
+	float half = height * 0.5f;
+	float slant = sqrtf(radius * radius + height * height);
+	std::vector<RingBasis> rings;
+	for (int j = 0; j <= stacks; j++)
+	{
+		float along = j / (float)stacks;
+		rings.push_back(RevolvedRing(radius * along, half - height * along, height / slant, radius / slant, along));
+	}
+	AddRings(data, rings, columns, true, false);
+	AddCap(data, columns, radius, -half, false);
+
+	EndShape(data);
+}
+
+// The tube's profile circle is walked outside edge first, going down, so its normal turns the right way
+void PrimitiveGenerator::Torus(MeshData& data, float majorRadius, float minorRadius, int majorSegments, int minorSegments)
+{
+	majorSegments = std::max(majorSegments, 3);
+	minorSegments = std::max(minorSegments, 3);
+	BeginShape(data, "torus");
+
+	std::vector<RingBasis> rings;
+	for (int j = 0; j <= minorSegments; j++)
+	{
+		float angle = DirectX::XM_2PI * (j % minorSegments) / minorSegments;
+		float c = cosf(angle);
+		float s = sinf(angle);
+		rings.push_back(RevolvedRing(majorRadius + minorRadius * c, -minorRadius * s, c, -s, j / (float)minorSegments));
+	}
+	AddRings(data, rings, BuildColumns(majorSegments), false, false);
+
+	EndShape(data);
+}
+
+// A circle swept along the helix in its Frenet frame (N points at the axis, B = T x N)
+// - Rings go along the helix with u, and columns go around the tube with v
+// - The tangent is the exact derivative along the helix, which leans off T by how far out the vertex is on the tube
+void PrimitiveGenerator::Helix(MeshData& data, float radius, float tubeRadius, float height, float turns, int segments, int tubeSegments)
+{
+	segments = std::max(segments, 1);
+	tubeSegments = std::max(tubeSegments, 3);
+	BeginShape(data, "helix");
+
+	ColumnTable columns = BuildColumns(tubeSegments);
+	float totalAngle = DirectX::XM_2PI * turns;
+	float climb = height / totalAngle;
+	float length = sqrtf(radius * radius + climb * climb);
+
+	std::vector<RingBasis> rings;
+	DirectX::XMFLOAT3 frames[2][4];
+	for (int j = 0; j <= segments; j++)
+	{
+		float along = j / (float)segments;
+		float t = totalAngle * along;
+		float c = cosf(t);
+		float s = sinf(t);
+
+		// The curve, its first and second derivatives, and how the frame turns
+		DirectX::XMVECTOR center = DirectX::XMVectorSet(radius * c, climb * t - height * 0.5f, radius * s, 0);
+		DirectX::XMVECTOR velocity = DirectX::XMVectorSet(-radius * s, climb, radius * c, 0);
+		DirectX::XMVECTOR acceleration = DirectX::XMVectorSet(-radius * c, 0, -radius * s, 0);
+		DirectX::XMVECTOR tangent = DirectX::XMVectorScale(velocity, 1.0f / length);
+		DirectX::XMVECTOR normal = DirectX::XMVectorSet(-c, 0, -s, 0);
+		DirectX::XMVECTOR binormal = DirectX::XMVector3Cross(tangent, normal);
+		DirectX::XMVECTOR normalTurn = DirectX::XMVectorSet(s, 0, -c, 0);
+		DirectX::XMVECTOR binormalTurn = DirectX::XMVectorAdd(
+			DirectX::XMVector3Cross(DirectX::XMVectorScale(acceleration, 1.0f / length), normal),
+			DirectX::XMVector3Cross(tangent, normalTurn));
+
+		DirectX::XMFLOAT3 p, n, b, dn, db, v;
+		DirectX::XMStoreFloat3(&p, center);
+		DirectX::XMStoreFloat3(&n, normal);
+		DirectX::XMStoreFloat3(&b, binormal);
+		DirectX::XMStoreFloat3(&dn, normalTurn);
+		DirectX::XMStoreFloat3(&db, binormalTurn);
+		DirectX::XMStoreFloat3(&v, velocity);
+
+		RingBasis ring = {};
+		for (int k = 0; k < 3; k++)
+		{
+			ring.constant[PositionX + k] = (&p.x)[k];
+			ring.cosine[PositionX + k] = (&n.x)[k] * tubeRadius;
+			ring.sine[PositionX + k] = (&b.x)[k] * tubeRadius;
+			ring.cosine[NormalX + k] = (&n.x)[k];
+			ring.sine[NormalX + k] = (&b.x)[k];
+			ring.constant[TangentX + k] = (&v.x)[k];
+			ring.cosine[TangentX + k] = (&dn.x)[k] * tubeRadius;
+			ring.sine[TangentX + k] = (&db.x)[k] * tubeRadius;
+		}
+		ring.constant[TextureU] = along;
+		ring.fraction[TextureV] = -1.0f;
+		ring.constant[TextureV] = 1.0f;
+		rings.push_back(ring);
+
+		// Keep the end frames for the caps
+		if (j == 0 || j == segments)
+		{
+			DirectX::XMFLOAT3* frame = frames[j == 0 ? 0 : 1];
+			frame[0] = p;
+			DirectX::XMStoreFloat3(&frame[1], tangent);
+			frame[2] = n;
+			frame[3] = b;
+		}
+	}
+	AddRings(data, rings, columns, false, false);
+
+	// Flat caps facing back along the helix at the start and forward at the end, textured in the frame's plane
+	for (int end = 0; end < 2; end++)
+	{
+		const DirectX::XMFLOAT3* frame = frames[end];
+		float facing = end == 0 ? -1.0f : 1.0f;
+		std::vector<RingBasis> capRings;
+		for (int r = 0; r < 2; r++)
+		{
+			float capRadius = (r == 0) == (end == 0) ? 0.0f : tubeRadius;
+			RingBasis ring = {};
+			for (int k = 0; k < 3; k++)
+			{
+				ring.constant[PositionX + k] = (&frame[0].x)[k];
+				ring.cosine[PositionX + k] = (&frame[2].x)[k] * capRadius;
+				ring.sine[PositionX + k] = (&frame[3].x)[k] * capRadius;
+				ring.constant[NormalX + k] = (&frame[1].x)[k] * facing;
+				ring.constant[TangentX + k] = (&frame[2].x)[k];
+			}
+			ring.cosine[TextureU] = 0.5f * capRadius / tubeRadius;
+			ring.constant[TextureU] = 0.5f;
+			ring.sine[TextureV] = 0.5f * facing * capRadius / tubeRadius;
+			ring.constant[TextureV] = 0.5f;
+			capRings.push_back(ring);
+		}
+		AddRings(data, capRings, columns, end == 0, end == 1);
+	}
+
+	EndShape(data);
+}
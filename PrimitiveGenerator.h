@@ -0,0 +1,40 @@
+#pragma once
+#include "Mesh.h"
+
+// --------------------------------------------------------
+// Builds the basic shapes straight into MeshData, so they
+// don't need any files and can be made at any density
+//
+// - Normals and tangents are exact (taken from the shape's
+//   own derivatives), so CalculateTangents isn't needed
+// - Tangents point along increasing u, with uvs laid out so
+//   the bitangent is never mirrored (the same handedness
+//   imported meshes have)
+// - Every shape is a set of rings whose vertices depend
+//   only on the cosine, sine and fraction of their column,
+//   so rings are filled four vertices at a time with SSE
+// - Front faces are clockwise, like everything else
+// - The data comes back as one submesh named after the
+//   shape, ready for Mesh::ProcessData
+// --------------------------------------------------------
+class PrimitiveGenerator
+{
+public:
+	// Sphere around the origin, slices go around Y and stacks go from pole to pole
+	static void Sphere(MeshData& data, float radius = 0.5f, int slices = 48, int stacks = 24);
+
+	// Axis aligned cube around the origin, each face split into a grid of subdivisions x subdivisions quads
+	static void Cube(MeshData& data, float size = 1.0f, int subdivisions = 4);
+
+	// Capped cylinder along Y, centered on the origin
+	static void Cylinder(MeshData& data, float radius = 0.5f, float height = 1.0f, int slices = 48, int stacks = 4);
+
+	// Capped cone along Y with its tip at the top, centered on the origin
+	static void Cone(MeshData& data, float radius = 0.5f, float height = 1.0f, int slices = 48, int stacks = 4);
+
+	// Torus lying flat around Y, majorRadius is to the middle of the tube
+	static void Torus(MeshData& data, float majorRadius = 0.5f, float minorRadius = 0.2f, int majorSegments = 64, int minorSegments = 24);
+
+	// Capped tube winding around Y, centered on the origin
+	static void Helix(MeshData& data, float radius = 0.5f, float tubeRadius = 0.15f, float height = 2.0f, float turns = 2.0f, int segments = 128, int tubeSegments = 16);
+};
@@ -0,0 +1,530 @@
+#include "ProgressiveMesh.h"
+#include "MeshSimplifier.h"
+#include "MeshCodec.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <queue>
+
+// A collapse undone, in the numbering of the original triangles and vertices
+struct ProgressiveSplit
+{
+	unsigned int submesh;
+	unsigned int vertex;                    // Comes back, and every corner below moves back onto it
+	std::vector<unsigned int> corners;      // Triangle * 3 + corner
+	std::vector<unsigned int> triangles;    // Come back with the corners they had before the collapse
+	float residualError;                    // Largest error of the collapses still left in its submesh once it's undone
+};
+
+static void WriteVarint(std::vector<unsigned char>& out, unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+static bool ReadVarint(const unsigned char*& data, const unsigned char* end, unsigned int& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35 && data < end; shift += 7)
+	{
+		unsigned char byte = *data++;
+		value |= (unsigned int)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// Simplifies each submesh as far as it'll go, then replays its collapses on the full triangles to see what each one changed
+// - Returns the splits of every submesh in the order they'd be undone, and leaves the triangles the base mesh keeps alive
+static void BuildSplits(const MeshData& data, const std::vector<MeshSubmesh>& submeshes, std::vector<unsigned int>& triangles,
+	std::vector<unsigned char>& alive, std::vector<std::vector<ProgressiveSplit>>& splits, std::vector<float>& baseErrors)
+{
+	int numVerts = (int)data.verts.size();
+	float scale = MeshSimplifier::GetMeshScale(data.verts.data(), numVerts);
+	std::vector<unsigned int> simplified;
+	std::vector<SimplifyCollapse> collapses;
+	std::vector<std::vector<unsigned int>> vertexTriangles(numVerts);
+
+	splits.resize(submeshes.size());
+	baseErrors.assign(submeshes.size(), 0.0f);
+	for (size_t s = 0; s < submeshes.size(); s++)
+	{
+		unsigned int firstTriangle = submeshes[s].startIndex / 3;
+		unsigned int triangleCount = submeshes[s].indexCount / 3;
+		const unsigned int* indices = data.indices.data() + submeshes[s].startIndex;
+		simplified.resize(submeshes[s].indexCount);
+		int target = (int)(triangleCount / ProgressiveMesh::BaseTriangleDivisor) * 3;
+		MeshSimplifier::Simplify(data.verts.data(), numVerts, indices, (int)submeshes[s].indexCount, target, 1.0f, simplified.data(), nullptr, &collapses);
+
+		for (unsigned int t = firstTriangle; t < firstTriangle + triangleCount; t++)
+		{
+			for (int c = 0; c < 3; c++)
+				vertexTriangles[triangles[t * 3 + c]].push_back(t);
+		}
+
+		// Collapses only ever move corners onto vertices that stay, so each vertex's list stays exact until it collapses itself
+		std::vector<ProgressiveSplit>& submeshSplits = splits[s];
+		submeshSplits.resize(collapses.size());
+		for (size_t i = 0; i < collapses.size(); i++)
+		{
+			unsigned int from = collapses[i].from;
+			unsigned int to = collapses[i].to;
+			ProgressiveSplit& split = submeshSplits[i];
+			split.submesh = (unsigned int)s;
+			split.vertex = from;
+
+			std::vector<unsigned int>& around = vertexTriangles[from];
+			for (size_t a = 0; a < around.size(); a++)
+			{
+				unsigned int t = around[a];
+				unsigned int* tri = triangles.data() + t * 3;
+				if (!alive[t] || (a > 0 && around[a - 1] == t))
+					continue;
+
+				if (tri[0] == to || tri[1] == to || tri[2] == to)
+				{
+					alive[t] = 0;
+					split.triangles.push_back(t);
+					continue;
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					if (tri[c] == from)
+					{
+						tri[c] = to;
+						split.corners.push_back(t * 3 + c);
+					}
+				}
+				vertexTriangles[to].push_back(t);
+			}
+			around.clear();
+			around.shrink_to_fit();
+		}
+
+		// Once a split is undone, only the collapses made before it are left
+		float worst = 0.0f;
+		for (size_t i = 0; i < submeshSplits.size(); i++)
+		{
+			submeshSplits[i].residualError = worst * scale;
+			worst = std::max(worst, collapses[i].error);
+		}
+		baseErrors[s] = worst * scale;
+		std::reverse(submeshSplits.begin(), submeshSplits.end());
+
+		for (unsigned int t = firstTriangle; t < firstTriangle + triangleCount; t++)
+		{
+			for (int c = 0; c < 3; c++)
+				vertexTriangles[triangles[t * 3 + c]].clear();
+		}
+	}
+}
+
+void ProgressiveMesh::Encode(const MeshData& data, std::vector<unsigned char>& out)
+{
+	// Data without submeshes is treated as a single one covering every index
+	std::vector<MeshSubmesh> submeshes = data.submeshes;
+	if (submeshes.empty())
+	{
+		MeshSubmesh whole = {};
+		whole.indexCount = (unsigned int)data.indices.size();
+		submeshes.push_back(whole);
+	}
+	for (size_t s = 0; s < submeshes.size(); s++)
+	{
+		submeshes[s].firstLod = submeshes[s].lodCount = 0;
+		submeshes[s].firstCluster = submeshes[s].clusterCount = 0;
+	}
+
+	// The triangles end up collapsed down to the base mesh, and each split remembers what it undoes
+	unsigned int indexCount = submeshes.back().startIndex + submeshes.back().indexCount;
+	std::vector<unsigned int> triangles(data.indices.begin(), data.indices.begin() + indexCount);
+	std::vector<unsigned char> alive(indexCount / 3, 1);
+	std::vector<std::vector<ProgressiveSplit>> splits;
+	std::vector<float> baseErrors;
+	BuildSplits(data, submeshes, triangles, alive, splits, baseErrors);
+
+	// Interleave the submeshes' splits, always refining whichever submesh is currently the furthest off
+	std::vector<const ProgressiveSplit*> order;
+	std::vector<float> orderErrors;
+	std::priority_queue<std::pair<float, unsigned int>> worst;
+	std::vector<size_t> next(submeshes.size(), 0);
+	float baseError = 0.0f;
+	for (size_t s = 0; s < submeshes.size(); s++)
+	{
+		baseError = std::max(baseError, baseErrors[s]);
+		if (!splits[s].empty())
+			worst.push(std::make_pair(baseErrors[s], (unsigned int)s));
+	}
+	while (!worst.empty())
+	{
+		unsigned int s = worst.top().second;
+		worst.pop();
+		const ProgressiveSplit& split = splits[s][next[s]++];
+		order.push_back(&split);
+		if (next[s] < splits[s].size())
+			worst.push(std::make_pair(split.residualError, s));
+		orderErrors.push_back(worst.empty() ? 0.0f : worst.top().first);
+	}
+
+	// Vertices are numbered in the order they're first needed, and triangles in the order they come back
+	std::vector<unsigned int> vertexNumbers(data.verts.size(), UINT_MAX);
+	std::vector<unsigned int> vertexOrder;
+	std::vector<unsigned int> positions(indexCount / 3);     // Where each triangle sits in its submesh's range
+	std::vector<unsigned int> residentIndices(submeshes.size(), 0);
+	auto number = [&](unsigned int v) {
+		if (vertexNumbers[v] == UINT_MAX)
+		{
+			vertexNumbers[v] = (unsigned int)vertexOrder.size();
+			vertexOrder.push_back(v);
+		}
+		return vertexNumbers[v];
+	};
+
+	ProgressiveMeshHeader header = {};
+	memcpy(header.magic, "PMSH", 4);
+	header.version = PROGRESSIVE_MESH_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.indexCount = indexCount;
+	header.submeshCount = (unsigned int)submeshes.size();
+	header.splitCount = (unsigned int)order.size();
+	header.chunkCount = 1 + (header.splitCount + ChunkSplits - 1) / ChunkSplits;
+	header.boundsMin = data.boundsMin;
+	header.boundsMax = data.boundsMax;
+
+	out.clear();
+	out.resize(sizeof(header) + submeshes.size() * sizeof(MeshSubmesh));
+	memcpy(out.data() + sizeof(header), submeshes.data(), submeshes.size() * sizeof(MeshSubmesh));
+
+	// Every chunk is numbered first (its records can only refer to vertices that exist once its own are appended), then written
+	std::vector<unsigned char> records;
+	std::vector<unsigned char> encodedVertices;
+	std::vector<Vertex> chunkVertices;
+	std::vector<unsigned int> corners;
+	for (unsigned int chunk = 0; chunk < header.chunkCount; chunk++)
+	{
+		unsigned int chunkFirstVertex = (unsigned int)vertexOrder.size();
+		size_t firstSplit = chunk == 0 ? 0 : (size_t)(chunk - 1) * ChunkSplits;
+		size_t endSplit = chunk == 0 ? 0 : std::min(order.size(), firstSplit + ChunkSplits);
+
+		if (chunk == 0)
+		{
+			for (size_t s = 0; s < submeshes.size(); s++)
+			{
+				for (unsigned int t = submeshes[s].startIndex / 3; t < (submeshes[s].startIndex + submeshes[s].indexCount) / 3; t++)
+				{
+					if (alive[t])
+						for (int c = 0; c < 3; c++)
+							number(triangles[t * 3 + c]);
+				}
+			}
+		}
+		for (size_t i = firstSplit; i < endSplit; i++)
+		{
+			number(order[i]->vertex);
+			for (unsigned int t : order[i]->triangles)
+				for (int c = 0; c < 3; c++)
+					number(triangles[t * 3 + c]);
+		}
+
+		// A chunk's vertices all arrive before its records, so they can go in any order, and the original order
+		// (vertex fetch optimized) keeps neighbors together for MeshCodec's deltas
+		unsigned int vertexEnd = (unsigned int)vertexOrder.size();
+		std::sort(vertexOrder.begin() + chunkFirstVertex, vertexOrder.end());
+		for (unsigned int v = chunkFirstVertex; v < vertexEnd; v++)
+			vertexNumbers[vertexOrder[v]] = v;
+
+		// Vertices are referred to by how far back from the newest one they are, and split triangles use 0 for the split vertex
+		auto writeVertex = [&](unsigned int v) { WriteVarint(records, vertexEnd - 1 - vertexNumbers[v]); };
+		auto writeTriangle = [&](unsigned int t, const ProgressiveSplit* split) {
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = triangles[t * 3 + c];
+				if (!split)
+					writeVertex(v);
+				else if (v == split->vertex)
+					WriteVarint(records, 0);
+				else
+					WriteVarint(records, vertexEnd - vertexNumbers[v]);
+			}
+		};
+
+		// Records: submesh, triangle count, then for splits the corner count, the vertex and the corners, then the triangles
+		records.clear();
+		unsigned int recordCount = 0;
+		if (chunk == 0)
+		{
+			for (size_t s = 0; s < submeshes.size(); s++)
+			{
+				std::vector<unsigned int> base;
+				for (unsigned int t = submeshes[s].startIndex / 3; t < (submeshes[s].startIndex + submeshes[s].indexCount) / 3; t++)
+					if (alive[t])
+						base.push_back(t);
+
+				WriteVarint(records, (unsigned int)s);
+				WriteVarint(records, (unsigned int)base.size());
+				for (unsigned int t : base)
+				{
+					positions[t] = residentIndices[s] / 3;
+					residentIndices[s] += 3;
+					writeTriangle(t, nullptr);
+				}
+				recordCount++;
+			}
+		}
+		for (size_t i = firstSplit; i < endSplit; i++)
+		{
+			const ProgressiveSplit& split = *order[i];
+			WriteVarint(records, split.submesh);
+			WriteVarint(records, (unsigned int)split.triangles.size());
+			WriteVarint(records, (unsigned int)split.corners.size());
+			writeVertex(split.vertex);
+
+			// Corners are sorted by where they sit in the submesh's range, and stored as gaps
+			corners.clear();
+			for (unsigned int corner : split.corners)
+				corners.push_back(positions[corner / 3] * 3 + corner % 3);
+			std::sort(corners.begin(), corners.end());
+			unsigned int previous = 0;
+			for (unsigned int corner : corners)
+			{
+				WriteVarint(records, corner - previous);
+				previous = corner;
+			}
+
+			for (unsigned int t : split.triangles)
+			{
+				positions[t] = residentIndices[split.submesh] / 3;
+				residentIndices[split.submesh] += 3;
+				writeTriangle(t, &split);
+			}
+			recordCount++;
+		}
+
+		chunkVertices.resize(vertexEnd - chunkFirstVertex);
+		for (unsigned int v = chunkFirstVertex; v < vertexEnd; v++)
+			chunkVertices[v - chunkFirstVertex] = data.verts[vertexOrder[v]];
+		encodedVertices.clear();
+		MeshCodec::EncodeVertices(chunkVertices.data(), (int)chunkVertices.size(), sizeof(Vertex), encodedVertices);
+		encodedVertices.resize((encodedVertices.size() + 3) & ~(size_t)3, 0);
+
+		ProgressiveMeshChunk chunkHeader = {};
+		chunkHeader.vertexCount = vertexEnd - chunkFirstVertex;
+		chunkHeader.vertexBytes = (unsigned int)encodedVertices.size();
+		chunkHeader.recordCount = recordCount;
+		chunkHeader.bytes = chunkHeader.vertexBytes + (unsigned int)records.size();
+		chunkHeader.error = chunk == 0 ? baseError : orderErrors[endSplit - 1];
+
+		size_t at = out.size();
+		out.resize(at + sizeof(chunkHeader) + chunkHeader.bytes);
+		memcpy(out.data() + at, &chunkHeader, sizeof(chunkHeader));
+		memcpy(out.data() + at + sizeof(chunkHeader), encodedVertices.data(), encodedVertices.size());
+		memcpy(out.data() + at + sizeof(chunkHeader) + encodedVertices.size(), records.data(), records.size());
+	}
+
+	header.vertexCount = (unsigned int)vertexOrder.size();
+	header.totalBytes = (unsigned int)out.size();
+	memcpy(out.data(), &header, sizeof(header));
+}
+
+bool ProgressiveMesh::Write(const char* path, const MeshData& data)
+{
+	std::vector<unsigned char> encoded;
+	Encode(data, encoded);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	out.write((const char*)encoded.data(), encoded.size());
+	return out.good();
+}
+
+// Buffers the bytes, then applies every chunk that's fully arrived
+bool ProgressiveMeshStream::Append(const void* data, size_t size)
+{
+	if (failed)
+		return false;
+
+	pending.insert(pending.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+	bytesReceived += size;
+
+	// The header and submesh table come first, and size everything else
+	if (!hasHeader)
+	{
+		if (pending.size() < sizeof(header))
+			return true;
+		memcpy(&header, pending.data(), sizeof(header));
+		if (memcmp(header.magic, "PMSH", 4) != 0 || header.version != PROGRESSIVE_MESH_VERSION || header.vertexStride != sizeof(Vertex) ||
+			header.indexCount % 3 != 0 || header.totalBytes < sizeof(header) || header.submeshCount == 0 || header.submeshCount > header.indexCount / 3 + 1 || header.chunkCount == 0)
+		{
+			failed = true;
+			return false;
+		}
+
+		// Corrupt or hostile counts would otherwise turn straight into huge allocations
+		unsigned long long elementLimit = (unsigned long long)header.totalBytes * MaxElementsPerByte;
+		if (header.vertexCount > MaxVertices || header.indexCount > MaxIndices ||
+			header.vertexCount > elementLimit || header.indexCount > elementLimit)
+		{
+			failed = true;
+			return false;
+		}
+
+		size_t tableBytes = (size_t)header.submeshCount * sizeof(MeshSubmesh);
+		if (pending.size() < sizeof(header) + tableBytes)
+			return true;
+		submeshes.resize(header.submeshCount);
+		memcpy(submeshes.data(), pending.data() + sizeof(header), tableBytes);
+		for (size_t s = 0; s < submeshes.size(); s++)
+		{
+			if (submeshes[s].startIndex % 3 != 0 || submeshes[s].indexCount % 3 != 0 ||
+				(size_t)submeshes[s].startIndex + submeshes[s].indexCount > header.indexCount)
+			{
+				failed = true;
+				return false;
+			}
+		}
+
+		verts.assign(header.vertexCount, Vertex());
+		indices.assign(header.indexCount, 0);
+		residentIndices.assign(header.submeshCount, 0);
+		dirtyBlocks.assign((header.indexCount + DirtyBlockIndices - 1) / DirtyBlockIndices, 0);
+		pendingStart = sizeof(header) + tableBytes;
+		hasHeader = true;
+	}
+
+	while (chunksApplied < header.chunkCount && pending.size() - pendingStart >= sizeof(ProgressiveMeshChunk))
+	{
+		ProgressiveMeshChunk chunk;
+		memcpy(&chunk, pending.data() + pendingStart, sizeof(chunk));
+		if (pending.size() - pendingStart - sizeof(chunk) < chunk.bytes)
+			break;
+
+		if (!DecodeChunk(pending.data() + pendingStart, sizeof(chunk) + (size_t)chunk.bytes))
+		{
+			failed = true;
+			return false;
+		}
+		pendingStart += sizeof(chunk) + chunk.bytes;
+		chunksApplied++;
+	}
+
+	// Drop what's been decoded, so only a partial chunk is ever held on to
+	pending.erase(pending.begin(), pending.begin() + pendingStart);
+	pendingStart = 0;
+	return true;
+}
+
+// Appends the chunk's vertices, then applies its records in order
+bool ProgressiveMeshStream::DecodeChunk(const unsigned char* data, size_t size)
+{
+	ProgressiveMeshChunk chunk;
+	memcpy(&chunk, data, sizeof(chunk));
+	const unsigned char* encoded = data + sizeof(chunk);
+	const unsigned char* end = data + size;
+	if (chunk.vertexBytes > chunk.bytes || chunk.vertexCount > header.vertexCount - residentVertexCount)
+		return false;
+	if (!MeshCodec::DecodeVertices(encoded, chunk.vertexBytes, verts.data() + residentVertexCount, chunk.vertexCount, sizeof(Vertex)))
+		return false;
+	residentVertexCount += chunk.vertexCount;
+
+	const unsigned char* c = encoded + chunk.vertexBytes;
+	auto readVertex = [&](unsigned int& v) {
+		unsigned int back;
+		if (!ReadVarint(c, end, back) || back >= (unsigned int)residentVertexCount)
+			return false;
+		v = residentVertexCount - 1 - back;
+		return true;
+	};
+	auto markDirty = [&](unsigned int index) { dirtyBlocks[index / DirtyBlockIndices] = 1; };
+
+	// The base chunk's records are plain triangle lists, every other record is a split
+	bool splits = chunksApplied > 0;
+	for (unsigned int r = 0; r < chunk.recordCount; r++)
+	{
+		unsigned int s, triangleCount;
+		if (!ReadVarint(c, end, s) || s >= header.submeshCount || !ReadVarint(c, end, triangleCount))
+			return false;
+
+		MeshSubmesh& submesh = submeshes[s];
+		if (triangleCount > (submesh.indexCount - residentIndices[s]) / 3)
+			return false;
+
+		// Corners move back onto the split vertex
+		unsigned int vertex = 0;
+		if (splits)
+		{
+			unsigned int cornerCount;
+			if (!ReadVarint(c, end, cornerCount) || cornerCount > residentIndices[s] || !readVertex(vertex))
+				return false;
+
+			unsigned int corner = 0;
+			for (unsigned int i = 0; i < cornerCount; i++)
+			{
+				unsigned int gap;
+				if (!ReadVarint(c, end, gap) || gap >= residentIndices[s])
+					return false;
+				corner += gap;
+				if (corner >= residentIndices[s])
+					return false;
+				indices[submesh.startIndex + corner] = vertex;
+				markDirty(submesh.startIndex + corner);
+			}
+		}
+
+		// Triangles go on the end of the submesh's resident range
+		for (unsigned int t = 0; t < triangleCount * 3; t++)
+		{
+			unsigned int index = submesh.startIndex + residentIndices[s];
+			if (!splits)
+			{
+				if (!readVertex(indices[index]))
+					return false;
+			}
+			else
+			{
+				unsigned int back;
+				if (!ReadVarint(c, end, back) || back > (unsigned int)residentVertexCount)
+					return false;
+				indices[index] = back == 0 ? vertex : residentVertexCount - back;
+			}
+			markDirty(index);
+			residentIndices[s]++;
+		}
+		residentTriangleCount += triangleCount;
+	}
+
+	residentError = chunk.error;
+	return c == end;
+}
+
+bool ProgressiveMeshStream::HasBase() { return chunksApplied > 0; }
+bool ProgressiveMeshStream::IsComplete() { return hasHeader && chunksApplied == header.chunkCount; }
+bool ProgressiveMeshStream::IsFailed() { return failed; }
+const ProgressiveMeshHeader& ProgressiveMeshStream::GetHeader() { return header; }
+
+int ProgressiveMeshStream::GetResidentVertexCount() { return residentVertexCount; }
+int ProgressiveMeshStream::GetResidentTriangleCount() { return residentTriangleCount; }
+int ProgressiveMeshStream::GetResidentIndexCount(int submesh) { return (int)residentIndices[submesh]; }
+float ProgressiveMeshStream::GetResidentError() { return residentError; }
+size_t ProgressiveMeshStream::GetBytesReceived() { return bytesReceived; }
+
+const std::vector<Vertex>& ProgressiveMeshStream::GetVertices() { return verts; }
+const std::vector<unsigned int>& ProgressiveMeshStream::GetIndices() { return indices; }
+const std::vector<MeshSubmesh>& ProgressiveMeshStream::GetSubmeshes() { return submeshes; }
+
+int ProgressiveMeshStream::GetUploadedVertexCount() { return uploadedVertexCount; }
+const std::vector<unsigned char>& ProgressiveMeshStream::GetDirtyBlocks() { return dirtyBlocks; }
+
+void ProgressiveMeshStream::ClearChanges()
+{
+	uploadedVertexCount = residentVertexCount;
+	std::fill(dirtyBlocks.begin(), dirtyBlocks.end(), 0);
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Mesh.h"
+
+// Bump whenever the layout below or the Vertex struct changes
+#define PROGRESSIVE_MESH_VERSION 1
+
+// --------------------------------------------------------
+// Header at the very start of every progressive mesh file
+// - Followed by the submesh table (full detail ranges),
+//   then the chunks, coarsest first
+// --------------------------------------------------------
+struct ProgressiveMeshHeader
+{
+	char magic[4];                     // Always "PMSH"
+	unsigned int version;              // PROGRESSIVE_MESH_VERSION at write time
+	unsigned int vertexStride;         // sizeof(Vertex) at write time
+	unsigned int vertexCount;          // Once every chunk is applied
+	unsigned int indexCount;
+	unsigned int submeshCount;
+	unsigned int chunkCount;           // The base mesh included
+	unsigned int splitCount;           // Vertex splits across every refinement chunk
+	unsigned int totalBytes;           // Size of the whole stream, header included
+	DirectX::XMFLOAT3 boundsMin;       // Axis aligned bounds of the full detail vertices
+	DirectX::XMFLOAT3 boundsMax;
+};
+
+// --------------------------------------------------------
+// Header of one chunk, which is only ever applied whole
+// - Followed by its new vertices (a MeshCodec stream padded
+//   to 4 bytes), then its records as varints
+// - The first chunk's records are the base mesh, one per
+//   submesh with its triangles and no corner changes
+// --------------------------------------------------------
+struct ProgressiveMeshChunk
+{
+	unsigned int bytes;                // Everything after this header
+	unsigned int vertexCount;          // Appended to the vertices, before any record is applied
+	unsigned int vertexBytes;
+	unsigned int recordCount;
+	float error;                       // Geometric error in world units once the chunk is applied, 0 after the last one
+};
+
+// --------------------------------------------------------
+// Progressive meshes (Hoppe '96), stored coarse to fine as
+// a base mesh followed by vertex splits
+//
+// - The splits are the simplifier's edge collapses undone
+//   in reverse, so each one only brings back a vertex, the
+//   triangles its collapse removed, and the corners that
+//   were moved off it
+// - Vertices are numbered in the order they're first used
+//   and triangles in the order they appear, so refining
+//   only ever appends to both and rewrites a few corners
+//   in place. Each submesh's triangles fill its own full
+//   detail range of the index buffer from the front
+// - Splits of different submeshes are interleaved by
+//   error, so the whole mesh refines evenly
+// --------------------------------------------------------
+class ProgressiveMesh
+{
+public:
+	// Vertex splits per refinement chunk
+	static const int ChunkSplits = 1024;
+
+	// The base mesh keeps about this fraction of each submesh's triangles (more if simplification stalls)
+	static const int BaseTriangleDivisor = 64;
+
+	// Builds the stream from the full detail level of finished mesh data (the levels of detail below it are ignored)
+	static void Encode(const MeshData& data, std::vector<unsigned char>& out);
+
+	// Encodes the data and writes it to the given path
+	static bool Write(const char* path, const MeshData& data);
+};
+
+// --------------------------------------------------------
+// Decodes a progressive mesh as its bytes arrive
+//
+// - Append takes the bytes in any sized pieces and applies
+//   every chunk that's complete, so the mesh can be drawn
+//   as soon as the base chunk is in
+// - Vertices and indices are kept at full detail size from
+//   the start (what's missing is zeroed, and draws as
+//   degenerate triangles), with the changed index blocks
+//   tracked until Mesh::Refine uploads them
+// - Not thread safe, but the mesh it's uploaded to only
+//   reads it during BeginStream and Refine
+// --------------------------------------------------------
+class ProgressiveMeshStream
+{
+public:
+	// Indices per block tracked for upload
+	static const int DirtyBlockIndices = 1024;
+
+	// Most vertices and indices a header may claim, since the arrays are sized from it before any chunk arrives
+	// - Each also has to fit in the stream at a sixteenth of a byte apiece, well under what encoding ever gets to
+	static const unsigned int MaxVertices = 1 << 24;
+	static const unsigned int MaxIndices = 3 << 24;
+	static const unsigned int MaxElementsPerByte = 16;
+
+	// Decodes whatever it can, false once the data turns out to be malformed (nothing is applied after that)
+	bool Append(const void* data, size_t size);
+
+	// True once the base mesh is in, and once every chunk is
+	bool HasBase();
+	bool IsComplete();
+	bool IsFailed();
+
+	// The header, only valid once the first bytes are in
+	const ProgressiveMeshHeader& GetHeader();
+
+	// What's resident so far
+	int GetResidentVertexCount();
+	int GetResidentTriangleCount();
+	int GetResidentIndexCount(int submesh);
+	float GetResidentError();
+	size_t GetBytesReceived();
+
+	// Full detail sized arrays, and the submesh table with full detail ranges
+	const std::vector<Vertex>& GetVertices();
+	const std::vector<unsigned int>& GetIndices();
+	const std::vector<MeshSubmesh>& GetSubmeshes();
+
+	// Changes since the last ClearChanges, for uploading them
+	int GetUploadedVertexCount();
+	const std::vector<unsigned char>& GetDirtyBlocks();
+	void ClearChanges();
+
+private:
+	bool DecodeChunk(const unsigned char* data, size_t size);
+
+	ProgressiveMeshHeader header = {};
+	std::vector<unsigned char> pending;     // Bytes not yet decoded
+	size_t pendingStart = 0;
+	size_t bytesReceived = 0;
+	bool hasHeader = false;
+	bool failed = false;
+	unsigned int chunksApplied = 0;
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	std::vector<MeshSubmesh> submeshes;
+	std::vector<unsigned int> residentIndices;  // Per submesh, from the front of its range
+	int residentVertexCount = 0;
+	int residentTriangleCount = 0;
+	float residentError = 0.0f;
+
+	int uploadedVertexCount = 0;
+	std::vector<unsigned char> dirtyBlocks;
+};
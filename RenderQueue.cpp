@@ -0,0 +1,91 @@
+#include "RenderQueue.h"
+#include "Mesh.h"
+#include "Material.h"
+#include <algorithm>
+
+RenderQueueItem RenderQueue::MakeItem(EntityHandle entity, EntityChunk* chunk, int row)
+{
+	RenderQueueItem item;
+	item.entity = entity;
+	item.renderPriority = chunk->materials[row]->renderPriority;
+	item.mesh = chunk->meshes[row];
+	return item;
+}
+
+bool RenderQueue::ItemLess(const RenderQueueItem& a, const RenderQueueItem& b)
+{
+	if (a.renderPriority != b.renderPriority)
+		return a.renderPriority < b.renderPriority;
+	return a.mesh < b.mesh;
+}
+
+void RenderQueue::Rebuild(EntityStore* entities)
+{
+	// Fill the queue with a reference to every renderable entity
+	items.clear();
+	entities->Query(ENTITY_COMPONENT_RENDERABLE, chunks);
+	for (EntityChunk* chunk : chunks)
+	{
+		for (int row = 0; row < chunk->count; row++)
+			items.push_back(MakeItem(chunk->entities[row], chunk, row));
+	}
+
+	// Sort that queue based on its priority, keeping entities that share a mesh together within each one
+	std::sort(items.begin(), items.end(), ItemLess);
+	entities->ClearChanges();
+	dirty = false;
+}
+
+void RenderQueue::Update(EntityStore* entities)
+{
+	if (dirty)
+	{
+		Rebuild(entities);
+		return;
+	}
+
+	// Drop everything destroyed (or changed) in one pass
+	// - Marking slots is enough: a slot's queued entity has to be destroyed before the slot is reused, so the queued
+	//   entity in a marked slot is always one of the logged ones
+	const std::vector<EntityHandle>& destroyed = entities->GetDestroyed();
+	if (!destroyed.empty())
+	{
+		for (EntityHandle entity : destroyed)
+		{
+			if (entity.index >= (int)removedSlots.size())
+				removedSlots.resize(entity.index + 1, 0);
+			removedSlots[entity.index] = 1;
+		}
+		items.erase(std::remove_if(items.begin(), items.end(), [this](const RenderQueueItem& item) {
+			return item.entity.index < (int)removedSlots.size() && removedSlots[item.entity.index];
+		}), items.end());
+		for (EntityHandle entity : destroyed)
+			removedSlots[entity.index] = 0;
+	}
+
+	// Sort the new ones on their own and merge them in, skipping any already destroyed again and duplicates from repeated changes
+	if (!entities->GetCreated().empty())
+	{
+		added = entities->GetCreated();
+		std::sort(added.begin(), added.end());
+		added.erase(std::unique(added.begin(), added.end()), added.end());
+
+		size_t oldCount = items.size();
+		for (EntityHandle entity : added)
+		{
+			int row;
+			EntityChunk* chunk = entities->Find(entity, row);
+			if (chunk && (chunk->components & ENTITY_COMPONENT_RENDERABLE) == ENTITY_COMPONENT_RENDERABLE)
+				items.push_back(MakeItem(entity, chunk, row));
+		}
+		std::sort(items.begin() + oldCount, items.end(), ItemLess);
+		std::inplace_merge(items.begin(), items.begin() + oldCount, items.end(), ItemLess);
+	}
+
+	entities->ClearChanges();
+}
+
+void RenderQueue::SetDirty() { dirty = true; }
+bool RenderQueue::GetDirty() { return dirty; }
+int RenderQueue::GetCount() { return (int)items.size(); }
+const RenderQueueItem& RenderQueue::GetItem(int index) { return items[index]; }
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+
+#include "EntityStore.h"
+
+// One entity in the render queue, found in the store again at draw time
+struct RenderQueueItem
+{
+	EntityHandle entity;
+	int renderPriority;                     // The entity material's, what the queue is sorted by
+	Mesh* mesh;                             // Then by this, so entities drawing the same mesh draw together
+};
+
+// --------------------------------------------------------
+// Every renderable entity, sorted by material priority and
+// then mesh
+//
+// - Keyed on the mesh itself rather than its buffers, which
+//   Mesh::Upload and Mesh::BeginStream swap out underneath
+//   the queue without the entity changing
+// - Update applies the store's created and destroyed logs
+//   instead of starting over: removed entities are filtered
+//   out by slot and the new ones sorted on their own and
+//   merged in, so a frame with a few changes costs a pass
+//   over the queue rather than a full sort
+// - It consumes (clears) the store's change logs, so it
+//   should be the only thing reading them
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	// Refills the queue from every renderable entity and clears the store's change logs
+	void Rebuild(EntityStore* entities);
+
+	// Applies the store's changes since the last Update or Rebuild, rebuilding instead if marked dirty
+	void Update(EntityStore* entities);
+
+	// Makes the next Update a full rebuild
+	void SetDirty();
+	bool GetDirty();
+
+	int GetCount();
+	const RenderQueueItem& GetItem(int index);
+
+private:
+	// Fills in the sort keys from the entity's material and mesh
+	static RenderQueueItem MakeItem(EntityHandle entity, EntityChunk* chunk, int row);
+	static bool ItemLess(const RenderQueueItem& a, const RenderQueueItem& b);
+
+	std::vector<RenderQueueItem> items;
+	bool dirty = true;
+
+	// Reused every update, removedSlots is all zeroes in between
+	std::vector<EntityChunk*> chunks;
+	std::vector<unsigned char> removedSlots;
+	std::vector<EntityHandle> added;
+};
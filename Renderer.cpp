@@ -8,6 +8,16 @@
 #include <cmath>
 
 
+// Combines the camera's view and projection matrices for culling
+static DirectX::XMFLOAT4X4 GetViewProjection(Camera* camera)
+{
+	DirectX::XMFLOAT4X4 view = camera->GetViewMatrix();
+	DirectX::XMFLOAT4X4 proj = camera->GetProjectionMatrix();
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&view), DirectX::XMLoadFloat4x4(&proj)));
+	return viewProj;
+}
+
 Renderer::Renderer() {
 	printf("---> Renderer loaded\n");
 }
@@ -30,44 +40,50 @@ void Renderer::ClearBackground(Microsoft::WRL::ComPtr<ID3D11DeviceContext> conte
 		0);
 }
 
+// Planes of the view frustum as (normal, distance), pointing inwards
+// - Pulled from the columns of the view projection, since points multiply it as rows
+static void GetFrustumPlanes(const DirectX::XMFLOAT4X4& viewProj, DirectX::XMFLOAT4 planes[6])
+{
+	const DirectX::XMFLOAT4X4& m = viewProj;
+	planes[0] = DirectX::XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);	// Left
+	planes[1] = DirectX::XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);	// Right
+	planes[2] = DirectX::XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);	// Bottom
+	planes[3] = DirectX::XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);	// Top
+	planes[4] = DirectX::XMFLOAT4(m._13, m._23, m._33, m._43);										// Near
+	planes[5] = DirectX::XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);	// Far
+}
+
 // Cycles through all the meshes the renderer has a references to and renders them on the rendertarget to get presented to the screen
 void Renderer::DrawMeshes(
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler,
-	std::vector<Entity> entities,
+	EntityStore* entities,
 	Camera* camera)
 {
-	for (int i = 0; i < entities.size(); i++)
-	{
-		// Set sampler, diffuse, and maybe normal textures
-		entities[i].GetMaterial()->GetPixelShader()->SetSamplerState("basicSampler", sampler.Get());
-		entities[i].GetMaterial()->GetPixelShader()->SetShaderResourceView("diffuseTexture", entities[i].GetMaterial()->GetTextureSRV().Get());
-		if (entities[i].GetMaterial()->hasNormalMap) {
-			entities[i].GetMaterial()->GetPixelShader()->SetShaderResourceView("normalTexture", entities[i].GetMaterial()->GetNormalMap().Get());
-		}
-
-		SimpleVertexShader* vsData = entities[i].GetMaterial()->GetVertexShader();
-		vsData->SetFloat4("colorTint", entities[i].GetMaterial()->GetColorTint());
-		vsData->SetMatrix4x4("world", entities[i].GetTransform()->GetWorldMatrix());
-		vsData->SetMatrix4x4("view", camera->GetViewMatrix());
-		vsData->SetMatrix4x4("proj", camera->GetProjectionMatrix());
+	DirectX::XMFLOAT4X4 viewProj = GetViewProjection(camera);
+	DirectX::XMFLOAT4 frustum[6];
+	GetFrustumPlanes(viewProj, frustum);
+	ResetGeometryBindings();
 
-		// Set buffers in the input assembler
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-		context->IASetVertexBuffers(0, 1, entities[i].GetMesh()->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(entities[i].GetMesh()->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+	// World matrices come from the store's last UpdateWorldMatrices
+	TransformSystem* transforms = entities->GetTransforms();
 
-		// Copying to resource
-		vsData->CopyAllBufferData();
+	// Walk the renderable chunks in place, nothing about the entities is copied
+	entities->Query(ENTITY_COMPONENT_RENDERABLE, drawChunks);
+	for (EntityChunk* chunk : drawChunks)
+	{
+		for (int row = 0; row < chunk->count; row++)
+		{
+			if (!IsEntityVisible(chunk, row, frustum))
+				continue;
 
-		// Set the shaders and sampler state
-		entities[i].GetMaterial()->GetVertexShader()->SetShader();	// TODO: Clump together items to render based on which shader type they are
-		entities[i].GetMaterial()->GetPixelShader()->SetShader();
-		entities[i].GetMaterial()->GetPixelShader()->CopyAllBufferData();
+			// Set buffers in the input assembler, then the shaders and everything they need
+			BindGeometry(context, chunk->meshes[row]);
+			ApplyMaterial(chunk->materials[row], chunk, row, transforms, camera, sampler);	// TODO: Clump together items to render based on which shader type they are
 
-		// Do the actual drawing
-		context->DrawIndexed(entities[i].GetMesh()->GetIndexCount(), 0, 0);
+			// Do the actual drawing
+			DrawEntity(context, sampler, chunk, row, transforms, camera, viewProj);
+		}
 	}
 }
 
@@ -75,59 +91,208 @@ void Renderer::DrawMeshes(
 void Renderer::DrawMeshesQueued(
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler,
+	EntityStore* entities,
 	Camera* camera)
 {
+	DirectX::XMFLOAT4X4 viewProj = GetViewProjection(camera);
+	DirectX::XMFLOAT4 frustum[6];
+	GetFrustumPlanes(viewProj, frustum);
+	ResetGeometryBindings();
+
+	// World matrices come from the store's last UpdateWorldMatrices
+	TransformSystem* transforms = entities->GetTransforms();
 	int currentPriority = -1;
-	for (int i = 0; i < renderQueue.size(); i++)
+	for (int i = 0; i < renderQueue.GetCount(); i++)
+	{
+		// The queue holds handles, so look up where the entity is now (and skip it if it's gone since the last update)
+		const RenderQueueItem& item = renderQueue.GetItem(i);
+		int row;
+		EntityChunk* chunk = entities->Find(item.entity, row);
+		if (!chunk || !IsEntityVisible(chunk, row, frustum))
+			continue;
+
+		// Set buffers in the input assembler, which pooled meshes of the same format can skip
+		BindGeometry(context, chunk->meshes[row]);
+
+		// Set the shaders and everything they need, but only switch pixel shaders if we need to
+		bool newPriority = currentPriority != item.renderPriority;
+		currentPriority = item.renderPriority;
+		ApplyMaterial(chunk->materials[row], chunk, row, transforms, camera, sampler, newPriority);	// TODO: Clump together items to render based on which shader type they are
+
+		// Do the actual drawing, and make the next entity set its pixel shader again if a submesh changed it
+		if (DrawEntity(context, sampler, chunk, row, transforms, camera, viewProj))
+			currentPriority = -1;
+	}
+}
+
+void Renderer::GenerateRenderQueue(EntityStore* entities)
+{
+	renderQueue.Rebuild(entities);
+}
+
+void Renderer::UpdateRenderQueue(EntityStore* entities)
+{
+	renderQueue.Update(entities);
+}
+
+// Tests the entity's world bounds against each plane, counting the ones that are skipped
+bool Renderer::IsEntityVisible(EntityChunk* chunk, int row, const DirectX::XMFLOAT4 frustum[6])
+{
+	unsigned int flags = chunk->renderFlags[row];
+	if (!(flags & ENTITY_RENDER_VISIBLE))
+		return false;
+	if (flags & ENTITY_RENDER_NO_CULLING)
+		return true;
+
+	const EntityBounds& bounds = chunk->bounds[row];
+	DirectX::XMFLOAT3 center((bounds.min.x + bounds.max.x) * 0.5f, (bounds.min.y + bounds.max.y) * 0.5f, (bounds.min.z + bounds.max.z) * 0.5f);
+	DirectX::XMFLOAT3 extent((bounds.max.x - bounds.min.x) * 0.5f, (bounds.max.y - bounds.min.y) * 0.5f, (bounds.max.z - bounds.min.z) * 0.5f);
+	for (int p = 0; p < 6; p++)
 	{
-		// Set sampler, diffuse, and maybe normal textures
-		renderQueue[i].GetMaterial()->GetPixelShader()->SetSamplerState("basicSampler", sampler.Get());
-		renderQueue[i].GetMaterial()->GetPixelShader()->SetShaderResourceView("diffuseTexture", renderQueue[i].GetMaterial()->GetTextureSRV().Get());
-		if (renderQueue[i].GetMaterial()->hasNormalMap) {
-			renderQueue[i].GetMaterial()->GetPixelShader()->SetShaderResourceView("normalTexture", renderQueue[i].GetMaterial()->GetNormalMap().Get());
+		const DirectX::XMFLOAT4& plane = frustum[p];
+		float distance = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+		float radius = extent.x * fabsf(plane.x) + extent.y * fabsf(plane.y) + extent.z * fabsf(plane.z);
+		if (distance + radius < 0.0f)
+		{
+			culledEntities++;
+			return false;
 		}
+	}
+	return true;
+}
 
-		SimpleVertexShader* vsData = renderQueue[i].GetMaterial()->GetVertexShader();
-		vsData->SetFloat4("colorTint", renderQueue[i].GetMaterial()->GetColorTint());
-		vsData->SetMatrix4x4("world", renderQueue[i].GetTransform()->GetWorldMatrix());
-		vsData->SetMatrix4x4("view", camera->GetViewMatrix());
-		vsData->SetMatrix4x4("proj", camera->GetProjectionMatrix());
+// Uses the distance to the camera, scaled into the mesh's own space
+// - Position and scale come from the world matrix (its last row and the lengths of the others)
+MeshLod Renderer::SelectLod(const DirectX::XMFLOAT4X4& world, Mesh* mesh, Camera* camera, int submesh)
+{
+	if (mesh->GetLodCount(submesh) == 1)
+		return mesh->GetLod(0, submesh);
 
-		// Set buffers in the input assembler
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-		context->IASetVertexBuffers(0, 1, renderQueue[i].GetMesh()->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(renderQueue[i].GetMesh()->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+	DirectX::XMFLOAT3 entityPos(world._41, world._42, world._43);
+	DirectX::XMFLOAT3 cameraPos = camera->GetTransform()->GetPosition();
+	DirectX::XMFLOAT3 scale(
+		sqrtf(world._11 * world._11 + world._12 * world._12 + world._13 * world._13),
+		sqrtf(world._21 * world._21 + world._22 * world._22 + world._23 * world._23),
+		sqrtf(world._31 * world._31 + world._32 * world._32 + world._33 * world._33));
+	float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(
+		DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&entityPos), DirectX::XMLoadFloat3(&cameraPos))));
+	float largestScale = fmaxf(scale.x, fmaxf(scale.y, scale.z));
+	if (largestScale <= 0.0f)
+		return mesh->GetLod(0, submesh);
 
-		// Copying to resource
-		vsData->CopyAllBufferData();
+	return mesh->GetLod(mesh->SelectLod(distance / largestScale, lodErrorPerDistance, submesh), submesh);
+}
+
+// Draws the selected level of detail of each submesh, or only the visible clusters when that's the full detail level
+// - Every submesh shares the buffers bound for the entity, so only materials can change between them
+bool Renderer::DrawEntity(
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler,
+	EntityChunk* chunk,
+	int row,
+	TransformSystem* transforms,
+	Camera* camera,
+	const DirectX::XMFLOAT4X4& viewProj)
+{
+	Mesh* mesh = chunk->meshes[row];
+	int transform = chunk->transforms[row];
+	Material* boundMaterial = chunk->materials[row];
+	unsigned int startIndex = mesh->GetStartIndex();
+	int baseVertex = mesh->GetBaseVertex();
+	bool changedMaterial = false;
+	for (int s = 0; s < mesh->GetSubmeshCount(); s++)
+	{
+		Material* material = chunk->GetSubmeshMaterial(row, s);
+		if (material != boundMaterial)
+		{
+			ApplyMaterial(material, chunk, row, transforms, camera, sampler);
+			boundMaterial = material;
+			changedMaterial = true;
+		}
 
-		// Set the shaders and sampler state, but only if we need to
-		if (currentPriority != renderQueue[i].renderPriority) {
-			currentPriority = renderQueue[i].renderPriority;
-			renderQueue[i].GetMaterial()->GetPixelShader()->SetShader();
-			renderQueue[i].GetMaterial()->GetPixelShader()->CopyAllBufferData();
+		MeshLod lod = SelectLod(transforms->GetWorldMatrix(transform), mesh, camera, s);
+		if (!clusterCulling || lod.startIndex != mesh->GetSubmesh(s).startIndex || mesh->GetClusterCount(s) == 0)
+		{
+			context->DrawIndexed(lod.indexCount, startIndex + lod.startIndex, baseVertex);
+			continue;
 		}
-		renderQueue[i].GetMaterial()->GetVertexShader()->SetShader();	// TODO: Clump together items to render based on which shader type they are
 
-		// Do the actual drawing
-		context->DrawIndexed(renderQueue[i].GetMesh()->GetIndexCount(), 0, 0);
+		// Neighboring visible clusters come back merged, so a fully visible submesh is still one draw
+		visibleRanges.clear();
+		MeshClusterizer::CullClusters(mesh->GetClusters(s), mesh->GetClusterCount(s), transforms->GetWorldMatrix(transform), viewProj, camera->GetTransform()->GetPosition(), visibleRanges);
+		for (size_t i = 0; i < visibleRanges.size(); i++)
+			context->DrawIndexed(visibleRanges[i].indexCount, startIndex + visibleRanges[i].startIndex, baseVertex);
 	}
+
+	return changedMaterial;
 }
 
-void Renderer::GenerateRenderQueue(std::vector<Entity> entities)
+// Used for the entity's own material by the draw loops, and for any submesh that overrides it
+void Renderer::ApplyMaterial(Material* material, EntityChunk* chunk, int row, TransformSystem* transforms, Camera* camera, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler, bool setPixelShader)
 {
-	// Clear out the old queue and set it up to be filled with a new one
-	renderQueue.clear();
+	int transform = chunk->transforms[row];
+	Mesh* mesh = chunk->meshes[row];
+
+	SimplePixelShader* psData = material->GetPixelShader();
+	psData->SetSamplerState("basicSampler", sampler.Get());
+	psData->SetShaderResourceView("diffuseTexture", material->GetTextureSRV().Get());
+	if (material->hasNormalMap)
+		psData->SetShaderResourceView("normalTexture", material->GetNormalMap().Get());
 
-	// Fill the queue with all the existing entities
-	for (int i = 0; i < entities.size(); i++)
-		renderQueue.push_back(entities[i]);
+	SimpleVertexShader* vsData = material->GetVertexShader();
+	vsData->SetFloat4("colorTint", material->GetColorTint());
+	vsData->SetMatrix4x4("world", transforms->GetWorldMatrix(transform));
+	vsData->SetMatrix4x4("worldInvTranspose", transforms->GetWorldInverseTransposeMatrix(transform));
+	vsData->SetMatrix4x4("view", camera->GetViewMatrix());
+	vsData->SetMatrix4x4("proj", camera->GetProjectionMatrix());
+	if (mesh->IsCompressed()) {
+		vsData->SetFloat3("quantizeMin", mesh->GetQuantizeMin());
+		vsData->SetFloat3("quantizeExtent", mesh->GetQuantizeExtent());
+	}
 
-	// Sort that queue based on its priority
-	std::sort(renderQueue.begin(), renderQueue.end());
-	dirty = false;
+	vsData->CopyAllBufferData();
+	vsData->SetShader();
+	if (setPixelShader) {
+		psData->SetShader();
+		psData->CopyAllBufferData();
+	}
+}
+
+// Compares against the raw pointers, so nothing is bound just because it's a different mesh
+void Renderer::BindGeometry(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Mesh* mesh)
+{
+	UINT stride = mesh->GetVertexStride();
+	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer = mesh->GetVertexBuffer();
+	if (vertexBuffer.Get() != boundVertexBuffer || stride != boundStride)
+	{
+		UINT offset = 0;
+		context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+		boundVertexBuffer = vertexBuffer.Get();
+		boundStride = stride;
+		geometryBinds++;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer = mesh->GetIndexBuffer();
+	if (indexBuffer.Get() != boundIndexBuffer || mesh->GetIndexFormat() != boundIndexFormat)
+	{
+		context->IASetIndexBuffer(indexBuffer.Get(), mesh->GetIndexFormat(), 0);
+		boundIndexBuffer = indexBuffer.Get();
+		boundIndexFormat = mesh->GetIndexFormat();
+		geometryBinds++;
+	}
+}
+
+void Renderer::ResetGeometryBindings()
+{
+	boundVertexBuffer = nullptr;
+	boundStride = 0;
+	boundIndexBuffer = nullptr;
+	boundIndexFormat = DXGI_FORMAT_UNKNOWN;
+	geometryBinds = 0;
+	culledEntities = 0;
 }
 
-void Renderer::SetDirty() { dirty = true; }
-bool Renderer::GetDirty() { return dirty; }
+void Renderer::SetDirty() { renderQueue.SetDirty(); }
+bool Renderer::GetDirty() { return renderQueue.GetDirty(); }
+int Renderer::GetGeometryBindCount() { return geometryBinds; }
+int Renderer::GetCulledEntityCount() { return culledEntities; }
@@ -2,7 +2,9 @@
 
 #include "Mesh.h"
 #include "BufferStructs.h"
-#include "Entity.h"
+#include "EntityStore.h"
+#include "RenderQueue.h"
+#include "Material.h"
 #include "Camera.h"
 #include "SimpleShader.h"
 #include "Skybox.h"
@@ -28,19 +30,74 @@ public:
 	void DrawMeshes(
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 		Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler,
-		std::vector<Entity> entities,
+		EntityStore* entities,
 		Camera* camera);
 
 	void DrawMeshesQueued(
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 		Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler,
+		EntityStore* entities,
 		Camera* camera);
 
-	void GenerateRenderQueue(std::vector<Entity> entities);
+	// Rebuilds the whole render queue
+	void GenerateRenderQueue(EntityStore* entities);
+
+	// Brings the render queue up to date with the entities created and destroyed since the last call
+	// - Only does a full rebuild the first time, or after SetDirty
+	void UpdateRenderQueue(EntityStore* entities);
 	void SetDirty();
 	bool GetDirty();
 
+	// How many times the last draw call had to bind vertex or index buffers
+	int GetGeometryBindCount();
+
+	// How many entities the last draw call skipped because their bounds were outside the view
+	int GetCulledEntityCount();
+
 private:
-	std::vector<Entity> renderQueue;
-	bool dirty;
+	// Picks which of a submesh's levels of detail to draw from where the camera is
+	MeshLod SelectLod(const DirectX::XMFLOAT4X4& world, Mesh* mesh, Camera* camera, int submesh);
+
+	// False if the entity's bounds are entirely outside the view, or it isn't visible at all
+	bool IsEntityVisible(EntityChunk* chunk, int row, const DirectX::XMFLOAT4 frustum[6]);
+
+	// Draws every submesh of the entity's mesh at its selected level of detail, culling clusters on the full detail level
+	// - The buffers and the entity's material are expected to be bound already
+	// - Returns true if a submesh's own material replaced the entity's shaders
+	bool DrawEntity(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler,
+		EntityChunk* chunk,
+		int row,
+		TransformSystem* transforms,
+		Camera* camera,
+		const DirectX::XMFLOAT4X4& viewProj);
+
+	// Sets and uploads everything a material's shaders need to draw the entity
+	// - The pixel shader can be left alone when the one already set is known to match
+	void ApplyMaterial(Material* material, EntityChunk* chunk, int row, TransformSystem* transforms, Camera* camera, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler, bool setPixelShader = true);
+
+	// Binds the mesh's vertex and index buffers, unless they're already bound (pooled meshes mostly share them)
+	void BindGeometry(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Mesh* mesh);
+	void ResetGeometryBindings();
+
+	RenderQueue renderQueue;
+
+	// Every renderable chunk, reused by each draw call
+	std::vector<EntityChunk*> drawChunks;
+	int culledEntities = 0;
+
+	// Largest mesh error allowed per unit of distance from the camera (about a pixel at 1080p)
+	float lodErrorPerDistance = 0.001f;
+
+	// Cull the clusters of full detail meshes on the CPU, reusing the range list every draw
+	bool clusterCulling = true;
+	std::vector<MeshIndexRange> visibleRanges;
+
+	// What the input assembler has bound, forgotten at the start of every draw call since other code binds its own buffers
+	ID3D11Buffer* boundVertexBuffer = nullptr;
+	UINT boundStride = 0;
+	ID3D11Buffer* boundIndexBuffer = nullptr;
+	DXGI_FORMAT boundIndexFormat = DXGI_FORMAT_UNKNOWN;
+	int geometryBinds = 0;
 };
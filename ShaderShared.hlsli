@@ -12,6 +12,16 @@ struct VertexShaderInput
 	float2 uv			: TEXCOORD;     // Vertex UV info
 };
 
+// Compressed vertex input (see CompactVertex/QuantizedVertex in Vertex.h)
+// - Position is either full floats or 16-bit unorms across the mesh bounds, depending on the input layout
+struct CompactVertexShaderInput
+{
+	float3 position		: POSITION;     // XYZ position, or quantized XYZ
+	float2 normal		: NORMAL;       // Octahedral encoded normal
+	float2 tangent		: TANGENT;		// Octahedral encoded tangent, handedness in the sign of Y
+	float2 uv			: TEXCOORD;     // Vertex UV info
+};
+
 // Struct to pass information from the vertex shader to the pixel shader
 struct VertexToPixel
 {
@@ -30,7 +40,7 @@ struct VertexToPixelWithTangent
 	float2 uv		: TEXCOORD;			// UV coord of the pixel
 	float3 normal	: NORMAL;			// Normal at the pixel's position
 	float3 worldPos	: POSITION;			// Position of the pixel in world space
-	float3 tangent	: TANGENT;
+	float4 tangent	: TANGENT;			// Tangent in XYZ, handedness of the bitangent (+1 or -1) in W
 };
 
 // Struct to pass information from the vertex shader to the pixel shader for the skybox
@@ -63,4 +73,49 @@ float3x3 createTBNMatrix(float3 normal, float3 tangent)
 	float3 bitangent = cross(tangent, normal);
 	return float3x3(tangent, bitangent, normal);
 }
+
+// Same as above, but flips the bitangent for mirrored uvs (handedness of -1)
+float3x3 createTBNMatrix(float3 normal, float3 tangent, float handedness) 
+{
+	float3x3 tbn = createTBNMatrix(normal, tangent);
+	tbn[1] *= handedness;
+	return tbn;
+}
+
+// ---------------------- VERTEX DECODING ----------------------
+
+// Unfolds an octahedral encoded unit vector
+float3 DecodeOctahedral(float2 e)
+{
+	float3 v = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-v.z);
+	v.xy += v.xy >= 0.0f ? -t : t;
+	return normalize(v);
+}
+
+// Unfolds an encoded tangent, with the bitangent's handedness (+1 or -1) in W
+float4 DecodeTangent(float2 e)
+{
+	float handedness = e.y < 0.0f ? -1.0f : 1.0f;
+	return float4(DecodeOctahedral(float2(e.x, abs(e.y) * 2.0f - 1.0f)), handedness);
+}
+
+// Maps a quantized position back into the mesh's bounds (use 0 and 1 for full float positions)
+float3 DequantizePosition(float3 position, float3 quantizeMin, float3 quantizeExtent)
+{
+	return quantizeMin + position * quantizeExtent;
+}
+
+// Expands a compressed vertex into the regular vertex shader input, plus the tangent's handedness
+VertexShaderInput DecodeCompactVertex(CompactVertexShaderInput input, float3 quantizeMin, float3 quantizeExtent, out float handedness)
+{
+	VertexShaderInput output;
+	float4 tangent = DecodeTangent(input.tangent);
+	output.position = DequantizePosition(input.position, quantizeMin, quantizeExtent);
+	output.normal = DecodeOctahedral(input.normal);
+	output.tangent = tangent.xyz;
+	output.uv = input.uv;
+	handedness = tangent.w;
+	return output;
+}
 #endif
\ No newline at end of file
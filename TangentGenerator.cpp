@@ -0,0 +1,312 @@
+#include "TangentGenerator.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+#include <thread>
+#include <vector>
+
+// Triangles whose uvs cover less than this (twice their uv area) don't give a direction
+static const float MinUvDeterminant = 1e-12f;
+
+// Tangents that are mostly along the normal (less than ~0.06 degrees off it) aren't trusted either
+static const float MinOrthogonalFraction = 1e-6f;
+
+// Runs job(0) to job(count - 1), each on its own thread (the last one on the calling thread)
+template<typename Job>
+static void RunOnThreads(int count, Job job)
+{
+	std::vector<std::thread> workers;
+	for (int i = 0; i + 1 < count; i++)
+		workers.push_back(std::thread(job, i));
+
+	job(count - 1);
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+// Unnormalized tangent of one triangle, or zero when its uvs are degenerate
+static DirectX::XMFLOAT3 TriangleTangent(const Vertex& v1, const Vertex& v2, const Vertex& v3)
+{
+	// Calculate vectors relative to triangle positions
+	float x1 = v2.position.x - v1.position.x;
+	float y1 = v2.position.y - v1.position.y;
+	float z1 = v2.position.z - v1.position.z;
+
+	float x2 = v3.position.x - v1.position.x;
+	float y2 = v3.position.y - v1.position.y;
+	float z2 = v3.position.z - v1.position.z;
+
+	// Do the same for vectors relative to triangle uv's
+	float s1 = v2.uv.x - v1.uv.x;
+	float t1 = v2.uv.y - v1.uv.y;
+
+	float s2 = v3.uv.x - v1.uv.x;
+	float t2 = v3.uv.y - v1.uv.y;
+
+	// Skip the divide when it would blow up
+	float det = s1 * t2 - s2 * t1;
+	if (!(fabsf(det) > MinUvDeterminant))
+		return DirectX::XMFLOAT3(0, 0, 0);
+
+	float r = 1.0f / det;
+	return DirectX::XMFLOAT3((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+}
+
+// Some unit vector perpendicular to the normal, for vertices whose uvs give no usable direction
+// - The x axis (or y, when the normal is close to x) with the normal's direction removed
+static DirectX::XMFLOAT3 FallbackTangent(const DirectX::XMFLOAT3& normal)
+{
+	DirectX::XMFLOAT3 axis = fabsf(normal.x) < 0.9f ? DirectX::XMFLOAT3(1, 0, 0) : DirectX::XMFLOAT3(0, 1, 0);
+	float dot = normal.x * axis.x + normal.y * axis.y + normal.z * axis.z;
+	float x = axis.x - normal.x * dot;
+	float y = axis.y - normal.y * dot;
+	float z = axis.z - normal.z * dot;
+
+	float lengthSq = x * x + y * y + z * z;
+	if (!(lengthSq > 0.0f && lengthSq <= FLT_MAX))
+		return DirectX::XMFLOAT3(1, 0, 0);
+
+	float inverse = 1.0f / sqrtf(lengthSq);
+	return DirectX::XMFLOAT3(x * inverse, y * inverse, z * inverse);
+}
+
+// Gram-Schmidt orthogonalizes a summed tangent against the normal and normalizes it
+static DirectX::XMFLOAT3 Orthonormalize(const DirectX::XMFLOAT3& normal, const DirectX::XMFLOAT3& sum)
+{
+	float dot = normal.x * sum.x + normal.y * sum.y + normal.z * sum.z;
+	float x = sum.x - normal.x * dot;
+	float y = sum.y - normal.y * dot;
+	float z = sum.z - normal.z * dot;
+
+	float lengthSq = x * x + y * y + z * z;
+	float sumSq = sum.x * sum.x + sum.y * sum.y + sum.z * sum.z;
+	if (!(lengthSq > sumSq * MinOrthogonalFraction && sumSq <= FLT_MAX))
+		return FallbackTangent(normal);
+
+	float inverse = 1.0f / sqrtf(lengthSq);
+	return DirectX::XMFLOAT3(x * inverse, y * inverse, z * inverse);
+}
+
+// One triangle at a time, exactly like the original Mesh::CalculateTangents apart from the degenerate handling
+void TangentGenerator::CalculateScalar(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	std::vector<DirectX::XMFLOAT3> sums(numVerts, DirectX::XMFLOAT3(0, 0, 0));
+	for (int i = 0; i + 2 < numIndices; i += 3)
+	{
+		DirectX::XMFLOAT3 t = TriangleTangent(verts[indices[i]], verts[indices[i + 1]], verts[indices[i + 2]]);
+		for (int c = 0; c < 3; c++)
+		{
+			DirectX::XMFLOAT3& sum = sums[indices[i + c]];
+			sum.x += t.x;
+			sum.y += t.y;
+			sum.z += t.z;
+		}
+	}
+
+	for (int i = 0; i < numVerts; i++)
+		verts[i].tangent = Orthonormalize(verts[i].normal, sums[i]);
+}
+
+// ---------------------- SSE HELPERS ----------------------
+
+// Adds the tangents of triangles [firstTriangle, endTriangle) into sums, which starts at vertex baseVertex
+// - One triangle per iteration with x, y and z side by side in a register, since gathering four
+//   triangles into columns costs more shuffles than the math it saves (the loop is bound by the
+//   scattered loads and adds, not the arithmetic)
+static void AccumulateTriangles(
+	const Vertex* verts, const unsigned int* indices,
+	int firstTriangle, int endTriangle,
+	__m128* sums, unsigned int baseVertex)
+{
+	// Positions are loaded as (x, y, z, nx) rows, so the last lane has to be cleared
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+
+	for (int t = firstTriangle; t < endTriangle; t++)
+	{
+		const unsigned int* tri = indices + t * 3;
+		const Vertex& v1 = verts[tri[0]];
+		const Vertex& v2 = verts[tri[1]];
+		const Vertex& v3 = verts[tri[2]];
+
+		// Edges, all three components at once
+		__m128 p1 = _mm_loadu_ps(&v1.position.x);
+		__m128 e1 = _mm_sub_ps(_mm_loadu_ps(&v2.position.x), p1);
+		__m128 e2 = _mm_sub_ps(_mm_loadu_ps(&v3.position.x), p1);
+
+		// Same uv math as TriangleTangent
+		float s1 = v2.uv.x - v1.uv.x;
+		float t1 = v2.uv.y - v1.uv.y;
+		float s2 = v3.uv.x - v1.uv.x;
+		float t2 = v3.uv.y - v1.uv.y;
+		float det = s1 * t2 - s2 * t1;
+		float r = fabsf(det) > MinUvDeterminant ? 1.0f / det : 0.0f;
+
+		__m128 tangent = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(t2), e1), _mm_mul_ps(_mm_set1_ps(t1), e2)), _mm_set1_ps(r));
+		tangent = _mm_and_ps(tangent, xyzMask);
+		for (int c = 0; c < 3; c++)
+		{
+			__m128* sum = &sums[tri[c] - baseVertex];
+			*sum = _mm_add_ps(*sum, tangent);
+		}
+	}
+}
+
+// Orthonormalizes the summed tangents of vertices [firstVertex, endVertex) and writes them out
+// - sums starts at firstVertex
+static void WriteTangents(Vertex* verts, int firstVertex, int endVertex, const __m128* sums)
+{
+	const __m128 minFraction = _mm_set1_ps(MinOrthogonalFraction);
+	const __m128 maxFloat = _mm_set1_ps(FLT_MAX);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	int i = firstVertex;
+	for (; i + 4 <= endVertex; i += 4)
+	{
+		// Normals come in as (nx, ny, nz, tx) rows, the tangent part is ignored
+		__m128 nx = _mm_loadu_ps(&verts[i].normal.x);
+		__m128 ny = _mm_loadu_ps(&verts[i + 1].normal.x);
+		__m128 nz = _mm_loadu_ps(&verts[i + 2].normal.x);
+		__m128 nw = _mm_loadu_ps(&verts[i + 3].normal.x);
+		_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+
+		const __m128* s = sums + (i - firstVertex);
+		__m128 sx = s[0], sy = s[1], sz = s[2], sw = s[3];
+		_MM_TRANSPOSE4_PS(sx, sy, sz, sw);
+
+		// Same math as Orthonormalize
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, sx), _mm_mul_ps(ny, sy)), _mm_mul_ps(nz, sz));
+		__m128 tx = _mm_sub_ps(sx, _mm_mul_ps(nx, dot));
+		__m128 ty = _mm_sub_ps(sy, _mm_mul_ps(ny, dot));
+		__m128 tz = _mm_sub_ps(sz, _mm_mul_ps(nz, dot));
+
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+		__m128 sumSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)), _mm_mul_ps(sz, sz));
+		__m128 valid = _mm_and_ps(_mm_cmpgt_ps(lengthSq, _mm_mul_ps(sumSq, minFraction)), _mm_cmple_ps(sumSq, maxFloat));
+
+		__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+		tx = _mm_mul_ps(tx, inverse);
+		ty = _mm_mul_ps(ty, inverse);
+		tz = _mm_mul_ps(tz, inverse);
+		__m128 tw = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+
+		// Write x and y, then z on its own, since a full row would spill into the uv
+		__m128 rows[4] = { tx, ty, tz, tw };
+		int validMask = _mm_movemask_ps(valid);
+		for (int k = 0; k < 4; k++)
+		{
+			if (validMask & (1 << k))
+			{
+				_mm_storel_pi((__m64*)&verts[i + k].tangent.x, rows[k]);
+				_mm_store_ss(&verts[i + k].tangent.z, _mm_movehl_ps(rows[k], rows[k]));
+			}
+			else
+			{
+				verts[i + k].tangent = FallbackTangent(verts[i + k].normal);
+			}
+		}
+	}
+
+	// Leftover vertices one at a time
+	for (; i < endVertex; i++)
+	{
+		DirectX::XMFLOAT4 sum;
+		_mm_storeu_ps(&sum.x, sums[i - firstVertex]);
+		verts[i].tangent = Orthonormalize(verts[i].normal, DirectX::XMFLOAT3(sum.x, sum.y, sum.z));
+	}
+}
+
+// Sums triangle tangents in parallel, then reduces and orthonormalizes them in parallel
+void TangentGenerator::Calculate(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, int threadCount)
+{
+	int numTriangles = numIndices / 3;
+	if (numVerts == 0)
+		return;
+
+	// Pick a thread count, small meshes aren't worth spinning up threads for
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency();
+		if (threadCount <= 0)
+			threadCount = 1;
+	}
+	threadCount = std::max(1, std::min(threadCount, numTriangles / MinTrianglesPerThread));
+
+	// Every thread sums its own triangles into a partial buffer covering just the vertices they use
+	// - Meshes that went through the vertex cache and fetch passes keep these ranges small
+	struct PartialSums
+	{
+		unsigned int firstVertex;
+		unsigned int endVertex;
+		std::vector<__m128> sums;
+	};
+	std::vector<PartialSums> partials(threadCount);
+	RunOnThreads(threadCount, [&](int thread)
+	{
+		int firstTriangle = (int)((long long)numTriangles * thread / threadCount);
+		int endTriangle = (int)((long long)numTriangles * (thread + 1) / threadCount);
+		PartialSums& partial = partials[thread];
+		if (firstTriangle == endTriangle)
+		{
+			partial.firstVertex = partial.endVertex = 0;
+			return;
+		}
+
+		unsigned int lowest = 0;
+		unsigned int highest = numVerts - 1;
+		if (threadCount > 1)
+		{
+			lowest = indices[firstTriangle * 3];
+			highest = lowest;
+			for (int i = firstTriangle * 3; i < endTriangle * 3; i++)
+			{
+				lowest = std::min(lowest, indices[i]);
+				highest = std::max(highest, indices[i]);
+			}
+		}
+
+		partial.firstVertex = lowest;
+		partial.endVertex = highest + 1;
+		partial.sums.assign(partial.endVertex - partial.firstVertex, _mm_setzero_ps());
+		AccumulateTriangles(verts, indices, firstTriangle, endTriangle, partial.sums.data(), lowest);
+	});
+
+	// Every thread adds up the partial buffers over its own range of vertices and writes the results
+	RunOnThreads(threadCount, [&](int thread)
+	{
+		int first = (int)((long long)numVerts * thread / threadCount) & ~3;
+		int end = thread + 1 == threadCount ? numVerts : (int)((long long)numVerts * (thread + 1) / threadCount) & ~3;
+		if (first >= end)
+			return;
+
+		// A single partial buffer covering the whole range (always the case on one thread) is used as is
+		int overlapping = 0;
+		const PartialSums* only = nullptr;
+		for (int p = 0; p < threadCount; p++)
+		{
+			if ((int)partials[p].firstVertex < end && (int)partials[p].endVertex > first)
+			{
+				overlapping++;
+				only = &partials[p];
+			}
+		}
+		if (overlapping == 1 && (int)only->firstVertex <= first && (int)only->endVertex >= end)
+		{
+			WriteTangents(verts, first, end, only->sums.data() + (first - (int)only->firstVertex));
+			return;
+		}
+
+		std::vector<__m128> sums(end - first, _mm_setzero_ps());
+		for (int p = 0; p < threadCount; p++)
+		{
+			int overlapFirst = std::max(first, (int)partials[p].firstVertex);
+			int overlapEnd = std::min(end, (int)partials[p].endVertex);
+			const __m128* source = partials[p].sums.data() + (overlapFirst - (int)partials[p].firstVertex);
+			for (int i = overlapFirst; i < overlapEnd; i++)
+				sums[i - first] = _mm_add_ps(sums[i - first], source[i - overlapFirst]);
+		}
+
+		WriteTangents(verts, first, end, sums.data());
+	});
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Builds per-vertex tangents from positions, normals and
+// uvs (Lengyel's method, see Mesh::CalculateTangents)
+//
+// - Triangles are summed with SSE2 and split across threads,
+//   each summing into its own partial buffer that only spans
+//   the vertices its triangles use, then every thread adds
+//   up and orthonormalizes its own range of vertices, four
+//   at a time as columns
+// - Triangles with degenerate uvs add nothing, and vertices
+//   left without a usable tangent get one perpendicular to
+//   their normal, so the output never has infinities or NaNs
+// --------------------------------------------------------
+class TangentGenerator
+{
+public:
+	// Every thread gets at least this many triangles
+	static const int MinTrianglesPerThread = 64 * 1024;
+
+	// Overwrites the tangent of every vertex, only positions, normals and uvs are read
+	// - A thread count of 0 picks one automatically based on the triangle count
+	static void Calculate(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, int threadCount = 0);
+
+	// Same results one triangle at a time on a single thread (the way Mesh used to do it), for comparisons
+	static void CalculateScalar(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
+};
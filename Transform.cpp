@@ -1,6 +1,7 @@
 #include "Transform.h"
+#include <cmath>
 // Initializes the entity's transform
-Transform::Transform() 
+Transform::Transform()
 {
 	SetPosition(0.0f, 0.0f, 0.0f);
 	SetRotation(0.0f, 0.0f, 0.0f);
@@ -22,9 +23,35 @@ void Transform::SetPosition(float x, float y, float z)
 // Setter for rotation
 void Transform::SetRotation(float pitch, float yaw, float roll)
 {
-	rotation.x = pitch;
-	rotation.y = yaw;
-	rotation.z = roll;
+	pitchYawRoll.x = pitch;
+	pitchYawRoll.y = yaw;
+	pitchYawRoll.z = roll;
+
+	// The only trig a rotation costs, and only when it changes
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+	updateRotation();
+
+	matrixDirty = true;
+}
+
+// Setter for rotation as a quaternion, which doesn't need to be normalized
+void Transform::SetRotation(DirectX::XMFLOAT4 quaternion)
+{
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionNormalize(DirectX::XMLoadFloat4(&quaternion)));
+	updateRotation();
+
+	// Recover the Euler angles from the basis, with roll folded into yaw when looking straight up or down
+	pitchYawRoll.x = asinf(fmaxf(-1.0f, fminf(1.0f, -forward.y)));
+	if (fabsf(forward.y) < 0.9999f)
+	{
+		pitchYawRoll.y = atan2f(forward.x, forward.z);
+		pitchYawRoll.z = atan2f(right.y, up.y);
+	}
+	else
+	{
+		pitchYawRoll.y = atan2f(-right.z, right.x);
+		pitchYawRoll.z = 0.0f;
+	}
 
 	matrixDirty = true;
 }
@@ -41,24 +68,21 @@ void Transform::SetScale(float x, float y, float z)
 
 // Moves the transform relative to the rotational vector
 void Transform::MoveRelative(float x, float y, float z) {
-	// Calculate the adjustment we need to make
-	DirectX::XMVECTOR absDirection = DirectX::XMVectorSet(x, y, z, 0);
-	DirectX::XMVECTOR rotationVector = DirectX::XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-	DirectX::XMVECTOR adjustment = DirectX::XMVector3Rotate(absDirection, rotationVector);
-
-	// Load current position into an XMVECTOR and add the adjustment to the current position
-	DirectX::XMVECTOR currentPos = DirectX::XMLoadFloat3(&position);
-	DirectX::XMVECTOR newPos = DirectX::XMVectorAdd(currentPos, adjustment);
+	// The cached basis is already the rotated axes, so no quaternion is needed
+	position.x += right.x * x + up.x * y + forward.x * z;
+	position.y += right.y * x + up.y * y + forward.y * z;
+	position.z += right.z * x + up.z * y + forward.z * z;
 
-	// Store the new position in place of the old position
-	DirectX::XMStoreFloat3(&position, newPos);
+	matrixDirty = true;
 }
 
 
 // --------------------------------- Getters for internal members
 DirectX::XMFLOAT3 Transform::GetPosition() { return position; }
-DirectX::XMFLOAT3 Transform::GetPitchYawRoll() { return rotation; }
+DirectX::XMFLOAT3 Transform::GetPitchYawRoll() { return pitchYawRoll; }
+DirectX::XMFLOAT4 Transform::GetRotation() { return rotation; }
 DirectX::XMFLOAT3 Transform::GetScale() { return scale; }
+DirectX::XMVECTOR Transform::GetForwardVector() { return DirectX::XMLoadFloat3(&forward); }
 bool Transform::GetMatrixDirty() { return matrixDirty; }
 
 // --------------------------------- Functions for transforming the entity's position, rotation, or scale
@@ -73,17 +97,13 @@ void Transform::MoveAbsolute(float x, float y, float z)
 }
 
 // Rotates the object about pitch, yaw, and roll axes
-void Transform::Rotate(float pitch, float yaw, float roll) 
+void Transform::Rotate(float pitch, float yaw, float roll)
 {
-	rotation.x += pitch;
-	rotation.y += yaw;
-	rotation.z += roll;
-
-	matrixDirty = true;
+	SetRotation(pitchYawRoll.x + pitch, pitchYawRoll.y + yaw, pitchYawRoll.z + roll);
 }
 
 // Scales the object my multiplying current by passed values
-void Transform::Scale(float x, float y, float z) 
+void Transform::Scale(float x, float y, float z)
 {
 	scale.x *= x;
 	scale.y *= y;
@@ -92,27 +112,60 @@ void Transform::Scale(float x, float y, float z)
 	matrixDirty = true;
 }
 
-// Generate and set in place an updated world matrix
+// Caches the rows of the rotation matrix, which are the rotated x, y and z axes
+void Transform::updateRotation()
+{
+	DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&rotation));
+	DirectX::XMStoreFloat3(&right, rotationMatrix.r[0]);
+	DirectX::XMStoreFloat3(&up, rotationMatrix.r[1]);
+	DirectX::XMStoreFloat3(&forward, rotationMatrix.r[2]);
+}
+
+// Generate and set in place an updated world matrix and its inverse transpose
 void Transform::updateWorldMatrix()
 {
-	// Generating trans/rot/scale matrices
+	// Generating trans/rot/scale matrices, with the rotation straight from the cached basis
 	DirectX::XMMATRIX translationMatrix = DirectX::XMMatrixTranslation(position.x, position.y, position.z);
-	DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
+	DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixSet(
+		right.x, right.y, right.z, 0.0f,
+		up.x, up.y, up.z, 0.0f,
+		forward.x, forward.y, forward.z, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
 	DirectX::XMMATRIX scaleMatrix = DirectX::XMMatrixScaling(scale.x, scale.y, scale.z);
 
 	// Calculating and setting new world matrix
 	DirectX::XMMATRIX world = translationMatrix * rotationMatrix * scaleMatrix;
 	DirectX::XMStoreFloat4x4(&worldMatrix, world);
 
-	// Denote that the matrix has been cleaned
+	// The inverse is S^-1 * R^T * T^-1, so its transpose is the rotation with each column divided by its scale
+	// - Translation ends up in the last column, where normals (w = 0) never see it
+	float invX = scale.x != 0.0f ? 1.0f / scale.x : 0.0f;
+	float invY = scale.y != 0.0f ? 1.0f / scale.y : 0.0f;
+	float invZ = scale.z != 0.0f ? 1.0f / scale.z : 0.0f;
+	worldInverseTransposeMatrix = DirectX::XMFLOAT4X4(
+		right.x * invX, right.y * invY, right.z * invZ, -position.x,
+		up.x * invX, up.y * invY, up.z * invZ, -position.y,
+		forward.x * invX, forward.y * invY, forward.z * invZ, -position.z,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Denote that the matrices have been cleaned
 	matrixDirty = false;
 }
 
 // Gets a cleaned world matrix when requested
-DirectX::XMFLOAT4X4 Transform::GetWorldMatrix() 
-{ 
+DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
+{
+	if (matrixDirty)
+		updateWorldMatrix();
+
+	return worldMatrix;
+}
+
+// Gets a cleaned inverse transpose of the world matrix, for transforming normals
+DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
+{
 	if (matrixDirty)
 		updateWorldMatrix();
 
-	return worldMatrix; 
+	return worldInverseTransposeMatrix;
 }
@@ -10,14 +10,17 @@ public:
 	// Collection of setters
 	void SetPosition(float x, float y, float z);
 	void SetRotation(float pitch, float yaw, float roll);
+	void SetRotation(DirectX::XMFLOAT4 quaternion);
 	void SetScale(float x, float y, float z);
 	void MoveRelative(float x, float y, float z);
 
 	// Collection of getters
 	DirectX::XMFLOAT3 GetPosition();
 	DirectX::XMFLOAT3 GetPitchYawRoll();
+	DirectX::XMFLOAT4 GetRotation();
 	DirectX::XMFLOAT3 GetScale();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
 	DirectX::XMVECTOR GetForwardVector();
 	bool GetMatrixDirty();
 
@@ -30,15 +33,24 @@ public:
 	void updateWorldMatrix();
 
 private:
-	// World matrix for projections
+	// Rebuilds the cached rotation basis from the quaternion
+	void updateRotation();
+
+	// World matrix for projections, and its inverse transpose for normals
 	DirectX::XMFLOAT4X4 worldMatrix;
+	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
 
 	// Position, rotation, and scale for object tracking
 	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 rotation;  // Note: Could be updated to quaternions for more robust rotations in the future
-	DirectX::XMFLOAT3 scale;		
+	DirectX::XMFLOAT4 rotation;			// Unit quaternion, the matrices are built from this
+	DirectX::XMFLOAT3 pitchYawRoll;		// The Euler angles as last set, or recovered from a quaternion
+	DirectX::XMFLOAT3 scale;
+
+	// Rotation basis (rows of the rotation matrix), cached whenever the rotation changes
+	DirectX::XMFLOAT3 right;
+	DirectX::XMFLOAT3 up;
+	DirectX::XMFLOAT3 forward;
 
-	// Boolean to track if we need to rebuild the world matrix before rendering
+	// Boolean to track if we need to rebuild both matrices before rendering
 	bool matrixDirty;
 };
-
@@ -0,0 +1,421 @@
+#include "TransformSystem.h"
+#include <xmmintrin.h>
+#include <cmath>
+
+// Transposes one matrix row of four transforms back from lanes and stores it
+static void StoreRow(DirectX::XMFLOAT4X4* world, int row, __m128 m0, __m128 m1, __m128 m2, __m128 m3)
+{
+	_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+	_mm_storeu_ps(world[0].m[row], m0);
+	_mm_storeu_ps(world[1].m[row], m1);
+	_mm_storeu_ps(world[2].m[row], m2);
+	_mm_storeu_ps(world[3].m[row], m3);
+}
+
+int TransformSystem::Create()
+{
+	if (!freeIndices.empty())
+	{
+		int t = freeIndices.back();
+		freeIndices.pop_back();
+		return t;
+	}
+
+	// Grow by a whole batch of identity transforms, so the padding lanes are always valid
+	if (count % BatchWidth == 0)
+	{
+		size_t size = count + BatchWidth;
+		posX.resize(size, 0.0f);
+		posY.resize(size, 0.0f);
+		posZ.resize(size, 0.0f);
+		rotX.resize(size, 0.0f);
+		rotY.resize(size, 0.0f);
+		rotZ.resize(size, 0.0f);
+		rotW.resize(size, 1.0f);
+		pitch.resize(size, 0.0f);
+		yaw.resize(size, 0.0f);
+		roll.resize(size, 0.0f);
+		scaleX.resize(size, 1.0f);
+		scaleY.resize(size, 1.0f);
+		scaleZ.resize(size, 1.0f);
+		local.resize(size);
+		localInverseTranspose.resize(size);
+		parents.resize(size, -1);
+		childCounts.resize(size, 0);
+		hierarchySlot.resize(size, -1);
+		dirty.resize((size + 63) / 64, 0);
+	}
+
+	int t = count++;
+	ResetTransform(t);
+	return t;
+}
+
+// Freed transforms go back to identity right away, so the index is ready to hand out again
+void TransformSystem::Destroy(int t)
+{
+	if (childCounts[t] > 0)
+	{
+		for (int c = 0; c < count; c++)
+		{
+			if (parents[c] == t)
+				parents[c] = -1;
+		}
+		childCounts[t] = 0;
+		hierarchyDirty = true;
+	}
+	SetParent(t, -1);
+	hierarchySlot[t] = -1;
+
+	ResetTransform(t);
+	dirty[t >> 6] &= ~(1ull << (t & 63));
+	freeIndices.push_back(t);
+}
+
+void TransformSystem::ResetTransform(int t)
+{
+	posX[t] = posY[t] = posZ[t] = 0.0f;
+	rotX[t] = rotY[t] = rotZ[t] = 0.0f;
+	rotW[t] = 1.0f;
+	pitch[t] = yaw[t] = roll[t] = 0.0f;
+	scaleX[t] = scaleY[t] = scaleZ[t] = 1.0f;
+	DirectX::XMStoreFloat4x4(&local[t], DirectX::XMMatrixIdentity());
+	DirectX::XMStoreFloat4x4(&localInverseTranspose[t], DirectX::XMMatrixIdentity());
+}
+
+void TransformSystem::Clear()
+{
+	count = 0;
+	freeIndices.clear();
+	posX.clear();
+	posY.clear();
+	posZ.clear();
+	rotX.clear();
+	rotY.clear();
+	rotZ.clear();
+	rotW.clear();
+	pitch.clear();
+	yaw.clear();
+	roll.clear();
+	scaleX.clear();
+	scaleY.clear();
+	scaleZ.clear();
+	local.clear();
+	localInverseTranspose.clear();
+	parents.clear();
+	childCounts.clear();
+	hierarchySlot.clear();
+	dirty.clear();
+	changed.clear();
+	hierarchy.clear();
+	hierarchyParents.clear();
+	hierarchyWorld.clear();
+	hierarchyInverseTranspose.clear();
+	hierarchyDirty = false;
+}
+
+int TransformSystem::GetCount() { return count - (int)freeIndices.size(); }
+
+void TransformSystem::MarkDirty(int t) { dirty[t >> 6] |= 1ull << (t & 63); }
+
+// --------------------------------- Setters for position, scale, and rotation
+void TransformSystem::SetPosition(int t, float x, float y, float z)
+{
+	posX[t] = x;
+	posY[t] = y;
+	posZ[t] = z;
+	MarkDirty(t);
+}
+
+// The only trig a rotation costs, and only when it changes
+void TransformSystem::SetRotation(int t, float p, float y, float r)
+{
+	pitch[t] = p;
+	yaw[t] = y;
+	roll[t] = r;
+
+	DirectX::XMFLOAT4 q;
+	DirectX::XMStoreFloat4(&q, DirectX::XMQuaternionRotationRollPitchYaw(p, y, r));
+	rotX[t] = q.x;
+	rotY[t] = q.y;
+	rotZ[t] = q.z;
+	rotW[t] = q.w;
+	MarkDirty(t);
+}
+
+// Same as Transform, the quaternion doesn't need to be normalized and the Euler angles are recovered from its basis
+void TransformSystem::SetRotation(int t, DirectX::XMFLOAT4 quaternion)
+{
+	DirectX::XMVECTOR q = DirectX::XMQuaternionNormalize(DirectX::XMLoadFloat4(&quaternion));
+	DirectX::XMStoreFloat4(&quaternion, q);
+	rotX[t] = quaternion.x;
+	rotY[t] = quaternion.y;
+	rotZ[t] = quaternion.z;
+	rotW[t] = quaternion.w;
+
+	DirectX::XMFLOAT3 right, up, forward;
+	DirectX::XMMATRIX basis = DirectX::XMMatrixRotationQuaternion(q);
+	DirectX::XMStoreFloat3(&right, basis.r[0]);
+	DirectX::XMStoreFloat3(&up, basis.r[1]);
+	DirectX::XMStoreFloat3(&forward, basis.r[2]);
+	pitch[t] = asinf(fmaxf(-1.0f, fminf(1.0f, -forward.y)));
+	if (fabsf(forward.y) < 0.9999f)
+	{
+		yaw[t] = atan2f(forward.x, forward.z);
+		roll[t] = atan2f(right.y, up.y);
+	}
+	else
+	{
+		yaw[t] = atan2f(-right.z, right.x);
+		roll[t] = 0.0f;
+	}
+	MarkDirty(t);
+}
+
+void TransformSystem::SetScale(int t, float x, float y, float z)
+{
+	scaleX[t] = x;
+	scaleY[t] = y;
+	scaleZ[t] = z;
+	MarkDirty(t);
+}
+
+void TransformSystem::MoveAbsolute(int t, float x, float y, float z)
+{
+	posX[t] += x;
+	posY[t] += y;
+	posZ[t] += z;
+	MarkDirty(t);
+}
+
+void TransformSystem::Rotate(int t, float p, float y, float r)
+{
+	SetRotation(t, pitch[t] + p, yaw[t] + y, roll[t] + r);
+}
+
+void TransformSystem::Scale(int t, float x, float y, float z)
+{
+	scaleX[t] *= x;
+	scaleY[t] *= y;
+	scaleZ[t] *= z;
+	MarkDirty(t);
+}
+
+// --------------------------------- Getters for internal members
+DirectX::XMFLOAT3 TransformSystem::GetPosition(int t) { return DirectX::XMFLOAT3(posX[t], posY[t], posZ[t]); }
+DirectX::XMFLOAT3 TransformSystem::GetPitchYawRoll(int t) { return DirectX::XMFLOAT3(pitch[t], yaw[t], roll[t]); }
+DirectX::XMFLOAT4 TransformSystem::GetRotation(int t) { return DirectX::XMFLOAT4(rotX[t], rotY[t], rotZ[t], rotW[t]); }
+DirectX::XMFLOAT3 TransformSystem::GetScale(int t) { return DirectX::XMFLOAT3(scaleX[t], scaleY[t], scaleZ[t]); }
+bool TransformSystem::GetMatrixDirty(int t) { return (dirty[t >> 6] >> (t & 63)) & 1; }
+int TransformSystem::GetParent(int t) { return parents[t]; }
+
+const DirectX::XMFLOAT4X4& TransformSystem::GetWorldMatrix(int t)
+{
+	return hierarchySlot[t] < 0 ? local[t] : hierarchyWorld[hierarchySlot[t]];
+}
+
+const DirectX::XMFLOAT4X4& TransformSystem::GetWorldInverseTransposeMatrix(int t)
+{
+	return hierarchySlot[t] < 0 ? localInverseTranspose[t] : hierarchyInverseTranspose[hierarchySlot[t]];
+}
+
+// --------------------------------- Hierarchy
+bool TransformSystem::SetParent(int t, int parent)
+{
+	// Only a transform with children can end up above its new parent, so building a hierarchy top down never walks
+	if (parent == t)
+		return false;
+	for (int p = parent; p >= 0 && childCounts[t] > 0; p = parents[p])
+	{
+		if (p == t)
+			return false;
+	}
+	if (parents[t] == parent)
+		return true;
+
+	if (parents[t] >= 0)
+		childCounts[parents[t]]--;
+	if (parent >= 0)
+		childCounts[parent]++;
+	parents[t] = parent;
+	hierarchyDirty = true;
+	return true;
+}
+
+// Lays the parented transforms out depth first from each root, which takes a pass over every transform, so it's
+// only done when links have changed since the last update
+void TransformSystem::RebuildHierarchy()
+{
+	for (int t : hierarchy)
+		hierarchySlot[t] = -1;
+	hierarchy.clear();
+	hierarchyParents.clear();
+
+	// Group the children by parent, counting out where each run ends then filling it back to front
+	childStart.resize(count);
+	int total = 0;
+	for (int t = 0; t < count; t++)
+	{
+		total += childCounts[t];
+		childStart[t] = total;
+	}
+	children.resize(total);
+	for (int t = 0; t < count; t++)
+	{
+		if (parents[t] >= 0)
+			children[--childStart[parents[t]]] = t;
+	}
+
+	for (int root = 0; root < count; root++)
+	{
+		if (parents[root] >= 0 || childCounts[root] == 0)
+			continue;
+
+		// Children are pushed last to first so they come off the stack in order
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			int t = stack.back();
+			stack.pop_back();
+			if (t != root)
+			{
+				hierarchySlot[t] = (int)hierarchy.size();
+				hierarchy.push_back(t);
+				hierarchyParents.push_back(hierarchySlot[parents[t]]);
+			}
+			for (int c = childStart[t] + childCounts[t] - 1; c >= childStart[t]; c--)
+				stack.push_back(children[c]);
+		}
+	}
+
+	hierarchyWorld.resize(hierarchy.size());
+	hierarchyInverseTranspose.resize(hierarchy.size());
+	hierarchyDirty = false;
+}
+
+// One pass in depth first order, so a parent's world matrix is always final before its children use it
+// - Each transform composed is marked changed, which is what carries a change down to the whole subtree
+// - Returns how many were composed that weren't dirty themselves
+int TransformSystem::ComposeHierarchy(bool all)
+{
+	int composed = 0;
+	for (size_t i = 0; i < hierarchy.size(); i++)
+	{
+		int t = hierarchy[i];
+		int parent = parents[t];
+		bool own = (changed[t >> 6] >> (t & 63)) & 1;
+		if (!all && !own && !((changed[parent >> 6] >> (parent & 63)) & 1))
+			continue;
+		if (!own)
+		{
+			changed[t >> 6] |= 1ull << (t & 63);
+			composed++;
+		}
+
+		// Inverse transposes compose in the same order, (L * P)^-T = L^-T * P^-T
+		int slot = hierarchyParents[i];
+		const DirectX::XMFLOAT4X4& parentWorld = slot < 0 ? local[parent] : hierarchyWorld[slot];
+		const DirectX::XMFLOAT4X4& parentInverseTranspose = slot < 0 ? localInverseTranspose[parent] : hierarchyInverseTranspose[slot];
+		DirectX::XMStoreFloat4x4(&hierarchyWorld[i], DirectX::XMMatrixMultiply(
+			DirectX::XMLoadFloat4x4(&local[t]), DirectX::XMLoadFloat4x4(&parentWorld)));
+		DirectX::XMStoreFloat4x4(&hierarchyInverseTranspose[i], DirectX::XMMatrixMultiply(
+			DirectX::XMLoadFloat4x4(&localInverseTranspose[t]), DirectX::XMLoadFloat4x4(&parentInverseTranspose)));
+	}
+	return composed;
+}
+
+// Everything dirty means everything is marked changed for the composing pass too
+int TransformSystem::UpdateAllWorldMatrices()
+{
+	for (int t = 0; t < count; t++)
+		MarkDirty(t);
+	return UpdateWorldMatrices();
+}
+
+// Rebuilds every dirty batch of four, which is T * R * S written out per element with R straight from the quaternion,
+// the same terms as XMMatrixRotationQuaternion (so the same matrix as Transform, to within float rounding)
+int TransformSystem::UpdateWorldMatrices()
+{
+	int rebuilt = 0;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	// New links mean composing everything again, otherwise only what changed (and what's under it)
+	bool relinked = hierarchyDirty;
+	if (hierarchyDirty)
+		RebuildHierarchy();
+	if (!hierarchy.empty())
+		changed = dirty;
+
+	for (size_t w = 0; w < dirty.size(); w++)
+	{
+		unsigned long long bits = dirty[w];
+		if (bits == 0)
+			continue;
+		dirty[w] = 0;
+
+		for (int g = 0; g < 64; g += BatchWidth)
+		{
+			unsigned int lanes = (unsigned int)(bits >> g) & 15;
+			if (lanes == 0)
+				continue;
+
+			// Clean lanes in the batch are rebuilt too, which gives back exactly the same matrix
+			rebuilt += (lanes & 1) + ((lanes >> 1) & 1) + ((lanes >> 2) & 1) + (lanes >> 3);
+			size_t base = w * 64 + g;
+
+			// Rotation from the quaternion, no trig needed
+			__m128 qx = _mm_loadu_ps(&rotX[base]);
+			__m128 qy = _mm_loadu_ps(&rotY[base]);
+			__m128 qz = _mm_loadu_ps(&rotZ[base]);
+			__m128 qw = _mm_loadu_ps(&rotW[base]);
+			__m128 x2 = _mm_add_ps(qx, qx);
+			__m128 y2 = _mm_add_ps(qy, qy);
+			__m128 z2 = _mm_add_ps(qz, qz);
+			__m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2), zz = _mm_mul_ps(qz, z2);
+			__m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2), yz = _mm_mul_ps(qy, z2);
+			__m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2), wz = _mm_mul_ps(qw, z2);
+			__m128 r00 = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+			__m128 r01 = _mm_add_ps(xy, wz);
+			__m128 r02 = _mm_sub_ps(xz, wy);
+			__m128 r10 = _mm_sub_ps(xy, wz);
+			__m128 r11 = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+			__m128 r12 = _mm_add_ps(yz, wx);
+			__m128 r20 = _mm_add_ps(xz, wy);
+			__m128 r21 = _mm_sub_ps(yz, wx);
+			__m128 r22 = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+
+			// Translation goes through the rotation, then every column is scaled
+			__m128 tx = _mm_loadu_ps(&posX[base]);
+			__m128 ty = _mm_loadu_ps(&posY[base]);
+			__m128 tz = _mm_loadu_ps(&posZ[base]);
+			__m128 sx = _mm_loadu_ps(&scaleX[base]);
+			__m128 sY = _mm_loadu_ps(&scaleY[base]);
+			__m128 sz = _mm_loadu_ps(&scaleZ[base]);
+			__m128 t0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, r00), _mm_mul_ps(ty, r10)), _mm_mul_ps(tz, r20));
+			__m128 t1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, r01), _mm_mul_ps(ty, r11)), _mm_mul_ps(tz, r21));
+			__m128 t2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, r02), _mm_mul_ps(ty, r12)), _mm_mul_ps(tz, r22));
+
+			DirectX::XMFLOAT4X4* out = &local[base];
+			StoreRow(out, 0, _mm_mul_ps(r00, sx), _mm_mul_ps(r01, sY), _mm_mul_ps(r02, sz), zero);
+			StoreRow(out, 1, _mm_mul_ps(r10, sx), _mm_mul_ps(r11, sY), _mm_mul_ps(r12, sz), zero);
+			StoreRow(out, 2, _mm_mul_ps(r20, sx), _mm_mul_ps(r21, sY), _mm_mul_ps(r22, sz), zero);
+			StoreRow(out, 3, _mm_mul_ps(t0, sx), _mm_mul_ps(t1, sY), _mm_mul_ps(t2, sz), one);
+
+			// Inverse transpose, the rotation with each column divided by its scale (a zero scale gives a zero
+			// column, like Transform) and the negated position in the last column
+			__m128 ix = _mm_and_ps(_mm_cmpneq_ps(sx, zero), _mm_div_ps(one, sx));
+			__m128 iy = _mm_and_ps(_mm_cmpneq_ps(sY, zero), _mm_div_ps(one, sY));
+			__m128 iz = _mm_and_ps(_mm_cmpneq_ps(sz, zero), _mm_div_ps(one, sz));
+			out = &localInverseTranspose[base];
+			StoreRow(out, 0, _mm_mul_ps(r00, ix), _mm_mul_ps(r01, iy), _mm_mul_ps(r02, iz), _mm_sub_ps(zero, tx));
+			StoreRow(out, 1, _mm_mul_ps(r10, ix), _mm_mul_ps(r11, iy), _mm_mul_ps(r12, iz), _mm_sub_ps(zero, ty));
+			StoreRow(out, 2, _mm_mul_ps(r20, ix), _mm_mul_ps(r21, iy), _mm_mul_ps(r22, iz), _mm_sub_ps(zero, tz));
+			StoreRow(out, 3, zero, zero, zero, one);
+		}
+	}
+
+	if (!hierarchy.empty() && (relinked || rebuilt > 0))
+		rebuilt += ComposeHierarchy(relinked);
+	return rebuilt;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Transforms stored as structure of arrays, for rebuilding
+// many world matrices at once
+//
+// - Each transform is an index handed out by Create, with
+//   the same position, quaternion rotation and scale as
+//   Transform and the same world matrix (T * R * S) and
+//   inverse transpose
+// - Like Transform, the only trig is turning pitch/yaw/roll
+//   into a quaternion when a rotation is set. Setters then
+//   only mark the transform in a dirty bitset, and
+//   UpdateWorldMatrices rebuilds every dirty matrix from
+//   its quaternion in one pass, four transforms at a time
+//   with SSE, so call it once per frame before rendering
+// - Destroyed indices are reused by later creates, most
+//   recently destroyed first
+// - A transform can have a parent, which makes its world
+//   matrix its own matrix times the parent's world matrix.
+//   Parented transforms are also kept depth first in flat
+//   arrays (laid out again only when links change), so
+//   after the batched pass a single linear pass composes
+//   every parent before its children, skipping the ones
+//   where neither they nor anything above them changed
+// - The arrays are padded to whole batches, so a batch
+//   never needs a scalar tail
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+	// Transforms per SSE batch
+	static const int BatchWidth = 4;
+
+	// Adds an identity transform and returns its index
+	int Create();
+
+	// Frees the index for a later Create, detaching it from its parent and its children from it (they become roots)
+	void Destroy(int t);
+
+	// Removes every transform
+	void Clear();
+
+	// Live transforms
+	int GetCount();
+
+	// Collection of setters, each marks the transform dirty
+	void SetPosition(int t, float x, float y, float z);
+	void SetRotation(int t, float pitch, float yaw, float roll);
+	void SetRotation(int t, DirectX::XMFLOAT4 quaternion);
+	void SetScale(int t, float x, float y, float z);
+	void MoveAbsolute(int t, float x, float y, float z);
+	void Rotate(int t, float pitch, float yaw, float roll);
+	void Scale(int t, float x, float y, float z);
+
+	// Collection of getters
+	DirectX::XMFLOAT3 GetPosition(int t);
+	DirectX::XMFLOAT3 GetPitchYawRoll(int t);
+	DirectX::XMFLOAT4 GetRotation(int t);
+	DirectX::XMFLOAT3 GetScale(int t);
+	bool GetMatrixDirty(int t);
+
+	// Attaches the transform to a parent, or detaches it with -1
+	// - Returns false and changes nothing if the parent is the transform itself or one of its descendants
+	bool SetParent(int t, int parent);
+	int GetParent(int t);
+
+	// Rebuilds the world matrix of every dirty transform and every transform under one, and returns how many that was
+	int UpdateWorldMatrices();
+
+	// Rebuilds and composes every world matrix, dirty or not, and returns how many that was
+	int UpdateAllWorldMatrices();
+
+	// The world matrix and its inverse transpose (for normals) as of the last UpdateWorldMatrices
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(int t);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(int t);
+
+private:
+	void MarkDirty(int t);
+	void ResetTransform(int t);
+	void RebuildHierarchy();
+	int ComposeHierarchy(bool all);
+
+	int count = 0;                          // Indices handed out so far, live or not
+	std::vector<int> freeIndices;
+
+	// One entry per transform, padded to a multiple of BatchWidth
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> rotX, rotY, rotZ, rotW;               // Unit quaternion, the matrices are built from this
+	std::vector<float> pitch, yaw, roll;                    // The Euler angles as last set, or recovered from a quaternion
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<DirectX::XMFLOAT4X4> local;                 // Also the world matrix, for transforms without a parent
+	std::vector<DirectX::XMFLOAT4X4> localInverseTranspose;
+	std::vector<int> parents;                               // -1 for roots
+	std::vector<int> childCounts;
+	std::vector<int> hierarchySlot;                         // Where a parented transform is in the hierarchy arrays, -1 for roots
+
+	// One bit per transform, set until its matrix is rebuilt, and the same bits as they were before the last
+	// rebuild (plus every transform composed under one) for deciding what to compose
+	std::vector<unsigned long long> dirty;
+	std::vector<unsigned long long> changed;
+
+	// One entry per parented transform, depth first, so parents always come before their children
+	std::vector<int> hierarchy;
+	std::vector<int> hierarchyParents;                      // The parent's hierarchy slot, -1 if the parent is a root
+	std::vector<DirectX::XMFLOAT4X4> hierarchyWorld;
+	std::vector<DirectX::XMFLOAT4X4> hierarchyInverseTranspose;
+	bool hierarchyDirty = false;
+
+	// Scratch for laying the hierarchy out, children grouped by parent
+	std::vector<int> childStart;
+	std::vector<int> children;
+	std::vector<int> stack;
+};
@@ -13,4 +13,31 @@ struct Vertex
 	DirectX::XMFLOAT3 normal;
 	DirectX::XMFLOAT3 tangent;
 	DirectX::XMFLOAT2 uv;
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// Compressed versions of Vertex, built by VertexCompressor
+//
+// - Normals and tangents are octahedral encoded into two
+//   16-bit snorms, with the bitangent handedness stored in
+//   the sign of the tangent's second component
+// - UVs are half floats
+// --------------------------------------------------------
+
+// 24 bytes, full precision positions
+struct CompactVertex
+{
+	DirectX::XMFLOAT3 position;
+	short normal[2];
+	short tangent[2];
+	unsigned short uv[2];
+};
+
+// 20 bytes, positions are 16-bit unorms across the mesh's bounding box
+struct QuantizedVertex
+{
+	unsigned short position[4];	    // W is padding, there's no three component 16-bit format
+	short normal[2];
+	short tangent[2];
+	unsigned short uv[2];
+};
@@ -0,0 +1,487 @@
+#include "VertexCompressor.h"
+#include <DirectXPackedVector.h>
+#include <d3dcompiler.h>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+const D3D11_INPUT_ELEMENT_DESC VertexCompressor::CompactLayout[4] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+const D3D11_INPUT_ELEMENT_DESC VertexCompressor::QuantizedLayout[4] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+// The tangent's second component is remapped to [0, 1] so its sign is free for the handedness,
+// this keeps it away from zero so the sign always survives quantization
+static const float MinTangentMagnitude = 1.0f / 32767.0f;
+
+// ---------------------- SCALAR HELPERS ----------------------
+// These do exactly the same float math as the SSE versions below, so both paths give identical bits
+
+static float Clamp(float v, float lowest, float highest)
+{
+	return v < lowest ? lowest : (v > highest ? highest : v);
+}
+
+static short ToSnorm16(float v)
+{
+	return (short)lrintf(Clamp(v, -1.0f, 1.0f) * 32767.0f);
+}
+
+static float FromSnorm16(short v)
+{
+	return v < -32767 ? -1.0f : v / 32767.0f;
+}
+
+// Projects a vector onto the octahedron, then folds the lower half over the upper one
+static void OctEncode(float x, float y, float z, float& u, float& v)
+{
+	float inv = 1.0f / Clamp(fabsf(x) + fabsf(y) + fabsf(z), FLT_MIN, FLT_MAX);
+	u = x * inv;
+	v = y * inv;
+	if (z < 0.0f)
+	{
+		float foldedU = copysignf(1.0f - fabsf(v), u);
+		float foldedV = copysignf(1.0f - fabsf(u), v);
+		u = foldedU;
+		v = foldedV;
+	}
+}
+
+static DirectX::XMFLOAT3 OctDecode(float u, float v)
+{
+	float x = u;
+	float y = v;
+	float z = 1.0f - fabsf(u) - fabsf(v);
+	float t = Clamp(-z, 0.0f, 1.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float length = sqrtf(x * x + y * y + z * z);
+	return DirectX::XMFLOAT3(x / length, y / length, z / length);
+}
+
+// Round to nearest even, specials and denormals included
+static unsigned short FloatToHalf(float f)
+{
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+	unsigned int sign = bits & 0x80000000u;
+	unsigned int absBits = bits ^ sign;
+
+	unsigned int result;
+	if (absBits >= (127u + 16u) << 23)
+	{
+		// Too big for a half (or inf/nan)
+		result = absBits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+	}
+	else if (absBits < (127u - 14u) << 23)
+	{
+		// Denormal, let the float adder do the rounding
+		const unsigned int magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+		float magic;
+		float absF;
+		memcpy(&magic, &magicBits, sizeof(magic));
+		memcpy(&absF, &absBits, sizeof(absF));
+		float sum = absF + magic;
+		memcpy(&result, &sum, sizeof(result));
+		result -= magicBits;
+	}
+	else
+	{
+		// Rebias the exponent and round the mantissa
+		unsigned int mantissaOdd = (absBits >> 13) & 1u;
+		result = (absBits + (0xfffu - ((127u - 15u) << 23)) + mantissaOdd) >> 13;
+	}
+
+	return (unsigned short)(result | (sign >> 16));
+}
+
+// Encodes everything but the position for a single vertex
+static void EncodeAttributes(const Vertex& v, float handedness, short normal[2], short tangent[2], unsigned short uv[2])
+{
+	float u, w;
+	OctEncode(v.normal.x, v.normal.y, v.normal.z, u, w);
+	normal[0] = ToSnorm16(u);
+	normal[1] = ToSnorm16(w);
+
+	OctEncode(v.tangent.x, v.tangent.y, v.tangent.z, u, w);
+	tangent[0] = ToSnorm16(u);
+	tangent[1] = ToSnorm16(copysignf(Clamp(w * 0.5f + 0.5f, MinTangentMagnitude, 1.0f), handedness));
+
+	uv[0] = FloatToHalf(v.uv.x);
+	uv[1] = FloatToHalf(v.uv.y);
+}
+
+static void DecodeAttributes(const short normal[2], const short tangent[2], const unsigned short uv[2], Vertex& out, float* handedness)
+{
+	out.normal = OctDecode(FromSnorm16(normal[0]), FromSnorm16(normal[1]));
+
+	float w = FromSnorm16(tangent[1]);
+	out.tangent = OctDecode(FromSnorm16(tangent[0]), fabsf(w) * 2.0f - 1.0f);
+	if (handedness)
+		*handedness = w < 0.0f ? -1.0f : 1.0f;
+
+	out.uv.x = DirectX::PackedVector::XMConvertHalfToFloat(uv[0]);
+	out.uv.y = DirectX::PackedVector::XMConvertHalfToFloat(uv[1]);
+}
+
+// ---------------------- SSE HELPERS ----------------------
+
+// Four vertices worth of attributes, one vertex per lane
+struct VertexColumns
+{
+	__m128 px, py, pz;
+	__m128 nx, ny, nz;
+	__m128 tx, ty, tz;
+	__m128 u, v;
+};
+
+// Loads four vertices and transposes them into columns
+// - Each vertex is read as three overlapping rows so nothing past the last vertex is touched
+static void LoadColumns(const Vertex* verts, VertexColumns& c)
+{
+	__m128 a0 = _mm_loadu_ps(&verts[0].position.x);	// px py pz nx
+	__m128 a1 = _mm_loadu_ps(&verts[1].position.x);
+	__m128 a2 = _mm_loadu_ps(&verts[2].position.x);
+	__m128 a3 = _mm_loadu_ps(&verts[3].position.x);
+	_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+	c.px = a0; c.py = a1; c.pz = a2; c.nx = a3;
+
+	__m128 b0 = _mm_loadu_ps(&verts[0].normal.y);	// ny nz tx ty
+	__m128 b1 = _mm_loadu_ps(&verts[1].normal.y);
+	__m128 b2 = _mm_loadu_ps(&verts[2].normal.y);
+	__m128 b3 = _mm_loadu_ps(&verts[3].normal.y);
+	_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+	c.ny = b0; c.nz = b1; c.tx = b2; c.ty = b3;
+
+	__m128 d0 = _mm_loadu_ps(&verts[0].tangent.y);	// ty tz u v
+	__m128 d1 = _mm_loadu_ps(&verts[1].tangent.y);
+	__m128 d2 = _mm_loadu_ps(&verts[2].tangent.y);
+	__m128 d3 = _mm_loadu_ps(&verts[3].tangent.y);
+	_MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+	c.tz = d1; c.u = d2; c.v = d3;
+}
+
+static __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128 CopySign(__m128 magnitude, __m128 sign)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	return _mm_or_ps(_mm_andnot_ps(signMask, magnitude), _mm_and_ps(signMask, sign));
+}
+
+static void OctEncode4(__m128 x, __m128 y, __m128 z, __m128& u, __m128& v)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+	__m128 inv = _mm_div_ps(one, _mm_min_ps(_mm_max_ps(l1, _mm_set1_ps(FLT_MIN)), _mm_set1_ps(FLT_MAX)));
+	__m128 pu = _mm_mul_ps(x, inv);
+	__m128 pv = _mm_mul_ps(y, inv);
+
+	__m128 foldedU = CopySign(_mm_sub_ps(one, _mm_andnot_ps(signMask, pv)), pu);
+	__m128 foldedV = CopySign(_mm_sub_ps(one, _mm_andnot_ps(signMask, pu)), pv);
+	__m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+	u = Select(lower, foldedU, pu);
+	v = Select(lower, foldedV, pv);
+}
+
+static __m128i ToSnorm16x4(__m128 v)
+{
+	v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+	return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(32767.0f)));
+}
+
+// Same as FloatToHalf, results are sign extended to 32 bits so _mm_packs_epi32 keeps them intact
+static __m128i FloatToHalf4(__m128 f)
+{
+	const __m128i magicBits = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+
+	__m128 sign = _mm_and_ps(f, _mm_set1_ps(-0.0f));
+	__m128 absF = _mm_xor_ps(f, sign);
+	__m128i absBits = _mm_castps_si128(absF);
+
+	// Specials (too big, inf and nan)
+	__m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+	__m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(isNan, _mm_set1_epi32(0x200)));
+	__m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23), absBits);
+
+	// Denormals
+	__m128i isDenormal = _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), absBits);
+	__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(magicBits))), magicBits);
+
+	// Normals
+	__m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(absBits, 13), _mm_set1_epi32(1));
+	__m128i rounded = _mm_add_epi32(_mm_add_epi32(absBits, _mm_set1_epi32(0xfff - ((127 - 15) << 23))), mantissaOdd);
+	__m128i normal = _mm_srli_epi32(rounded, 13);
+
+	__m128i result = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+	result = _mm_or_si128(_mm_and_si128(isRegular, result), _mm_andnot_si128(isRegular, special));
+	return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+// Encodes everything but the position for four vertices, each lane of the outputs is one vertex's packed pair
+static void EncodeAttributes4(const VertexColumns& c, __m128 handedness, __m128i& normals, __m128i& tangents, __m128i& uvs)
+{
+	__m128 nu, nv, tu, tv;
+	OctEncode4(c.nx, c.ny, c.nz, nu, nv);
+	OctEncode4(c.tx, c.ty, c.tz, tu, tv);
+
+	__m128 tw = _mm_add_ps(_mm_mul_ps(tv, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f));
+	tw = _mm_min_ps(_mm_max_ps(tw, _mm_set1_ps(MinTangentMagnitude)), _mm_set1_ps(1.0f));
+	tw = CopySign(tw, handedness);
+
+	// Interleave the 16-bit results into (first, second) pairs
+	__m128i firsts = _mm_packs_epi32(ToSnorm16x4(nu), ToSnorm16x4(tu));
+	__m128i seconds = _mm_packs_epi32(ToSnorm16x4(nv), ToSnorm16x4(tw));
+	normals = _mm_unpacklo_epi16(firsts, seconds);
+	tangents = _mm_unpackhi_epi16(firsts, seconds);
+
+	__m128i halves = _mm_packs_epi32(FloatToHalf4(c.u), FloatToHalf4(c.v));
+	uvs = _mm_unpacklo_epi16(halves, _mm_srli_si128(halves, 8));
+}
+
+// ---------------------- VERTEX COMPRESSOR ----------------------
+
+HRESULT VertexCompressor::CreateInputLayout(ID3D11Device* device, LPCWSTR shaderFile, bool quantizedPositions, ID3D11InputLayout** inputLayout)
+{
+	ID3DBlob* shaderBlob = nullptr;
+	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
+	if (FAILED(hr))
+		return hr;
+
+	hr = device->CreateInputLayout(
+		quantizedPositions ? QuantizedLayout : CompactLayout,
+		4,
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		inputLayout);
+
+	shaderBlob->Release();
+	return hr;
+}
+
+void VertexCompressor::CalculateHandedness(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, std::vector<float>& handedness)
+{
+	// Sum up the uv derived bitangent of every triangle around each vertex (same math as Mesh::CalculateTangents)
+	std::vector<DirectX::XMFLOAT3> bitangents(numVerts, DirectX::XMFLOAT3(0, 0, 0));
+	for (int i = 0; i + 2 < numIndices; i += 3)
+	{
+		const Vertex& v1 = verts[indices[i]];
+		const Vertex& v2 = verts[indices[i + 1]];
+		const Vertex& v3 = verts[indices[i + 2]];
+
+		float x1 = v2.position.x - v1.position.x;
+		float y1 = v2.position.y - v1.position.y;
+		float z1 = v2.position.z - v1.position.z;
+		float x2 = v3.position.x - v1.position.x;
+		float y2 = v3.position.y - v1.position.y;
+		float z2 = v3.position.z - v1.position.z;
+
+		float s1 = v2.uv.x - v1.uv.x;
+		float t1 = v2.uv.y - v1.uv.y;
+		float s2 = v3.uv.x - v1.uv.x;
+		float t2 = v3.uv.y - v1.uv.y;
+
+		// Only the sign matters, so skip the divide (and degenerate uvs along with it)
+		float det = s1 * t2 - s2 * t1;
+		if (det == 0.0f)
+			continue;
+		float r = det > 0.0f ? 1.0f : -1.0f;
+
+		DirectX::XMFLOAT3 b((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
+		for (int c = 0; c < 3; c++)
+		{
+			DirectX::XMFLOAT3& sum = bitangents[indices[i + c]];
+			sum.x += b.x;
+			sum.y += b.y;
+			sum.z += b.z;
+		}
+	}
+
+	// The shaders build their bitangent as cross(tangent, normal), which is right whenever the uvs aren't
+	// mirrored (the v derivative then lines up with cross(normal, tangent), since v is flipped on import), so
+	// that side counts as +1 and mirrored uvs as -1 (VertexShaderCompact hands this on to flip the bitangent)
+	handedness.resize(numVerts);
+	for (int i = 0; i < numVerts; i++)
+	{
+		DirectX::XMVECTOR normal = DirectX::XMLoadFloat3(&verts[i].normal);
+		DirectX::XMVECTOR tangent = DirectX::XMLoadFloat3(&verts[i].tangent);
+		DirectX::XMVECTOR bitangent = DirectX::XMLoadFloat3(&bitangents[i]);
+		float side = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVector3Cross(normal, tangent), bitangent));
+		handedness[i] = side < 0.0f ? -1.0f : 1.0f;
+	}
+}
+
+void VertexCompressor::Encode(const Vertex* verts, int numVerts, const float* handedness, CompactVertex* out)
+{
+	int i = 0;
+	for (; i + 4 <= numVerts; i += 4)
+	{
+		VertexColumns c;
+		LoadColumns(verts + i, c);
+
+		__m128i normals, tangents, uvs;
+		EncodeAttributes4(c, handedness ? _mm_loadu_ps(handedness + i) : _mm_set1_ps(1.0f), normals, tangents, uvs);
+
+		alignas(16) unsigned int packed[3][4];
+		_mm_store_si128((__m128i*)packed[0], normals);
+		_mm_store_si128((__m128i*)packed[1], tangents);
+		_mm_store_si128((__m128i*)packed[2], uvs);
+		for (int k = 0; k < 4; k++)
+		{
+			out[i + k].position = verts[i + k].position;
+			memcpy(out[i + k].normal, &packed[0][k], 4);
+			memcpy(out[i + k].tangent, &packed[1][k], 4);
+			memcpy(out[i + k].uv, &packed[2][k], 4);
+		}
+	}
+
+	// Leftovers
+	EncodeScalar(verts + i, numVerts - i, handedness ? handedness + i : nullptr, out + i);
+}
+
+void VertexCompressor::EncodeScalar(const Vertex* verts, int numVerts, const float* handedness, CompactVertex* out)
+{
+	for (int i = 0; i < numVerts; i++)
+	{
+		out[i].position = verts[i].position;
+		EncodeAttributes(verts[i], handedness ? handedness[i] : 1.0f, out[i].normal, out[i].tangent, out[i].uv);
+	}
+}
+
+void VertexCompressor::EncodeQuantized(const Vertex* verts, int numVerts, const float* handedness, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, QuantizedVertex* out)
+{
+	// Flat axes all quantize to zero
+	float extent[3] = { boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z };
+	float scale[3];
+	for (int a = 0; a < 3; a++)
+		scale[a] = extent[a] > 0.0f ? 65535.0f / extent[a] : 0.0f;
+
+	__m128 minX = _mm_set1_ps(boundsMin.x), minY = _mm_set1_ps(boundsMin.y), minZ = _mm_set1_ps(boundsMin.z);
+	__m128 scaleX = _mm_set1_ps(scale[0]), scaleY = _mm_set1_ps(scale[1]), scaleZ = _mm_set1_ps(scale[2]);
+	__m128 zero = _mm_setzero_ps();
+	__m128 top = _mm_set1_ps(65535.0f);
+
+	// Unorms are biased down by 32768 so the signed pack works, then flipped back with the xor
+	__m128i bias = _mm_set1_epi32(32768);
+	__m128i flip = _mm_set1_epi16((short)0x8000);
+
+	int i = 0;
+	for (; i + 4 <= numVerts; i += 4)
+	{
+		VertexColumns c;
+		LoadColumns(verts + i, c);
+
+		__m128i qx = _mm_sub_epi32(_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(c.px, minX), scaleX), zero), top)), bias);
+		__m128i qy = _mm_sub_epi32(_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(c.py, minY), scaleY), zero), top)), bias);
+		__m128i qz = _mm_sub_epi32(_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(c.pz, minZ), scaleZ), zero), top)), bias);
+
+		__m128i xy = _mm_xor_si128(_mm_packs_epi32(qx, qy), flip);
+		__m128i zw = _mm_xor_si128(_mm_packs_epi32(qz, _mm_sub_epi32(_mm_setzero_si128(), bias)), flip);
+		xy = _mm_unpacklo_epi16(xy, _mm_srli_si128(xy, 8));
+		zw = _mm_unpacklo_epi16(zw, _mm_srli_si128(zw, 8));
+
+		alignas(16) unsigned long long positions[4];
+		_mm_store_si128((__m128i*)positions, _mm_unpacklo_epi32(xy, zw));
+		_mm_store_si128((__m128i*)(positions + 2), _mm_unpackhi_epi32(xy, zw));
+
+		__m128i normals, tangents, uvs;
+		EncodeAttributes4(c, handedness ? _mm_loadu_ps(handedness + i) : _mm_set1_ps(1.0f), normals, tangents, uvs);
+
+		alignas(16) unsigned int packed[3][4];
+		_mm_store_si128((__m128i*)packed[0], normals);
+		_mm_store_si128((__m128i*)packed[1], tangents);
+		_mm_store_si128((__m128i*)packed[2], uvs);
+		for (int k = 0; k < 4; k++)
+		{
+			memcpy(out[i + k].position, &positions[k], 8);
+			memcpy(out[i + k].normal, &packed[0][k], 4);
+			memcpy(out[i + k].tangent, &packed[1][k], 4);
+			memcpy(out[i + k].uv, &packed[2][k], 4);
+		}
+	}
+
+	// Leftovers
+	for (; i < numVerts; i++)
+	{
+		const DirectX::XMFLOAT3& p = verts[i].position;
+		out[i].position[0] = (unsigned short)lrintf(Clamp((p.x - boundsMin.x) * scale[0], 0.0f, 65535.0f));
+		out[i].position[1] = (unsigned short)lrintf(Clamp((p.y - boundsMin.y) * scale[1], 0.0f, 65535.0f));
+		out[i].position[2] = (unsigned short)lrintf(Clamp((p.z - boundsMin.z) * scale[2], 0.0f, 65535.0f));
+		out[i].position[3] = 0;
+		EncodeAttributes(verts[i], handedness ? handedness[i] : 1.0f, out[i].normal, out[i].tangent, out[i].uv);
+	}
+}
+
+void VertexCompressor::Decode(const CompactVertex* verts, int numVerts, Vertex* out, float* handedness)
+{
+	for (int i = 0; i < numVerts; i++)
+	{
+		out[i].position = verts[i].position;
+		DecodeAttributes(verts[i].normal, verts[i].tangent, verts[i].uv, out[i], handedness ? handedness + i : nullptr);
+	}
+}
+
+void VertexCompressor::DecodeQuantized(const QuantizedVertex* verts, int numVerts, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, Vertex* out, float* handedness)
+{
+	// Matches DequantizePosition() in ShaderShared.hlsli
+	DirectX::XMFLOAT3 step((boundsMax.x - boundsMin.x) / 65535.0f, (boundsMax.y - boundsMin.y) / 65535.0f, (boundsMax.z - boundsMin.z) / 65535.0f);
+	for (int i = 0; i < numVerts; i++)
+	{
+		out[i].position.x = boundsMin.x + verts[i].position[0] * step.x;
+		out[i].position.y = boundsMin.y + verts[i].position[1] * step.y;
+		out[i].position.z = boundsMin.z + verts[i].position[2] * step.z;
+		DecodeAttributes(verts[i].normal, verts[i].tangent, verts[i].uv, out[i], handedness ? handedness + i : nullptr);
+	}
+}
+
+// Angle between two vectors in degrees, zero length vectors don't count
+static float AngleBetween(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+	float lengths = sqrtf((a.x * a.x + a.y * a.y + a.z * a.z) * (b.x * b.x + b.y * b.y + b.z * b.z));
+	if (lengths == 0.0f)
+		return 0.0f;
+
+	float cosine = Clamp((a.x * b.x + a.y * b.y + a.z * b.z) / lengths, -1.0f, 1.0f);
+	return DirectX::XMConvertToDegrees(acosf(cosine));
+}
+
+VertexErrorStats VertexCompressor::MeasureError(const Vertex* original, const Vertex* decoded, int numVerts, const float* handedness, const float* decodedHandedness)
+{
+	VertexErrorStats stats = {};
+	for (int i = 0; i < numVerts; i++)
+	{
+		const Vertex& a = original[i];
+		const Vertex& b = decoded[i];
+
+		float position = fmaxf(fabsf(a.position.x - b.position.x), fmaxf(fabsf(a.position.y - b.position.y), fabsf(a.position.z - b.position.z)));
+		float uv = fmaxf(fabsf(a.uv.x - b.uv.x), fabsf(a.uv.y - b.uv.y));
+		stats.positionError = fmaxf(stats.positionError, position);
+		stats.uvError = fmaxf(stats.uvError, uv);
+		stats.normalAngle = fmaxf(stats.normalAngle, AngleBetween(a.normal, b.normal));
+		stats.tangentAngle = fmaxf(stats.tangentAngle, AngleBetween(a.tangent, b.tangent));
+
+		float expected = handedness ? handedness[i] : 1.0f;
+		if (decodedHandedness && decodedHandedness[i] != expected)
+			stats.handednessFlips++;
+	}
+
+	return stats;
+}
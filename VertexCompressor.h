@@ -0,0 +1,44 @@
+#pragma once
+#include <d3d11.h>
+#include <vector>
+
+#include "Vertex.h"
+
+// Largest differences between a set of vertices and their compressed versions
+struct VertexErrorStats
+{
+	float positionError;    // World units
+	float normalAngle;      // Degrees
+	float tangentAngle;     // Degrees
+	float uvError;
+	int handednessFlips;
+};
+
+// Converts Vertex data into the CompactVertex/QuantizedVertex layouts
+// - Encoding works on four vertices at a time with SSE2, with a scalar tail
+// - Decoding is only here to measure error, the GPU does the real decoding (see ShaderShared.hlsli)
+class VertexCompressor
+{
+public:
+	// Input layouts matching each compressed vertex struct
+	static const D3D11_INPUT_ELEMENT_DESC CompactLayout[4];
+	static const D3D11_INPUT_ELEMENT_DESC QuantizedLayout[4];
+
+	// Creates an input layout for one of the compressed formats, validated against a compiled vertex shader (.cso)
+	static HRESULT CreateInputLayout(ID3D11Device* device, LPCWSTR shaderFile, bool quantizedPositions, ID3D11InputLayout** inputLayout);
+
+	// Finds the sign of each vertex's bitangent relative to cross(tangent, normal), which is what the shaders assume
+	static void CalculateHandedness(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, std::vector<float>& handedness);
+
+	// Encoders, handedness may be null (all right handed)
+	static void Encode(const Vertex* verts, int numVerts, const float* handedness, CompactVertex* out);
+	static void EncodeQuantized(const Vertex* verts, int numVerts, const float* handedness, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, QuantizedVertex* out);
+	static void EncodeScalar(const Vertex* verts, int numVerts, const float* handedness, CompactVertex* out);
+
+	// Decoders, the handedness of each vertex is written to handedness when it isn't null
+	static void Decode(const CompactVertex* verts, int numVerts, Vertex* out, float* handedness);
+	static void DecodeQuantized(const QuantizedVertex* verts, int numVerts, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, Vertex* out, float* handedness);
+
+	// Compares original and decoded vertices
+	static VertexErrorStats MeasureError(const Vertex* original, const Vertex* decoded, int numVerts, const float* handedness, const float* decodedHandedness);
+};
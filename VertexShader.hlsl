@@ -6,6 +6,7 @@ cbuffer ExternalData : register(b0)
 {
 	float4 colorTint;
 	matrix world;
+	matrix worldInvTranspose;	// Upper 3x3 transforms normals, even with non-uniform scale
 	matrix view;
 	matrix proj;
 }
@@ -25,7 +26,7 @@ VertexToPixel main( VertexShaderInput input )
 	// Calculate and apply world view projection matrix
 	matrix wvp = mul(proj, mul(view, world));
 	output.position = mul(wvp, float4(input.position, 1.0f));
-	output.normal = normalize(mul((float3x3)world, input.normal));			// TODO: Update the world position to be the inverse transpose when passing in
+	output.normal = mul((float3x3)worldInvTranspose, input.normal);		// Normalized in the pixel shader, after interpolation
 	
 	// Calculate vert's world position
 	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
@@ -0,0 +1,45 @@
+#include "ShaderShared.hlsli"
+
+// Creating cbuffer
+cbuffer ExternalData : register(b0)
+{
+	float4 colorTint;
+	matrix world;
+	matrix worldInvTranspose;	// Upper 3x3 transforms normals, even with non-uniform scale
+	matrix view;
+	matrix proj;
+	float3 quantizeMin;		// Mesh bounds for quantized positions, (0, 0, 0)
+	float3 quantizeExtent;	// and (1, 1, 1) for full float positions
+}
+
+// --------------------------------------------------------
+// Same as VertexShaderNormal, but reads the compressed vertex formats
+// 
+// - Needs an input layout from VertexCompressor::CreateInputLayout()
+// - Passes the tangent's handedness on in its W, so mirrored uvs
+//   get their bitangent flipped in the pixel shader
+// --------------------------------------------------------
+VertexToPixelWithTangent main(CompactVertexShaderInput compactInput)
+{
+	// Expand the vertex, then carry on as usual
+	float handedness;
+	VertexShaderInput input = DecodeCompactVertex(compactInput, quantizeMin, quantizeExtent, handedness);
+	VertexToPixelWithTangent output;
+
+	// Calculate and apply world view projection matrix
+	matrix wvp = mul(proj, mul(view, world));
+	output.position = mul(wvp, float4(input.position, 1.0f));
+	output.normal = mul((float3x3)worldInvTranspose, input.normal);		// Normalized in the pixel shader, after interpolation
+
+	// Calculate vert's world position
+	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
+
+	// Tangents lie in the surface, so they follow the world matrix itself
+	output.tangent = float4(mul((float3x3)world, input.tangent), handedness);
+
+	// Pass the color and uv through 
+	output.color = colorTint;
+	output.uv = input.uv;
+
+	return output;
+}
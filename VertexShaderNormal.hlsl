@@ -5,6 +5,7 @@ cbuffer ExternalData : register(b0)
 {
 	float4 colorTint;
 	matrix world;
+	matrix worldInvTranspose;	// Upper 3x3 transforms normals, even with non-uniform scale
 	matrix view;
 	matrix proj;
 }
@@ -24,14 +25,16 @@ VertexToPixelWithTangent main(VertexShaderInput input)
 	// Calculate and apply world view projection matrix
 	matrix wvp = mul(proj, mul(view, world));
 	output.position = mul(wvp, float4(input.position, 1.0f));
-	output.normal = normalize(mul((float3x3)world, input.normal));			// TODO: Update the world position to be the inverse transpose when passing in
+	output.normal = mul((float3x3)worldInvTranspose, input.normal);		// Normalized in the pixel shader, after interpolation
 
 	// Calculate vert's world position
 	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
 
-	// Pass the color, tangent, and uv through 
+	// Tangents lie in the surface, so they follow the world matrix itself (full vertices are always right handed)
+	output.tangent = float4(mul((float3x3)world, input.tangent), 1.0f);
+
+	// Pass the color and uv through 
 	output.color = colorTint;
-	output.tangent = input.tangent;
 	output.uv = input.uv;
 
 